@@ -0,0 +1,255 @@
+/*!
+ * \file
+ * \brief Файл реализации класса ArenaNoteStorage.
+ */
+#include "arenanotestorage.hpp"
+
+#include <algorithm> // max()
+#include <iterator> // next()
+
+namespace
+{
+
+//! Наименьший размер буферов в символах, при котором проверяется их заполнение.
+const std::size_t minReclaimSize = 1024 * 1024;
+
+}
+
+/*!
+ * \brief Буферы символов и массивы ячеек хранилища ArenaNoteStorage.
+ *
+ * Является источником данных ленивых заметок снимка: номер записи —
+ * это номер ячейки.
+ */
+class ArenaNoteStorage::Arena : public NoteSource
+{
+public:
+    QString title(quint32 record) const Q_DECL_OVERRIDE
+    {
+        return QString(titles.data() + titleOffsets[record], titleLengths[record]);
+    }
+    QString text(quint32 record) const Q_DECL_OVERRIDE
+    {
+        return QString(texts.data() + textOffsets[record], textLengths[record]);
+    }
+    int textLength(quint32 record) const Q_DECL_OVERRIDE
+    {
+        return static_cast<int>(textLengths[record]);
+    }
+
+    //! Дописывает заголовок и текст заметки \a note в буферы и помещает их в ячейку \a idx.
+    void store(SizeType idx, const Note &note)
+    {
+        QString title = note.title();
+        QString text = note.text();
+        titleOffsets[idx] = put(titles, title.constData(), title.size());
+        titleLengths[idx] = title.size();
+        textOffsets[idx] = put(texts, text.constData(), text.size());
+        textLengths[idx] = text.size();
+    }
+    //! Дописывает в буферы строки ячейки \a from буферов \a other и помещает их в ячейку \a idx.
+    void copy(const Arena &other, SizeType from, SizeType idx)
+    {
+        titleOffsets[idx] = put(titles, other.titles.data() + other.titleOffsets[from], other.titleLengths[from]);
+        titleLengths[idx] = other.titleLengths[from];
+        textOffsets[idx] = put(texts, other.texts.data() + other.textOffsets[from], other.textLengths[from]);
+        textLengths[idx] = other.textLengths[from];
+    }
+    //! Вставляет пустую ячейку перед ячейкой \a idx.
+    void insertSlot(SizeType idx)
+    {
+        titleOffsets.insert(std::next(titleOffsets.begin(), idx), 0);
+        titleLengths.insert(std::next(titleLengths.begin(), idx), 0);
+        textOffsets.insert(std::next(textOffsets.begin(), idx), 0);
+        textLengths.insert(std::next(textLengths.begin(), idx), 0);
+    }
+    //! Изменяет количество ячеек на \a size.
+    void resizeSlots(SizeType size)
+    {
+        titleOffsets.resize(size);
+        titleLengths.resize(size);
+        textOffsets.resize(size);
+        textLengths.resize(size);
+    }
+    //! Возвращает количество символов, на которые ссылаются ячейки.
+    std::size_t liveSize() const
+    {
+        std::size_t live = 0;
+        for (SizeType i = 0; i < titleLengths.size(); ++i)
+        {
+            live += static_cast<std::size_t>(titleLengths[i]) + static_cast<std::size_t>(textLengths[i]);
+        }
+        return live;
+    }
+
+    //! Символы заголовков.
+    std::vector<QChar> titles;
+    //! Символы текстов.
+    std::vector<QChar> texts;
+    //! Смещения заголовков ячеек в titles.
+    std::vector<quint64> titleOffsets;
+    //! Длины заголовков ячеек в символах.
+    std::vector<int> titleLengths;
+    //! Смещения текстов ячеек в texts.
+    std::vector<quint64> textOffsets;
+    //! Длины текстов ячеек в символах.
+    std::vector<int> textLengths;
+
+private:
+    //! Дописывает \a size символов \a s в конец буфера \a chars и возвращает их смещение.
+    static quint64 put(std::vector<QChar> &chars, const QChar *s, int size)
+    {
+        quint64 offset = chars.size();
+        chars.insert(chars.end(), s, s + size);
+        return offset;
+    }
+};
+
+ArenaNoteStorage::ArenaNoteStorage()
+    : mArena(std::make_shared<Arena>())
+    , mReclaimAt(minReclaimSize)
+{
+}
+
+ArenaNoteStorage::SizeType ArenaNoteStorage::size() const
+{
+    return mArena->titleOffsets.size();
+}
+
+Note ArenaNoteStorage::note(SizeType idx) const
+{
+    return Note(title(idx), text(idx));
+}
+
+QString ArenaNoteStorage::title(SizeType idx) const
+{
+    return mArena->title(static_cast<quint32>(idx));
+}
+
+QString ArenaNoteStorage::text(SizeType idx) const
+{
+    return mArena->text(static_cast<quint32>(idx));
+}
+
+/*!
+ * Заметки снимка не копируют строки, а ссылаются на буферы. Пока снимок
+ * существует, изменение хранилища копирует буферы (см. writable()).
+ */
+std::vector<Note> ArenaNoteStorage::snapshot() const
+{
+    std::shared_ptr<const NoteSource> source = mArena;
+    std::vector<Note> notes;
+    notes.reserve(size());
+    for (SizeType i = 0; i < size(); ++i)
+    {
+        notes.emplace_back(source, static_cast<quint32>(i));
+    }
+    return notes;
+}
+
+void ArenaNoteStorage::set(SizeType idx, Note note)
+{
+    // Прежние строки ячейки остаются в буферах до уплотнения
+    writable().store(idx, note);
+    reclaim();
+}
+
+void ArenaNoteStorage::insert(SizeType idx, Note note)
+{
+    Arena &arena = writable();
+    arena.insertSlot(idx);
+    arena.store(idx, note);
+    reclaim();
+}
+
+void ArenaNoteStorage::append(std::vector<Note> notes)
+{
+    Arena &arena = writable();
+    SizeType first = size();
+    arena.resizeSlots(first + notes.size());
+    for (SizeType i = 0; i < notes.size(); ++i)
+    {
+        arena.store(first + i, notes[i]);
+    }
+    reclaim();
+}
+
+void ArenaNoteStorage::move(SizeType from, SizeType to)
+{
+    // Переносятся только смещения и длины, символы остаются на месте
+    Arena &arena = writable();
+    arena.titleOffsets[to] = arena.titleOffsets[from];
+    arena.titleLengths[to] = arena.titleLengths[from];
+    arena.textOffsets[to] = arena.textOffsets[from];
+    arena.textLengths[to] = arena.textLengths[from];
+}
+
+void ArenaNoteStorage::resize(SizeType size)
+{
+    writable().resizeSlots(size);
+}
+
+void ArenaNoteStorage::erase(SizeType first, SizeType last)
+{
+    Arena &arena = writable();
+    arena.titleOffsets.erase(std::next(arena.titleOffsets.begin(), first), std::next(arena.titleOffsets.begin(), last));
+    arena.titleLengths.erase(std::next(arena.titleLengths.begin(), first), std::next(arena.titleLengths.begin(), last));
+    arena.textOffsets.erase(std::next(arena.textOffsets.begin(), first), std::next(arena.textOffsets.begin(), last));
+    arena.textLengths.erase(std::next(arena.textLengths.begin(), first), std::next(arena.textLengths.begin(), last));
+}
+
+void ArenaNoteStorage::clear()
+{
+    // Снимки продолжают ссылаться на прежние буферы
+    mArena = std::make_shared<Arena>();
+    mReclaimAt = minReclaimSize;
+}
+
+/*!
+ * Если буферы разделяются со снимком, который может читаться в рабочем
+ * потоке, изменять их нельзя, поэтому хранилище получает собственную копию.
+ */
+ArenaNoteStorage::Arena &ArenaNoteStorage::writable()
+{
+    if (mArena.use_count() > 1)
+    {
+        mArena = std::make_shared<Arena>(*mArena);
+    }
+    return *mArena;
+}
+
+/*!
+ * Заполнение проверяется, только когда буферы вырастают вдвое с прошлой
+ * проверки, поэтому подсчёт используемых символов (линейный по количеству
+ * ячеек) в среднем не замедляет изменения. Ячейки, оставшиеся за пределами
+ * записной книжки (промежуток Notebook), переносятся вместе с остальными.
+ */
+void ArenaNoteStorage::reclaim()
+{
+    std::size_t used = mArena->titles.size() + mArena->texts.size();
+    if (used < mReclaimAt)
+    {
+        return;
+    }
+    std::size_t live = mArena->liveSize();
+    if (live * 2 < used)
+    {
+        const Arena &old = *mArena;
+        std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+        arena->resizeSlots(size());
+        std::size_t titleSize = 0;
+        for (int length : old.titleLengths)
+        {
+            titleSize += static_cast<std::size_t>(length);
+        }
+        arena->titles.reserve(titleSize);
+        arena->texts.reserve(live - titleSize);
+        for (SizeType i = 0; i < size(); ++i)
+        {
+            arena->copy(old, i, i);
+        }
+        mArena = arena;
+        used = live;
+    }
+    mReclaimAt = std::max(minReclaimSize, used * 2);
+}
@@ -0,0 +1,76 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса ArenaNoteStorage.
+ */
+#ifndef ARENANOTESTORAGE_HPP
+#define ARENANOTESTORAGE_HPP
+
+#include <cstddef> // size_t
+#include <memory> // shared_ptr
+#include <vector>
+
+#include "notestorage.hpp"
+
+/*!
+ * \brief Хранилище заметок в общих непрерывных буферах (\e аренах).
+ *
+ * Вектор объектов Note (VectorNoteStorage) выделяет память под заголовок
+ * и текст каждой заметки отдельно, поэтому миллион заметок — это миллионы
+ * выделений памяти и разбросанные по куче строки. Здесь же символы всех
+ * заголовков лежат подряд в одном буфере, символы всех текстов — в другом,
+ * а ячейка — это лишь смещения и длины строк в буферах, хранящиеся в
+ * отдельных массивах (структура массивов). Загрузка и вставка заметок
+ * сводятся к дописыванию символов в конец буферов, буферы растут
+ * геометрически, и на миллион заметок приходится несколько десятков
+ * выделений памяти. Перенос ячейки — это копирование смещений, а не строк.
+ *
+ * Объекты Note создаются только по требованию: operator[] записной книжки
+ * и диалог редактирования получают заметку с копиями строк (note()), а
+ * заголовки для видов читаются прямо из буфера (title()). Снимок (snapshot())
+ * состоит из ленивых заметок, читающих из тех же буферов: буферы разделяются
+ * со снимком, пока хранилище не изменится, а при первом изменении хранилище
+ * копирует их (копирование при записи), не трогая снимок.
+ *
+ * При замене и удалении заметок их прежние строки остаются в буферах.
+ * Когда неиспользуемые символы составляют больше половины буферов,
+ * буферы уплотняются.
+ *
+ * Тексты в буферах хранятся несжатыми, поэтому сжатие текстов в памяти
+ * (setTextCompression()) не поддерживается; на сжатие при сохранении
+ * в файл это не влияет.
+ */
+class ArenaNoteStorage : public NoteStorage
+{
+public:
+    //! Конструктор по умолчанию.
+    ArenaNoteStorage();
+
+    SizeType size() const Q_DECL_OVERRIDE;
+    Note note(SizeType idx) const Q_DECL_OVERRIDE;
+    QString title(SizeType idx) const Q_DECL_OVERRIDE;
+    QString text(SizeType idx) const Q_DECL_OVERRIDE;
+    std::vector<Note> snapshot() const Q_DECL_OVERRIDE;
+    void set(SizeType idx, Note note) Q_DECL_OVERRIDE;
+    void insert(SizeType idx, Note note) Q_DECL_OVERRIDE;
+    void append(std::vector<Note> notes) Q_DECL_OVERRIDE;
+    void move(SizeType from, SizeType to) Q_DECL_OVERRIDE;
+    void resize(SizeType size) Q_DECL_OVERRIDE;
+    void erase(SizeType first, SizeType last) Q_DECL_OVERRIDE;
+    void clear() Q_DECL_OVERRIDE;
+
+private:
+    // Буферы и массивы ячеек; определены в файле реализации
+    class Arena;
+
+    //! Возвращает буферы для изменения, предварительно отделив их от снимков.
+    Arena &writable();
+    //! Уплотняет буферы, если неиспользуемые символы составляют больше их половины.
+    void reclaim();
+
+    //! Буферы и массивы ячеек, разделяемые со снимками.
+    std::shared_ptr<Arena> mArena;
+    //! Размер буферов в символах, при котором reclaim() проверит их заполнение.
+    std::size_t mReclaimAt;
+};
+
+#endif // ARENANOTESTORAGE_HPP
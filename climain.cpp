@@ -0,0 +1,175 @@
+/*!
+ * \file
+ * \brief Файл главной функции консольной программы toynote-cli.
+ */
+#include <cstdio> // stdout, stderr
+#include <exception>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "config.hpp"
+#include "notebooktool.hpp"
+#include "notestorage.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+//! Описание команд для справки.
+const char commandsHelp[] = QT_TRANSLATE_NOOP("NotebookTool",
+    "Commands:\n"
+    "  list FILE...            print the titles of the notes\n"
+    "  grep PATTERN FILE...    print the notes containing PATTERN\n"
+    "  count FILE...           print the number of the notes\n"
+    "  export FILE TEXT        write the notes to TEXT (.txt, .md or .jsonl)\n"
+    "  import TEXT FILE        read the notes from TEXT (.txt, .md or .jsonl)\n"
+    "  merge OUTPUT FILE...    write the notes of all FILEs to OUTPUT\n"
+    "  compact FILE...         rewrite FILEs in the current format\n"
+    "  verify FILE...          check the structure and checksums of FILEs\n"
+    "  salvage FILE OUTPUT     write the intact notes of a damaged FILE to OUTPUT\n"
+    "  generate COUNT FILE     write COUNT synthetic notes to FILE\n"
+    "  bench                   measure the performance of notebook operations");
+
+}
+
+/*!
+ * \brief main
+ * \param argc количество параметров командной строки
+ * \param argv параметры командной строки
+ * \return код результата
+ *
+ * Главная функция консольной программы. Разбирает командную строку и
+ * выполняет команду методом класса NotebookTool.
+ */
+int main(int argc, char *argv[])
+{
+    // Консольной программе достаточно QCoreApplication: окон и событий
+    // графического интерфейса нет
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("toynote-cli"));
+    QCoreApplication::setApplicationVersion(QString::fromLatin1(Config::applicationVersion));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(NotebookTool::tr(commandsHelp));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QStringLiteral("command"), NotebookTool::tr("Command to execute."),
+                                 NotebookTool::tr("command [arguments...]"));
+    QCommandLineOption ignoreCase({ QStringLiteral("i"), QStringLiteral("ignore-case") },
+                                  NotebookTool::tr("grep: ignore case."));
+    QCommandLineOption regExp({ QStringLiteral("E"), QStringLiteral("regexp") },
+                              NotebookTool::tr("grep: PATTERN is a regular expression."));
+    QCommandLineOption compress({ QStringLiteral("c"), QStringLiteral("compress") },
+                                NotebookTool::tr("import, merge, compact, salvage: compress the texts of the notes."));
+    QCommandLineOption seed(QStringLiteral("seed"), NotebookTool::tr("generate, bench: generator seed."),
+                            NotebookTool::tr("number"), QStringLiteral("1"));
+    QCommandLineOption notes(QStringLiteral("notes"), NotebookTool::tr("bench: number of notes."),
+                             NotebookTool::tr("number"), QStringLiteral("100000"));
+    QCommandLineOption storage(QStringLiteral("storage"),
+                               NotebookTool::tr("bench: note storage (%1).").arg(NoteStorage::kinds().join(QStringLiteral(", "))),
+                               NotebookTool::tr("kind"), NoteStorage::defaultKind());
+    QCommandLineOption repeat(QStringLiteral("repeat"), NotebookTool::tr("bench: repetitions of each operation."),
+                              NotebookTool::tr("number"), QStringLiteral("3"));
+    QCommandLineOption json(QStringLiteral("json"), NotebookTool::tr("bench: write the results to a JSON file."),
+                            NotebookTool::tr("file"));
+    QCommandLineOption baseline(QStringLiteral("baseline"),
+                                NotebookTool::tr("bench: compare the times with a JSON file of earlier results."),
+                                NotebookTool::tr("file"));
+    QCommandLineOption trace(QStringLiteral("trace"),
+                             NotebookTool::tr("Write a Chrome trace of the command to a JSON file."),
+                             NotebookTool::tr("file"));
+    parser.addOption(ignoreCase);
+    parser.addOption(regExp);
+    parser.addOption(compress);
+    parser.addOption(seed);
+    parser.addOption(notes);
+    parser.addOption(storage);
+    parser.addOption(repeat);
+    parser.addOption(json);
+    parser.addOption(baseline);
+    parser.addOption(trace);
+    parser.process(a);
+    if (parser.isSet(trace))
+    {
+        Trace::start(parser.value(trace));
+    }
+    else
+    {
+        Trace::startFromEnvironment();
+    }
+
+    QStringList args = parser.positionalArguments();
+    QString command = args.isEmpty() ? QString() : args.takeFirst();
+    QTextStream out(stdout);
+    out.setCodec("UTF-8");
+    QTextStream err(stderr);
+    NotebookTool tool(out);
+    try
+    {
+        if (command == QLatin1String("list") && !args.isEmpty())
+        {
+            tool.list(args);
+        }
+        else if (command == QLatin1String("grep") && args.size() >= 2)
+        {
+            QString pattern = args.takeFirst();
+            NoteScanner::Mode mode = parser.isSet(regExp) ? NoteScanner::RegExp
+                                   : parser.isSet(ignoreCase) ? NoteScanner::CaseInsensitive
+                                                              : NoteScanner::Substring;
+            tool.grep(pattern, mode, args);
+        }
+        else if (command == QLatin1String("count") && !args.isEmpty())
+        {
+            tool.count(args);
+        }
+        else if (command == QLatin1String("export") && args.size() == 2)
+        {
+            tool.exportText(args[0], args[1]);
+        }
+        else if (command == QLatin1String("import") && args.size() == 2)
+        {
+            tool.importText(args[0], args[1], parser.isSet(compress));
+        }
+        else if (command == QLatin1String("merge") && args.size() >= 2)
+        {
+            QString output = args.takeFirst();
+            tool.merge(args, output, parser.isSet(compress));
+        }
+        else if (command == QLatin1String("compact") && !args.isEmpty())
+        {
+            tool.compact(args, parser.isSet(compress));
+        }
+        else if (command == QLatin1String("verify") && !args.isEmpty())
+        {
+            tool.verify(args);
+        }
+        else if (command == QLatin1String("salvage") && args.size() == 2)
+        {
+            tool.salvage(args[0], args[1], parser.isSet(compress));
+        }
+        else if (command == QLatin1String("generate") && args.size() == 2)
+        {
+            tool.generate(args[0].toUInt(), args[1], parser.value(seed).toULongLong(), parser.isSet(compress));
+        }
+        else if (command == QLatin1String("bench") && args.isEmpty())
+        {
+            tool.bench(parser.value(notes).toUInt(), parser.value(seed).toULongLong(), parser.value(storage),
+                       parser.value(repeat).toInt(), parser.value(json), parser.value(baseline));
+        }
+        else
+        {
+            err << parser.helpText();
+            return 2;
+        }
+        Trace::stop();
+    }
+    catch (const std::exception &e)
+    {
+        out.flush();
+        err << QCoreApplication::applicationName() << ": " << QString::fromUtf8(e.what()) << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -7,6 +7,8 @@
 #ifndef CONFIG
 #define CONFIG
 
+#include <cstddef> // size_t
+
 #include <QtGlobal> // QT_TRANSLATE_NOOP
 
 namespace Config
@@ -39,7 +41,119 @@ const char notebookFileNameFilter[] = QT_TRANSLATE_NOOP("Config", "Notebooks (*.
 /*!
  * \brief Фильтр для имён файлов записных книжек в текстовом формате.
  */
-const char textNotebookFileNameFilter[] = QT_TRANSLATE_NOOP("Config", "Text (*.txt);; Text (*.text)");
+const char textNotebookFileNameFilter[] = QT_TRANSLATE_NOOP("Config", "Text (*.txt);; Text (*.text);; Markdown (*.md);; JSON Lines (*.jsonl)");
+
+/*!
+ * \brief Порог размера журнала изменений в байтах.
+ *
+ * Когда журнал записной книжки становится больше порога, он уплотняется:
+ * в фоновом потоке записывается новый файл записной книжки, а журнал
+ * очищается (см. NotebookJournal).
+ */
+const qint64 journalCompactionThreshold = 16 * 1024 * 1024;
+
+/*!
+ * \brief Наибольший интервал между порциями заметок при фоновой загрузке, в миллисекундах.
+ *
+ * NotebookLoader передаёт прочитанные заметки записной книжке порциями.
+ * Короткий интервал позволяет пользователю видеть первые заметки почти сразу,
+ * а ограничение количества порций не даёт перегрузить очередь событий.
+ */
+const int loaderBatchInterval = 50;
+
+//! Наибольшее количество заметок в одной порции при фоновой загрузке.
+const int loaderBatchSize = 65536;
+
+/*!
+ * \brief Количество потоков общего пула фоновой работы (см. WorkerPool).
+ *
+ * В пуле загружаются, сохраняются и индексируются записные книжки всех
+ * вкладок. 0 означает количество ядер процессора.
+ */
+const int workerThreads = 0;
+
+/*!
+ * \brief Наибольший объём памяти, удерживаемой историей изменений, в байтах.
+ *
+ * Когда история отмены изменений (NotebookHistory) занимает больше,
+ * самые старые изменения забываются.
+ */
+const std::size_t historyMemoryLimit = 64 * 1024 * 1024;
+
+/*!
+ * \brief Размер кэша распакованных текстов заметок, в символах.
+ *
+ * Сжатые тексты заметок распаковываются при обращении к ним, последние
+ * распакованные тексты хранятся в кэше (см. NoteCodec).
+ */
+const int decodedTextCacheSize = 4 * 1024 * 1024;
+
+/*!
+ * \brief Размер части текста, добавляемой в редактор заметки за раз, в символах.
+ *
+ * Большой текст загружается в EditNoteDialog частями между обработкой
+ * событий, поэтому диалог открывается сразу и не замирает.
+ */
+const int editorChunkSize = 256 * 1024;
+
+/*!
+ * \brief Размер текста заметки, начиная с которого она открывается для просмотра, в символах.
+ *
+ * Такая заметка сначала показывается только для чтения (см. NotePreview):
+ * отрисовываются лишь видимые строки, поэтому просмотр не зависит от
+ * размера текста. Редактирование включается кнопкой диалога.
+ */
+const int notePreviewThreshold = 4 * 1024 * 1024;
+
+/*!
+ * \brief Вид хранилища заметок записной книжки по умолчанию (см. NoteStorage::defaultKind()).
+ *
+ * Другой вид можно выбрать при запуске параметром командной строки
+ * \c --storage.
+ *
+ * \c "vector" хранит каждую заметку отдельным объектом и поддерживает
+ * ленивую загрузку и сжатие текстов в памяти. \c "arena" хранит заголовки
+ * и тексты всех заметок в общих буферах, что требует гораздо меньше
+ * выделений памяти на больших записных книжках. \c "sqlite" держит заметки
+ * в базе данных SQLite во временном файле, а в памяти — лишь кэш страниц
+ * заголовков, так что расход памяти не зависит от размера записной книжки.
+ */
+const char noteStorage[] = "vector";
+
+/*!
+ * \brief Количество заголовков в странице кэша хранилища SQLite.
+ *
+ * Вид читает заголовки соседних строк подряд, поэтому SqliteNoteStorage
+ * запрашивает их у базы данных страницами, а не по одному.
+ */
+const int sqlitePageRows = 256;
+
+//! Наибольшее количество страниц заголовков в кэше хранилища SQLite.
+const int sqliteCachePages = 64;
+
+/*!
+ * \brief Размер страничного кэша самой SQLite, в килобайтах.
+ *
+ * Ограничивает память, которую библиотека SQLite держит под страницы
+ * базы данных (PRAGMA cache_size).
+ */
+const int sqliteCacheSize = 16 * 1024;
+
+/*!
+ * \brief Количество изменений хранилища SQLite в одной транзакции.
+ *
+ * Изменения накапливаются в открытой транзакции и фиксируются группой:
+ * фиксация каждой вставки по отдельности во много раз медленнее.
+ */
+const int sqliteCommitBatch = 4096;
+
+/*!
+ * \brief Переменная окружения, включающая трассировку.
+ *
+ * Если переменная задана, программа записывает продолжительность основных
+ * операций в файл, имя которого является значением переменной (см. Trace).
+ */
+const char traceVariable[] = "TOYNOTE_TRACE";
 
 }
 #endif // CONFIG
@@ -0,0 +1,152 @@
+/*!
+ * \file
+ * \brief Файл реализации класса Crc32c.
+ */
+#include "crc32c.hpp"
+
+#include <cstring> // memcpy()
+
+// Инструкция crc32 из SSE4.2 собирается, как и векторный поиск NoteScanner,
+// только для x86-64 компиляторами GCC и Clang: функция собирается для
+// SSE4.2 с помощью атрибута target, а поддержка процессором проверяется
+// при запуске. На ARM расширение CRC доступно, только если компилятору
+// разрешено его использовать (например, -march=armv8-a+crc)
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TOYNOTE_CRC_X86
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define TOYNOTE_CRC_ARM
+#include <arm_acle.h>
+#endif
+
+namespace
+{
+
+//! Тип функции вычисления суммы. Принимает и возвращает инвертированное значение суммы.
+using UpdateFunction = quint32 (*)(quint32 crc, const uchar *p, std::size_t size);
+
+//! Таблицы для вычисления суммы по 8 байтов за шаг (slicing-by-8).
+struct Tables
+{
+    //! Конструктор. Заполняет таблицы для отражённого многочлена CRC-32C.
+    Tables()
+    {
+        const quint32 polynomial = 0x82F63B78;
+        for (quint32 i = 0; i < 256; ++i)
+        {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = c & 1 ? (c >> 1) ^ polynomial : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (int k = 1; k < 8; ++k)
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+
+    //! Таблицы: t[k][b] — вклад байта b, за которым следуют k байтов.
+    quint32 t[8][256];
+};
+
+//! Вычисляет сумму по таблицам.
+quint32 updateTable(quint32 c, const uchar *p, std::size_t size)
+{
+    static const Tables tables;
+    const auto &t = tables.t;
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        quint32 lo = c ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<quint32>(p[3]) << 24);
+        quint32 hi = p[4] | p[5] << 8 | p[6] << 16 | static_cast<quint32>(p[7]) << 24;
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+          ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; size > 0; ++p, --size)
+    {
+        c = t[0][(c ^ *p) & 0xFF] ^ (c >> 8);
+    }
+    return c;
+}
+
+#ifdef TOYNOTE_CRC_X86
+//! Вычисляет сумму инструкциями SSE4.2, по 8 байтов за инструкцию.
+__attribute__((target("sse4.2")))
+quint32 updateSse42(quint32 c, const uchar *p, std::size_t size)
+{
+    quint64 c64 = c;
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        quint64 v;
+        std::memcpy(&v, p, sizeof(v));
+        c64 = _mm_crc32_u64(c64, v);
+    }
+    c = static_cast<quint32>(c64);
+    for (; size > 0; ++p, --size)
+    {
+        c = _mm_crc32_u8(c, *p);
+    }
+    return c;
+}
+#endif
+
+#ifdef TOYNOTE_CRC_ARM
+//! Вычисляет сумму инструкциями расширения CRC ARMv8, по 8 байтов за инструкцию.
+quint32 updateArm(quint32 c, const uchar *p, std::size_t size)
+{
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        quint64 v;
+        std::memcpy(&v, p, sizeof(v));
+        c = __crc32cd(c, v);
+    }
+    for (; size > 0; ++p, --size)
+    {
+        c = __crc32cb(c, *p);
+    }
+    return c;
+}
+#endif
+
+//! Функция вычисления суммы, выбранная для данного процессора.
+struct UpdateDispatch
+{
+    //! Функция вычисления.
+    UpdateFunction update;
+    //! Название реализации.
+    const char *name;
+};
+
+//! Выбирает функцию вычисления суммы по возможностям процессора.
+UpdateDispatch selectUpdate()
+{
+#if defined(TOYNOTE_CRC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return UpdateDispatch{ updateSse42, "sse4.2" };
+    }
+#elif defined(TOYNOTE_CRC_ARM)
+    return UpdateDispatch{ updateArm, "armv8-crc" };
+#endif
+    return UpdateDispatch{ updateTable, "table" };
+}
+
+//! Функция вычисления суммы. Выбирается один раз при запуске программы.
+const UpdateDispatch updateDispatch = selectUpdate();
+
+}
+
+quint32 Crc32c::update(quint32 crc, const void *data, std::size_t size)
+{
+    return ~updateDispatch.update(~crc, static_cast<const uchar *>(data), size);
+}
+
+const char *Crc32c::implementation()
+{
+    return updateDispatch.name;
+}
@@ -0,0 +1,35 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса Crc32c.
+ */
+#ifndef CRC32C_HPP
+#define CRC32C_HPP
+
+#include <cstddef> // size_t
+
+#include <QtGlobal> // quint32
+
+/*!
+ * \brief Класс вычисления контрольной суммы CRC-32C (Castagnoli).
+ *
+ * Используется для проверки записей файла записной книжки (см.
+ * NotebookFile). На процессорах x86-64 с SSE4.2 и ARMv8 с расширением CRC
+ * сумма вычисляется специальными инструкциями процессора, иначе — по
+ * таблицам, по 8 байтов за шаг. Реализация выбирается один раз при запуске
+ * программы. Методы можно вызывать из разных потоков одновременно.
+ */
+class Crc32c
+{
+public:
+    /*!
+     * \brief Продолжает вычисление суммы \a crc данными \a data размером \a size байт.
+     *
+     * Сумма пустых данных равна 0, поэтому сумма данных, разбитых на части,
+     * вычисляется последовательными вызовами, начиная с \a crc, равного 0.
+     */
+    static quint32 update(quint32 crc, const void *data, std::size_t size);
+    //! Возвращает название используемой реализации.
+    static const char *implementation();
+};
+
+#endif // CRC32C_HPP
@@ -8,9 +8,49 @@
 // Заголовочный файл UI-класса, сгенерированного на основе editnotedialog.ui
 #include "ui_editnotedialog.h"
 
+#include <utility> // move()
+
+#include "config.hpp"
 #include "note.hpp"
+#include "trace.hpp"
 
 #include <QMessageBox>
+#include <QPushButton>
+#include <QRegularExpression>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTimer>
+
+namespace
+{
+
+/*!
+ * \brief Возвращает конец части текста \a text, начинающейся с позиции \a from.
+ *
+ * Часть не длиннее Config::editorChunkSize символов и по возможности
+ * заканчивается переводом строки, чтобы редактор получал целые абзацы.
+ */
+int chunkEnd(const QString &text, int from)
+{
+    int end = text.size() - from > Config::editorChunkSize ? from + Config::editorChunkSize : text.size();
+    if (end == text.size())
+    {
+        return end;
+    }
+    int newline = text.lastIndexOf(QLatin1Char('\n'), end - 1);
+    if (newline >= from)
+    {
+        return newline + 1;
+    }
+    // Строка длиннее части: по крайней мере не разрываем суррогатную пару
+    if (text.at(end - 1).isHighSurrogate())
+    {
+        ++end;
+    }
+    return end;
+}
+
+}
 
 /*!
 * Конструирует объект класса с родительским объектом \a parent.
@@ -21,10 +61,27 @@
 */
 EditNoteDialog::EditNoteDialog(QWidget *parent) :
     QDialog(parent), // Передаём parent конструктору базового класса
-    mUi(new Ui::EditNoteDialog) // Создаём объект Ui::EditNoteDialog
+    mUi(new Ui::EditNoteDialog), // Создаём объект Ui::EditNoteDialog
+    mNote(nullptr),
+    mLoaded(0),
+    mNoteTextLoaded(false),
+    mPreviewMode(false),
+    mNoteModified(false)
 {
+    TRACE_SCOPE("EditNoteDialog::EditNoteDialog");
     // Отображаем GUI, сгенерированный из файла editnotedialog.ui, в данном окне
     mUi->setupUi(this);
+    // Индикатор загрузки и виджет просмотра показываются только при необходимости
+    mUi->loadProgress->hide();
+    mUi->preview->hide();
+    mEditButton = mUi->buttonBox->addButton(tr("&Edit"), QDialogButtonBox::ActionRole);
+    mEditButton->hide();
+    connect(mEditButton, &QPushButton::clicked, this, &EditNoteDialog::startEditing);
+    // Таймер с нулевым интервалом срабатывает, когда очередь событий пуста,
+    // поэтому части текста добавляются, не мешая перерисовке и вводу
+    mLoadTimer = new QTimer(this);
+    mLoadTimer->setInterval(0);
+    connect(mLoadTimer, &QTimer::timeout, this, &EditNoteDialog::loadNextChunk);
 }
 
 /*!
@@ -45,12 +102,109 @@ Note *EditNoteDialog::note() const
 
 void EditNoteDialog::setNote(Note *note)
 {
+    TRACE_SCOPE("EditNoteDialog::setNote");
     mNote = note;
 
-    if (!mNote->title().isEmpty() && !mNote->text().isEmpty()) {
-        this->mUi->titleEdit->setText(mNote->title());
-        this->mUi->plainTextEdit->setPlainText(mNote->text());
+    // Текст ленивой или сжатой заметки получаем один раз
+    QString title = mNote->title();
+    QString text = mNote->text();
+    if (!title.isEmpty() && !text.isEmpty()) {
+        this->mUi->titleEdit->setText(title);
+        // Строка перемещается: единственный экземпляр декодированного
+        // текста хранится в mText до конца загрузки в редактор
+        mText = std::move(text);
+        if (mPreviewMode) {
+            mUi->preview->setText(mText);
+        } else {
+            startLoading();
+        }
+    }
+}
+
+bool EditNoteDialog::isNoteModified() const
+{
+    return mNoteModified;
+}
+
+bool EditNoteDialog::isPreviewMode() const
+{
+    return mPreviewMode;
+}
+
+void EditNoteDialog::setPreviewMode(bool preview)
+{
+    mPreviewMode = preview;
+    mUi->plainTextEdit->setVisible(!preview);
+    mUi->preview->setVisible(preview);
+    mUi->titleEdit->setReadOnly(preview);
+    mUi->buttonBox->button(QDialogButtonBox::Ok)->setVisible(!preview);
+    mEditButton->setVisible(preview);
+}
+
+void EditNoteDialog::startEditing()
+{
+    mUi->preview->setText(QString());
+    setWindowTitle(tr("Edit Note"));
+    setPreviewMode(false);
+    startLoading();
+    mUi->plainTextEdit->setFocus();
+}
+
+/*!
+ * Первая часть текста сразу показывается в редакторе, остальные
+ * добавляются методом loadNextChunk(). Пока текст загружается, его нельзя
+ * изменять, а диалог — подтвердить; история отмены редактора загрузку
+ * не запоминает.
+ */
+void EditNoteDialog::startLoading()
+{
+    QPlainTextEdit *edit = mUi->plainTextEdit;
+    mLoaded = chunkEnd(mText, 0);
+    edit->setPlainText(mText.left(mLoaded));
+    mNoteTextLoaded = true;
+    if (mLoaded == mText.size()) {
+        mText.clear();
+        edit->document()->setModified(false);
+        return;
     }
+    edit->setReadOnly(true);
+    edit->setUndoRedoEnabled(false);
+    mUi->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+    mUi->loadProgress->setRange(0, 100);
+    mUi->loadProgress->setValue(static_cast<int>(static_cast<qint64>(mLoaded) * 100 / mText.size()));
+    mUi->loadProgress->show();
+    mLoadTimer->start();
+}
+
+void EditNoteDialog::loadNextChunk()
+{
+    TRACE_SCOPE("EditNoteDialog::loadNextChunk");
+    QPlainTextEdit *edit = mUi->plainTextEdit;
+    int end = chunkEnd(mText, mLoaded);
+    // Отдельный курсор добавляет текст в конец, не сдвигая курсор и
+    // прокрутку редактора
+    QTextCursor cursor(edit->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(mText.mid(mLoaded, end - mLoaded));
+    mLoaded = end;
+    mUi->loadProgress->setValue(static_cast<int>(static_cast<qint64>(mLoaded) * 100 / mText.size()));
+    if (mLoaded < mText.size()) {
+        return;
+    }
+    mLoadTimer->stop();
+    mText.clear();
+    edit->setUndoRedoEnabled(true);
+    edit->setReadOnly(false);
+    edit->document()->setModified(false);
+    mUi->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
+    mUi->loadProgress->hide();
+}
+
+bool EditNoteDialog::isTextEmpty() const
+{
+    // Ищем первый непробельный символ по абзацам документа, не собирая
+    // весь текст в одну строку
+    return mUi->plainTextEdit->document()->find(QRegularExpression(QStringLiteral("\\S"))).isNull();
 }
 
 /*!
@@ -66,9 +220,14 @@ void EditNoteDialog::setNote(Note *note)
  */
 void EditNoteDialog::accept()
 {
+    TRACE_SCOPE("EditNoteDialog::accept");
+    // Недозагруженный текст подтверждать нельзя
+    if (mLoadTimer->isActive() || mPreviewMode) {
+        return;
+    }
     // Проверяем корректность заполнения полей
     bool emptyTitle = mUi->titleEdit->text().trimmed().isEmpty();
-    bool emptyText = mUi->plainTextEdit->toPlainText().trimmed().isEmpty();
+    bool emptyText = isTextEmpty();
     if (emptyTitle || emptyText) {
         QMessageBox errDlg(this);
         errDlg.setTextFormat(Qt::RichText);
@@ -88,9 +247,18 @@ void EditNoteDialog::accept()
 
     // Читаем заголовок и текст заметки из полей диалога и записываем
     // их в соответствующие атрибуты заметки по указателю mNote
-    mNote->setTitle(mUi->titleEdit->text());
-    // Получаем текст заметки из QPlainTextEdit
-    mNote->setText(mUi->plainTextEdit->toPlainText());
+    // Изменённые поля перемещаются в заметку, неизменённые остаются как
+    // есть: ленивый или сжатый текст не декодируется и не копируется
+    QString title = mUi->titleEdit->text();
+    if (title != mNote->title()) {
+        mNote->setTitle(std::move(title));
+        mNoteModified = true;
+    }
+    // Получаем текст заметки из QPlainTextEdit, только если его изменяли
+    if (!mNoteTextLoaded || mUi->plainTextEdit->document()->isModified()) {
+        mNote->setText(mUi->plainTextEdit->toPlainText());
+        mNoteModified = true;
+    }
     // Вызываем метод базового класса, чтобы он выполнил стандартные операции
     // при закрытии диалогового окна. Если не вызвать его, то диалог не
     // будет считаться подтверждённым и не закроется.
@@ -10,11 +10,14 @@
 #include <memory> // unique_ptr
 
 #include <QDialog>
+#include <QString>
 
 // Объявляем класс Note, чтобы ниже можно было упоминать указатели на него,
 // не включая определение класса. Это увеличивает скорость сборки проекта за
 // счёт уменьшения количества обрабатываемых заголовочных файлов.
 class Note;
+class QPushButton;
+class QTimer;
 
 // Объявляем класс Ui::EditNoteDialog, чтобы ниже можно было упоминать указатели на него,
 // не включая определение класса. Этот класс создаётся автоматически из UI-файла.
@@ -35,6 +38,13 @@ class EditNoteDialog;
  *
  * Редактируемая заметка передаётся по указателю через метод setNote(). Прочитать
  * текущий указатель можно через метод note().
+ *
+ * Большой текст загружается в редактор частями по Config::editorChunkSize
+ * символов между обработкой событий: диалог открывается сразу, а пока
+ * текст загружается, редактор доступен только для чтения. В режиме
+ * просмотра (setPreviewMode()) текст показывается виджетом NotePreview,
+ * который отрисовывает только видимые строки; редактирование включается
+ * кнопкой «Edit».
  * \sa \ref faq_qt_designer_how
  */
 class EditNoteDialog : public QDialog
@@ -53,11 +63,33 @@ public:
     Note *note() const;
     //! Устанавливает указатель на редактируемую заметку.
     void setNote(Note *note);
+    /*!
+     * \brief Возвращает \c true, если подтверждённый диалог изменил заметку.
+     *
+     * Неизменённые поля заметки диалог не трогает, поэтому заметку, которую
+     * пользователь подтвердил без изменений, не нужно записывать в модель.
+     */
+    bool isNoteModified() const;
+    //! Возвращает \c true, если диалог показывает заметку только для чтения.
+    bool isPreviewMode() const;
+    //! Включает или выключает режим просмотра. Вызывается до setNote().
+    void setPreviewMode(bool preview);
 public slots:
     //! Обрабатывает подтверждение диалога.
     void accept() Q_DECL_OVERRIDE;
 
+private slots:
+    //! Добавляет в редактор следующую часть загружаемого текста.
+    void loadNextChunk();
+    //! Переключает диалог из режима просмотра в режим редактирования.
+    void startEditing();
+
 private:
+    //! Начинает загрузку текста mText в редактор.
+    void startLoading();
+    //! Возвращает \c true, если текст в редакторе состоит только из пробельных символов.
+    bool isTextEmpty() const;
+
     /*!
      * \brief Указатель на сгенерированный интерфейс.
      *
@@ -73,6 +105,20 @@ private:
     Ui::EditNoteDialog *mUi;
     //! Указатель на редактируемую заметку
     Note *mNote;
+    //! Текст заметки, ещё не загруженный в редактор полностью.
+    QString mText;
+    //! Количество символов mText, уже добавленных в редактор.
+    int mLoaded;
+    //! Признак того, что в редактор загружен текст заметки.
+    bool mNoteTextLoaded;
+    //! Признак режима просмотра.
+    bool mPreviewMode;
+    //! Признак того, что подтверждённый диалог изменил заметку.
+    bool mNoteModified;
+    //! Таймер, добавляющий части текста между обработкой событий.
+    QTimer *mLoadTimer;
+    //! Кнопка перехода от просмотра к редактированию.
+    QPushButton *mEditButton;
 };
 
 #endif // EDITNOTEDIALOG_HPP
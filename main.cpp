@@ -4,8 +4,50 @@
  * \author Кирилл Пушкарёв
  * \date 2017
  */
-#include "mainwindow.hpp"
+#include "config.hpp"
+#include "notestorage.hpp"
+#include "trace.hpp"
+#include "workspacewindow.hpp"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QEvent>
+#include <QMessageBox>
+#include <exception>
+
+namespace
+{
+
+/*!
+ * \brief Класс приложения, записывающего отрисовку виджетов в трассировку.
+ *
+ * Все события проходят через метод notify(), поэтому здесь можно измерить
+ * обработку события рисования любого виджета, включая области просмотра
+ * списков и таблиц.
+ */
+class Application : public QApplication
+{
+public:
+    Application(int &argc, char **argv)
+        : QApplication(argc, argv)
+    {
+    }
+
+    bool notify(QObject *receiver, QEvent *event) Q_DECL_OVERRIDE
+    {
+        if (event->type() != QEvent::Paint || !Trace::isEnabled())
+        {
+            return QApplication::notify(receiver, event);
+        }
+        // Область просмотра (viewport) — простой QWidget, поэтому интервал
+        // подписывается классом владеющего ею вида
+        QObject *widget = receiver->objectName() == QLatin1String("qt_scrollarea_viewport") && receiver->parent()
+                ? receiver->parent() : receiver;
+        TRACE_SCOPE("paint", widget->metaObject()->className());
+        return QApplication::notify(receiver, event);
+    }
+};
+
+}
 
 /*!
  * \brief main
@@ -17,15 +59,56 @@
  */
 int main(int argc, char *argv[])
 {
-    // Создать объект класса QApplication. Класс QApplication является частью
-    // библиотеки Qt и отвечает за функционирование программы в целом
-    QApplication a(argc, argv);
-    // Создать объект класса MainWindow. Класс MainWindow является частью
-    // данной программы и отвечает за функционирование её главного окна
-    MainWindow w;
+    // Создать объект класса Application (потомка QApplication). Класс
+    // QApplication является частью библиотеки Qt и отвечает за
+    // функционирование программы в целом
+    Application a(argc, argv);
+    // Разобрать параметры командной строки: параметр --storage выбирает
+    // хранилище заметок (см. NoteStorage::create()), остальные аргументы —
+    // имена открываемых файлов
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption storage(QStringLiteral("storage"),
+                               QApplication::translate("main", "Note storage (%1).")
+                               .arg(NoteStorage::kinds().join(QStringLiteral(", "))),
+                               QApplication::translate("main", "kind"), NoteStorage::defaultKind());
+    parser.addOption(storage);
+    parser.addPositionalArgument(QStringLiteral("files"), QApplication::translate("main", "Notebooks to open."),
+                                 QStringLiteral("[files...]"));
+    parser.process(a);
+    try
+    {
+        NoteStorage::setDefaultKind(parser.value(storage));
+        // Хранилище может быть недоступно (например, без драйвера SQLite),
+        // поэтому пробуем создать его сразу, а не при открытии файла
+        NoteStorage::create();
+    }
+    catch (const std::exception &e)
+    {
+        QMessageBox::critical(nullptr, Config::applicationName, QString::fromUtf8(e.what()));
+        return 1;
+    }
+    // Включить трассировку, если задана переменная окружения TOYNOTE_TRACE
+    Trace::startFromEnvironment();
+    // Создать объект класса WorkspaceWindow. Класс WorkspaceWindow является
+    // частью данной программы и отвечает за функционирование её главного
+    // окна; каждая записная книжка открывается в нём на отдельной вкладке
+    WorkspaceWindow w;
+    // Открыть файлы, указанные в командной строке
+    w.openFiles(parser.positionalArguments());
     // Отобразить главное окно
     w.show();
 
     // Начать обработку событий (щелчков мыши по элементам интерфейса и т. д.)
-    return a.exec();
+    int result = a.exec();
+    try
+    {
+        // Записать трассировку в файл
+        Trace::stop();
+    }
+    catch (const std::exception &e)
+    {
+        qWarning("%s", e.what());
+    }
+    return result;
 }
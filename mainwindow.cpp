@@ -8,16 +8,26 @@
 // Заголовочный файл UI-класса, сгенерированного на основе mainwindow.ui
 #include "ui_mainwindow.h"
 
-#include <set>
+#include <algorithm> // sort(), unique()
+#include <memory> // shared_ptr
 #include <stdexcept>
+#include <utility> // move()
+#include <vector>
 
 #include <QDesktopServices>
 #include <QFile>
 #include <QTextStream>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFutureWatcher>
+#include <QHeaderView>
+#include <QLineEdit>
 #include <QMessageBox>
+#include <QProgressBar>
+#include <QPushButton>
 #include <QSaveFile>
+#include <QStatusBar>
+#include <QTimer>
 #include <QUrlQuery>
 #include <QtGlobal> // qVersion()
 #include <QDateTime>
@@ -25,6 +35,20 @@
 #include "config.hpp"
 #include "editnotedialog.hpp"
 #include "loteryprocessor.h"
+#include "notefiltermodel.hpp"
+#include "notesortmodel.hpp"
+#include "noteindex.hpp"
+#include "noteimporter.hpp"
+#include "notescanner.hpp"
+#include "notestorage.hpp"
+#include "notebookexporter.hpp"
+#include "notebookfile.hpp"
+#include "notebookhistory.hpp"
+#include "notebookjournal.hpp"
+#include "notebookloader.hpp"
+#include "notebooksaver.hpp"
+#include "trace.hpp"
+#include "workerpool.hpp"
 
 /*!
  * Конструирует объект класса с родительским объектом \a parent.
@@ -34,32 +58,161 @@
  */
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent), // Передаём parent конструктору базового класса
-    mUi(new Ui::MainWindow) // Создаём объект Ui::MainWindow
+    mUi(new Ui::MainWindow), // Создаём объект Ui::MainWindow
+    mSaver(new NotebookSaver(this)), // Объект фонового сохранения удалится вместе с окном
+    mLoader(new NotebookLoader(this)),
+    mExporter(new NotebookExporter(this)),
+    mScanner(new NoteScanner(this)),
+    mLastSaveJob(0),
+    mImportTarget(nullptr),
+    mImporting(false),
+    mSalvaging(false)
 {
     // Присоединяем сигналы, соответствующие изменению статуса записной книжки,
     // к слоту, обеспечивающему обновление интерфейса окна
     connect(this, &MainWindow::notebookReady, this, &MainWindow::updateUI);
     connect(this, &MainWindow::notebookClosed, this, &MainWindow::updateUI);
-    // Присоединяем сигнал создания записной книжки к лямбда-выражению,
-    // устанавливающему в главном окне признак изменения (имеет ли текущий
-    // документ несохранённые изменения). В заголовке окна при наличии
-    // несохранённых изменений будет отображаться звёздочка или другое
-    // обозначение, в зависимости от системы. "[this]" в лямбда-выражении
-    // означает, что оно обращается к методам данного класса (в данном случае к
-    // методу MainWindow::setWindowModified()).
-    //
-    // Лямбда-выражение — это выражение, результатом которого является
-    // функциональный объект (объект, действующий как функция). В фигурных
-    // скобках записывается тело этой функции. Таким образом, в данном случае
-    // сигнал MainWindow::notebookCreated будет вызывать код, записанный в
-    // фигурных скобках, то есть метод MainWindow::setWindowModified() с параметром true.
-    connect(this, &MainWindow::notebookCreated, this, [this] { setWindowModified(true); });
-    connect(this, &MainWindow::notebookSaved, this, [this] { setWindowModified(false); });
 
     // Отображаем GUI, сгенерированный из файла mainwindow.ui, в данном окне
     mUi->setupUi(this);
     // Настраиваем таблицу заметок, чтобы её последняя колонка занимала всё доступное место
     mUi->notesView->horizontalHeader()->setStretchLastSection(true);
+    // Щелчок по заголовку столбца упорядочивает заметки (см. NoteSortModel).
+    // Пока пользователь не выбрал столбец, заметки идут в порядке записной книжки
+    mUi->notesView->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    mUi->notesView->setSortingEnabled(true);
+    // Сжатие текстов относится к текущей записной книжке и ко всем
+    // создаваемым и открываемым после неё
+    connect(mUi->actionCompress_Notes, &QAction::toggled, this, [this](bool on) {
+        if (mNotebook)
+        {
+            mNotebook->setTextCompression(on);
+        }
+    });
+    // Пункты меню отмены и повтора работают с историей текущей записной книжки
+    connect(mUi->actionUndo, &QAction::triggered, this, [this] {
+        if (mHistory && !isNotebookLoading())
+        {
+            mHistory->undo();
+        }
+    });
+    connect(mUi->actionRedo, &QAction::triggered, this, [this] {
+        if (mHistory && !isNotebookLoading())
+        {
+            mHistory->redo();
+        }
+    });
+    // Индикатор хода сохранения в строке состояния. Отображается, только
+    // пока идёт сохранение
+    mSaveProgress = new QProgressBar(this);
+    mSaveProgress->setMaximumWidth(150);
+    mSaveProgress->hide();
+    statusBar()->addPermanentWidget(mSaveProgress);
+    connect(mSaver, &NotebookSaver::started, this, [this](quint64, QString fileName) {
+        mSaveProgress->setValue(0);
+        mSaveProgress->show();
+        statusBar()->showMessage(tr("Saving %1...").arg(QFileInfo(fileName).fileName()));
+    });
+    connect(mSaver, &NotebookSaver::progress, this, [this](quint64, qint64 done, qint64 total) {
+        // QProgressBar работает с int, поэтому показываем проценты
+        mSaveProgress->setValue(total > 0 ? static_cast<int>(done * 100 / total) : 100);
+    });
+    connect(mSaver, &NotebookSaver::finished, mSaveProgress, &QProgressBar::hide);
+    connect(mSaver, &NotebookSaver::saved, this, &MainWindow::saveFinished);
+    connect(mSaver, &NotebookSaver::failed, this, &MainWindow::saveFailed);
+    connect(mSaver, &NotebookSaver::superseded, this, [this](quint64 job) {
+        mSaveJobs.remove(job);
+        mSaveMarks.remove(job);
+    });
+    // Индикатор хода загрузки и кнопка её прерывания. Отображаются, только
+    // пока записная книжка загружается
+    mLoadProgress = new QProgressBar(this);
+    mLoadProgress->setMaximumWidth(150);
+    mLoadProgress->hide();
+    statusBar()->addPermanentWidget(mLoadProgress);
+    mLoadCancel = new QPushButton(tr("Cancel"), this);
+    mLoadCancel->hide();
+    statusBar()->addPermanentWidget(mLoadCancel);
+    connect(mLoadCancel, &QPushButton::clicked, mLoader, &NotebookLoader::cancel);
+    connect(mLoader, &NotebookLoader::progress, this, [this](qint64 done, qint64 total) {
+        mLoadProgress->setValue(total > 0 ? static_cast<int>(done * 100 / total) : 100);
+    });
+    connect(mLoader, &NotebookLoader::finished, this, &MainWindow::loadFinished);
+    connect(mLoader, &NotebookLoader::failed, this, &MainWindow::loadFailed);
+    connect(mLoader, &NotebookLoader::canceled, this, &MainWindow::loadCanceled);
+    // Индикатор хода выгрузки в текстовый файл и кнопка её прерывания
+    mExportProgress = new QProgressBar(this);
+    mExportProgress->setMaximumWidth(150);
+    mExportProgress->hide();
+    statusBar()->addPermanentWidget(mExportProgress);
+    mExportCancel = new QPushButton(tr("Cancel Export"), this);
+    mExportCancel->hide();
+    statusBar()->addPermanentWidget(mExportCancel);
+    connect(mExportCancel, &QPushButton::clicked, mExporter, &NotebookExporter::cancel);
+    connect(mExporter, &NotebookExporter::progress, this, [this](qint64 done, qint64 total) {
+        mExportProgress->setValue(total > 0 ? static_cast<int>(done * 100 / total) : 100);
+    });
+    auto hideExportProgress = [this]() {
+        mExportProgress->hide();
+        mExportCancel->hide();
+        updateUI();
+    };
+    connect(mExporter, &NotebookExporter::finished, this, [this, hideExportProgress](QString fileName) {
+        hideExportProgress();
+        statusBar()->showMessage(tr("Exported %1").arg(QFileInfo(fileName).fileName()), 2000);
+    });
+    connect(mExporter, &NotebookExporter::canceled, this, [this, hideExportProgress](QString) {
+        hideExportProgress();
+        statusBar()->showMessage(tr("Export canceled"), 2000);
+    });
+    connect(mExporter, &NotebookExporter::failed, this, [this, hideExportProgress](QString fileName, QString message) {
+        hideExportProgress();
+        statusBar()->clearMessage();
+        QMessageBox::critical(this, Config::applicationName, tr("Unable to write to the file %1: %2").arg(fileName).arg(message));
+    });
+    // Строка фильтра на панели инструментов. Таблица заметок показывает
+    // только заметки, содержащие введённую строку
+    mFilterEdit = new QLineEdit(this);
+    mFilterEdit->setPlaceholderText(tr("Filter"));
+    mFilterEdit->setClearButtonEnabled(true);
+    mFilterEdit->setMaximumWidth(200);
+    mUi->mainToolBar->addSeparator();
+    mUi->mainToolBar->addWidget(mFilterEdit);
+    connect(mFilterEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        if (mFilter)
+        {
+            mFilter->setFilterText(text);
+        }
+    });
+    // Строка поиска на панели инструментов. Поиск запускается, когда
+    // пользователь перестаёт набирать запрос
+    mSearchEdit = new QLineEdit(this);
+    mSearchEdit->setPlaceholderText(tr("Search (word, prefix*, OR, \"substring\", /regexp/)"));
+    mSearchEdit->setClearButtonEnabled(true);
+    mSearchEdit->setMaximumWidth(250);
+    mUi->mainToolBar->addWidget(mSearchEdit);
+    mSearchTimer = new QTimer(this);
+    mSearchTimer->setSingleShot(true);
+    mSearchTimer->setInterval(200);
+    connect(mSearchEdit, &QLineEdit::textChanged, mSearchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(mSearchEdit, &QLineEdit::returnPressed, this, &MainWindow::searchNotes);
+    connect(mSearchTimer, &QTimer::timeout, this, &MainWindow::searchNotes);
+    // Совпадения, найденные просмотром заметок, поступают по мере поиска
+    connect(mScanner, &NoteScanner::matchesFound, this, [this](const std::vector<NoteScanner::Match> &matches) {
+        std::vector<int> rows;
+        for (const NoteScanner::Match &m : matches)
+        {
+            // Совпадения упорядочены по заметкам, в одной заметке их может быть несколько
+            if (rows.empty() || rows.back() != m.row)
+            {
+                rows.push_back(m.row);
+            }
+        }
+        selectRows(rows, QItemSelectionModel::Select | QItemSelectionModel::Rows);
+    });
+    connect(mScanner, &NoteScanner::finished, this, [this](int count) {
+        statusBar()->showMessage(tr("%n match(es) found", "", count), 5000);
+    });
     // Обновляем заголовок окна
     refreshWindowTitle();
     // Создаём новую записную книжку
@@ -154,15 +307,20 @@ bool MainWindow::saveNotebook()
         // Задействуем функцию "сохранить как" и выходим
         return saveNotebookAs();
     }
-    else
+    // Если включено сохранение в журнал, дописываем в него только изменения
+    if (mUi->actionIncremental_Save->isChecked() && appendToJournal())
     {
-        // Cохраняем в текущий файл
-        saveNotebookToFile(mNotebookFileName);
+        // Сигнализируем о готовности
+        emit notebookReady();
+        // Изменения уже записаны, сигнализируем о сохранении записной книжки
+        emit notebookSaved();
+        return true;
     }
+    // Иначе сохраняем в текущий файл целиком. Сохранение выполняется в фоне,
+    // о его завершении сигнализирует saveFinished()
+    saveNotebookToFile(mNotebookFileName);
     // Сигнализируем о готовности
     emit notebookReady();
-    // Сигнализируем о сохранении записной книжки
-    emit notebookSaved();
     return true;
 }
 
@@ -181,14 +339,12 @@ bool MainWindow::saveNotebookAs()
     {
         return false;
     }
-    // Сохраняем записную книжку в выбранный файл
+    // Сохраняем записную книжку в выбранный файл (в фоне)
     saveNotebookToFile(fileName);
     // Устанавливаем выбранное имя файла в качестве текущего
     setNotebookFileName(fileName);
     // Сигнализируем о готовности
     emit notebookReady();
-    // Сигнализируем о сохранении записной книжки
-    emit notebookSaved();
     return true;
 }
 
@@ -207,39 +363,244 @@ bool MainWindow::openNotebook()
     {
         return false;
     }
+    return openNotebookFile(fileName);
+}
+
+bool MainWindow::openNotebookFile(const QString &fileName)
+{
+    // Новую пустую записную книжку закрываем молча, остальные — как обычно
+    if (isNotebookEmpty())
+    {
+        destroyNotebook();
+    }
+    else if (isNotebookOpen() && !closeNotebook())
+    {
+        return false;
+    }
+    // Выбранный файл может ещё сохраняться в фоне, дожидаемся завершения
+    mSaver->waitForFinished();
+    // Устанавливаем в качестве текущей пустую записную книжку, которую
+    // NotebookLoader будет заполнять в фоне. Таблица заметок показывает
+    // заметки по мере их чтения. Журнал создаётся только после загрузки
+    // (см. loadFinished()), так как он относится к файлу целиком
+    setNotebook(new Notebook(NoteStorage::create()));
+    // Устанавливаем текущее имя файла
+    setNotebookFileName(fileName);
+    mLoadProgress->setValue(0);
+    mLoadProgress->show();
+    mLoadCancel->show();
+    statusBar()->showMessage(tr("Opening %1...").arg(QFileInfo(fileName).fileName()));
+    mLoader->load(fileName, mNotebook.get());
+    // Сигнализируем о готовности к просмотру
+    emit notebookReady();
+    return true;
+}
+
+void MainWindow::loadFinished(QString fileName)
+{
+    hideLoadProgress();
+    if (mSalvaging)
+    {
+        mSalvaging = false;
+        statusBar()->clearMessage();
+        // Журнал относится к неповреждённому файлу и не применяется, а
+        // восстановленные заметки остаются несохранёнными
+        trackModified();
+        attachHistory();
+        attachIndex();
+        emit notebookReady();
+        QMessageBox::information(this, Config::applicationName,
+                                 tr("The file %1 was damaged.").arg(fileName) + QLatin1Char('\n')
+                                 + NotebookFile::describe(mLoader->salvageReport()));
+        return;
+    }
     // Блок обработки исключительных ситуаций
     try
     {
-        // Создаём объект inf, связанный с файлом fileName
-        QFile inf(fileName);
-        // Открываем файл только для чтения
-        if (!inf.open(QIODevice::ReadOnly))
+        // Применяем изменения, сохранённые в журнал после записи файла
+        int replayed = NotebookJournal::replay(fileName, *mNotebook);
+        if (replayed > 0)
         {
-            throw std::runtime_error((tr("open(): ") + inf.errorString()).toStdString());
+            statusBar()->showMessage(tr("Applied %n change(s) from the journal", "", replayed), 5000);
         }
-        // Привязываем к файлу поток, позволяющий считывать объекты Qt
-        QDataStream ist(&inf);
-        // Создаём новый объект записной книжки
-        std::unique_ptr<Notebook> nb(new Notebook);
-        // Загружаем записную книжку из файла
-        ist >> *nb;
-        // Устанавливаем новую записную книжку в качестве текущей.
-        // Метод release() забирает указатель у объекта nb
-        setNotebook(nb.release());
+        else
+        {
+            statusBar()->clearMessage();
+        }
+        // Последующие изменения будут записываться в журнал этого файла
+        attachJournal(fileName);
+        // Загруженные заметки и изменения из журнала уже есть на диске
+        mNotebook->markClean(mNotebook->generation());
+        trackModified();
+        // Отменять можно только изменения, сделанные после загрузки
+        attachHistory();
+        // Индексируем заметки в фоне только после загрузки, чтобы не
+        // обрабатывать каждую порцию в потоке интерфейса
+        attachIndex();
     }
     catch (const std::exception &e)
     {
         // Если при открытии файла возникла исключительная ситуация, сообщить пользователю
         QMessageBox::critical(this, Config::applicationName, tr("Unable to open the file %1: %2").arg(fileName).arg(e.what()));
-        return false;
+        destroyNotebook();
+        setNotebookFileName();
+        emit notebookClosed();
+        return;
     }
-    // Устанавливаем текущее имя файла
-    setNotebookFileName(fileName);
-    // Сигнализируем о готовности
+    // Сигнализируем о готовности: записную книжку теперь можно изменять
     emit notebookReady();
     // Сигнализируем об открытии записной книжки
     emit notebookOpened(mNotebookFileName);
-    return true;
+}
+
+void MainWindow::loadFailed(QString fileName, QString message)
+{
+    hideLoadProgress();
+    statusBar()->clearMessage();
+    // Частично загруженная записная книжка не нужна
+    destroyNotebook();
+    setNotebookFileName();
+    emit notebookClosed();
+    bool salvaging = mSalvaging;
+    mSalvaging = false;
+    // Записи файла с таблицей смещений можно попытаться найти заново
+    QFile f(fileName);
+    if (!salvaging && f.open(QIODevice::ReadOnly) && NotebookFile::isVersion2(&f))
+    {
+        f.close();
+        if (QMessageBox::question(this, Config::applicationName,
+                                  tr("Unable to open the file %1: %2").arg(fileName).arg(message) + QLatin1String("\n\n")
+                                  + tr("Open the intact notes of the file?")) == QMessageBox::Yes)
+        {
+            salvageNotebook(fileName);
+        }
+        return;
+    }
+    QMessageBox::critical(this, Config::applicationName, tr("Unable to open the file %1: %2").arg(fileName).arg(message));
+}
+
+void MainWindow::salvageNotebook(const QString &fileName)
+{
+    setNotebook(new Notebook(NoteStorage::create()));
+    setNotebookFileName();
+    mLoadProgress->setValue(0);
+    mLoadProgress->show();
+    mLoadCancel->show();
+    statusBar()->showMessage(tr("Recovering %1...").arg(QFileInfo(fileName).fileName()));
+    mSalvaging = true;
+    mLoader->load(fileName, mNotebook.get(), true);
+    emit notebookReady();
+}
+
+void MainWindow::loadCanceled()
+{
+    mSalvaging = false;
+    hideLoadProgress();
+    statusBar()->showMessage(tr("Opening canceled"), 2000);
+    destroyNotebook();
+    setNotebookFileName();
+    emit notebookClosed();
+}
+
+/*!
+ * Найденные заметки выделяются в таблице. Запрос в кавычках ищется как
+ * подстрока без учёта регистра, а запрос между косыми чертами — как
+ * регулярное выражение; в обоих случаях просматриваются все заметки
+ * (см. NoteScanner). Остальные запросы выполняются по полнотекстовому
+ * индексу (см. NoteIndex).
+ */
+void MainWindow::searchNotes()
+{
+    TRACE_SCOPE("MainWindow::searchNotes");
+    mSearchTimer->stop();
+    mScanner->cancel();
+    QString query = mSearchEdit->text();
+    if (!isNotebookOpen() || query.trimmed().isEmpty())
+    {
+        return;
+    }
+    bool quoted = query.size() >= 2 && query.startsWith(QLatin1Char('"')) && query.endsWith(QLatin1Char('"'));
+    bool regexp = query.size() >= 2 && query.startsWith(QLatin1Char('/')) && query.endsWith(QLatin1Char('/'));
+    if (quoted || regexp)
+    {
+        mUi->notesView->selectionModel()->clearSelection();
+        try
+        {
+            mScanner->scan(mNotebook.get(), query.mid(1, query.size() - 2),
+                           regexp ? NoteScanner::RegExp : NoteScanner::CaseInsensitive);
+        }
+        catch (const std::exception &e)
+        {
+            statusBar()->showMessage(QString::fromUtf8(e.what()), 5000);
+            return;
+        }
+        statusBar()->showMessage(tr("Searching..."));
+        return;
+    }
+    if (!mIndex || !mIndex->isReady())
+    {
+        // Поиск будет повторён по сигналу NoteIndex::ready()
+        statusBar()->showMessage(tr("Indexing notes..."));
+        return;
+    }
+    std::vector<NoteIndex::NoteId> ids = mIndex->search(query);
+    // Заметки, вставленные в середину, получают наибольшие идентификаторы,
+    // поэтому строки найденных заметок упорядочиваются отдельно
+    std::vector<int> rows;
+    rows.reserve(ids.size());
+    for (NoteIndex::NoteId id : ids)
+    {
+        // Заметку могли удалить после того, как индекс её нашёл
+        int row = mNotebook->rowOf(id);
+        if (row >= 0)
+        {
+            rows.push_back(row);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    selectRows(rows, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    statusBar()->showMessage(tr("%n note(s) found", "", static_cast<int>(rows.size())), 5000);
+}
+
+void MainWindow::selectRows(const std::vector<int> &rows, QItemSelectionModel::SelectionFlags command)
+{
+    QItemSelection selection;
+    int first = -1, last = -1;
+    for (int row : rows)
+    {
+        if (first >= 0 && row == last + 1)
+        {
+            last = row;
+            continue;
+        }
+        if (first >= 0)
+        {
+            selection.select(mNotebook->index(first, 0), mNotebook->index(last, 0));
+        }
+        first = last = row;
+    }
+    if (first >= 0)
+    {
+        selection.select(mNotebook->index(first, 0), mNotebook->index(last, 0));
+    }
+    // Таблица заметок показывает строки моделей-посредников
+    selection = mSort->mapSelectionFromSource(mFilter->mapSelectionFromSource(selection));
+    // Прокручиваем таблицу к первой выделенной строке, если выделение
+    // начинается заново
+    bool scroll = !selection.isEmpty()
+            && ((command & QItemSelectionModel::Clear) || !mUi->notesView->selectionModel()->hasSelection());
+    // Если выделение пусто, ClearAndSelect просто снимет прежнее выделение
+    mUi->notesView->selectionModel()->select(selection, command);
+    if (scroll)
+    {
+        mUi->notesView->scrollTo(selection.first().topLeft());
+    }
+}
+
+void MainWindow::hideLoadProgress()
+{
+    mLoadProgress->hide();
+    mLoadCancel->hide();
 }
 
 bool MainWindow::closeNotebook()
@@ -249,6 +610,13 @@ bool MainWindow::closeNotebook()
     {
         return true;
     }
+    // Частично загруженную записную книжку сохранять нельзя: прерываем
+    // загрузку, loadCanceled() закроет записную книжку
+    if (isNotebookLoading())
+    {
+        mLoader->cancel();
+        return true;
+    }
     // Создаём окно с вопросом о сохранении файла
     QMessageBox saveQuery(this);
     // Устанавливаем иконку вопроса
@@ -294,6 +662,10 @@ bool MainWindow::newNote()
         QMessageBox::warning(this, Config::applicationName, tr("No open notebooks"));
         return false;
     }
+    if (isNotebookLoading())
+    {
+        return false;
+    }
     // Создаём диалог редактирования заметки
     EditNoteDialog noteDlg(this);
     // Устанавливаем заголовок noteDlg
@@ -306,13 +678,18 @@ bool MainWindow::newNote()
     {
         return false;
     }
-    // Вставляем заметку в записную книжку
-    mNotebook->insert(note);
+    // Вставляем заметку в записную книжку через историю, чтобы вставку можно
+    // было отменить
+    mHistory->insert(note);
     return true;
 }
 
 void MainWindow::deleteNotes()
 {
+    if (isNotebookLoading())
+    {
+        return;
+    }
     // Создаём окно с вопросом об удалении заметок
     QMessageBox delCong(this);
     delCong.setIcon(QMessageBox::Question);
@@ -325,26 +702,12 @@ void MainWindow::deleteNotes()
         return;
     }
 
-    // Для хранения номеров строк создаём STL-контейнер "множество", элементы
-    // которого автоматически упорядочиваются по возрастанию
-    std::set<int> rows;
-    {
-        // Получаем от таблицы заметок список индексов выбранных в настоящий момент
-        // элементов
-        QModelIndexList idc = mUi->notesView->selectionModel()->selectedRows();
-        // Вставляем номера выбранных строк в rows
-        for (const auto &i : idc)
-        {
-            rows.insert(i.row());
-        }
-    }
-    // Обходим множество номеров выбранных строк *по убыванию*, чтобы удаление предыдущих
-    // не сбивало нумерацию следующих
-    for (auto it = rows.rbegin(); it != rows.rend(); ++it)
-    {
-        // Удаляем строку
-        mNotebook->erase(*it);
-    }
+    // Передаём записной книжке выделение целиком: модели-посредники
+    // преобразуют его диапазонами, а записная книжка удаляет каждый
+    // непрерывный диапазон строк за раз, не перебирая строки по одной.
+    // История запоминает только удалённые заметки
+    mHistory->erase(mFilter->mapSelectionToSource(
+                        mSort->mapSelectionToSource(mUi->notesView->selectionModel()->selection())));
 }
 
 void MainWindow::updateUI() {
@@ -352,12 +715,16 @@ void MainWindow::updateUI() {
 
     // сохраним состояние наличия открытой записной книжки в переменную, для производительности
     bool ino = isNotebookOpen();
-    this->mUi->actionSave           ->setEnabled(ino);  // File|Save
-    this->mUi->actionSave_As        ->setEnabled(ino);  // File|Save as
-    this->mUi->actionSave_As_Text   ->setEnabled(ino);  // File|Save as text
+    // пока записная книжка загружается, её можно только просматривать
+    bool editable = ino && !isNotebookLoading();
+    this->mUi->actionSave           ->setEnabled(editable);  // File|Save
+    this->mUi->actionSave_As        ->setEnabled(editable);  // File|Save as
+    this->mUi->actionSave_As_Text   ->setEnabled(editable && !mExporter->isBusy());  // File|Save as text
+    this->mUi->actionImport_Text    ->setEnabled(editable && !mImporting);  // File|Import text
     this->mUi->actionCloseNotebook  ->setEnabled(ino);  // File|Close
-    this->mUi->actionNew_Note       ->setEnabled(ino);  // Add
+    this->mUi->actionNew_Note       ->setEnabled(editable);  // Add
     this->mUi->notesView            ->setEnabled(ino);  // Notes grid
+    updateUndoActions();  // Edit|Undo, Edit|Redo
 
     // хэндлер выделения заметок;
     // мы сбрасываем модель при закрытии нотбука, поэтому нужно устанавливать каждый раз новый
@@ -365,7 +732,7 @@ void MainWindow::updateUI() {
         connect(
             mUi->notesView->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, [this] (const QItemSelection &selected) {
-                bool selected_any = selected.size() > 0;
+                bool selected_any = selected.size() > 0 && !isNotebookLoading();
                 this->mUi->actionDelete_Notes->setEnabled(selected_any);  // Delete
 
                 bool selected_only = mUi->notesView->selectionModel()->selectedIndexes().size() == 1;
@@ -395,49 +762,143 @@ void MainWindow::refreshWindowTitle()
 }
 
 /*!
- * Сохраняет текущую записную книжку в файл \a fileName. Данный метод
- * отвечает непосредственно за сохранение и не предусматривает диалога с
- * пользователем.
+ * Ставит в очередь сохранение текущей записной книжки в файл \a fileName.
+ * Данный метод отвечает непосредственно за сохранение и не предусматривает
+ * диалога с пользователем.
+ *
+ * В потоке интерфейса делается только снимок записной книжки, запись в файл
+ * выполняет NotebookSaver в рабочем потоке. Результат обрабатывается
+ * методами saveFinished() и saveFailed().
  */
 void MainWindow::saveNotebookToFile(QString fileName)
 {
+    TRACE_SCOPE("MainWindow::saveNotebookToFile");
     // Если записная книжка не открыта, прерываем операцию
     if (!isNotebookOpen())
     {
         return;
     }
-    // Блок обработки исключительных ситуаций
+    // Запоминаем, какие изменения журнала и записной книжки войдут в снимок
+    SaveMark mark{ mJournal->mark(), mNotebook->generation() };
+    mLastSaveJob = mSaver->save(fileName, mNotebook->snapshot(), mNotebook->textCompression());
+    mSaveJobs.insert(mLastSaveJob);
+    mSaveMarks.insert(mLastSaveJob, mark);
+}
+
+void MainWindow::saveFinished(quint64 job, QString fileName)
+{
+    // Задания, не найденные в mSaveJobs, относятся к уплотнению журнала
+    if (!mSaveJobs.remove(job))
+    {
+        return;
+    }
+    statusBar()->showMessage(tr("Saved %1").arg(QFileInfo(fileName).fileName()), 2000);
+    // Если записная книжка была закрыта, задания нет в mSaveMarks
+    if (!mSaveMarks.contains(job))
+    {
+        return;
+    }
+    SaveMark mark = mSaveMarks.take(job);
+    // Файл содержит все изменения, вошедшие в снимок, поэтому журнал
+    // начинается заново
+    mJournal->rebase(fileName, mark.journal);
+    // Изменения, сделанные после снимка, остаются несохранёнными
+    mNotebook->markClean(mark.generation);
+    // Более раннее задание не содержит изменений, сделанных перед более
+    // поздним, поэтому о сохранении сигнализирует только последнее
+    if (job == mLastSaveJob)
+    {
+        emit notebookSaved();
+    }
+}
+
+void MainWindow::saveFailed(quint64 job, QString fileName, QString message)
+{
+    if (!mSaveJobs.remove(job))
+    {
+        return;
+    }
+    mSaveMarks.remove(job);
+    statusBar()->clearMessage();
+    // Если при сохранении файла возникла ошибка, сообщить пользователю
+    QMessageBox::critical(this, Config::applicationName, tr("Unable to write to the file %1: %2").arg(fileName).arg(message));
+}
+
+bool MainWindow::appendToJournal()
+{
+    // Журнал должен относиться к файлу, в который сохраняется записная книжка
+    if (!mJournal || mJournal->baseFileName() != mNotebookFileName || !mJournal->canAppend())
+    {
+        return false;
+    }
     try
     {
-        /*
-         * Создаём объект outf, связанный с файлом fileName.
-         * QSaveFile обеспечивает безопасное сохранение (через промежуточный
-         * временный файл), чтобы избежать потери данных в случае нештатного
-         * завершения операции сохранения. Само сохранение происходит при вызове
-         * метода commit().
-         */
-        QSaveFile outf(fileName);
-        // Открываем файл только для записи
-        outf.open(QIODevice::WriteOnly);
-        // Привязываем к файлу поток, позволяющий выводить объекты Qt
-        QDataStream ost(&outf);
-        // Выводим записную книжку в файл
-        ost << *mNotebook;
-        // Запускаем сохранение и смотрим результат.
-        // В случае неудачи запускаем исключительную ситуацию (блок прерывается,
-        // управление передаётся в блок catch)
-        if (!outf.commit())
-        {
-            throw std::runtime_error(tr("Unable to commit the save").toStdString());
-        }
-        // Устанавливаем текущее имя файла
-        setNotebookFileName(fileName);
+        mJournal->append();
     }
     catch (const std::exception &e)
     {
-        // Если при сохранении файла возникла исключительная ситуация, сообщить пользователю
-        QMessageBox::critical(this, Config::applicationName, tr("Unable to write to the file %1: %2").arg(fileName).arg(e.what()));
+        // Не удалось дописать журнал — сохраним записную книжку целиком
+        statusBar()->showMessage(tr("Unable to write to the journal: %1").arg(e.what()), 5000);
+        return false;
     }
+    // Журнал содержит все изменения записной книжки
+    mNotebook->markClean(mNotebook->generation());
+    statusBar()->showMessage(tr("Changes saved to the journal"), 2000);
+    // Если журнал стал слишком большим, в фоне записываем новый файл
+    mJournal->compactIfNeeded();
+    return true;
+}
+
+void MainWindow::attachIndex()
+{
+    mIndex.reset(new NoteIndex(mNotebook.get()));
+    // Если пользователь начал поиск до построения индекса, выполняем его
+    connect(mIndex.get(), &NoteIndex::ready, this, [this] {
+        if (!mSearchEdit->text().trimmed().isEmpty())
+        {
+            searchNotes();
+        }
+    });
+}
+
+void MainWindow::trackModified()
+{
+    // Признак изменения окна (имеет ли текущий документ несохранённые
+    // изменения) следует за набором изменений записной книжки. В заголовке
+    // окна при наличии несохранённых изменений будет отображаться звёздочка
+    // или другое обозначение, в зависимости от системы
+    connect(mNotebook.get(), &Notebook::modifiedChanged, this, &QWidget::setWindowModified);
+    setWindowModified(mNotebook->isModified());
+}
+
+void MainWindow::attachHistory()
+{
+    mHistory.reset(new NotebookHistory(mNotebook.get()));
+    connect(mHistory.get(), &NotebookHistory::changed, this, &MainWindow::updateUndoActions);
+    updateUndoActions();
+}
+
+void MainWindow::updateUndoActions()
+{
+    bool editable = mHistory && !isNotebookLoading();
+    mUi->actionUndo->setEnabled(editable && mHistory->canUndo());
+    mUi->actionRedo->setEnabled(editable && mHistory->canRedo());
+    // Показываем в меню, какое именно изменение будет отменено или повторено
+    mUi->actionUndo->setText(mUi->actionUndo->isEnabled()
+                             ? tr("&Undo %1").arg(mHistory->undoText()) : tr("&Undo"));
+    mUi->actionRedo->setText(mUi->actionRedo->isEnabled()
+                             ? tr("&Redo %1").arg(mHistory->redoText()) : tr("&Redo"));
+}
+
+void MainWindow::attachJournal(const QString &fileName)
+{
+    mJournal.reset(new NotebookJournal(mNotebook.get(), fileName, mSaver));
+    connect(mJournal.get(), &NotebookJournal::compacted, this, [this] {
+        statusBar()->showMessage(tr("The journal has been compacted"), 2000);
+    });
+    connect(mJournal.get(), &NotebookJournal::compactionFailed, this, [this](QString message) {
+        QMessageBox::warning(this, Config::applicationName, tr("Unable to compact the journal: %1").arg(message));
+    });
 }
 
 bool MainWindow::isNotebookOpen() const
@@ -447,6 +908,58 @@ bool MainWindow::isNotebookOpen() const
     return static_cast<bool>(mNotebook);
 }
 
+bool MainWindow::isNotebookEmpty() const
+{
+    return isNotebookOpen() && !isNotebookLoading() && mNotebookFileName.isEmpty()
+            && !isWindowModified() && mNotebook->size() == 0;
+}
+
+std::vector<Note> MainWindow::selectedNotes() const
+{
+    std::vector<Note> notes;
+    if (!isNotebookOpen())
+    {
+        return notes;
+    }
+    // Преобразуем выделение в строки записной книжки так же, как при
+    // удалении заметок, и упорядочиваем их
+    QItemSelection selection = mFilter->mapSelectionToSource(
+                mSort->mapSelectionToSource(mUi->notesView->selectionModel()->selection()));
+    std::vector<int> rows;
+    for (const QItemSelectionRange &range : selection)
+    {
+        for (int row = range.top(); row <= range.bottom(); ++row)
+        {
+            rows.push_back(row);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    notes.reserve(rows.size());
+    for (int row : rows)
+    {
+        notes.push_back((*mNotebook)[static_cast<Notebook::SizeType>(row)]);
+    }
+    return notes;
+}
+
+bool MainWindow::appendNotes(std::vector<Note> notes)
+{
+    if (!isNotebookOpen() || isNotebookLoading())
+    {
+        return false;
+    }
+    std::size_t count = notes.size();
+    mHistory->insertMany(mNotebook->size(), std::move(notes));
+    statusBar()->showMessage(tr("Added %n note(s)", nullptr, static_cast<int>(count)), 2000);
+    return true;
+}
+
+bool MainWindow::isNotebookLoading() const
+{
+    return mLoader->isRunning();
+}
+
 void MainWindow::setNotebookFileName(QString name)
 {
     // Устанавливаем имя файла
@@ -473,19 +986,44 @@ QString MainWindow::notebookName() const
 
 void MainWindow::createNotebook()
 {
-    setNotebook(new Notebook);
+    setNotebook(new Notebook(NoteStorage::create()));
+    // У новой записной книжки нет файла, журнал получит его при первом сохранении
+    attachJournal(QString());
+    attachIndex();
+    trackModified();
+    attachHistory();
 }
 
 void MainWindow::setNotebook(Notebook *notebook)
 {
+    TRACE_SCOPE("MainWindow::setNotebook");
     /*
      * Заменяем имеющийся указатель на объект записной книжки новым.
      * Если в mNotebook хранился какой-то ненулевой указатель на объект,
      * то метод reset() удалит его автоматически
      */
+    // Журнал и незавершённые сохранения относятся к прежней записной книжке,
+    // поэтому забываем о них первыми
+    mJournal.reset();
+    mIndex.reset();
+    mHistory.reset();
+    mScanner->cancel();
+    mSaveMarks.clear();
+    mImportTarget = nullptr;
+    // Связываем новый объект записной книжки с таблицей заметок в главном
+    // окне через фильтр и модель сортировки. Прежние модели и записная книжка
+    // удаляются после того, как таблица переключится на новую модель
+    notebook->setTextCompression(mUi->actionCompress_Notes->isChecked());
+    std::unique_ptr<NoteFilterModel> filter(new NoteFilterModel(notebook));
+    filter->setFilterText(mFilterEdit->text());
+    std::unique_ptr<NoteSortModel> sort(new NoteSortModel(notebook, filter.get()));
+    // Новая записная книжка упорядочивается так же, как прежняя
+    QHeaderView *header = mUi->notesView->horizontalHeader();
+    sort->sort(header->sortIndicatorSection(), header->sortIndicatorOrder());
+    mUi->notesView->setModel(sort.get());
+    mSort = std::move(sort);
+    mFilter = std::move(filter);
     mNotebook.reset(notebook);
-    // Связываем новый объект записной книжки с таблицей заметок в главном окне
-    mUi->notesView->setModel(mNotebook.get());
 }
 
 /*!
@@ -496,13 +1034,42 @@ void MainWindow::destroyNotebook()
 {
     // Отключаем объект записной книжки от таблицы заметок в главном окне
     mUi->notesView->setModel(0);
-    // Удаляем объект записной книжки
+    // Удаляем журнал и объект записной книжки
+    mJournal.reset();
+    mIndex.reset();
+    mHistory.reset();
+    mScanner->cancel();
+    mSaveMarks.clear();
+    mImportTarget = nullptr;
+    mSort.reset();
+    mFilter.reset();
     mNotebook.reset();
+    setWindowModified(false);
+}
+
+bool MainWindow::prepareToClose()
+{
+    // Новую пустую записную книжку сохранять незачем
+    if (!isNotebookEmpty() && !closeNotebook())
+    {
+        return false;
+    }
+    // Дожидаемся завершения фоновых сохранений, показывая их ход
+    mSaver->waitForFinished();
+    return true;
 }
 
 void MainWindow::on_actionExit_triggered()
 {
-    if (isNotebookOpen())
+    // Окно во вкладке рабочей области закрывается вместе с ней: рабочая
+    // область спросит о сохранении записных книжек всех вкладок
+    if (parentWidget())
+    {
+        window()->close();
+        return;
+    }
+    // Загружаемая записная книжка ещё не изменялась, сохранять её незачем
+    if (isNotebookOpen() && !isNotebookLoading())
     {
         QMessageBox exitDlg(this);
         exitDlg.setIcon(QMessageBox::Question);
@@ -515,6 +1082,8 @@ void MainWindow::on_actionExit_triggered()
             saveNotebook();
         }
     }
+    // Дожидаемся завершения фоновых сохранений, показывая их ход
+    mSaver->waitForFinished();
 
     QCoreApplication::exit(0);
 }
@@ -524,8 +1093,17 @@ void MainWindow::on_actionVisit_eCourses_triggered()
     QDesktopServices::openUrl(QUrl("https://e.sfu-kras.ru"));
 }
 
+/*!
+ * Заметки выгружаются в фоне объектом NotebookExporter, который получает
+ * снимок записной книжки. Формат определяется расширением выбранного файла
+ * (см. NoteExporter::formatForFileName()).
+ */
 void MainWindow::on_actionSave_As_Text_triggered()
 {
+    if (!isNotebookOpen() || mExporter->isBusy())
+    {
+        return;
+    }
     // Выводим диалог выбора файла для сохранения
     QString fileName = QFileDialog::getSaveFileName(this, tr("Save Notebook As Text"), QString(), Config::textNotebookFileNameFilter);
     // Если пользователь не выбрал файл, возвращаем false
@@ -534,29 +1112,78 @@ void MainWindow::on_actionSave_As_Text_triggered()
         return;
     }
 
-    // Сохраняем записную книжку в выбранный файл в текстовом формате
-    try
-    {
-        QSaveFile outf(fileName);
-        outf.open(QIODevice::WriteOnly);
-        QTextStream ost(&outf);
-        auto ns = mNotebook->size();
-        for (int i = 0; i < ns; i++) {
-            ost << QString("+++ %1/%2 +++\n").arg(i+1).arg(ns);
-            ost << tr("Title: ") << (*mNotebook)[i].title() << "\n";
-            ost << tr("Content: ") << (*mNotebook)[i].text() << "\n";
-            ost << QString("--- %1/%2 ---\n").arg(i+1).arg(ns);
-        }
+    // Выгружаем снимок записной книжки в выбранный файл в рабочем потоке
+    mExporter->start(fileName, mNotebook->snapshot(), NoteExporter::formatForFileName(fileName));
+    updateUI();
+    mExportProgress->setValue(0);
+    mExportProgress->show();
+    mExportCancel->show();
+    statusBar()->showMessage(tr("Exporting %1...").arg(QFileInfo(fileName).fileName()));
+}
 
-        if (!outf.commit())
-        {
-            throw std::runtime_error(tr("Unable to commit the save").toStdString());
-        }
+/*!
+ * Файл читается в рабочем потоке методом NoteImporter::read(), а
+ * прочитанные заметки добавляются в конец записной книжки методом
+ * NotebookHistory::insertMany(). Он вставляет их одним вызовом
+ * Notebook::insertMany(), поэтому модель сообщает о вставке один раз,
+ * сколько бы заметок ни было в файле, а весь импорт становится одной
+ * командой истории и отменяется одним действием Undo. Журнал записывает
+ * вставку, как и любое другое изменение.
+ */
+void MainWindow::on_actionImport_Text_triggered()
+{
+    if (!isNotebookOpen() || isNotebookLoading() || mImporting)
+    {
+        return;
     }
-    catch (const std::exception &e)
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Import Notes"), QString(), Config::textNotebookFileNameFilter);
+    if (fileName.isEmpty())
     {
-        QMessageBox::critical(this, Config::applicationName, tr("Unable to write to the file %1: %2").arg(fileName).arg(e.what()));
+        return;
     }
+
+    typedef std::vector<Note> Notes;
+    std::shared_ptr<QString> error(new QString);
+    QFutureWatcher<Notes> *watcher = new QFutureWatcher<Notes>(this);
+    connect(watcher, &QFutureWatcher<Notes>::finished, this, [this, watcher, error, fileName]() {
+        watcher->deleteLater();
+        mImporting = false;
+        Notebook *target = mImportTarget;
+        mImportTarget = nullptr;
+        updateUI();
+        if (!error->isEmpty())
+        {
+            statusBar()->clearMessage();
+            QMessageBox::critical(this, Config::applicationName, tr("Unable to import the file %1: %2").arg(fileName).arg(*error));
+            return;
+        }
+        // Записная книжка могла быть закрыта или заменена, пока файл читался
+        if (!target || target != mNotebook.get())
+        {
+            statusBar()->clearMessage();
+            return;
+        }
+        Notes notes = watcher->result();
+        std::size_t count = notes.size();
+        // Импорт, как и добавление заметок, можно отменить
+        mHistory->insertMany(mNotebook->size(), std::move(notes));
+        statusBar()->showMessage(tr("Imported %n note(s)", nullptr, static_cast<int>(count)), 2000);
+    });
+    mImporting = true;
+    mImportTarget = mNotebook.get();
+    watcher->setFuture(WorkerPool::instance().run<Notes>(this, [fileName, error]() -> Notes {
+        try
+        {
+            return NoteImporter::read(fileName);
+        }
+        catch (const std::exception &e)
+        {
+            *error = QString::fromUtf8(e.what());
+            return Notes();
+        }
+    }));
+    updateUI();
+    statusBar()->showMessage(tr("Importing %1...").arg(QFileInfo(fileName).fileName()));
 }
 
 void MainWindow::on_actionLottery_triggered()
@@ -582,28 +1209,48 @@ void MainWindow::on_actionLottery_triggered()
 
 void MainWindow::on_notesView_activated(const QModelIndex &index)
 {
+    if (isNotebookLoading())
+    {
+        return;
+    }
     if (mUi->notesView->selectionModel()->selectedRows().size() != 1) {
         return;
     }
 
-    int pos = index.row();
+    // Номер строки таблицы относится к моделям-посредникам, находим номер заметки
+    int pos = mFilter->mapToSource(mSort->mapToSource(index)).row();
     // Создаём диалог редактирования заметки
     EditNoteDialog noteDlg(this);
     noteDlg.setWindowTitle(tr("Edit Note"));
 
+    // Копия ленивой или сжатой заметки — это лишь ссылка на источник,
+    // а копия обычной разделяет строки с хранилищем (неявное разделение
+    // данных). Текст декодируется один раз, в setNote(), и затем
+    // переносится в документ редактора
     Note note = (*mNotebook)[pos];
+    // Очень большую заметку сначала показываем только для чтения: просмотр
+    // открывается сразу, а загрузка в редактор начинается по кнопке диалога.
+    // Длину текста узнаём, не декодируя и не распаковывая его
+    if (note.textLength() >= Config::notePreviewThreshold)
+    {
+        noteDlg.setWindowTitle(tr("View Note"));
+        noteDlg.setPreviewMode(true);
+    }
     noteDlg.setNote(&note);
 
-    if (noteDlg.exec() == EditNoteDialog::Accepted)
+    // Заметку, подтверждённую без изменений, в записную книжку не
+    // записываем, а изменённую перемещаем в хранилище без копирования
+    if (noteDlg.exec() == EditNoteDialog::Accepted && noteDlg.isNoteModified())
     {
-        mNotebook->updateNoteAt(note, pos);
+        mHistory->update(pos, std::move(note));
     }
 }
 
 void MainWindow::on_actionWeb_search_triggered()
 {
     QUrlQuery query("https://yandex.ru/search/?");
-    auto note = (*mNotebook)[mUi->notesView->selectionModel()->currentIndex().row()];
+    auto note = (*mNotebook)[mFilter->mapToSource(
+            mSort->mapToSource(mUi->notesView->selectionModel()->currentIndex())).row()];
     query.addQueryItem("text", note.text());
     QString url = query.toString();
     QDesktopServices::openUrl(url);
@@ -8,12 +8,29 @@
 #define MAINWINDOW_H
 
 #include <memory> // unique_ptr
+#include <vector>
 
+#include <QHash>
 #include <QItemSelection>
+#include <QSet>
 #include <QMainWindow>
 
 #include "notebook.hpp"
 
+class NoteFilterModel;
+class NoteIndex;
+class NotebookExporter;
+class NotebookHistory;
+class NotebookJournal;
+class NotebookLoader;
+class NotebookSaver;
+class NoteScanner;
+class NoteSortModel;
+class QLineEdit;
+class QProgressBar;
+class QPushButton;
+class QTimer;
+
 // Объявляем класс Ui::MainWindow, чтобы ниже можно было упоминать указатели на него,
 // не включая определение класса. Этот класс создаётся автоматически из UI-файла.
 // Данное объявление также было создано автоматически, когда Qt Creator
@@ -43,6 +60,38 @@ public:
     ~MainWindow();
     //! Событие закрытия приложения
     void closeEvent(QCloseEvent *event);
+    /*!
+     * \brief Открывает записную книжку из файла \a fileName вместо текущей.
+     *
+     * Файл загружается в фоне (см. NotebookLoader). Новая пустая записная
+     * книжка закрывается без вопроса о сохранении. Возвращает \c true, если
+     * загрузка начата.
+     */
+    bool openNotebookFile(const QString &fileName);
+    /*!
+     * \brief Готовит окно к закрытию.
+     *
+     * Предлагает сохранить текущую записную книжку и дожидается завершения
+     * фоновых сохранений. Возвращает \c false, если пользователь отказался
+     * закрывать записную книжку.
+     */
+    bool prepareToClose();
+    //! Возвращает \c true, если в настоящий момент имеется открытая записная книжка.
+    bool isNotebookOpen() const;
+    //! Возвращает \c true, если текущая записная книжка новая, пустая и не изменялась.
+    bool isNotebookEmpty() const;
+    //! Возвращает имя файла текущей записной книжки.
+    QString notebookName() const;
+    //! Возвращает копии выбранных в таблице заметок в порядке записной книжки.
+    std::vector<Note> selectedNotes() const;
+    /*!
+     * \brief Добавляет заметки \a notes в конец текущей записной книжки.
+     *
+     * Заметки вставляются одним вызовом NotebookHistory::insertMany(), поэтому
+     * добавление отменяется одной командой. Возвращает \c false, если
+     * записная книжка не открыта или ещё загружается.
+     */
+    bool appendNotes(std::vector<Note> notes);
     /*
      * В этом разделе перечисляются слоты — методы, которые могут получать и
      * обрабатывать сигналы, например от активации пункта меню
@@ -74,12 +123,26 @@ private slots:
     void on_actionVisit_eCourses_triggered();
     //! Экспортирует заметки в текстовом формате.
     void on_actionSave_As_Text_triggered();
+    //! Добавляет в текущую записную книжку заметки из текстового файла.
+    void on_actionImport_Text_triggered();
     //! Запускает диалог лотереи.
     void on_actionLottery_triggered();
     //! Запускает диалог редактирования заметки
     void on_notesView_activated(const QModelIndex &index);
     //! Запускает поиск текста заметки в интернете
     void on_actionWeb_search_triggered();
+    //! Обрабатывает успешное завершение задания \a job фонового сохранения в файл \a fileName.
+    void saveFinished(quint64 job, QString fileName);
+    //! Обрабатывает ошибку \a message задания \a job фонового сохранения в файл \a fileName.
+    void saveFailed(quint64 job, QString fileName, QString message);
+    //! Завершает открытие записной книжки после фоновой загрузки файла \a fileName.
+    void loadFinished(QString fileName);
+    //! Обрабатывает ошибку \a message фоновой загрузки файла \a fileName.
+    void loadFailed(QString fileName, QString message);
+    //! Закрывает частично загруженную записную книжку после прерывания загрузки.
+    void loadCanceled();
+    //! Выделяет в таблице заметки, соответствующие запросу в строке поиска.
+    void searchNotes();
 
     // В этом разделе перечисляются сигналы, которые выдаёт данный класс
 signals:
@@ -109,17 +172,67 @@ signals:
      * его работу и недоступны извне.
      */
 private:
+    //! Состояние текущей записной книжки на момент снимка для сохранения.
+    struct SaveMark
+    {
+        //! Значение NotebookJournal::mark().
+        quint64 journal;
+        //! Значение Notebook::generation().
+        Notebook::Generation generation;
+    };
+
     /*!
-     * \brief Сохраняет текущую записную книжку в файл.
+     * \brief Ставит в очередь фоновое сохранение текущей записной книжки в файл.
      * \param fileName Имя файла.
      */
     void saveNotebookToFile(QString fileName);
-    //! Возвращает \c true, если в настоящий момент имеется открытая записная книжка.
-    bool isNotebookOpen() const;
+    /*!
+     * \brief Дописывает изменения текущей записной книжки в её журнал.
+     * \return \c true, если изменения записаны. \c false означает, что
+     * записную книжку нужно сохранить целиком.
+     */
+    bool appendToJournal();
+    //! Создаёт журнал изменений текущей записной книжки для файла \a fileName.
+    void attachJournal(const QString &fileName);
+    //! Создаёт полнотекстовый индекс текущей записной книжки.
+    void attachIndex();
+    /*!
+     * \brief Связывает признак изменения окна с набором изменений текущей записной книжки.
+     *
+     * Вызывается после загрузки записной книжки, чтобы заметки, добавляемые
+     * при загрузке, не отмечали окно изменённым.
+     */
+    void trackModified();
+    //! Создаёт историю изменений текущей записной книжки.
+    void attachHistory();
+    //! Обновляет состояние и текст пунктов меню отмены и повтора.
+    void updateUndoActions();
+    /*!
+     * \brief Выделяет в таблице строки \a rows с флагами \a command.
+     *
+     * Номера строк должны идти по возрастанию. Соседние строки объединяются
+     * в диапазоны, поэтому выделение остаётся компактным даже для большого
+     * количества строк.
+     */
+    void selectRows(const std::vector<int> &rows, QItemSelectionModel::SelectionFlags command);
+    /*!
+     * \brief Возвращает \c true, если текущая записная книжка ещё загружается.
+     *
+     * Пока записная книжка загружается, заметки можно просматривать,
+     * но нельзя изменять и сохранять.
+     */
+    bool isNotebookLoading() const;
+    //! Скрывает индикатор хода загрузки.
+    void hideLoadProgress();
+    /*!
+     * \brief Загружает неповреждённые заметки повреждённого файла \a fileName.
+     *
+     * Записная книжка не связывается с файлом, чтобы её сохранение не
+     * заменило повреждённый файл (см. NotebookFile::salvage()).
+     */
+    void salvageNotebook(const QString &fileName);
     //! Устанавливает имя файла текущей записной книжки равным \a name.
     void setNotebookFileName(QString name = QString());
-    //! Возвращает имя файла текущей записной книжки.
-    QString notebookName() const;
     //! Создаёт новую записную книжку.
     void createNotebook();
     //! Устанавливает указатель на текущую записную книжку равным \a notebook.
@@ -145,8 +258,72 @@ private:
      * или уничтожении самого unique_ptr.
      */
     std::unique_ptr<Notebook> mNotebook;
+    /*!
+     * \brief Модель-посредник, через которую таблица заметок отображает записную книжку.
+     *
+     * Номера строк таблицы заметок относятся к этой модели, а не к записной
+     * книжке (см. NoteFilterModel::mapToSource()).
+     */
+    std::unique_ptr<NoteFilterModel> mFilter;
+    /*!
+     * \brief Модель сортировки над фильтром; её строки и показывает таблица заметок.
+     *
+     * Объявлена после mFilter, чтобы уничтожаться раньше фильтра.
+     */
+    std::unique_ptr<NoteSortModel> mSort;
+    /*!
+     * \brief Журнал изменений текущей записной книжки.
+     *
+     * Объявлен после mNotebook, чтобы уничтожаться раньше записной книжки.
+     */
+    std::unique_ptr<NotebookJournal> mJournal;
+    //! Полнотекстовый индекс текущей записной книжки. Также уничтожается раньше записной книжки.
+    std::unique_ptr<NoteIndex> mIndex;
+    //! История изменений текущей записной книжки. Также уничтожается раньше записной книжки.
+    std::unique_ptr<NotebookHistory> mHistory;
+    //! Строка поиска на панели инструментов.
+    QLineEdit *mSearchEdit;
+    //! Строка фильтра на панели инструментов.
+    QLineEdit *mFilterEdit;
+    //! Таймер, откладывающий поиск, пока пользователь набирает запрос.
+    QTimer *mSearchTimer;
+    //! Объект поиска подстрок и регулярных выражений просмотром заметок.
+    NoteScanner *mScanner;
+    //! Объект фонового сохранения записных книжек.
+    NotebookSaver *mSaver;
+    //! Индикатор хода сохранения в строке состояния.
+    QProgressBar *mSaveProgress;
+    //! Объект фоновой загрузки записных книжек.
+    NotebookLoader *mLoader;
+    //! Индикатор хода загрузки в строке состояния.
+    QProgressBar *mLoadProgress;
+    //! Кнопка прерывания загрузки в строке состояния.
+    QPushButton *mLoadCancel;
+    //! Объект фоновой выгрузки записной книжки в текстовый файл.
+    NotebookExporter *mExporter;
+    //! Индикатор хода выгрузки в строке состояния.
+    QProgressBar *mExportProgress;
+    //! Кнопка прерывания выгрузки в строке состояния.
+    QPushButton *mExportCancel;
+    //! Идентификатор последнего задания сохранения текущей записной книжки.
+    quint64 mLastSaveJob;
+    //! Незавершённые задания сохранения, запущенные пользователем.
+    QSet<quint64> mSaveJobs;
+    //! Состояние записной книжки на момент снимка для незавершённых заданий её сохранения.
+    QHash<quint64, SaveMark> mSaveMarks;
     //! Имя файла текущей записной книжки.
     QString mNotebookFileName;
+    /*!
+     * \brief Записная книжка, в которую добавляются заметки выполняющегося чтения текстового файла.
+     *
+     * Сбрасывается при замене или закрытии записной книжки: прочитанные
+     * заметки тогда отбрасываются.
+     */
+    Notebook *mImportTarget;
+    //! Признак того, что текстовый файл читается.
+    bool mImporting;
+    //! Признак того, что выполняется загрузка с пропуском повреждённых записей.
+    bool mSalvaging;
 };
 
 #endif // MAINWINDOW_H
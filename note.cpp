@@ -6,43 +6,205 @@
  */
 #include "note.hpp"
 
+#include <utility> // move()
+
+#include "notecodec.hpp"
+
+namespace
+{
+
+//! Источник, хранящий сжатый текст одной заметки (см. Note::compressText()).
+class CompressedText : public NoteSource
+{
+public:
+    //! Конструктор. \a packed — сжатый текст.
+    explicit CompressedText(QByteArray packed)
+        : mPacked(std::move(packed))
+        , mCacheKey(NoteCodec::newCacheKey())
+    {
+    }
+    //! Заголовок в этом источнике не хранится.
+    QString title(quint32) const Q_DECL_OVERRIDE
+    {
+        return QString();
+    }
+    QString text(quint32) const Q_DECL_OVERRIDE
+    {
+        return NoteCodec::decompressCached(mCacheKey, 0, mPacked.constData(), mPacked.size());
+    }
+    QByteArray compressedText(quint32) const Q_DECL_OVERRIDE
+    {
+        return mPacked;
+    }
+    int textLength(quint32) const Q_DECL_OVERRIDE
+    {
+        return NoteCodec::decompressedLength(mPacked.constData(), mPacked.size());
+    }
+    //! Возвращает объём памяти, занимаемой источником, в байтах.
+    std::size_t memoryUsage() const
+    {
+        return sizeof(CompressedText) + static_cast<std::size_t>(mPacked.capacity());
+    }
+private:
+    //! Сжатый текст.
+    QByteArray mPacked;
+    //! Ключ источника в кэше распакованных текстов.
+    quint64 mCacheKey;
+};
+
+}
+
+NoteSource::~NoteSource()
+{
+}
+
+QByteArray NoteSource::compressedText(quint32) const
+{
+    return QByteArray();
+}
+
+int NoteSource::textLength(quint32 record) const
+{
+    return text(record).size();
+}
+
 Note::Note()
+    : mRecord(0)
+    , mLazyTitle(false)
+    , mLazyText(false)
 {
 }
 
 Note::Note(QString title, QString text)
-    : mTitle(title) // Передаём заголовок конструктору mTitle
-    , mText(text) // Передаём заголовок конструктору mText
+    : mTitle(std::move(title)) // Перемещаем заголовок в mTitle, не копируя строку
+    , mText(std::move(text)) // Перемещаем текст в mText
+    , mRecord(0)
+    , mLazyTitle(false)
+    , mLazyText(false)
 {
 }
 
-const QString &Note::title() const
+Note::Note(std::shared_ptr<const NoteSource> source, quint32 record)
+    : mSource(std::move(source))
+    , mRecord(record)
+    , mLazyTitle(true)
+    , mLazyText(true)
 {
-    return mTitle;
+}
+
+QString Note::title() const
+{
+    // Ленивый заголовок декодируется из источника при каждом обращении
+    return mLazyTitle ? mSource->title(mRecord) : mTitle;
 }
 
 void Note::setTitle(const QString &title)
 {
     mTitle = title;
+    mLazyTitle = false;
+    dropSourceIfUnused();
 }
 
-const QString &Note::text() const
+void Note::setTitle(QString &&title)
 {
-    return mText;
+    mTitle = std::move(title);
+    mLazyTitle = false;
+    dropSourceIfUnused();
+}
+
+QString Note::text() const
+{
+    // Ленивый текст декодируется из источника при каждом обращении,
+    // в объекте он не сохраняется
+    return mLazyText ? mSource->text(mRecord) : mText;
 }
 
 void Note::setText(const QString &text)
 {
     mText = text;
+    mLazyText = false;
+    dropSourceIfUnused();
+}
+
+void Note::setText(QString &&text)
+{
+    mText = std::move(text);
+    mLazyText = false;
+    dropSourceIfUnused();
+}
+
+int Note::textLength() const
+{
+    return mLazyText ? mSource->textLength(mRecord) : mText.size();
+}
+
+bool Note::isTextLazy() const
+{
+    return mLazyText;
+}
+
+void Note::compressText()
+{
+    // Источник уже используется текстом или заголовком
+    if (mLazyText || mSource)
+    {
+        return;
+    }
+    QByteArray packed = NoteCodec::compress(mText);
+    if (packed.isEmpty())
+    {
+        return;
+    }
+    mSource = std::make_shared<CompressedText>(std::move(packed));
+    mRecord = 0;
+    mLazyText = true;
+    mText.clear();
+}
+
+QByteArray Note::compressedText() const
+{
+    return mLazyText ? mSource->compressedText(mRecord) : QByteArray();
+}
+
+std::size_t Note::memoryUsage() const
+{
+    std::size_t usage = sizeof(Note);
+    if (!mLazyTitle)
+    {
+        usage += static_cast<std::size_t>(mTitle.capacity()) * sizeof(QChar);
+    }
+    if (!mLazyText)
+    {
+        usage += static_cast<std::size_t>(mText.capacity()) * sizeof(QChar);
+    }
+    // Сжатый текст (см. compressText()) принадлежит заметке, хотя и читается
+    // через источник
+    else if (const CompressedText *packed = dynamic_cast<const CompressedText *>(mSource.get()))
+    {
+        usage += packed->memoryUsage();
+    }
+    return usage;
 }
 
 void Note::save(QDataStream &ost) const
 {
-    ost << mTitle << mText;
+    ost << title() << text();
 }
 
 void Note::load(QDataStream &ist)
 {
     ist >> mTitle >> mText;
+    mLazyTitle = mLazyText = false;
+    dropSourceIfUnused();
 }
 
+void Note::dropSourceIfUnused()
+{
+    // Если оба поля хранятся в объекте, источник больше не нужен. Освобождая
+    // указатель, мы позволяем удалить источник (например, закрыть файл), когда
+    // на него не останется ссылок
+    if (!mLazyTitle && !mLazyText)
+    {
+        mSource.reset();
+    }
+}
@@ -7,11 +7,54 @@
 #ifndef NOTE_HPP
 #define NOTE_HPP
 
+#include <cstddef> // size_t
+#include <memory> // shared_ptr
+
+#include <QByteArray>
 #include <QDataStream>
 #include <QString>
 
+/*!
+ * \brief Интерфейс источника данных заметок.
+ *
+ * Позволяет заметке не хранить заголовок и текст у себя, а получать их по
+ * требованию. Источником может быть, например, отображённый в память файл
+ * записной книжки (см. NotebookFile). Методы источника могут вызываться
+ * из разных потоков одновременно.
+ */
+class NoteSource
+{
+public:
+    //! Виртуальный деструктор, чтобы источники можно было удалять через указатель на базовый класс.
+    virtual ~NoteSource();
+    //! Возвращает заголовок записи с номером \a record.
+    virtual QString title(quint32 record) const = 0;
+    //! Возвращает текст записи с номером \a record.
+    virtual QString text(quint32 record) const = 0;
+    /*!
+     * \brief Возвращает сжатый текст записи с номером \a record (см. NoteCodec).
+     *
+     * Если текст хранится в источнике несжатым, возвращает пустой массив.
+     * Реализация по умолчанию всегда возвращает пустой массив.
+     */
+    virtual QByteArray compressedText(quint32 record) const;
+    /*!
+     * \brief Возвращает длину текста записи с номером \a record в символах.
+     *
+     * Реализация по умолчанию декодирует текст; источники, знающие длину
+     * заранее, переопределяют метод, чтобы не декодировать его.
+     */
+    virtual int textLength(quint32 record) const;
+};
+
 /*!
  * \brief Класс заметки.
+ *
+ * Заголовок и текст заметки могут храниться в самом объекте или читаться
+ * по требованию из источника NoteSource (\e ленивая заметка). Во втором
+ * случае методы title() и text() каждый раз декодируют данные источника,
+ * не сохраняя их в объекте, поэтому открытая записная книжка не держит
+ * тексты заметок в памяти.
  */
 class Note
 {
@@ -26,23 +69,76 @@ public:
      * Создаёт объект Note с заголовком \a title и текстом \a text.
      */
     Note(QString title, QString text);
+    /*!
+     * \brief Конструктор ленивой заметки.
+     * \param source Источник данных заметки.
+     * \param record Номер записи в источнике.
+     *
+     * Создаёт объект Note, заголовок и текст которого читаются из записи
+     * \a record источника \a source при обращении к ним.
+     */
+    Note(std::shared_ptr<const NoteSource> source, quint32 record);
     //! Возвращает заголовок заметки.
-    const QString &title() const;
+    QString title() const;
     //! Устанавливает заголовок заметки равным \a title.
     void setTitle(const QString &title);
+    //! Устанавливает заголовок заметки равным \a title, перемещая строку в заметку.
+    void setTitle(QString &&title);
     //! Возвращает текст заметки.
-    const QString &text() const;
+    QString text() const;
     //! Устанавливает заголовок заметки равным \a text.
     void setText(const QString &text);
+    //! Устанавливает текст заметки равным \a text, перемещая строку в заметку.
+    void setText(QString &&text);
+    /*!
+     * \brief Возвращает длину текста заметки в символах.
+     *
+     * В отличие от text().size(), не декодирует и не распаковывает ленивый
+     * или сжатый текст, если источник знает его длину.
+     */
+    int textLength() const;
+    //! Возвращает \c true, если текст заметки читается из источника по требованию.
+    bool isTextLazy() const;
+    /*!
+     * \brief Сжимает текст заметки в памяти.
+     *
+     * Сжатый текст хранится в отдельном источнике и распаковывается при
+     * каждом вызове text() (через кэш NoteCodec). Копии заметки разделяют
+     * сжатые данные. Текст, уже читаемый из источника, а также короткий или
+     * плохо сжимаемый текст не изменяется.
+     */
+    void compressText();
+    //! Возвращает сжатый текст заметки или пустой массив, если текст не сжат.
+    QByteArray compressedText() const;
+    /*!
+     * \brief Оценивает объём памяти, занимаемой заметкой, в байтах.
+     *
+     * Поля, читаемые из источника, не учитываются: источник не принадлежит
+     * заметке. Исключение — сжатый текст (см. compressText()): его источник
+     * создан самой заметкой, и учитывается размер сжатых данных. Строки,
+     * разделяемые с другими заметками, учитываются полностью.
+     */
+    std::size_t memoryUsage() const;
     //! Сохраняет заметку в поток \a ost.
     void save(QDataStream &ost) const;
     //! Загружает заметку из потока \a ist.
     void load(QDataStream &ist);
 private:
+    //! Отвязывает заметку от источника, если ни одно поле больше не читается из него.
+    void dropSourceIfUnused();
+
     //! Заголовок заметки.
     QString mTitle;
     //! Текст заметки.
     QString mText;
+    //! Источник данных ленивой заметки (пустой, если все поля хранятся в объекте).
+    std::shared_ptr<const NoteSource> mSource;
+    //! Номер записи в источнике mSource.
+    quint32 mRecord;
+    //! Признак того, что заголовок читается из источника.
+    bool mLazyTitle;
+    //! Признак того, что текст читается из источника.
+    bool mLazyText;
 };
 
 /*!
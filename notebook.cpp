@@ -6,22 +6,49 @@
  */
 #include "notebook.hpp"
 
-#include <iterator> // next()
+#include <algorithm> // for_each(), is_sorted(), lower_bound(), max(), min(), minmax_element(), move(), move_backward(), sort()
+#include <iterator> // make_move_iterator(), next(), prev()
 #include <stdexcept> // runtime_error
+#include <utility> // move(), pair
 
+#include <QFile>
 #include <QString> // QString::number()
+#include <QtConcurrent/QtConcurrentMap>
 
 #include "note.hpp"
+#include "notebookfile.hpp"
+#include "notedecoder.hpp"
+#include "trace.hpp"
+#include "vectornotestorage.hpp"
+
+namespace
+{
+
+//! Количество недостающих ключей сортировки, начиная с которого они вычисляются параллельно.
+const std::size_t parallelSortKeys = 4096;
+
+}
 
 Notebook::Notebook()
+    : Notebook(std::unique_ptr<NoteStorage>(new VectorNoteStorage))
+{
+}
+
+Notebook::Notebook(std::unique_ptr<NoteStorage> storage)
+    : mStorage(std::move(storage))
+    , mNextId(1)
+    , mIdsOrdered(true)
+    , mGapStart(0)
+    , mGapSize(0)
+    , mGeneration(0)
+    , mTextCompression(false)
 {
 }
 
 /*!
- * Возвращает ссылку на заметку с индексом \a idx. Слово \c const после
+ * Возвращает копию заметки с индексом \a idx. Слово \c const после
  * списка параметров означает, что это константная версия метода,
- * она не может изменять данные класса. Результат также имеет квалификатор
- * \c const, т. е. по этой ссылке заметку нельзя изменить.
+ * она не может изменять данные класса.
  *
  * Таким образом, данный метод позволяет прочитать заметку с индексом \a idx
  * из коллекции, но не изменить её.
@@ -35,16 +62,175 @@ Notebook::Notebook()
  * неподконтрольна данному классу и он не имеет возможности узнать,
  * была ли заметка реально изменена и когда это произошло, а значит не может
  * уведомить присоединённые виды о том, что данные изменились.
+ *
+ * Метод возвращает копию, а не ссылку, потому что хранилище может вовсе не
+ * держать объекты Note (см. ArenaNoteStorage) и создаёт заметку по
+ * требованию. Копия заметки из вектора дёшева благодаря неявному разделению
+ * данных QString.
  * \sa \ref faq_const_method
  */
-const Note &Notebook::operator[](Notebook::SizeType idx) const
+Note Notebook::operator[](Notebook::SizeType idx) const
 {
-    return mNotes[idx];
+    return mStorage->note(physical(idx));
 }
 
 Notebook::SizeType Notebook::size() const
 {
-    return mNotes.size();
+    return static_cast<SizeType>(mStorage->size()) - mGapSize;
+}
+
+std::vector<Note> Notebook::snapshot() const
+{
+    return withoutGap(mStorage->snapshot());
+}
+
+Notebook::NoteId Notebook::idAt(SizeType idx) const
+{
+    return mIds[physical(idx)];
+}
+
+/*!
+ * Пока идентификаторы идут по возрастанию, индекс находится двоичным
+ * поиском в mIds за логарифмическое время. Во время удаления диапазонов
+ * (см. eraseRanges()) поиск ведётся отдельно до и после промежутка.
+ *
+ * После вставки в середину идентификаторы идут не по порядку, и поиск
+ * ведётся в mRowIndex. Он строится за O(n log n) при первом вызове после
+ * сдвига строк, поэтому серия вызовов (например, при отмене удаления
+ * многих заметок) стоит одного построения.
+ */
+Notebook::SizeType Notebook::rowOf(NoteId id) const
+{
+    if (!mIdsOrdered)
+    {
+        if (mRowIndex.empty())
+        {
+            mRowIndex.reserve(static_cast<std::size_t>(size()));
+            for (SizeType row = 0; row < size(); ++row)
+            {
+                mRowIndex.emplace_back(mIds[physical(row)], row);
+            }
+            std::sort(mRowIndex.begin(), mRowIndex.end());
+        }
+        auto it = std::lower_bound(mRowIndex.begin(), mRowIndex.end(), std::make_pair(id, SizeType(0)));
+        return it != mRowIndex.end() && it->first == id ? it->second : -1;
+    }
+    auto gapBegin = std::next(mIds.begin(), mGapStart);
+    auto gapEnd = std::next(gapBegin, mGapSize);
+    auto it = std::lower_bound(mIds.begin(), gapBegin, id);
+    if (it != gapBegin && *it == id)
+    {
+        return static_cast<SizeType>(it - mIds.begin());
+    }
+    it = std::lower_bound(gapEnd, mIds.end(), id);
+    if (it == mIds.end() || *it != id)
+    {
+        return -1;
+    }
+    return static_cast<SizeType>(it - mIds.begin()) - mGapSize;
+}
+
+std::vector<Notebook::NoteId> Notebook::ids() const
+{
+    return withoutGap(mIds);
+}
+
+bool Notebook::isConcurrentReadable() const
+{
+    return mStorage->isConcurrentReadable();
+}
+
+QCollator Notebook::collator() const
+{
+    return mCollator;
+}
+
+void Notebook::setCollator(const QCollator &collator)
+{
+    mCollator = collator;
+    resetSortKeys();
+}
+
+void Notebook::prepareSortKeys(SizeType first, SizeType last)
+{
+    TRACE_SCOPE("Notebook::prepareSortKeys");
+    std::vector<SizeType> missing;
+    for (SizeType i = first; i <= last; ++i)
+    {
+        if (!mSortKeys[physical(i)])
+        {
+            missing.push_back(physical(i));
+        }
+    }
+    // QCollator настраивается при первом использовании, поэтому вычисляем
+    // первый ключ здесь, а остальные потоки только читают настройки
+    auto compute = [this](SizeType cell) {
+        mSortKeys[cell].reset(new QCollatorSortKey(mCollator.sortKey(mStorage->title(cell))));
+    };
+    // Хранилище, привязанное к потоку, читаем только из этого потока
+    if (missing.size() < parallelSortKeys || !mStorage->isConcurrentReadable())
+    {
+        std::for_each(missing.begin(), missing.end(), compute);
+        return;
+    }
+    compute(missing.front());
+    QtConcurrent::blockingMap(std::next(missing.begin()), missing.end(), compute);
+}
+
+const QCollatorSortKey &Notebook::sortKey(SizeType idx) const
+{
+    return *mSortKeys[physical(idx)];
+}
+
+bool Notebook::isModified() const
+{
+    return !mDirty.empty();
+}
+
+Notebook::Generation Notebook::generation() const
+{
+    return mGeneration;
+}
+
+std::vector<Notebook::IdRange> Notebook::dirtyRanges() const
+{
+    std::vector<IdRange> ranges;
+    ranges.reserve(mDirty.size());
+    for (const auto &range : mDirty)
+    {
+        ranges.push_back(IdRange{ range.first, range.second.last });
+    }
+    return ranges;
+}
+
+bool Notebook::isDirty(NoteId id) const
+{
+    // Находим последний диапазон, начинающийся не позже id
+    auto it = mDirty.upper_bound(id);
+    return it != mDirty.begin() && std::prev(it)->second.last >= id;
+}
+
+void Notebook::markClean(Generation generation)
+{
+    if (mDirty.empty())
+    {
+        return;
+    }
+    for (auto it = mDirty.begin(); it != mDirty.end();)
+    {
+        if (it->second.generation <= generation)
+        {
+            it = mDirty.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (mDirty.empty())
+    {
+        emit modifiedChanged(false);
+    }
 }
 
 /*!
@@ -55,7 +241,7 @@ Notebook::SizeType Notebook::size() const
  */
 int Notebook::rowCount(const QModelIndex &parent) const
 {
-    return !parent.isValid() ? mNotes.size() : 0;
+    return !parent.isValid() ? size() : 0;
 }
 
 /*!
@@ -85,8 +271,8 @@ QVariant Notebook::data(const QModelIndex &index, int role) const
         if (index.column() == 0)
         {
             // При возврате строка заголовка (QString) автоматически преобразуется
-            // в QVariant
-            return mNotes[index.row()].title();
+            // в QVariant. Заголовок читается из хранилища без создания заметки
+            return mStorage->title(physical(index.row()));
         }
     }
     // Игнорируем все остальные запросы, возвращая пустой QVariant
@@ -125,52 +311,116 @@ QVariant Notebook::headerData(int section, Qt::Orientation orientation, int role
     return QVariant();
 }
 
+bool Notebook::textCompression() const
+{
+    return mTextCompression;
+}
+
+void Notebook::setTextCompression(bool on)
+{
+    // Содержимое заметок не меняется, поэтому виды не уведомляются
+    mStorage->setTextCompression(on);
+    mTextCompression = on;
+}
+
+/*!
+ * Записывает заметки в поток \a ost в формате версии 2 (см. NotebookFile).
+ */
 void Notebook::save(QDataStream &ost) const
 {
-    // Цикл по всем заметкам
-    for (const Note &n : mNotes)
-    {
-        // Выводим заметку в поток
-        ost << n;
-        // Если возникла ошибка, запускаем исключительную ситуацию
-        if (ost.status() == QDataStream::WriteFailed)
-        {
-            throw std::runtime_error(tr("Write to the stream failed").toStdString());
-        }
-    }
+    TRACE_SCOPE("Notebook::save");
+    NotebookFile::write(ost, snapshot(), NotebookFile::ProgressFunction(), mTextCompression);
 }
 
+/*!
+ * Определяет версию формата по началу данных потока \a ist. Файлы версии 1
+ * читаются классом NoteDecoder, файлы версии 2 загружаются методом
+ * loadVersion2().
+ */
 Notebook::SizeType Notebook::load(QDataStream &ist)
 {
+    TRACE_SCOPE("Notebook::load");
+    if (NotebookFile::isVersion2(ist.device()))
+    {
+        return loadVersion2(ist);
+    }
+    // Читаем заметки во временный вектор, чтобы передать их хранилищу разом.
+    // Записи декодируются параллельно (см. NoteDecoder).
+    // Файл читается до начала сброса модели, чтобы ошибка не оставила
+    // модель в промежуточном состоянии
+    std::vector<Note> notes = NoteDecoder::readAll(ist.device());
     // В соответствии с требованиями Qt, уведомляем привязанные виды о том,
     // что мы начинаем сброс модели (данные и структура модели могут
     // радикально измениться, поэтому сохранённая где-либо информация о модели
     // должна быть обновлена).
     // См. QAbstractItemModel
     beginResetModel();
-    // Удаляем все заметки
-    mNotes.clear();
-    // Пока в потоке есть данные
-    while (!ist.atEnd())
-    {
-        Note n;
-        // Читаем очередную заметку из потока
-        ist >> n;
-        // Если возникла ошибка, запускаем исключительную ситуацию
-        if (ist.status() == QDataStream::ReadCorruptData)
-        {
-            throw std::runtime_error(tr("Corrupt data were read from the stream").toStdString());
-        }
-        // Вставляем прочитанную заметку в конец вектора mNotes
-        mNotes.push_back(n);
-    }
+    // Заменяем все заметки хранилища прочитанными
+    mStorage->clear();
+    mStorage->append(std::move(notes));
+    // Выдаём идентификаторы загруженным заметкам
+    mIds.clear();
+    assignIds(0);
+    mIdsOrdered = true;
+    mRowIndex.clear();
+    resetSortKeys();
     // В соответствии с требованиями Qt, уведомляем привязанные виды о том,
     // что мы закончили сброс модели
     endResetModel();
-    return mNotes.size();
+    // Загруженная записная книжка совпадает с файлом
+    resetDirty();
+    return size();
+}
+
+/*!
+ * Если поток \a ist связан с файлом, файл отображается в память, иначе
+ * все данные потока считываются в память. Заметки записной книжки становятся
+ * ленивыми: таблица смещений позволяет получать заголовки для data(),
+ * не трогая тексты, а текст декодируется только при вызове Note::text().
+ */
+Notebook::SizeType Notebook::loadVersion2(QDataStream &ist)
+{
+    TRACE_SCOPE("Notebook::loadVersion2");
+    std::shared_ptr<NotebookFile> file;
+    // qobject_cast() возвращает нулевой указатель, если устройство не является файлом
+    QFile *f = qobject_cast<QFile *>(ist.device());
+    if (f && !f->fileName().isEmpty())
+    {
+        file = NotebookFile::open(f->fileName());
+    }
+    else
+    {
+        file = NotebookFile::fromData(ist.device()->readAll());
+    }
+    // Загрузка синхронная, поэтому записи проверяем сразу, все параллельно
+    file->verify();
+    // Файл открываем и проверяем до начала сброса модели, чтобы ошибка
+    // не оставила модель в промежуточном состоянии
+    std::vector<Note> notes;
+    notes.reserve(file->size());
+    for (NotebookFile::SizeType i = 0; i < file->size(); ++i)
+    {
+        notes.push_back(file->note(i));
+    }
+    beginResetModel();
+    mStorage->clear();
+    mStorage->append(std::move(notes));
+    mIds.clear();
+    assignIds(0);
+    mIdsOrdered = true;
+    mRowIndex.clear();
+    resetSortKeys();
+    endResetModel();
+    resetDirty();
+    return size();
 }
 
 void Notebook::insert(const Note &note)
+{
+    insert(Note(note));
+}
+
+void Notebook::insert(Note &&note)
 {
     // В соответствии с требованиями Qt, уведомляем привязанные виды о том,
     // что мы начинаем вставлять строки в модель.
@@ -179,30 +429,403 @@ void Notebook::insert(const Note &note)
                     size(), // Номер первой добавляемой строки
                     size() // Номер последней добавляемой строки
                     );
-    // Вставляем заметку в конец вектора mNotes
-    mNotes.push_back(note);
+    // Вставляем заметку в конец хранилища
+    mStorage->insert(mStorage->size(), std::move(note));
+    // Выдаём новой заметке идентификатор
+    mIds.push_back(mNextId++);
+    mSortKeys.emplace_back();
+    mRowIndex.clear();
     // В соответствии с требованиями Qt, уведомляем привязанные виды о том,
     // что мы закончили вставлять строки в модель.
     endInsertRows();
+    markDirty(mIds.back(), mIds.back());
+}
+
+void Notebook::append(std::vector<Note> notes)
+{
+    insertMany(size(), std::move(notes));
+}
+
+void Notebook::insertMany(SizeType idx, std::vector<Note> notes)
+{
+    TRACE_SCOPE("Notebook::insertMany");
+    if (notes.empty())
+    {
+        return;
+    }
+    SizeType count = static_cast<SizeType>(notes.size());
+    if (idx == size())
+    {
+        // Уведомляем виды о вставке сразу всего диапазона строк
+        beginInsertRows(QModelIndex(), idx, idx + count - 1);
+        // Перемещаем заметки в конец хранилища, не копируя их
+        mStorage->append(std::move(notes));
+        assignIds(idx);
+        mSortKeys.resize(mStorage->size());
+        mRowIndex.clear();
+        endInsertRows();
+        // Новые заметки получили идентификаторы подряд
+        markDirty(mIds[idx], mIds.back());
+        return;
+    }
+    // Идентификаторы между соседями могли принадлежать удалённым заметкам,
+    // которые ещё может вернуть отмена (см. restore()), поэтому новые
+    // заметки получают новые идентификаторы из mNextId, хотя они больше
+    // идентификаторов следующих заметок. Ключи сортировки не копируются,
+    // поэтому пустые ключи новых заметок вставляются перемещением
+    std::vector<NoteId> ids(notes.size());
+    std::vector<std::unique_ptr<QCollatorSortKey>> keys(notes.size());
+    for (NoteId &id : ids)
+    {
+        id = mNextId++;
+    }
+    beginInsertRows(QModelIndex(), idx, idx + count - 1);
+    mStorage->insertMany(idx, std::move(notes));
+    mIds.insert(std::next(mIds.begin(), idx), ids.begin(), ids.end());
+    mSortKeys.insert(std::next(mSortKeys.begin(), idx), std::make_move_iterator(keys.begin()),
+                     std::make_move_iterator(keys.end()));
+    mIdsOrdered = false;
+    mRowIndex.clear();
+    endInsertRows();
+    markDirty(ids.front(), ids.back());
+}
+
+void Notebook::reserve(SizeType size)
+{
+    mStorage->reserve(static_cast<NoteStorage::SizeType>(size));
+    mIds.reserve(size);
+    mSortKeys.reserve(size);
+}
+
+void Notebook::insertAt(SizeType idx, const Note &note)
+{
+    TRACE_SCOPE("Notebook::insertAt");
+    if (idx == size())
+    {
+        insert(note);
+        return;
+    }
+    // Как и в insertMany(), заметка получает новый идентификатор
+    NoteId id = mNextId++;
+    beginInsertRows(QModelIndex(), idx, idx);
+    mStorage->insert(idx, note);
+    mIds.insert(std::next(mIds.begin(), idx), id);
+    mSortKeys.emplace(std::next(mSortKeys.begin(), idx));
+    mIdsOrdered = false;
+    mRowIndex.clear();
+    endInsertRows();
+    markDirty(id, id);
+}
+
+/*!
+ * Заметки, встающие на одно место, образуют серию. Серии обходятся с конца,
+ * так что номера строк ещё не обработанных серий не меняются. Хранилище сразу
+ * увеличивается до итогового размера; свободные элементы образуют промежуток
+ * (см. eraseRanges()), который перед каждой серией сдвигается к её месту,
+ * а затем заполняется её заметками. Каждая существующая заметка при этом
+ * перемещается не более одного раза, а хранилище сдвигает заметки за
+ * каждой серией одним вызовом NoteStorage::moveRange().
+ */
+void Notebook::restore(const std::vector<SizeType> &rows, const std::vector<NoteId> &ids,
+                       const std::vector<Note> &notes)
+{
+    TRACE_SCOPE("Notebook::restore");
+    // Серия: заметки notes[first] ... notes[last - 1], встающие перед строкой row
+    struct Run
+    {
+        SizeType row;
+        std::size_t first;
+        std::size_t last;
+    };
+    std::vector<Run> runs;
+    // Номера возвращаемых заметок (без уже имеющихся идентификаторов)
+    std::vector<std::size_t> picked;
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+        if (rowOf(ids[i]) >= 0)
+        {
+            continue;
+        }
+        // Перед заметкой встанут уже выбранные заметки, поэтому среди
+        // существующих она встаёт на место с номером на столько же меньше
+        SizeType row = std::max(0, std::min(rows[i] - static_cast<SizeType>(picked.size()), size()));
+        if (runs.empty() || runs.back().row != row)
+        {
+            runs.push_back(Run{ row, picked.size(), picked.size() });
+        }
+        picked.push_back(i);
+        runs.back().last = picked.size();
+    }
+    if (picked.empty())
+    {
+        return;
+    }
+    SizeType count = static_cast<SizeType>(picked.size());
+    // Существующие заметки, ещё не сдвинутые к концу хранилища, занимают
+    // ячейки с 0 по end - 1
+    SizeType end = size();
+    mStorage->resize(mStorage->size() + picked.size());
+    mIds.resize(mIds.size() + picked.size());
+    mSortKeys.resize(mSortKeys.size() + picked.size());
+    mGapStart = end;
+    mGapSize = count;
+    // Возвращённые заметки могут встать не по порядку идентификаторов
+    mIdsOrdered = false;
+    for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+    {
+        // Сдвигаем заметки после места серии к концу, за промежуток.
+        // Хранилище переносит диапазон целиком (см. NoteStorage::moveRange())
+        mStorage->moveRange(run->row, end, run->row + mGapSize);
+        std::move_backward(std::next(mIds.begin(), run->row), std::next(mIds.begin(), end),
+                           std::next(mIds.begin(), end + mGapSize));
+        std::move_backward(std::next(mSortKeys.begin(), run->row), std::next(mSortKeys.begin(), end),
+                           std::next(mSortKeys.begin(), end + mGapSize));
+        end = run->row;
+        mGapStart = run->row;
+        SizeType length = static_cast<SizeType>(run->last - run->first);
+        mRowIndex.clear();
+        beginInsertRows(QModelIndex(), run->row, run->row + length - 1);
+        // Заполняем конец промежутка заметками серии
+        SizeType to = mGapStart + mGapSize - length;
+        for (std::size_t k = run->first; k < run->last; ++k, ++to)
+        {
+            mStorage->set(to, notes[picked[k]]);
+            mIds[to] = ids[picked[k]];
+            mSortKeys[to].reset();
+        }
+        mGapSize -= length;
+        mRowIndex.clear();
+        endInsertRows();
+    }
+    mGapStart = 0;
+    mIdsOrdered = std::is_sorted(mIds.begin(), mIds.end());
+    mRowIndex.clear();
+    for (const Run &run : runs)
+    {
+        auto bounds = std::minmax_element(std::next(picked.begin(), run.first),
+                                          std::next(picked.begin(), run.last),
+                                          [&ids](std::size_t a, std::size_t b) { return ids[a] < ids[b]; });
+        markDirty(ids[*bounds.first], ids[*bounds.second]);
+    }
 }
 
 void Notebook::updateNoteAt(const Note &note, SizeType idx)
 {
-    mNotes[idx] = note;
-    dataChanged(QModelIndex(), QModelIndex());
+    updateNoteAt(Note(note), idx);
+}
+
+void Notebook::updateNoteAt(Note &&note, SizeType idx)
+{
+    mStorage->set(physical(idx), std::move(note));
+    // Ключ сортировки будет вычислен заново по новому заголовку
+    mSortKeys[physical(idx)].reset();
+    // Уведомляем виды об изменении всех столбцов строки idx
+    emit dataChanged(index(idx, 0), index(idx, columnCount() - 1));
+    markDirty(idAt(idx), idAt(idx));
 }
 
 void Notebook::erase(SizeType idx)
 {
+    NoteId id = mIds[idx];
     // В соответствии с требованиями Qt, уведомляем привязанные виды о том,
     // что мы начинаем удалять строки из модели
     beginRemoveRows(QModelIndex(), // Индекс родителя, из списка потомков которого удаляются строки
                     idx, // Номер первой удаляемой строки
                     idx // Номер последней удаляемой строки
                     );
-    // Удаляем из вектора элемент с индексом idx
-    mNotes.erase(std::next(mNotes.begin(), idx));
+    // Удаляем из хранилища ячейку с индексом idx
+    mStorage->erase(idx, idx + 1);
+    mIds.erase(std::next(mIds.begin(), idx));
+    mSortKeys.erase(std::next(mSortKeys.begin(), idx));
+    mRowIndex.clear();
     // В соответствии с требованиями Qt, уведомляем привязанные виды о том,
     // что мы закончили удалять строки из модели
     endRemoveRows();
+    markDirty(id, id);
+}
+
+/*!
+ * Диапазоны выделения упорядочиваются и объединяются, если они пересекаются
+ * или соприкасаются; столбцы диапазонов не учитываются. Затем диапазоны
+ * обходятся по возрастанию, и заметки, оставшиеся между ними, сдвигаются
+ * к началу хранилища. Каждая оставшаяся заметка перемещается не более одного
+ * раза, поэтому удаление занимает линейное время независимо от количества
+ * диапазонов, а не O(n) на каждую удалённую строку, как при вызовах erase().
+ * Хранилище получает по одному вызову NoteStorage::moveRange() на каждый
+ * промежуток между диапазонами (см. moveCells()).
+ *
+ * Виды уведомляются об удалении каждого диапазона отдельно, и между
+ * уведомлениями модель должна выглядеть так, будто удалены только
+ * предыдущие диапазоны. Для этого освободившиеся ячейки хранилища образуют
+ * промежуток (mGapStart, mGapSize), который пропускают методы чтения
+ * (см. physical()). К концу удаления промежуток переносится в конец
+ * хранилища и отрезается.
+ */
+void Notebook::eraseRanges(const QItemSelection &selection)
+{
+    TRACE_SCOPE("Notebook::eraseRanges");
+    // Собираем диапазоны строк
+    std::vector<std::pair<SizeType, SizeType>> ranges;
+    for (const QItemSelectionRange &range : selection)
+    {
+        if (range.isValid() && range.model() == this)
+        {
+            ranges.emplace_back(range.top(), range.bottom());
+        }
+    }
+    if (ranges.empty())
+    {
+        return;
+    }
+    std::sort(ranges.begin(), ranges.end());
+    // Объединяем пересекающиеся и соседние диапазоны
+    auto last = ranges.begin();
+    for (auto it = std::next(ranges.begin()); it != ranges.end(); ++it)
+    {
+        if (it->first <= last->second + 1)
+        {
+            last->second = std::max(last->second, it->second);
+        }
+        else
+        {
+            *++last = *it;
+        }
+    }
+    ranges.erase(std::next(last), ranges.end());
+    // Идентификаторы удаляемых заметок каждого диапазона. Между ними могут
+    // быть идентификаторы, удалённые раньше, или, если идентификаторы идут
+    // не по порядку, идентификаторы других заметок — набор изменений
+    // от этого лишь отметит больше, чем нужно
+    std::vector<IdRange> removed;
+    removed.reserve(ranges.size());
+    for (const auto &range : ranges)
+    {
+        auto bounds = std::minmax_element(std::next(mIds.begin(), range.first),
+                                          std::next(mIds.begin(), range.second + 1));
+        removed.push_back(IdRange{ *bounds.first, *bounds.second });
+    }
+
+    // Позиция, куда перемещается следующая оставшаяся заметка
+    SizeType write = ranges.front().first;
+    // Первая оставшаяся заметка после предыдущего диапазона
+    SizeType read = write;
+    for (const auto &range : ranges)
+    {
+        // Сдвигаем заметки между предыдущим и текущим диапазонами вплотную
+        // к уже сдвинутым, так что промежуток оказывается перед текущим диапазоном
+        write = moveCells(read, range.first, write);
+        read = range.first;
+        mGapStart = write;
+        mGapSize = read - write;
+        mRowIndex.clear();
+        // Номера строк диапазона с учётом уже удалённых строк
+        beginRemoveRows(QModelIndex(), range.first - mGapSize, range.second - mGapSize);
+        // Удалённые заметки присоединяются к промежутку
+        read = range.second + 1;
+        mGapSize = read - write;
+        mRowIndex.clear();
+        endRemoveRows();
+    }
+    // Сдвигаем заметки после последнего диапазона и отрезаем промежуток
+    write = moveCells(read, static_cast<SizeType>(mStorage->size()), write);
+    mStorage->resize(write);
+    mIds.resize(write);
+    mSortKeys.resize(write);
+    mGapStart = 0;
+    mGapSize = 0;
+    // Удаление могло убрать заметки, стоявшие не по порядку
+    mIdsOrdered = mIdsOrdered || std::is_sorted(mIds.begin(), mIds.end());
+    for (const IdRange &range : removed)
+    {
+        markDirty(range.first, range.last);
+    }
+}
+
+/*!
+ * Ячейки хранилища переносятся одним вызовом NoteStorage::moveRange(),
+ * поэтому хранилище, которому перенос по одной ячейке дорог (например,
+ * SqliteNoteStorage), сдвигает весь диапазон сразу.
+ */
+Notebook::SizeType Notebook::moveCells(SizeType first, SizeType last, SizeType to)
+{
+    if (first == to)
+    {
+        return last;
+    }
+    mStorage->moveRange(first, last, to);
+    std::move(std::next(mIds.begin(), first), std::next(mIds.begin(), last), std::next(mIds.begin(), to));
+    std::move(std::next(mSortKeys.begin(), first), std::next(mSortKeys.begin(), last),
+              std::next(mSortKeys.begin(), to));
+    return to + (last - first);
+}
+
+Notebook::SizeType Notebook::physical(SizeType idx) const
+{
+    return idx < mGapStart ? idx : idx + mGapSize;
+}
+
+template <typename T>
+std::vector<T> Notebook::withoutGap(std::vector<T> v) const
+{
+    if (mGapSize != 0)
+    {
+        v.erase(std::next(v.begin(), mGapStart), std::next(v.begin(), mGapStart + mGapSize));
+    }
+    return v;
+}
+
+/*!
+ * Диапазон объединяется с пересекающимися и соседними диапазонами набора,
+ * поэтому, например, последовательно вставленные заметки образуют один
+ * диапазон.
+ */
+void Notebook::markDirty(NoteId first, NoteId last)
+{
+    bool wasModified = isModified();
+    ++mGeneration;
+    // Первый диапазон, который может пересечься с новым или примкнуть к нему,
+    // начинается не позже first или сразу за ним
+    auto it = mDirty.upper_bound(first);
+    if (it != mDirty.begin() && std::prev(it)->second.last + 1 >= first)
+    {
+        --it;
+    }
+    while (it != mDirty.end() && it->first <= last + 1)
+    {
+        first = std::min(first, it->first);
+        last = std::max(last, it->second.last);
+        it = mDirty.erase(it);
+    }
+    mDirty.emplace(first, DirtyRange{ last, mGeneration });
+    if (!wasModified)
+    {
+        emit modifiedChanged(true);
+    }
+}
+
+void Notebook::resetDirty()
+{
+    bool wasModified = isModified();
+    mDirty.clear();
+    ++mGeneration;
+    if (wasModified)
+    {
+        emit modifiedChanged(false);
+    }
+}
+
+void Notebook::resetSortKeys()
+{
+    mSortKeys.clear();
+    mSortKeys.resize(mStorage->size());
+}
+
+void Notebook::assignIds(SizeType first)
+{
+    mIds.resize(first);
+    mIds.reserve(mStorage->size());
+    for (SizeType i = first; i < size(); ++i)
+    {
+        mIds.push_back(mNextId++);
+    }
 }
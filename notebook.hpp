@@ -8,12 +8,18 @@
 #define NOTEBOOK_HPP
 
 #include <cstddef> // size_t
+#include <map>
+#include <memory> // unique_ptr
+#include <utility> // forward(), pair
 #include <vector>
 
 #include <QAbstractTableModel>
+#include <QCollator>
 #include <QDataStream>
+#include <QItemSelection>
 
 #include "note.hpp"
+#include "notestorage.hpp"
 
 /*!
  * \brief Класс записной книжки.
@@ -29,6 +35,10 @@
  * таких как QAbstractItemModel::dataChanged(). Если поменять содержимое модели,
  * никого не уведомив, то виды будут отображать его неправильно.
  *
+ * Сами заметки лежат в хранилище (NoteStorage), способ хранения выбирается
+ * при создании записной книжки. Записная книжка отвечает за порядок
+ * заметок, их идентификаторы, набор изменений и уведомления видов.
+ *
  * \sa \ref faq_interface \ref faq_modelview \ref faq_qt_model_structure
  */
 class Notebook : public QAbstractTableModel
@@ -43,17 +53,138 @@ public:
      * применяются беззнаковые типы.
      */
     using SizeType = int;
+    /*!
+     * \brief Тип идентификаторов заметок.
+     *
+     * В отличие от номера строки, идентификатор заметки не меняется при
+     * удалении других заметок и никогда не используется повторно в пределах
+     * записной книжки. Идентификаторы выдаются по возрастанию (см. mNextId),
+     * но заметка, вставленная в середину записной книжки, получает новый,
+     * наибольший идентификатор, поэтому порядок идентификаторов может не
+     * совпадать с порядком строк.
+     */
+    using NoteId = quint64;
+    /*!
+     * \brief Тип номера поколения записной книжки.
+     *
+     * Номер поколения увеличивается при каждом изменении записной книжки
+     * (см. generation()). Запомнив его при снимке для сохранения, после
+     * сохранения можно отметить сохранёнными только изменения, вошедшие
+     * в снимок (см. markClean()).
+     */
+    using Generation = quint64;
+    //! Диапазон идентификаторов заметок с \a first по \a last включительно.
+    struct IdRange
+    {
+        //! Первый идентификатор диапазона.
+        NoteId first;
+        //! Последний идентификатор диапазона.
+        NoteId last;
+    };
 
-    //! Конструктор по умолчанию.
+    //! Конструктор по умолчанию. Заметки хранятся в векторе (VectorNoteStorage).
     Notebook();
+    //! Конструктор записной книжки, хранящей заметки в хранилище \a storage.
+    explicit Notebook(std::unique_ptr<NoteStorage> storage);
     /*!
      * \brief Оператор [].
      * \param idx Индекс читаемого элемента.
-     * \return Константная ссылка на заметку.
+     * \return Копия заметки.
      */
-    const Note &operator[](SizeType idx) const;
+    Note operator[](SizeType idx) const;
     //! Определяет размер коллекции (количество заметок).
     SizeType size() const;
+    /*!
+     * \brief Возвращает копию всех заметок записной книжки.
+     *
+     * Копирование дёшево: QString использует неявное разделение данных,
+     * а ленивые заметки лишь увеличивают счётчик ссылок на источник
+     * (см. NoteStorage::snapshot()). Копия
+     * не зависит от дальнейших изменений записной книжки, поэтому её можно
+     * передать в рабочий поток, например для сохранения.
+     */
+    std::vector<Note> snapshot() const;
+    //! Возвращает идентификатор заметки с индексом \a idx.
+    NoteId idAt(SizeType idx) const;
+    //! Возвращает индекс заметки с идентификатором \a id или -1, если такой заметки нет.
+    SizeType rowOf(NoteId id) const;
+    //! Возвращает копию идентификаторов всех заметок в порядке их следования.
+    std::vector<NoteId> ids() const;
+    /*!
+     * \brief Возвращает \c true, если заметки можно читать из рабочих потоков.
+     *
+     * Пока записная книжка не изменяется, operator[]() можно вызывать из
+     * разных потоков одновременно, если хранилище это допускает (см.
+     * NoteStorage::isConcurrentReadable()). Иначе заметки читаются только
+     * из потока записной книжки.
+     */
+    bool isConcurrentReadable() const;
+
+    /*!
+     * \name Ключи сортировки.
+     *
+     * Сравнение строк методом QCollator::compare() с учётом языка медленно,
+     * поэтому для сортировки заголовков (см. NoteSortModel) записная книжка
+     * хранит ключи QCollatorSortKey, которые сравниваются гораздо быстрее.
+     * Ключ вычисляется один раз и хранится, пока не изменится заголовок
+     * заметки (updateNoteAt()) или правила сравнения (setCollator()).
+     * Ключи вычисляются только по требованию, поэтому без сортировки
+     * записная книжка не тратит на них ни времени, ни памяти.
+     * @{
+     */
+    //! Возвращает правила сравнения заголовков.
+    QCollator collator() const;
+    //! Устанавливает правила сравнения заголовков \a collator и забывает вычисленные ключи.
+    void setCollator(const QCollator &collator);
+    /*!
+     * \brief Вычисляет недостающие ключи сортировки заметок с индексами с \a first по \a last.
+     *
+     * Если ключей недостаёт много, они вычисляются параллельно, в пуле
+     * потоков QtConcurrent.
+     */
+    void prepareSortKeys(SizeType first, SizeType last);
+    /*!
+     * \brief Возвращает ключ сортировки заголовка заметки с индексом \a idx.
+     *
+     * Ключ должен быть вычислен заранее методом prepareSortKeys(). Метод
+     * можно вызывать из разных потоков одновременно, пока записная книжка
+     * не изменяется.
+     */
+    const QCollatorSortKey &sortKey(SizeType idx) const;
+    //! @}
+
+    /*!
+     * \name Учёт несохранённых изменений.
+     *
+     * Записная книжка помнит идентификаторы заметок, которые были вставлены,
+     * изменены или удалены после последнего сохранения. Идентификаторы, в
+     * отличие от номеров строк, не сдвигаются при вставке и удалении, а
+     * изменения обычно затрагивают соседние идентификаторы, поэтому они
+     * хранятся упорядоченным набором непересекающихся диапазонов. Набор может
+     * включать и идентификаторы, которых уже нет ни в записной книжке, ни
+     * в файле: он указывает, где могут быть отличия от сохранённой версии.
+     *
+     * Загрузка записной книжки очищает набор. Заметки, добавленные методом
+     * append() во время фоновой загрузки, попадают в набор, поэтому после
+     * загрузки его нужно очистить вызовом markClean().
+     * @{
+     */
+    //! Возвращает \c true, если в записной книжке есть несохранённые изменения.
+    bool isModified() const;
+    //! Возвращает номер текущего поколения записной книжки.
+    Generation generation() const;
+    //! Возвращает диапазоны идентификаторов изменённых заметок по возрастанию.
+    std::vector<IdRange> dirtyRanges() const;
+    //! Возвращает \c true, если заметка с идентификатором \a id изменена после сохранения.
+    bool isDirty(NoteId id) const;
+    /*!
+     * \brief Отмечает сохранёнными изменения, сделанные до поколения \a generation включительно.
+     *
+     * Диапазоны, изменённые позже, остаются в наборе целиком, даже если
+     * часть их изменений вошла в сохранённый снимок.
+     */
+    void markClean(Generation generation);
+    //! @}
 
     /*!
      * \name Реализация интерфейса модели.
@@ -95,19 +226,183 @@ public:
     //! @}
     // Конец реализации интерфейса модели
 
+    //! Возвращает \c true, если тексты заметок сжимаются.
+    bool textCompression() const;
+    /*!
+     * \brief Включает или выключает сжатие текстов заметок (см. Note::compressText()).
+     *
+     * При включении сжимаются тексты всех заметок, хранящиеся в памяти
+     * (параллельно, в пуле потоков QtConcurrent), а затем тексты вставленных
+     * и изменённых заметок. Ленивые заметки и так не держат тексты в памяти
+     * и не изменяются. Сжатие влияет и на сохранение записной книжки
+     * (см. NotebookFile::write()). При выключении уже сжатые тексты
+     * остаются сжатыми в памяти, но в файл записываются несжатыми.
+     * Хранилище может не поддерживать сжатие в памяти
+     * (см. NoteStorage::setTextCompression()), тогда оно влияет только
+     * на сохранение.
+     */
+    void setTextCompression(bool on);
     //! Сохраняет записную книжку в поток \a ost.
     void save(QDataStream &ost) const;
     //! Очищает записную книжку и загружает новую из потока \a ist. Возвращает количество загруженных заметок.
     SizeType load(QDataStream &ist);
     //! Вставляет заметку \a note в записную книжку.
     void insert(const Note &note);
+    //! Вставляет заметку \a note в записную книжку, перемещая её в хранилище.
+    void insert(Note &&note);
+    /*!
+     * \brief Вставляет в конец записной книжки заметку, созданную из аргументов \a args.
+     *
+     * Аргументы передаются конструктору Note, например заголовок и текст;
+     * строки, переданные как rvalue, перемещаются в заметку.
+     */
+    template <typename... Args>
+    void emplace(Args &&... args);
+    /*!
+     * \brief Добавляет заметки \a notes в конец записной книжки.
+     *
+     * То же, что insertMany(size(), notes). Используется для постепенного
+     * заполнения записной книжки при фоновой загрузке (см. NotebookLoader).
+     */
+    void append(std::vector<Note> notes);
+    /*!
+     * \brief Вставляет заметки \a notes перед заметкой с индексом \a idx.
+     *
+     * В отличие от многократного вызова insert(), место в хранилище
+     * выделяется один раз, заметки перемещаются в него без копирования,
+     * а виды получают одно уведомление о вставке диапазона строк. Новые
+     * заметки получают новые идентификаторы, а идентификаторы остальных
+     * заметок не меняются. Используется при чтении текстовых файлов,
+     * копировании заметок между записными книжками и воспроизведении журнала.
+     */
+    void insertMany(SizeType idx, std::vector<Note> notes);
+    /*!
+     * \brief Вставляет заметки диапазона [\a first, \a last) перед заметкой с индексом \a idx.
+     *
+     * Чтобы переместить заметки, а не копировать, передайте итераторы
+     * std::make_move_iterator().
+     */
+    template <typename Iterator>
+    void insertMany(SizeType idx, Iterator first, Iterator last);
+    //! Резервирует место для \a size заметок.
+    void reserve(SizeType size);
+    /*!
+     * \brief Вставляет заметку \a note перед заметкой с индексом \a idx.
+     *
+     * Если \a idx равен size(), заметка добавляется в конец, как при
+     * insert(). Используется при воспроизведении журнала (см. NotebookJournal).
+     */
+    void insertAt(SizeType idx, const Note &note);
+    /*!
+     * \brief Возвращает в записную книжку удалённые заметки \a notes с идентификаторами \a ids.
+     *
+     * \a rows — номера строк, которые заметки займут после возврата, по
+     * возрастанию, то есть строки, где заметки были до удаления, если
+     * записная книжка с тех пор не менялась. Заметки, оказавшиеся рядом,
+     * вставляются одним диапазоном строк, а существующие заметки сдвигаются
+     * за один проход по хранилищу. Идентификаторы, уже имеющиеся в записной
+     * книжке, пропускаются. Используется для отмены удаления (см. NotebookHistory).
+     */
+    void restore(const std::vector<SizeType> &rows, const std::vector<NoteId> &ids,
+                 const std::vector<Note> &notes);
     //! Редактирует заметку \a note на позиции \a idx.
     void updateNoteAt(const Note &note, SizeType idx);
+    //! Редактирует заметку \a note на позиции \a idx, перемещая её в хранилище.
+    void updateNoteAt(Note &&note, SizeType idx);
     //! Удаляет заметку с индексом \a idx из записной книжки.
     void erase(SizeType idx);
+    /*!
+     * \brief Удаляет из записной книжки строки, входящие в выделение \a selection.
+     *
+     * Виды уведомляются об удалении каждого непрерывного диапазона строк
+     * одной парой сигналов, а заметки сдвигаются за один проход по хранилищу.
+     * Индексы отдельных строк при этом не создаются, поэтому метод подходит
+     * для удаления выделения из сотен тысяч строк.
+     *
+     * Обработчики сигналов об удалении могут читать записную книжку, но не
+     * должны изменять её.
+     */
+    void eraseRanges(const QItemSelection &selection);
+
+signals:
+    /*!
+     * \brief Сигнализирует, что признак несохранённых изменений стал равен \a modified.
+     * \sa isModified()
+     */
+    void modifiedChanged(bool modified);
+
 private:
-    //! Внутренний контейнер для хранения заметок записной книжки.
-    std::vector<Note> mNotes;
+    //! Изменённый диапазон идентификаторов в mDirty.
+    struct DirtyRange
+    {
+        //! Последний идентификатор диапазона.
+        NoteId last;
+        //! Поколение последнего изменения в диапазоне.
+        Generation generation;
+    };
+
+    //! Загружает записную книжку формата версии 2 или 3 из потока \a ist.
+    SizeType loadVersion2(QDataStream &ist);
+    //! Выдаёт идентификаторы всем заметкам, начиная с заметки с индексом \a first.
+    void assignIds(SizeType first);
+    /*!
+     * \brief Переносит к началу ячейки с \a first по \a last - 1 вместе с идентификаторами и ключами сортировки.
+     * \return Номер ячейки, следующей за последней перенесённой, то есть \a to + (\a last - \a first).
+     */
+    SizeType moveCells(SizeType first, SizeType last, SizeType to);
+    //! Возвращает номер ячейки mStorage заметки с индексом \a idx с учётом промежутка.
+    SizeType physical(SizeType idx) const;
+    //! Возвращает вектор \a v без элементов промежутка.
+    template <typename T>
+    std::vector<T> withoutGap(std::vector<T> v) const;
+    //! Отмечает изменёнными заметки с идентификаторами с \a first по \a last.
+    void markDirty(NoteId first, NoteId last);
+    //! Очищает набор изменений после загрузки записной книжки.
+    void resetDirty();
+    //! Забывает ключи сортировки всех заметок.
+    void resetSortKeys();
+
+    //! Хранилище заметок записной книжки.
+    std::unique_ptr<NoteStorage> mStorage;
+    //! Идентификаторы заметок; mIds[i] — идентификатор заметки в ячейке i хранилища.
+    std::vector<NoteId> mIds;
+    /*!
+     * \brief Ключи сортировки заголовков; mSortKeys[i] относится к заметке в ячейке i хранилища.
+     *
+     * Пустой указатель означает, что ключ ещё не вычислен. QCollatorSortKey
+     * не имеет конструктора по умолчанию, поэтому ключи хранятся по указателю.
+     */
+    std::vector<std::unique_ptr<QCollatorSortKey>> mSortKeys;
+    //! Правила сравнения заголовков для ключей сортировки.
+    QCollator mCollator;
+    //! Идентификатор, который получит следующая добавленная заметка.
+    NoteId mNextId;
+    //! Идут ли идентификаторы в mIds по возрастанию (тогда rowOf() ищет прямо в mIds).
+    bool mIdsOrdered;
+    /*!
+     * \brief Пары (идентификатор, номер строки) по возрастанию идентификаторов.
+     *
+     * Нужны rowOf(), только когда идентификаторы идут не по порядку
+     * (см. mIdsOrdered). Строятся при первом вызове rowOf() и очищаются
+     * при каждом сдвиге строк.
+     */
+    mutable std::vector<std::pair<NoteId, SizeType>> mRowIndex;
+    /*!
+     * \brief Начало промежутка в mStorage и mIds.
+     *
+     * Промежуток существует только во время удаления диапазонов (см.
+     * eraseRanges()) и возврата заметок (см. restore()): ячейки хранилища
+     * с mGapStart по mGapStart + mGapSize - 1 не принадлежат записной книжке.
+     */
+    SizeType mGapStart;
+    //! Размер промежутка; 0, если промежутка нет.
+    SizeType mGapSize;
+    //! Изменённые диапазоны идентификаторов по первому идентификатору диапазона.
+    std::map<NoteId, DirtyRange> mDirty;
+    //! Номер текущего поколения.
+    Generation mGeneration;
+    //! Признак сжатия текстов заметок при сохранении.
+    bool mTextCompression;
 };
 
 /*!
@@ -138,4 +433,17 @@ inline QDataStream &operator>>(QDataStream &ist, Notebook &notebook)
     return ist;
 }
 
+template <typename... Args>
+void Notebook::emplace(Args &&... args)
+{
+    insert(Note(std::forward<Args>(args)...));
+}
+
+template <typename Iterator>
+void Notebook::insertMany(SizeType idx, Iterator first, Iterator last)
+{
+    // Конструктор вектора по прямым итераторам выделяет память один раз
+    insertMany(idx, std::vector<Note>(first, last));
+}
+
 #endif // NOTEBOOK_HPP
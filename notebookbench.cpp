@@ -0,0 +1,290 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookBench.
+ */
+#include "notebookbench.hpp"
+
+#include <algorithm> // min(), max()
+#include <limits> // numeric_limits
+#include <memory> // unique_ptr, make_shared
+#include <stdexcept> // runtime_error
+#include <utility> // move
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+#include <QThreadPool>
+
+#include "config.hpp"
+#include "notebook.hpp"
+#include "notebooktool.hpp"
+#include "notegenerator.hpp"
+#include "notestorage.hpp"
+
+namespace
+{
+
+//! Наибольшее количество вставок, изменений и удалений в одном замере.
+const quint32 maxEdits = 10000;
+
+/*!
+ * \brief Возвращает значение поля \a field файла /proc/self/status в КиБ.
+ *
+ * Если значение неизвестно, возвращает -1.
+ */
+qint64 procStatus(const char *field)
+{
+#ifdef Q_OS_LINUX
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        return -1;
+    }
+    QByteArray prefix = QByteArray(field) + ':';
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine())
+    {
+        if (line.startsWith(prefix))
+        {
+            // Строка имеет вид "VmHWM:     123456 kB"
+            return line.mid(prefix.size()).simplified().split(' ').first().toLongLong();
+        }
+    }
+#else
+    Q_UNUSED(field)
+#endif
+    return -1;
+}
+
+/*!
+ * \brief Сбрасывает пиковый объём резидентной памяти процесса (поле VmHWM).
+ *
+ * Поддерживается Linux начиная с версии 4.0. Если сбросить не удалось, VmHWM
+ * остаётся пиком за всё время работы процесса.
+ */
+void resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile clearRefs(QStringLiteral("/proc/self/clear_refs"));
+    if (clearRefs.open(QIODevice::WriteOnly))
+    {
+        clearRefs.write("5");
+    }
+#endif
+}
+
+//! Возвращает \a i-ю из разбросанных по [0, \a n) позиций.
+quint32 spread(quint32 i, quint32 n)
+{
+    return static_cast<quint32>(static_cast<quint64>(i) * Q_UINT64_C(2654435761) % n);
+}
+
+}
+
+NotebookBench::NotebookBench(quint32 notes, quint64 seed, const QString &storage, int repeat)
+    : mNotes(notes)
+    , mSeed(seed)
+    , mStorage(storage)
+    , mRepeat(std::max(repeat, 1))
+{
+}
+
+void NotebookBench::setAllocationCounter(AllocationCounter counter)
+{
+    mAllocationCounter = std::move(counter);
+}
+
+std::vector<NotebookBench::Result> NotebookBench::run(const std::function<void(const Result &)> &report)
+{
+    QTemporaryDir dir;
+    if (!dir.isValid())
+    {
+        throw std::runtime_error(tr("Unable to create a temporary directory").toStdString());
+    }
+    const QString notebookFileName = dir.filePath(QStringLiteral("bench.tnb"));
+    const QString textFileName = dir.filePath(QStringLiteral("bench.txt"));
+    auto generator = std::make_shared<const NoteGenerator>(mSeed);
+    // Неизвестный вид хранилища обнаруживается до начала замеров
+    NoteStorage::create(mStorage);
+
+    std::vector<Note> notes;
+    std::unique_ptr<Notebook> notebook;
+    // Заметки для вставки и изменения продолжают нумерацию записей
+    const quint32 edits = std::min(mNotes, maxEdits);
+    const std::vector<Note> extra = generator->notes(mNotes, edits);
+    auto makeNotebook = [this]() {
+        return std::unique_ptr<Notebook>(new Notebook(NoteStorage::create(mStorage)));
+    };
+    auto fill = [&]() {
+        notebook.reset();
+        notebook = makeNotebook();
+        notebook->append(notes);
+    };
+
+    std::vector<Result> results;
+    // Выполняет замер: setup() готовит данные, body() выполняет операцию и
+    // возвращает количество обработанных байтов
+    auto measure = [&](const QString &name, quint64 count,
+                       const std::function<void()> &setup, const std::function<quint64()> &body) {
+        Result result{ name, count, 0, std::numeric_limits<double>::infinity(), -1, -1, -1 };
+        for (int i = 0; i < mRepeat; ++i)
+        {
+            setup();
+            qint64 before = procStatus("VmRSS");
+            resetPeakRss();
+            quint64 allocationsBefore = mAllocationCounter ? mAllocationCounter() : 0;
+            QElapsedTimer timer;
+            timer.start();
+            result.bytes = body();
+            double seconds = timer.nsecsElapsed() / 1e9;
+            quint64 allocationsAfter = mAllocationCounter ? mAllocationCounter() : 0;
+            qint64 peak = procStatus("VmHWM"), after = procStatus("VmRSS");
+            result.seconds = std::min(result.seconds, seconds);
+            result.peakRss = std::max(result.peakRss, peak);
+            if (mAllocationCounter)
+            {
+                qint64 allocations = static_cast<qint64>(allocationsAfter - allocationsBefore);
+                result.allocations = result.allocations < 0 ? allocations : std::min(result.allocations, allocations);
+            }
+            if (before >= 0 && after >= 0)
+            {
+                result.rssGrowth = std::max(result.rssGrowth, after - before);
+            }
+        }
+        results.push_back(result);
+        if (report)
+        {
+            report(result);
+        }
+    };
+
+    measure(QStringLiteral("generate"), mNotes, [&]() {
+        notes.clear();
+        notes.shrink_to_fit();
+    }, [&]() {
+        notes = generator->notes(0, mNotes);
+        return quint64(0);
+    });
+    std::vector<Note> copy;
+    measure(QStringLiteral("append"), mNotes, [&]() {
+        notebook.reset();
+        copy = notes;
+    }, [&]() {
+        notebook = makeNotebook();
+        notebook->append(std::move(copy));
+        return quint64(0);
+    });
+    measure(QStringLiteral("save"), mNotes, [&]() {
+        if (!notebook)
+        {
+            fill();
+        }
+    }, [&]() {
+        QFile f(notebookFileName);
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            throw std::runtime_error(tr("Unable to open %1: %2").arg(notebookFileName, f.errorString()).toStdString());
+        }
+        QDataStream ost(&f);
+        notebook->save(ost);
+        f.close();
+        return static_cast<quint64>(QFileInfo(notebookFileName).size());
+    });
+    measure(QStringLiteral("load"), mNotes, [&]() {
+        notebook.reset();
+    }, [&]() {
+        QFile f(notebookFileName);
+        if (!f.open(QIODevice::ReadOnly))
+        {
+            throw std::runtime_error(tr("Unable to open %1: %2").arg(notebookFileName, f.errorString()).toStdString());
+        }
+        QDataStream ist(&f);
+        notebook = makeNotebook();
+        notebook->load(ist);
+        return static_cast<quint64>(f.size());
+    });
+    measure(QStringLiteral("insertAt"), edits, fill, [&]() {
+        for (quint32 i = 0; i < edits; ++i)
+        {
+            notebook->insertAt(spread(i, notebook->size() + 1), extra[i]);
+        }
+        return quint64(0);
+    });
+    measure(QStringLiteral("updateNoteAt"), edits, fill, [&]() {
+        for (quint32 i = 0; i < edits; ++i)
+        {
+            notebook->updateNoteAt(extra[i], spread(i, notebook->size()));
+        }
+        return quint64(0);
+    });
+    measure(QStringLiteral("erase"), edits, fill, [&]() {
+        for (quint32 i = 0; i < edits; ++i)
+        {
+            notebook->erase(spread(i, notebook->size()));
+        }
+        return quint64(0);
+    });
+    notebook.reset();
+    measure(QStringLiteral("exportText"), mNotes, []() {}, [&]() {
+        NotebookTool::exportText(notebookFileName, textFileName);
+        return static_cast<quint64>(QFileInfo(textFileName).size());
+    });
+    return results;
+}
+
+QJsonObject NotebookBench::toJson(const std::vector<Result> &results) const
+{
+    QJsonArray array;
+    for (const Result &r : results)
+    {
+        QJsonObject o;
+        o.insert(QStringLiteral("name"), r.name);
+        o.insert(QStringLiteral("notes"), static_cast<double>(r.notes));
+        o.insert(QStringLiteral("bytes"), static_cast<double>(r.bytes));
+        o.insert(QStringLiteral("seconds"), r.seconds);
+        o.insert(QStringLiteral("notesPerSecond"), r.seconds > 0 ? r.notes / r.seconds : 0.0);
+        o.insert(QStringLiteral("megabytesPerSecond"), r.seconds > 0 ? r.bytes / r.seconds / 1e6 : 0.0);
+        o.insert(QStringLiteral("peakRssKiB"), static_cast<double>(r.peakRss));
+        o.insert(QStringLiteral("rssGrowthKiB"), static_cast<double>(r.rssGrowth));
+        o.insert(QStringLiteral("allocations"), static_cast<double>(r.allocations));
+        o.insert(QStringLiteral("allocationsPerNote"),
+                 r.allocations >= 0 && r.notes > 0 ? static_cast<double>(r.allocations) / r.notes : -1.0);
+        array.append(o);
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), QString::fromLatin1(Config::applicationVersion));
+    root.insert(QStringLiteral("qt"), QString::fromLatin1(qVersion()));
+    root.insert(QStringLiteral("threads"), QThreadPool::globalInstance()->maxThreadCount());
+    root.insert(QStringLiteral("notes"), static_cast<double>(mNotes));
+    // 64-битное значение не всегда представимо числом JSON (double)
+    root.insert(QStringLiteral("seed"), QString::number(mSeed));
+    root.insert(QStringLiteral("storage"), mStorage);
+    root.insert(QStringLiteral("repeat"), mRepeat);
+    root.insert(QStringLiteral("results"), array);
+    return root;
+}
+
+std::map<QString, double> NotebookBench::readTimes(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        throw std::runtime_error(tr("Unable to open %1: %2").arg(fileName, f.errorString()).toStdString());
+    }
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &error);
+    if (error.error != QJsonParseError::NoError)
+    {
+        throw std::runtime_error(tr("%1: %2").arg(fileName, error.errorString()).toStdString());
+    }
+    std::map<QString, double> times;
+    for (const QJsonValue &v : doc.object().value(QStringLiteral("results")).toArray())
+    {
+        QJsonObject o = v.toObject();
+        times[o.value(QStringLiteral("name")).toString()] = o.value(QStringLiteral("seconds")).toDouble();
+    }
+    return times;
+}
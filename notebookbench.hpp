@@ -0,0 +1,108 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookBench.
+ */
+#ifndef NOTEBOOKBENCH_HPP
+#define NOTEBOOKBENCH_HPP
+
+#include <functional> // function
+#include <map>
+#include <vector>
+
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QJsonObject>
+#include <QString>
+
+/*!
+ * \brief Класс измерения производительности записной книжки.
+ *
+ * Набор замеров выполняет основные операции Notebook над синтетическими
+ * заметками NoteGenerator: добавление, сохранение, загрузку, вставку,
+ * изменение и удаление заметок и выгрузку в текстовый файл. Каждая
+ * операция повторяется заданное число раз на заново подготовленных данных;
+ * в результат идёт лучшее время. Подготовка данных в замер не входит.
+ *
+ * Для каждой операции определяются количество обработанных заметок и
+ * байтов, время, пиковый объём резидентной памяти процесса во время
+ * операции и его прирост после неё. Объём памяти известен только в Linux
+ * (файл /proc/self/status); на других платформах он равен -1. Количество
+ * выделений памяти за операцию определяется, только если задан счётчик
+ * выделений (setAllocationCounter()); иначе оно равно -1. Счётчик задаёт
+ * тест производительности tests/tst_notebookbench, замещающий операторы
+ * new и delete; в программы счётчик не входит.
+ *
+ * Результаты преобразуются в JSON (toJson()), чтобы их можно было
+ * сохранить и сравнить с результатами другой версии программы.
+ */
+class NotebookBench
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NotebookBench)
+public:
+    //! Тип функции, возвращающей количество выделений памяти с начала работы процесса.
+    using AllocationCounter = std::function<quint64()>;
+
+    //! Результат замера одной операции.
+    struct Result
+    {
+        //! Название операции.
+        QString name;
+        //! Количество обработанных заметок.
+        quint64 notes;
+        //! Количество обработанных байтов или 0, если операция не работает с файлом.
+        quint64 bytes;
+        //! Лучшее время в секундах.
+        double seconds;
+        //! Наибольший пиковый объём резидентной памяти в КиБ или -1.
+        qint64 peakRss;
+        //! Наибольший прирост объёма резидентной памяти в КиБ или -1.
+        qint64 rssGrowth;
+        //! Наименьшее количество выделений памяти за операцию или -1, если счётчик не задан.
+        qint64 allocations;
+    };
+
+    /*!
+     * \brief Конструктор.
+     * \param notes Количество заметок записной книжки.
+     * \param seed Начальное значение генератора заметок.
+     * \param storage Вид хранилища заметок (см. NoteStorage::create()).
+     * \param repeat Количество повторений каждой операции.
+     */
+    NotebookBench(quint32 notes, quint64 seed, const QString &storage, int repeat);
+
+    //! Устанавливает счётчик выделений памяти \a counter (по умолчанию не задан).
+    void setAllocationCounter(AllocationCounter counter);
+
+    /*!
+     * \brief Выполняет замеры.
+     *
+     * Функции \a report передаётся результат каждой операции сразу после её
+     * замера. В случае ошибки запускает исключительную ситуацию.
+     */
+    std::vector<Result> run(const std::function<void(const Result &)> &report = std::function<void(const Result &)>());
+
+    //! Преобразует результаты \a results в объект JSON вместе с параметрами замеров.
+    QJsonObject toJson(const std::vector<Result> &results) const;
+    /*!
+     * \brief Читает времена операций из результатов в формате JSON в файле \a fileName.
+     *
+     * Возвращает словарь «название операции — время в секундах». В случае
+     * ошибки запускает исключительную ситуацию.
+     */
+    static std::map<QString, double> readTimes(const QString &fileName);
+
+private:
+    //! Количество заметок.
+    quint32 mNotes;
+    //! Начальное значение генератора.
+    quint64 mSeed;
+    //! Вид хранилища.
+    QString mStorage;
+    //! Количество повторений.
+    int mRepeat;
+    //! Счётчик выделений памяти или пустая функция.
+    AllocationCounter mAllocationCounter;
+};
+
+#endif // NOTEBOOKBENCH_HPP
@@ -0,0 +1,89 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookExporter.
+ */
+#include "notebookexporter.hpp"
+
+#include <exception>
+#include <memory> // shared_ptr
+#include <utility> // move()
+
+#include "workerpool.hpp"
+
+NotebookExporter::NotebookExporter(QObject *parent)
+    : QObject(parent)
+    , mRunning(false)
+    , mCancel(false)
+{
+    connect(&mWatcher, &QFutureWatcher<Result>::finished, this, &NotebookExporter::finish);
+}
+
+NotebookExporter::~NotebookExporter()
+{
+    // Рабочий поток обращается к объекту (mCancel, сигнал progress()),
+    // поэтому объект нельзя уничтожать, пока выгрузка выполняется
+    mCancel = true;
+    mWatcher.waitForFinished();
+}
+
+bool NotebookExporter::start(const QString &fileName, std::vector<Note> notes, NoteExporter::Format format)
+{
+    if (isBusy())
+    {
+        return false;
+    }
+    mFileName = fileName;
+    mRunning = true;
+    mCancel = false;
+    std::shared_ptr<const std::vector<Note>> shared(new std::vector<Note>(std::move(notes)));
+    NotebookExporter *self = this;
+    mWatcher.setFuture(WorkerPool::instance().run<Result>(this, [self, shared, fileName, format]() -> Result {
+        qint64 total = static_cast<qint64>(shared->size());
+        try
+        {
+            bool done = NoteExporter::write(fileName, *shared, format, [self, total](std::size_t written) {
+                // Сигнал отправляется из рабочего потока, поэтому получатели
+                // в потоке интерфейса получат его через очередь
+                emit self->progress(static_cast<qint64>(written), total);
+            }, [self]() {
+                return self->mCancel.load();
+            });
+            return Result{ !done, QString() };
+        }
+        catch (const std::exception &e)
+        {
+            return Result{ false, QString::fromUtf8(e.what()) };
+        }
+    }));
+    return true;
+}
+
+bool NotebookExporter::isBusy() const
+{
+    return mRunning;
+}
+
+void NotebookExporter::cancel()
+{
+    mCancel = true;
+}
+
+void NotebookExporter::finish()
+{
+    Result result = mWatcher.result();
+    QString fileName = mFileName;
+    mFileName.clear();
+    mRunning = false;
+    if (result.canceled)
+    {
+        emit canceled(fileName);
+    }
+    else if (!result.error.isEmpty())
+    {
+        emit failed(fileName, result.error);
+    }
+    else
+    {
+        emit finished(fileName);
+    }
+}
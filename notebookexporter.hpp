@@ -0,0 +1,82 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookExporter.
+ */
+#ifndef NOTEBOOKEXPORTER_HPP
+#define NOTEBOOKEXPORTER_HPP
+
+#include <atomic>
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+
+#include "note.hpp"
+#include "noteexporter.hpp"
+
+/*!
+ * \brief Класс фоновой выгрузки записной книжки в текстовый файл.
+ *
+ * Принимает снимок заметок (см. Notebook::snapshot()) и записывает его
+ * методом NoteExporter::write() в рабочем потоке, чтобы выгрузка больших
+ * записных книжек не замораживала окно. Ход выгрузки сообщается сигналом
+ * progress(), результат — сигналами finished(), failed() или canceled(),
+ * которые отправляются в потоке объекта NotebookExporter.
+ *
+ * Одновременно выполняется только одна выгрузка.
+ */
+class NotebookExporter : public QObject
+{
+    Q_OBJECT
+public:
+    //! Конструктор с необязательным указанием родительского объекта \a parent.
+    explicit NotebookExporter(QObject *parent = nullptr);
+    //! Деструктор. Прерывает выгрузку и дожидается завершения рабочего потока.
+    ~NotebookExporter();
+
+    /*!
+     * \brief Начинает выгрузку заметок \a notes в файл \a fileName в формате \a format.
+     *
+     * Возвращает \c false, если уже выполняется другая выгрузка.
+     */
+    bool start(const QString &fileName, std::vector<Note> notes, NoteExporter::Format format);
+    //! Возвращает \c true, если выгрузка выполняется.
+    bool isBusy() const;
+    //! Прерывает выгрузку. Файл при этом не изменяется.
+    void cancel();
+
+signals:
+    //! Сигнализирует, что записано \a done заметок из \a total.
+    void progress(qint64 done, qint64 total);
+    //! Сигнализирует, что выгрузка в файл \a fileName завершена.
+    void finished(QString fileName);
+    //! Сигнализирует, что выгрузка в файл \a fileName не удалась из-за ошибки \a message.
+    void failed(QString fileName, QString message);
+    //! Сигнализирует, что выгрузка в файл \a fileName прервана.
+    void canceled(QString fileName);
+
+private:
+    //! Результат выгрузки.
+    struct Result
+    {
+        //! Признак прерванной выгрузки.
+        bool canceled;
+        //! Сообщение об ошибке или пустая строка.
+        QString error;
+    };
+
+    //! Обрабатывает завершение рабочего потока.
+    void finish();
+
+    //! Имя файла выполняющейся выгрузки.
+    QString mFileName;
+    //! Признак того, что выгрузка выполняется (до обработки её результата).
+    bool mRunning;
+    //! Признак запрошенного прерывания. Читается рабочим потоком.
+    std::atomic<bool> mCancel;
+    //! Наблюдатель за выполнением выгрузки.
+    QFutureWatcher<Result> mWatcher;
+};
+
+#endif // NOTEBOOKEXPORTER_HPP
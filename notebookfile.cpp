@@ -0,0 +1,694 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookFile.
+ */
+#include "notebookfile.hpp"
+
+#include <algorithm> // min(), remove_if()
+#include <atomic>
+#include <cstring> // memchr(), memcmp(), memcpy()
+#include <limits> // numeric_limits
+#include <new> // bad_alloc
+#include <stdexcept> // runtime_error
+
+#include <QFileInfo>
+#include <QIODevice>
+#include <QMutex>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtEndian>
+
+#include "crc32c.hpp"
+#include "notecodec.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+//! Сигнатура в начале файла версии 2.
+const char fileSignature[8] = { 'T', 'O', 'Y', 'N', 'O', 'T', 'E', '\0' };
+//! Сигнатура в конце файла версии 2.
+const char indexSignature[8] = { 'T', 'N', 'B', 'I', 'N', 'D', 'E', 'X' };
+//! Сигнатура заголовка записи в файле версии 3.
+const char recordSignature[4] = { 'T', 'N', 'R', 'C' };
+//! Версия формата, записываемая в заголовок.
+const quint32 formatVersion = 3;
+//! Наименьшая версия формата с таблицей смещений.
+const quint32 firstIndexedVersion = 2;
+//! Размер заголовка: сигнатура, версия, флаги.
+const qint64 headerSize = 8 + 4 + 4;
+//! Размер окончания: смещение таблицы, количество записей, сигнатура.
+const qint64 trailerSize = 8 + 8 + 8;
+//! Размер элемента таблицы смещений: смещение, размеры заголовка и текста, флаги, контрольная сумма.
+const qint64 entrySize = 8 + 4 + 4 + 4 + 4;
+//! Размер заголовка записи: сигнатура, размеры заголовка и текста, флаги, контрольная сумма.
+const qint64 recordHeaderSize = 4 + 4 + 4 + 4 + 4;
+//! Размер полей заголовка записи, покрываемых контрольной суммой: размеры и флаги.
+const std::size_t recordFieldsSize = 4 + 4 + 4;
+//! Флаг записи: текст сжат.
+const quint32 recordTextCompressed = 0x1;
+//! Количество записей, проверяемых одной задачей пула потоков.
+const quint32 verifyChunkSize = 1024;
+
+//! Дописывает в \a buf значение \a value в порядке байтов little-endian.
+template <typename T>
+void appendLittleEndian(QByteArray &buf, T value)
+{
+    uchar bytes[sizeof(T)];
+    qToLittleEndian(value, bytes);
+    buf.append(reinterpret_cast<const char *>(bytes), sizeof(T));
+}
+
+//! Записывает \a size байт из \a data в поток \a ost, проверяя результат.
+void writeRaw(QDataStream &ost, const char *data, int size)
+{
+    if (ost.writeRawData(data, size) != size || ost.status() == QDataStream::WriteFailed)
+    {
+        throw std::runtime_error(NotebookFile::tr("Write to the stream failed").toStdString());
+    }
+}
+
+/*!
+ * \brief Возвращает строку \a s в кодировке UTF-16LE.
+ *
+ * На машинах little-endian данные строки не копируются, поэтому результат
+ * действителен, пока существует \a s.
+ */
+QByteArray toUtf16Le(const QString &s)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // Внутреннее представление QString совпадает с форматом файла
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(s.utf16()), s.size() * 2);
+#else
+    QByteArray buf;
+    buf.reserve(s.size() * 2);
+    for (QChar c : s)
+    {
+        appendLittleEndian<quint16>(buf, c.unicode());
+    }
+    return buf;
+#endif
+}
+
+//! Возвращает контрольную сумму записи: полей \a fields заголовка записи и \a size байт данных \a data.
+quint32 recordChecksum(const uchar *fields, const uchar *data, std::size_t size)
+{
+    return Crc32c::update(Crc32c::update(0, fields, recordFieldsSize), data, size);
+}
+
+//! Защищает mappedFiles.
+QMutex mappedFilesMutex;
+//! Отображённые в память файлы (см. NotebookFile::release()).
+std::vector<std::weak_ptr<NotebookFile>> mappedFiles;
+
+// Данные отображения заменяет в памяти только detach(), который вызывается
+// лишь в Windows (см. описание класса NotebookFile), поэтому в остальных
+// системах чтение данных обходится без блокировки
+#ifdef Q_OS_WIN
+#define NOTEBOOKFILE_READ_LOCK() QReadLocker readLock(&mLock)
+#else
+#define NOTEBOOKFILE_READ_LOCK() do {} while (false)
+#endif
+
+//! Генерирует исключительную ситуацию о повреждённом файле.
+[[noreturn]] void throwCorrupt()
+{
+    throw std::runtime_error(NotebookFile::tr("Corrupt data were read from the stream").toStdString());
+}
+
+}
+
+NotebookFile::NotebookFile()
+    : mBase(nullptr)
+    , mSize(0)
+    , mIndex(nullptr)
+    , mVersion(0)
+    , mCount(0)
+    , mCacheKey(NoteCodec::newCacheKey())
+{
+}
+
+std::shared_ptr<NotebookFile> NotebookFile::open(const QString &fileName)
+{
+    std::shared_ptr<NotebookFile> nf = map(fileName);
+    nf->parse();
+    track(nf);
+    return nf;
+}
+
+/*!
+ * Неповреждённый файл открывается обычным образом. Если при этом возникает
+ * ошибка, записи ищутся заново методом rebuildIndex().
+ */
+std::shared_ptr<NotebookFile> NotebookFile::salvage(const QString &fileName, SalvageReport &report)
+{
+    TRACE_SCOPE("NotebookFile::salvage");
+    report = SalvageReport{ -1, 0, {} };
+    std::shared_ptr<NotebookFile> nf = map(fileName);
+    try
+    {
+        nf->parse();
+        nf->verify();
+        report.expected = nf->mCount;
+        report.recovered = nf->mCount;
+        track(nf);
+        return nf;
+    }
+    catch (const std::exception &)
+    {
+        // Файлы версии 2 искать без таблицы смещений не по чему
+        if (nf->mSize >= headerSize && std::memcmp(nf->mBase, fileSignature, sizeof(fileSignature)) == 0
+                && qFromLittleEndian<quint32>(nf->mBase + 8) == firstIndexedVersion)
+        {
+            throw;
+        }
+    }
+    nf->rebuildIndex(report);
+    track(nf);
+    return nf;
+}
+
+QString NotebookFile::describe(const SalvageReport &report)
+{
+    QString result = report.expected >= 0
+            ? tr("Recovered %1 of %2 note(s).").arg(report.recovered).arg(report.expected)
+            : tr("Recovered %1 note(s); the index of the file is damaged.").arg(report.recovered);
+    if (!report.skipped.empty())
+    {
+        result += QLatin1Char('\n') + tr("Skipped damaged areas:");
+        for (const std::pair<quint64, quint64> &area : report.skipped)
+        {
+            result += QLatin1Char('\n') + tr("%1 byte(s) at offset %2").arg(area.second).arg(area.first);
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<NotebookFile> NotebookFile::map(const QString &fileName)
+{
+    std::shared_ptr<NotebookFile> nf(new NotebookFile);
+    nf->mFile.setFileName(fileName);
+    if (!nf->mFile.open(QIODevice::ReadOnly))
+    {
+        throw std::runtime_error((tr("open(): ") + nf->mFile.errorString()).toStdString());
+    }
+    nf->mSize = nf->mFile.size();
+    // Отображаем весь файл в память. Страницы файла будут читаться с диска
+    // операционной системой по мере обращения к ним
+    nf->mBase = nf->mFile.map(0, nf->mSize);
+    if (!nf->mBase)
+    {
+        throw std::runtime_error((tr("map(): ") + nf->mFile.errorString()).toStdString());
+    }
+    return nf;
+}
+
+void NotebookFile::track(const std::shared_ptr<NotebookFile> &nf)
+{
+    QMutexLocker lock(&mappedFilesMutex);
+    // Заодно забываем файлы, на которые больше никто не ссылается
+    mappedFiles.erase(std::remove_if(mappedFiles.begin(), mappedFiles.end(),
+                                     [](const std::weak_ptr<NotebookFile> &f) { return f.expired(); }),
+                      mappedFiles.end());
+    mappedFiles.push_back(nf);
+}
+
+#ifdef Q_OS_WIN
+void NotebookFile::release(const QString &fileName)
+{
+    QString path = QFileInfo(fileName).canonicalFilePath();
+    if (path.isEmpty())
+    {
+        return;
+    }
+    std::vector<std::shared_ptr<NotebookFile>> files;
+    {
+        QMutexLocker lock(&mappedFilesMutex);
+        for (const std::weak_ptr<NotebookFile> &f : mappedFiles)
+        {
+            std::shared_ptr<NotebookFile> nf = f.lock();
+            if (nf && QFileInfo(nf->mFile.fileName()).canonicalFilePath() == path)
+            {
+                files.push_back(nf);
+            }
+        }
+    }
+    for (const std::shared_ptr<NotebookFile> &nf : files)
+    {
+        nf->detach();
+    }
+}
+
+/*!
+ * Ленивые заметки ссылаются на объект NotebookFile, а не на отображение,
+ * поэтому после переноса данных в память продолжают работать. Чтение
+ * заметок в других потоках дожидается окончания переноса (см. mLock).
+ */
+void NotebookFile::detach()
+{
+    TRACE_SCOPE("NotebookFile::detach");
+    QWriteLocker lock(&mLock);
+    if (!mFile.isOpen())
+    {
+        return;
+    }
+    // Данные копируются в буфер в куче, а не в QByteArray, размер которого
+    // ограничен 2 ГиБ
+    const uchar *mapped = mBase;
+    try
+    {
+        mDetached.reset(new uchar[static_cast<std::size_t>(mSize)]);
+    }
+    catch (const std::bad_alloc &)
+    {
+        throw std::runtime_error(tr("Not enough memory to replace the file %1 while it is open")
+                                 .arg(mFile.fileName()).toStdString());
+    }
+    std::memcpy(mDetached.get(), mapped, static_cast<std::size_t>(mSize));
+    mBase = mDetached.get();
+    // Восстановленная таблица смещений и так лежит в памяти
+    if (mRebuiltIndex.isEmpty())
+    {
+        mIndex = mBase + (mIndex - mapped);
+    }
+    mFile.unmap(const_cast<uchar *>(mapped));
+    mFile.close();
+}
+#endif
+
+std::shared_ptr<NotebookFile> NotebookFile::fromData(const QByteArray &data)
+{
+    std::shared_ptr<NotebookFile> nf(new NotebookFile);
+    nf->mData = data;
+    nf->mBase = reinterpret_cast<const uchar *>(nf->mData.constData());
+    nf->mSize = nf->mData.size();
+    nf->parse();
+    return nf;
+}
+
+bool NotebookFile::isVersion2(QIODevice *device)
+{
+    // peek() читает данные, не сдвигая текущую позицию устройства, поэтому
+    // файл версии 1 после проверки можно читать как обычно
+    QByteArray head = device->peek(sizeof(fileSignature));
+    return head.size() == sizeof(fileSignature)
+            && std::memcmp(head.constData(), fileSignature, sizeof(fileSignature)) == 0;
+}
+
+void NotebookFile::write(QDataStream &ost, const std::vector<Note> &notes,
+                         const ProgressFunction &progress, bool compress)
+{
+    TRACE_SCOPE("NotebookFile::write");
+    // Заголовок
+    QByteArray header(fileSignature, sizeof(fileSignature));
+    appendLittleEndian<quint32>(header, formatVersion);
+    appendLittleEndian<quint32>(header, 0); // Флаги файла
+    writeRaw(ost, header.constData(), header.size());
+
+    // Записи. Одновременно заполняем таблицу смещений, которая будет
+    // записана после них
+    QByteArray index;
+    index.reserve(static_cast<int>(notes.size() * entrySize));
+    quint64 offset = headerSize;
+    for (const Note &n : notes)
+    {
+        QString title = n.title();
+        QByteArray titleData = toUtf16Le(title);
+        quint32 flags = 0;
+        // Уже сжатый текст берём как есть, не распаковывая
+        QByteArray packed;
+        if (compress)
+        {
+            packed = n.compressedText();
+            if (packed.isEmpty())
+            {
+                packed = NoteCodec::compress(n.text());
+            }
+        }
+        QString text;
+        QByteArray textData;
+        if (!packed.isEmpty())
+        {
+            flags |= recordTextCompressed;
+            textData = packed;
+        }
+        else
+        {
+            text = n.text();
+            textData = toUtf16Le(text);
+        }
+        quint32 titleSize = titleData.size();
+        quint32 textSize = textData.size();
+        // Заголовок записи. Контрольная сумма покрывает размеры, флаги и
+        // данные записи
+        QByteArray record(recordSignature, sizeof(recordSignature));
+        appendLittleEndian<quint32>(record, titleSize);
+        appendLittleEndian<quint32>(record, textSize);
+        appendLittleEndian<quint32>(record, flags);
+        const uchar *fields = reinterpret_cast<const uchar *>(record.constData()) + sizeof(recordSignature);
+        quint32 crc = Crc32c::update(Crc32c::update(0, fields, recordFieldsSize), titleData.constData(), titleSize);
+        crc = Crc32c::update(crc, textData.constData(), textSize);
+        appendLittleEndian<quint32>(record, crc);
+        writeRaw(ost, record.constData(), record.size());
+        writeRaw(ost, titleData.constData(), titleData.size());
+        writeRaw(ost, textData.constData(), textData.size());
+        offset += recordHeaderSize;
+        appendLittleEndian<quint64>(index, offset);
+        appendLittleEndian<quint32>(index, titleSize);
+        appendLittleEndian<quint32>(index, textSize);
+        appendLittleEndian<quint32>(index, flags); // Флаги записи
+        appendLittleEndian<quint32>(index, crc);
+        offset += titleSize + textSize;
+        // Следующая запись должна начинаться с чётного смещения
+        if (offset % 2 != 0)
+        {
+            writeRaw(ost, "", 1);
+            ++offset;
+        }
+        if (progress)
+        {
+            progress(index.size() / entrySize);
+        }
+    }
+    writeRaw(ost, index.constData(), index.size());
+
+    // Окончание
+    QByteArray trailer;
+    appendLittleEndian<quint64>(trailer, offset);
+    appendLittleEndian<quint64>(trailer, notes.size());
+    trailer.append(indexSignature, sizeof(indexSignature));
+    writeRaw(ost, trailer.constData(), trailer.size());
+}
+
+void NotebookFile::save(const QString &fileName, const std::vector<Note> &notes,
+                        const ProgressFunction &progress, bool compress)
+{
+    TRACE_SCOPE("NotebookFile::save");
+    QSaveFile outf(fileName);
+    if (!outf.open(QIODevice::WriteOnly))
+    {
+        throw std::runtime_error((tr("open(): ") + outf.errorString()).toStdString());
+    }
+    QDataStream ost(&outf);
+    write(ost, notes, progress, compress);
+#ifdef Q_OS_WIN
+    // Отображённый файл в Windows заменить нельзя (см. описание класса)
+    release(fileName);
+#endif
+    if (!outf.commit())
+    {
+        throw std::runtime_error(tr("Unable to commit the save").toStdString());
+    }
+}
+
+NotebookFile::SizeType NotebookFile::size() const
+{
+    return mCount;
+}
+
+Note NotebookFile::note(SizeType record) const
+{
+    return Note(shared_from_this(), record);
+}
+
+QString NotebookFile::title(quint32 record) const
+{
+    NOTEBOOKFILE_READ_LOCK();
+    const uchar *e = entry(record);
+    return decode(qFromLittleEndian<quint64>(e), qFromLittleEndian<quint32>(e + 8));
+}
+
+QString NotebookFile::text(quint32 record) const
+{
+    NOTEBOOKFILE_READ_LOCK();
+    const uchar *e = entry(record);
+    // Текст записан сразу после заголовка
+    quint64 offset = qFromLittleEndian<quint64>(e) + qFromLittleEndian<quint32>(e + 8);
+    quint32 size = qFromLittleEndian<quint32>(e + 12);
+    if (qFromLittleEndian<quint32>(e + 16) & recordTextCompressed)
+    {
+        return NoteCodec::decompressCached(mCacheKey, record, reinterpret_cast<const char *>(mBase + offset),
+                                           static_cast<int>(size));
+    }
+    return decode(offset, size);
+}
+
+QByteArray NotebookFile::compressedText(quint32 record) const
+{
+    NOTEBOOKFILE_READ_LOCK();
+    const uchar *e = entry(record);
+    if (!(qFromLittleEndian<quint32>(e + 16) & recordTextCompressed))
+    {
+        return QByteArray();
+    }
+    quint64 offset = qFromLittleEndian<quint64>(e) + qFromLittleEndian<quint32>(e + 8);
+    return QByteArray(reinterpret_cast<const char *>(mBase + offset),
+                      static_cast<int>(qFromLittleEndian<quint32>(e + 12)));
+}
+
+int NotebookFile::textLength(quint32 record) const
+{
+    NOTEBOOKFILE_READ_LOCK();
+    const uchar *e = entry(record);
+    quint32 size = qFromLittleEndian<quint32>(e + 12);
+    if (qFromLittleEndian<quint32>(e + 16) & recordTextCompressed)
+    {
+        quint64 offset = qFromLittleEndian<quint64>(e) + qFromLittleEndian<quint32>(e + 8);
+        return NoteCodec::decompressedLength(reinterpret_cast<const char *>(mBase + offset), static_cast<int>(size));
+    }
+    // Несжатый текст записан в UTF-16LE, по 2 байта на символ
+    return static_cast<int>(size / 2);
+}
+
+void NotebookFile::parse()
+{
+    if (mSize < headerSize + trailerSize
+            || std::memcmp(mBase, fileSignature, sizeof(fileSignature)) != 0)
+    {
+        throwCorrupt();
+    }
+    mVersion = qFromLittleEndian<quint32>(mBase + 8);
+    if (mVersion < firstIndexedVersion || mVersion > formatVersion)
+    {
+        throw std::runtime_error(tr("Unsupported notebook file version %1").arg(mVersion).toStdString());
+    }
+    // Перед данными записи версии 3 находится заголовок записи
+    const quint64 firstRecord = static_cast<quint64>(headerSize) + (mVersion >= 3 ? recordHeaderSize : 0);
+
+    const uchar *trailer = mBase + mSize - trailerSize;
+    if (std::memcmp(trailer + 16, indexSignature, sizeof(indexSignature)) != 0)
+    {
+        throwCorrupt();
+    }
+    quint64 indexOffset = qFromLittleEndian<quint64>(trailer);
+    quint64 count = qFromLittleEndian<quint64>(trailer + 8);
+    // Таблица смещений должна занимать всё место между записями и окончанием
+    quint64 indexEnd = static_cast<quint64>(mSize - trailerSize);
+    if (indexOffset < static_cast<quint64>(headerSize) || indexOffset > indexEnd
+            || (indexEnd - indexOffset) / entrySize != count
+            || (indexEnd - indexOffset) % entrySize != 0)
+    {
+        throwCorrupt();
+    }
+    mIndex = mBase + indexOffset;
+    mCount = static_cast<SizeType>(count);
+
+    // Проверяем, что все записи лежат внутри области записей. Это позволяет
+    // потом декодировать их без дополнительных проверок. Суммы смещения и
+    // размеров могут переполниться, поэтому сравниваем разности. Смещение не
+    // меньше firstRecord, значит, заголовок записи версии 3 не заходит на
+    // заголовок файла
+    for (SizeType i = 0; i < mCount; ++i)
+    {
+        const uchar *e = entry(i);
+        quint64 offset = qFromLittleEndian<quint64>(e);
+        quint64 titleSize = qFromLittleEndian<quint32>(e + 8);
+        quint64 textSize = qFromLittleEndian<quint32>(e + 12);
+        quint32 flags = qFromLittleEndian<quint32>(e + 16);
+        // Размер сжатого текста может быть нечётным
+        bool compressed = (flags & recordTextCompressed) != 0;
+        if (offset < firstRecord || offset % 2 != 0
+                || (flags & ~recordTextCompressed) != 0
+                || titleSize % 2 != 0 || (!compressed && textSize % 2 != 0)
+                || offset > indexOffset || titleSize + textSize > indexOffset - offset
+                || (mVersion >= 3 && offset - recordHeaderSize < static_cast<quint64>(headerSize)))
+        {
+            throwCorrupt();
+        }
+    }
+}
+
+/*!
+ * Записи делятся на части по verifyChunkSize записей, которые проверяются
+ * параллельно. Сообщается запись с наименьшим номером из повреждённых.
+ */
+void NotebookFile::verify() const
+{
+    TRACE_SCOPE("NotebookFile::verify");
+    if (mVersion < 3 || mCount == 0)
+    {
+        return;
+    }
+    std::vector<SizeType> chunks;
+    for (quint64 first = 0; first < mCount; first += verifyChunkSize)
+    {
+        chunks.push_back(static_cast<SizeType>(first));
+    }
+    std::atomic<quint64> damaged(std::numeric_limits<quint64>::max());
+    QtConcurrent::blockingMap(chunks, [this, &damaged](SizeType first) {
+        TRACE_SCOPE("NotebookFile verify chunk");
+        SizeType last = static_cast<SizeType>(std::min<quint64>(static_cast<quint64>(first) + verifyChunkSize, mCount));
+        for (SizeType i = first; i < last; ++i)
+        {
+            if (!isIntact(i))
+            {
+                quint64 known = damaged.load();
+                while (i < known && !damaged.compare_exchange_weak(known, i))
+                {
+                }
+                return;
+            }
+        }
+    });
+    if (damaged.load() != std::numeric_limits<quint64>::max())
+    {
+        throw std::runtime_error(tr("Checksum mismatch in note %1").arg(damaged.load() + 1).toStdString());
+    }
+}
+
+void NotebookFile::verify(SizeType first, SizeType last) const
+{
+    if (mVersion < 3)
+    {
+        return;
+    }
+    for (SizeType i = first; i < last; ++i)
+    {
+        if (!isIntact(i))
+        {
+            throw std::runtime_error(tr("Checksum mismatch in note %1").arg(static_cast<quint64>(i) + 1).toStdString());
+        }
+    }
+}
+
+bool NotebookFile::isIntact(SizeType record) const
+{
+    NOTEBOOKFILE_READ_LOCK();
+    const uchar *e = entry(record);
+    quint64 offset = qFromLittleEndian<quint64>(e);
+    const uchar *h = mBase + offset - recordHeaderSize;
+    // Размеры и флаги в заголовке записи и в таблице смещений записаны в
+    // одном порядке, за ними следует контрольная сумма
+    return std::memcmp(h, recordSignature, sizeof(recordSignature)) == 0
+            && std::memcmp(h + sizeof(recordSignature), e + 8, recordFieldsSize + 4) == 0
+            && recordChecksum(h + sizeof(recordSignature), mBase + offset,
+                              qFromLittleEndian<quint32>(e + 8) + static_cast<std::size_t>(qFromLittleEndian<quint32>(e + 12)))
+               == qFromLittleEndian<quint32>(e + 20);
+}
+
+/*!
+ * Если окончание файла цело, записи ищутся до таблицы смещений, иначе до
+ * конца файла. Запись принимается, если её заголовок правдоподобен, а
+ * контрольная сумма совпадает; после неё поиск продолжается с конца записи.
+ * В повреждённой области поиск переходит к следующему символу 'T' (функцией
+ * memchr()) с чётным смещением, поэтому идёт со скоростью просмотра памяти.
+ */
+void NotebookFile::rebuildIndex(SalvageReport &report)
+{
+    TRACE_SCOPE("NotebookFile::rebuildIndex");
+    const quint64 size = static_cast<quint64>(mSize);
+    quint64 end = size;
+    if (mSize >= headerSize + trailerSize)
+    {
+        const uchar *trailer = mBase + mSize - trailerSize;
+        quint64 indexOffset = qFromLittleEndian<quint64>(trailer);
+        quint64 count = qFromLittleEndian<quint64>(trailer + 8);
+        quint64 indexEnd = size - trailerSize;
+        if (std::memcmp(trailer + 16, indexSignature, sizeof(indexSignature)) == 0
+                && indexOffset >= static_cast<quint64>(headerSize) && indexOffset <= indexEnd
+                && (indexEnd - indexOffset) == count * entrySize)
+        {
+            end = indexOffset;
+            report.expected = static_cast<qint64>(count);
+        }
+    }
+    const quint64 none = std::numeric_limits<quint64>::max();
+    quint64 damagedFrom = none;
+    QByteArray index;
+    quint64 pos = std::min<quint64>(headerSize, end);
+    while (end - pos >= static_cast<quint64>(recordHeaderSize))
+    {
+        const uchar *h = mBase + pos;
+        if (std::memcmp(h, recordSignature, sizeof(recordSignature)) == 0)
+        {
+            quint32 titleSize = qFromLittleEndian<quint32>(h + 4);
+            quint32 textSize = qFromLittleEndian<quint32>(h + 8);
+            quint32 flags = qFromLittleEndian<quint32>(h + 12);
+            quint64 data = pos + recordHeaderSize;
+            bool compressed = (flags & recordTextCompressed) != 0;
+            if ((flags & ~recordTextCompressed) == 0 && titleSize % 2 == 0 && (compressed || textSize % 2 == 0)
+                    && end - data >= static_cast<quint64>(titleSize) + textSize
+                    && recordChecksum(h + 4, mBase + data, static_cast<std::size_t>(titleSize) + textSize)
+                       == qFromLittleEndian<quint32>(h + 16))
+            {
+                if (damagedFrom != none)
+                {
+                    report.skipped.emplace_back(damagedFrom, pos - damagedFrom);
+                    damagedFrom = none;
+                }
+                appendLittleEndian<quint64>(index, data);
+                index.append(reinterpret_cast<const char *>(h + 4), recordFieldsSize + 4);
+                pos = data + titleSize + textSize;
+                pos = std::min(pos + pos % 2, end);
+                continue;
+            }
+        }
+        if (damagedFrom == none)
+        {
+            damagedFrom = pos;
+        }
+        // Записи начинаются с чётных смещений
+        pos += 2;
+        const void *t = pos < end ? std::memchr(mBase + pos, recordSignature[0], end - pos) : nullptr;
+        pos = t ? static_cast<quint64>(static_cast<const uchar *>(t) - mBase) : end;
+        pos = std::min(pos + pos % 2, end);
+    }
+    if (pos < end && damagedFrom == none)
+    {
+        damagedFrom = pos;
+    }
+    if (damagedFrom != none && damagedFrom < end)
+    {
+        report.skipped.emplace_back(damagedFrom, end - damagedFrom);
+    }
+    mRebuiltIndex = index;
+    mIndex = reinterpret_cast<const uchar *>(mRebuiltIndex.constData());
+    mCount = static_cast<SizeType>(mRebuiltIndex.size() / entrySize);
+    mVersion = formatVersion;
+    report.recovered = mCount;
+}
+
+const uchar *NotebookFile::entry(SizeType record) const
+{
+    return mIndex + static_cast<qint64>(record) * entrySize;
+}
+
+QString NotebookFile::decode(quint64 offset, quint32 size) const
+{
+    const uchar *p = mBase + offset;
+    int length = static_cast<int>(size / 2);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // Данные в файле уже имеют внутреннее представление QString, достаточно
+    // скопировать их
+    return QString(reinterpret_cast<const QChar *>(p), length);
+#else
+    QString s(length, Qt::Uninitialized);
+    ushort *d = reinterpret_cast<ushort *>(s.data());
+    for (int i = 0; i < length; ++i)
+    {
+        d[i] = qFromLittleEndian<quint16>(p + 2 * i);
+    }
+    return s;
+#endif
+}
@@ -0,0 +1,227 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookFile.
+ */
+#ifndef NOTEBOOKFILE_HPP
+#define NOTEBOOKFILE_HPP
+
+#include <cstddef> // size_t
+#include <functional> // function
+#include <memory> // shared_ptr, enable_shared_from_this, unique_ptr
+#include <utility> // pair
+#include <vector>
+
+#include <QByteArray>
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QDataStream>
+#include <QFile>
+#include <QReadWriteLock>
+#include <QString>
+
+#include "note.hpp"
+
+class QIODevice;
+
+/*!
+ * \brief Класс файла записной книжки формата версий 2 и 3.
+ *
+ * Файл версии 1 представляет собой просто последовательность заметок,
+ * записанных через QDataStream, и читается только целиком, от начала до конца
+ * (см. NoteDecoder). Файлы версий 2 и 3 снабжены заголовком и таблицей
+ * смещений, что позволяет обращаться к любой заметке, не читая остальные.
+ * Структура файла версии 3:
+ *
+ * | Часть            | Содержимое                                                  |
+ * |------------------|-------------------------------------------------------------|
+ * | Заголовок        | сигнатура \c "TOYNOTE\0", версия (4 байта), флаги (4 байта) |
+ * | Записи           | для каждой заметки: заголовок записи, затем заголовок и текст заметки в UTF-16LE |
+ * | Таблица смещений | для каждой заметки: смещение заголовка заметки (8 байт), размеры заголовка и текста в байтах (по 4), флаги (4), контрольная сумма (4) |
+ * | Окончание        | смещение таблицы (8 байт), количество заметок (8 байт), сигнатура \c "TNBINDEX" |
+ *
+ * Заголовок записи (20 байт) состоит из сигнатуры \c "TNRC", размеров
+ * заголовка и текста заметки, флагов и контрольной суммы CRC-32C (см.
+ * Crc32c) размеров, флагов и данных записи. Он повторяет элемент таблицы
+ * смещений, поэтому записи неповреждённой части файла можно найти и
+ * проверить без таблицы (см. salvage()). В файлах версии 2 заголовков
+ * записей нет, а поле контрольной суммы таблицы смещений зарезервировано.
+ *
+ * Флаг записи 1 означает, что текст записи сжат (см. NoteCodec); размер
+ * текста в таблице смещений тогда равен размеру сжатых данных. Записи
+ * выравниваются по границе 2 байт, поэтому после сжатого текста нечётного
+ * размера следует байт заполнения. Другие флаги записей не определены.
+ *
+ * Все числа записываются в порядке байтов little-endian. Таблица смещений
+ * находится в конце файла, чтобы файл можно было записывать в поток
+ * последовательно, не возвращаясь к заголовку. Записывается всегда
+ * версия 3.
+ *
+ * Для чтения файл отображается в память (см. QFile::map()). При открытии
+ * проверяются только заголовок, окончание и таблица смещений, а данные
+ * записей не читаются, поэтому открытие не зависит от размера файла.
+ * Контрольные суммы записей проверяет тот, кто открыл файл: целиком и
+ * параллельно (verify()) или по частям по мере чтения (см. NotebookLoader).
+ * Объект NotebookFile является источником данных
+ * (NoteSource) для ленивых заметок, которые декодируют заголовок и текст из
+ * отображения по требованию. Сжатые тексты распаковываются через кэш
+ * NoteCodec, поэтому при просмотре списка заметок (только заголовки)
+ * распаковка не выполняется. Заметки держат указатель на источник, поэтому
+ * файл остаётся отображённым, пока на него ссылается хотя бы одна заметка.
+ *
+ * Записная книжка сохраняется (см. save()) в тот же файл, который
+ * отображён для её ленивых заметок: QSaveFile записывает новый файл рядом
+ * и переименовывает его поверх прежнего. В POSIX переименование заменяет
+ * только запись каталога, а отображённые данные прежнего файла остаются
+ * доступны, пока отображение не будет снято, поэтому ленивые заметки
+ * по-прежнему читают прежнее содержимое, совпадающее с сохранённым; место
+ * на диске освобождается, когда удаляется последняя такая заметка. В
+ * Windows отображённый файл заменить нельзя, поэтому перед заменой save()
+ * копирует данные всех объектов NotebookFile, отображающих этот файл, в
+ * память и снимает отображение (см. release()). Чтение заметок в других
+ * потоках в Windows защищено от такой замены блокировкой; в остальных
+ * системах данные не заменяются, и чтение обходится без блокировки.
+ */
+class NotebookFile : public NoteSource, public std::enable_shared_from_this<NotebookFile>
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NotebookFile)
+public:
+    //! Тип номеров записей.
+    using SizeType = quint32;
+    //! Тип функции, которой сообщается количество уже записанных заметок.
+    using ProgressFunction = std::function<void(std::size_t)>;
+
+    //! Отчёт о восстановлении повреждённого файла (см. salvage()).
+    struct SalvageReport
+    {
+        //! Количество записей по таблице смещений или -1, если таблица повреждена.
+        qint64 expected;
+        //! Количество восстановленных записей.
+        quint64 recovered;
+        //! Пропущенные повреждённые области файла: смещение и размер в байтах.
+        std::vector<std::pair<quint64, quint64>> skipped;
+    };
+
+    /*!
+     * \brief Открывает файл \a fileName и отображает его в память.
+     *
+     * Проверяются заголовок и таблица смещений, но не контрольные суммы
+     * записей (см. verify()). В случае ошибки запускает исключительную
+     * ситуацию.
+     */
+    static std::shared_ptr<NotebookFile> open(const QString &fileName);
+    /*!
+     * \brief Открывает повреждённый файл \a fileName, пропуская повреждённые записи.
+     *
+     * Если файл не повреждён, действует как open(). Иначе записи файла
+     * версии 3 ищутся по заголовкам записей, без таблицы смещений: после
+     * повреждённой области поиск продолжается со следующей сигнатуры
+     * \c "TNRC", и в файл попадают только записи с верной контрольной
+     * суммой. Что было пропущено, записывается в \a report. Файлы версии 2
+     * не содержат контрольных сумм и заголовков записей, поэтому для них
+     * метод действует как open().
+     */
+    static std::shared_ptr<NotebookFile> salvage(const QString &fileName, SalvageReport &report);
+    //! Возвращает описание отчёта \a report для пользователя.
+    static QString describe(const SalvageReport &report);
+    //! Создаёт объект для данных \a data, уже находящихся в памяти. Как и open(), не проверяет контрольные суммы записей.
+    static std::shared_ptr<NotebookFile> fromData(const QByteArray &data);
+    //! Возвращает \c true, если с текущей позиции устройства \a device начинается файл версии 2 или 3. Данные не извлекаются.
+    static bool isVersion2(QIODevice *device);
+    /*!
+     * \brief Записывает заметки \a notes в поток \a ost в формате версии 3.
+     *
+     * Если задана функция \a progress, она вызывается после записи каждой
+     * заметки с количеством уже записанных заметок. Если \a compress равен
+     * \c true, тексты заметок сжимаются; тексты, уже сжатые в памяти или
+     * в исходном файле, записываются без повторного сжатия.
+     */
+    static void write(QDataStream &ost, const std::vector<Note> &notes,
+                      const ProgressFunction &progress = ProgressFunction(), bool compress = false);
+    /*!
+     * \brief Сохраняет заметки \a notes в файл \a fileName в формате версии 3.
+     *
+     * Сохранение выполняется через QSaveFile, то есть файл заменяется
+     * целиком только в случае успешной записи. В случае ошибки запускает
+     * исключительную ситуацию. Метод не обращается к объектам графического
+     * интерфейса и может вызываться из рабочего потока. Параметры \a progress
+     * и \a compress имеют тот же смысл, что и для write(). В Windows
+     * отображения заменяемого файла перед заменой переносятся в память
+     * (см. описание класса).
+     */
+    static void save(const QString &fileName, const std::vector<Note> &notes,
+                     const ProgressFunction &progress = ProgressFunction(), bool compress = false);
+
+    /*!
+     * \brief Проверяет контрольные суммы всех записей файла версии 3.
+     *
+     * Записи проверяются параллельно в пуле потоков QtConcurrent. В случае
+     * несовпадения запускает исключительную ситуацию.
+     */
+    void verify() const;
+    //! Проверяет контрольные суммы записей с \a first по \a last - 1 в вызывающем потоке.
+    void verify(SizeType first, SizeType last) const;
+    //! Возвращает количество записей в файле.
+    SizeType size() const;
+    //! Возвращает ленивую заметку, связанную с записью \a record.
+    Note note(SizeType record) const;
+    //! Декодирует заголовок записи \a record.
+    QString title(quint32 record) const Q_DECL_OVERRIDE;
+    //! Декодирует текст записи \a record.
+    QString text(quint32 record) const Q_DECL_OVERRIDE;
+    //! Возвращает сжатый текст записи \a record или пустой массив, если текст записи не сжат.
+    QByteArray compressedText(quint32 record) const Q_DECL_OVERRIDE;
+    //! Возвращает длину текста записи \a record по таблице смещений или заголовку сжатых данных.
+    int textLength(quint32 record) const Q_DECL_OVERRIDE;
+
+private:
+    //! Конструктор. Объекты создаются только методами open(), salvage() и fromData().
+    NotebookFile();
+    //! Открывает файл \a fileName и отображает его в память, не разбирая данные.
+    static std::shared_ptr<NotebookFile> map(const QString &fileName);
+    //! Запоминает отображённый файл \a nf, чтобы release() мог его найти.
+    static void track(const std::shared_ptr<NotebookFile> &nf);
+#ifdef Q_OS_WIN
+    //! Переносит в память данные всех отображений файла \a fileName и снимает отображения.
+    static void release(const QString &fileName);
+    //! Копирует данные отображения в mDetached и снимает отображение. В случае ошибки запускает исключительную ситуацию.
+    void detach();
+#endif
+    //! Проверяет заголовок, окончание и таблицу смещений данных mBase.
+    void parse();
+    //! Возвращает \c true, если заголовок и контрольная сумма записи \a record совпадают с таблицей смещений.
+    bool isIntact(SizeType record) const;
+    //! Строит таблицу смещений из найденных в данных записей, заполняя отчёт \a report.
+    void rebuildIndex(SalvageReport &report);
+    //! Возвращает указатель на элемент таблицы смещений для записи \a record.
+    const uchar *entry(SizeType record) const;
+    //! Декодирует строку UTF-16LE длиной \a size байт, начинающуюся со смещения \a offset.
+    QString decode(quint64 offset, quint32 size) const;
+
+    //! Отображаемый в память файл (не используется для данных из памяти).
+    QFile mFile;
+    //! Данные, переданные fromData() (не используются для отображённого файла).
+    QByteArray mData;
+    //! Указатель на начало данных файла.
+    const uchar *mBase;
+    //! Размер данных файла в байтах.
+    qint64 mSize;
+    //! Указатель на начало таблицы смещений.
+    const uchar *mIndex;
+    //! Таблица смещений, построенная rebuildIndex() (пустая для неповреждённого файла).
+    QByteArray mRebuiltIndex;
+    //! Версия формата файла.
+    quint32 mVersion;
+    //! Количество записей.
+    SizeType mCount;
+    //! Ключ файла в кэше распакованных текстов (см. NoteCodec).
+    quint64 mCacheKey;
+#ifdef Q_OS_WIN
+    //! Данные отображения, перенесённые в память методом detach().
+    std::unique_ptr<uchar[]> mDetached;
+    //! Защищает mBase и mIndex от замены методом detach() во время чтения.
+    mutable QReadWriteLock mLock;
+#endif
+};
+
+#endif // NOTEBOOKFILE_HPP
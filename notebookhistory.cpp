@@ -0,0 +1,292 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookHistory.
+ */
+#include "notebookhistory.hpp"
+
+#include <algorithm> // sort(), unique()
+#include <utility> // move()
+
+#include "config.hpp"
+
+namespace
+{
+
+//! Возвращает оценку объёма памяти, занимаемой заметками \a notes.
+std::size_t memoryUsageOf(const std::vector<Note> &notes)
+{
+    std::size_t usage = 0;
+    for (const Note &note : notes)
+    {
+        usage += note.memoryUsage();
+    }
+    return usage;
+}
+
+}
+
+NotebookHistory::NotebookHistory(Notebook *notebook, QObject *parent)
+    : QObject(parent)
+    , mNotebook(notebook)
+    , mDone(0)
+    , mMemoryUsage(0)
+    , mMemoryLimit(Config::historyMemoryLimit)
+{
+    // После сброса модели идентификаторы заметок в командах ничего не значат
+    connect(notebook, &Notebook::modelReset, this, &NotebookHistory::clear);
+}
+
+void NotebookHistory::insert(const Note &note)
+{
+    mNotebook->insert(note);
+    // Берём заметку из записной книжки: её текст может быть сжат
+    Notebook::SizeType row = mNotebook->size() - 1;
+    Command command{ Command::Insert, tr("Add Note"), { mNotebook->idAt(row) }, { row },
+                     {}, { (*mNotebook)[row] }, 0 };
+    push(std::move(command));
+}
+
+void NotebookHistory::insertMany(Notebook::SizeType idx, std::vector<Note> notes)
+{
+    if (notes.empty())
+    {
+        return;
+    }
+    Notebook::SizeType count = static_cast<Notebook::SizeType>(notes.size());
+    mNotebook->insertMany(idx, std::move(notes));
+    // Как и в insert(), берём заметки из записной книжки: их тексты могут быть сжаты
+    Command command{ Command::Insert, tr("Add %n Note(s)", nullptr, count), {}, {}, {}, {}, 0 };
+    command.ids.reserve(static_cast<std::size_t>(count));
+    command.rows.reserve(static_cast<std::size_t>(count));
+    command.after.reserve(static_cast<std::size_t>(count));
+    for (Notebook::SizeType row = idx; row < idx + count; ++row)
+    {
+        command.ids.push_back(mNotebook->idAt(row));
+        command.rows.push_back(row);
+        command.after.push_back((*mNotebook)[row]);
+    }
+    push(std::move(command));
+}
+
+void NotebookHistory::update(Notebook::SizeType idx, const Note &note)
+{
+    update(idx, Note(note));
+}
+
+void NotebookHistory::update(Notebook::SizeType idx, Note &&note)
+{
+    // Прежняя заметка разделяет неизменённые поля с новой
+    Command command{ Command::Update, tr("Edit Note"), { mNotebook->idAt(idx) }, {},
+                     { (*mNotebook)[idx] }, {}, 0 };
+    mNotebook->updateNoteAt(std::move(note), idx);
+    command.after.push_back((*mNotebook)[idx]);
+    push(std::move(command));
+}
+
+void NotebookHistory::erase(const QItemSelection &selection)
+{
+    // Запоминаем удаляемые заметки и их строки по возрастанию строк
+    std::vector<Notebook::SizeType> rows;
+    for (const QItemSelectionRange &range : selection)
+    {
+        if (range.isValid() && range.model() == mNotebook)
+        {
+            for (int row = range.top(); row <= range.bottom(); ++row)
+            {
+                rows.push_back(row);
+            }
+        }
+    }
+    if (rows.empty())
+    {
+        return;
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    Command command{ Command::Erase, tr("Delete %n Note(s)", "", static_cast<int>(rows.size())),
+                     {}, {}, {}, {}, 0 };
+    command.ids.reserve(rows.size());
+    command.before.reserve(rows.size());
+    for (Notebook::SizeType row : rows)
+    {
+        command.ids.push_back(mNotebook->idAt(row));
+        command.before.push_back((*mNotebook)[row]);
+    }
+    command.rows = std::move(rows);
+    mNotebook->eraseRanges(selection);
+    push(std::move(command));
+}
+
+bool NotebookHistory::canUndo() const
+{
+    return mDone > 0;
+}
+
+bool NotebookHistory::canRedo() const
+{
+    return mDone < mCommands.size();
+}
+
+QString NotebookHistory::undoText() const
+{
+    return canUndo() ? mCommands[mDone - 1].text : QString();
+}
+
+QString NotebookHistory::redoText() const
+{
+    return canRedo() ? mCommands[mDone].text : QString();
+}
+
+std::size_t NotebookHistory::memoryUsage() const
+{
+    return mMemoryUsage;
+}
+
+std::size_t NotebookHistory::memoryLimit() const
+{
+    return mMemoryLimit;
+}
+
+void NotebookHistory::setMemoryLimit(std::size_t limit)
+{
+    mMemoryLimit = limit;
+    evict();
+    emit changed();
+}
+
+void NotebookHistory::undo()
+{
+    if (!canUndo())
+    {
+        return;
+    }
+    const Command &command = mCommands[--mDone];
+    switch (command.kind)
+    {
+    case Command::Insert:
+        eraseIds(command.ids);
+        break;
+    case Command::Update:
+        replace(command.ids, command.before);
+        break;
+    case Command::Erase:
+        mNotebook->restore(command.rows, command.ids, command.before);
+        break;
+    }
+    emit changed();
+}
+
+void NotebookHistory::redo()
+{
+    if (!canRedo())
+    {
+        return;
+    }
+    const Command &command = mCommands[mDone++];
+    switch (command.kind)
+    {
+    case Command::Insert:
+        mNotebook->restore(command.rows, command.ids, command.after);
+        break;
+    case Command::Update:
+        replace(command.ids, command.after);
+        break;
+    case Command::Erase:
+        eraseIds(command.ids);
+        break;
+    }
+    emit changed();
+}
+
+void NotebookHistory::clear()
+{
+    if (mCommands.empty())
+    {
+        return;
+    }
+    mCommands.clear();
+    mDone = 0;
+    mMemoryUsage = 0;
+    emit changed();
+}
+
+void NotebookHistory::push(Command command)
+{
+    // Отменённые команды повторить больше нельзя
+    while (mCommands.size() > mDone)
+    {
+        mMemoryUsage -= mCommands.back().cost;
+        mCommands.pop_back();
+    }
+    command.cost = memoryUsageOf(command.before) + memoryUsageOf(command.after)
+            + command.ids.size() * sizeof(Notebook::NoteId)
+            + command.rows.size() * sizeof(Notebook::SizeType) + sizeof(Command);
+    mMemoryUsage += command.cost;
+    mCommands.push_back(std::move(command));
+    mDone = mCommands.size();
+    evict();
+    emit changed();
+}
+
+void NotebookHistory::replace(const std::vector<Notebook::NoteId> &ids, const std::vector<Note> &notes)
+{
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+        // Заметка могла быть удалена в обход истории
+        Notebook::SizeType row = mNotebook->rowOf(ids[i]);
+        if (row >= 0)
+        {
+            mNotebook->updateNoteAt(notes[i], row);
+        }
+    }
+}
+
+/*!
+ * Строки заметок упорядочиваются, соседние строки объединяются в диапазоны,
+ * и записная книжка удаляет их за один проход (см. Notebook::eraseRanges()).
+ */
+void NotebookHistory::eraseIds(const std::vector<Notebook::NoteId> &ids)
+{
+    std::vector<Notebook::SizeType> rows;
+    rows.reserve(ids.size());
+    for (Notebook::NoteId id : ids)
+    {
+        Notebook::SizeType row = mNotebook->rowOf(id);
+        if (row >= 0)
+        {
+            rows.push_back(row);
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    QItemSelection selection;
+    int first = -1, last = -1;
+    for (Notebook::SizeType row : rows)
+    {
+        if (first >= 0 && row == last + 1)
+        {
+            last = row;
+            continue;
+        }
+        if (first >= 0)
+        {
+            selection.append(QItemSelectionRange(mNotebook->index(first, 0), mNotebook->index(last, 0)));
+        }
+        first = last = row;
+    }
+    if (first >= 0)
+    {
+        selection.append(QItemSelectionRange(mNotebook->index(first, 0), mNotebook->index(last, 0)));
+    }
+    mNotebook->eraseRanges(selection);
+}
+
+void NotebookHistory::evict()
+{
+    // Последнюю выполненную команду оставляем в любом случае
+    while (mMemoryUsage > mMemoryLimit && mDone > 1)
+    {
+        mMemoryUsage -= mCommands.front().cost;
+        mCommands.pop_front();
+        --mDone;
+    }
+}
@@ -0,0 +1,153 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookHistory.
+ */
+#ifndef NOTEBOOKHISTORY_HPP
+#define NOTEBOOKHISTORY_HPP
+
+#include <cstddef> // size_t
+#include <deque>
+#include <vector>
+
+#include <QItemSelection>
+#include <QObject>
+#include <QString>
+
+#include "note.hpp"
+#include "notebook.hpp"
+
+/*!
+ * \brief Класс истории изменений записной книжки для их отмены и повтора.
+ *
+ * Изменения, которые должны отменяться, выполняются через методы истории
+ * (insert(), update(), erase()), а не напрямую через Notebook. Каждое из них
+ * становится командой, которую можно отменить методом undo() и повторить
+ * методом redo().
+ *
+ * Команда хранит только затронутые заметки, а не снимок всей записной
+ * книжки. Заметки в команде — это обычные копии Note: QString использует
+ * неявное разделение данных, поэтому неизменённые заголовки и тексты
+ * разделяются с записной книжкой, а ленивые заметки хранят лишь ссылку на
+ * источник. Изменяемые и удаляемые заметки определяются идентификаторами
+ * (Notebook::NoteId), поэтому находятся, как бы ни сдвигались строки.
+ * Удалённые заметки возвращаются на запомненные строки: команды отменяются
+ * и повторяются строго по порядку, поэтому к этому моменту остальные
+ * заметки стоят так же, как при выполнении команды.
+ *
+ * Объём памяти, удерживаемой историей, ограничен (см. setMemoryLimit()).
+ * Когда он превышен, забываются самые старые команды. Загрузка записной
+ * книжки (сброс модели) очищает историю.
+ */
+class NotebookHistory : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Конструктор.
+     * \param notebook Записная книжка. Должна существовать, пока существует история.
+     * \param parent Родительский объект.
+     */
+    explicit NotebookHistory(Notebook *notebook, QObject *parent = nullptr);
+
+    //! Вставляет заметку \a note в конец записной книжки.
+    void insert(const Note &note);
+    /*!
+     * \brief Вставляет заметки \a notes перед заметкой с индексом \a idx.
+     *
+     * Вставка выполняется одним вызовом Notebook::insertMany() и отменяется
+     * одной командой.
+     */
+    void insertMany(Notebook::SizeType idx, std::vector<Note> notes);
+    //! Заменяет заметку с индексом \a idx заметкой \a note.
+    void update(Notebook::SizeType idx, const Note &note);
+    //! Заменяет заметку с индексом \a idx заметкой \a note, перемещая её в записную книжку.
+    void update(Notebook::SizeType idx, Note &&note);
+    //! Удаляет строки записной книжки, входящие в выделение \a selection (см. Notebook::eraseRanges()).
+    void erase(const QItemSelection &selection);
+
+    //! Возвращает \c true, если есть команда для отмены.
+    bool canUndo() const;
+    //! Возвращает \c true, если есть команда для повтора.
+    bool canRedo() const;
+    //! Возвращает описание команды, которая будет отменена.
+    QString undoText() const;
+    //! Возвращает описание команды, которая будет повторена.
+    QString redoText() const;
+    /*!
+     * \brief Возвращает оценку объёма памяти, удерживаемой историей, в байтах.
+     *
+     * Оценка сверху: строки, разделяемые с записной книжкой, учитываются
+     * полностью (см. Note::memoryUsage()).
+     */
+    std::size_t memoryUsage() const;
+    //! Возвращает наибольший объём памяти, удерживаемой историей, в байтах.
+    std::size_t memoryLimit() const;
+    /*!
+     * \brief Устанавливает наибольший объём памяти, удерживаемой историей, равным \a limit байт.
+     *
+     * Последняя команда сохраняется, даже если сама занимает больше.
+     */
+    void setMemoryLimit(std::size_t limit);
+
+public slots:
+    //! Отменяет последнюю выполненную команду.
+    void undo();
+    //! Повторяет последнюю отменённую команду.
+    void redo();
+    //! Забывает все команды.
+    void clear();
+
+signals:
+    //! Сигнализирует, что изменились команды, доступные для отмены и повтора.
+    void changed();
+
+private:
+    //! Команда истории.
+    struct Command
+    {
+        //! Вид команды.
+        enum Kind
+        {
+            Insert, //!< Вставка заметок
+            Update, //!< Изменение заметок
+            Erase   //!< Удаление заметок
+        };
+
+        //! Вид команды.
+        Kind kind;
+        //! Описание команды для пользователя.
+        QString text;
+        //! Идентификаторы затронутых заметок в порядке строк.
+        std::vector<Notebook::NoteId> ids;
+        //! Строки вставленных или удалённых заметок по возрастанию (для Insert и Erase).
+        std::vector<Notebook::SizeType> rows;
+        //! Заметки до выполнения команды (для Update и Erase).
+        std::vector<Note> before;
+        //! Заметки после выполнения команды (для Insert и Update).
+        std::vector<Note> after;
+        //! Оценка объёма памяти, удерживаемой командой.
+        std::size_t cost;
+    };
+
+    //! Добавляет выполненную команду \a command, забывая отменённые и самые старые команды.
+    void push(Command command);
+    //! Заменяет заметки с идентификаторами \a ids заметками \a notes.
+    void replace(const std::vector<Notebook::NoteId> &ids, const std::vector<Note> &notes);
+    //! Удаляет из записной книжки заметки с идентификаторами \a ids.
+    void eraseIds(const std::vector<Notebook::NoteId> &ids);
+    //! Забывает самые старые команды, пока история не уложится в ограничение памяти.
+    void evict();
+
+    //! Записная книжка.
+    Notebook *mNotebook;
+    //! Команды от самой старой к самой новой.
+    std::deque<Command> mCommands;
+    //! Количество выполненных команд; команды начиная с этой отменены.
+    std::size_t mDone;
+    //! Оценка объёма памяти, удерживаемой командами.
+    std::size_t mMemoryUsage;
+    //! Наибольший объём памяти, удерживаемой командами.
+    std::size_t mMemoryLimit;
+};
+
+#endif // NOTEBOOKHISTORY_HPP
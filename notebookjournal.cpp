@@ -0,0 +1,418 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookJournal.
+ */
+#include "notebookjournal.hpp"
+
+#include <algorithm> // min()
+#include <cstddef> // ptrdiff_t
+#include <stdexcept> // runtime_error
+#include <utility> // move()
+#include <vector>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QItemSelection>
+
+#include "config.hpp"
+#include "notebook.hpp"
+#include "notebooksaver.hpp"
+
+namespace
+{
+
+//! Сигнатура журнала ("TNBJ").
+const quint32 journalMagic = 0x544E424A;
+//! Версия формата журнала.
+const quint32 journalVersion = 1;
+
+//! Генерирует исключительную ситуацию о повреждённом журнале.
+[[noreturn]] void throwCorrupt()
+{
+    throw std::runtime_error(NotebookJournal::tr("Corrupt journal data").toStdString());
+}
+
+}
+
+NotebookJournal::NotebookJournal(Notebook *notebook, const QString &baseFileName,
+                                 NotebookSaver *saver, QObject *parent)
+    : QObject(parent)
+    , mNotebook(notebook)
+    , mSaver(saver)
+    , mBaseFileName(baseFileName)
+    , mSequence(0)
+    , mPendingFirst(0)
+    , mNeedsFullSave(false)
+    , mFullSaveMark(0)
+    , mCompactionThreshold(Config::journalCompactionThreshold)
+    , mCompactionJob(0)
+    , mCompactionMark(0)
+{
+    // Накапливаем изменения модели. Заметки копируются в записи сразу, так как
+    // к моменту записи журнала строки могут сместиться или измениться снова.
+    // Копирование заметки дёшево благодаря неявному разделению данных QString
+    connect(notebook, &Notebook::rowsInserted, this,
+            [this](const QModelIndex &, int first, int last) {
+        for (int row = first; row <= last; ++row)
+        {
+            record(Record{ Insert, static_cast<quint32>(row), 0, (*mNotebook)[row] });
+        }
+    });
+    connect(notebook, &Notebook::rowsRemoved, this,
+            [this](const QModelIndex &, int first, int last) {
+        record(Record{ Erase, static_cast<quint32>(first),
+                       static_cast<quint32>(last - first + 1), Note() });
+    });
+    connect(notebook, &Notebook::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        // Если модель не сообщила, какие строки изменились, записать
+        // изменения в журнал невозможно
+        if (!topLeft.isValid() || !bottomRight.isValid())
+        {
+            requireFullSave();
+            return;
+        }
+        for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        {
+            record(Record{ Update, static_cast<quint32>(row), 0, (*mNotebook)[row] });
+        }
+    });
+    // После сброса модели её содержимое никак не связано с базой
+    connect(notebook, &Notebook::modelReset, this, &NotebookJournal::requireFullSave);
+
+    // Уплотнение — это полное сохранение записной книжки в файл базы
+    connect(saver, &NotebookSaver::saved, this, [this](quint64 job, QString fileName) {
+        if (job == mCompactionJob)
+        {
+            mCompactionJob = 0;
+            rebase(fileName, mCompactionMark);
+            emit compacted();
+        }
+    });
+    connect(saver, &NotebookSaver::failed, this, [this](quint64 job, QString, QString message) {
+        if (job == mCompactionJob)
+        {
+            mCompactionJob = 0;
+            emit compactionFailed(message);
+        }
+    });
+}
+
+QString NotebookJournal::journalFileName(const QString &baseFileName)
+{
+    return baseFileName + QStringLiteral(".journal");
+}
+
+int NotebookJournal::replay(const QString &baseFileName, Notebook &notebook)
+{
+    QFile jf(journalFileName(baseFileName));
+    if (!jf.exists())
+    {
+        return 0;
+    }
+    if (!jf.open(QIODevice::ReadWrite))
+    {
+        throw std::runtime_error((tr("open(): ") + jf.errorString()).toStdString());
+    }
+    QDataStream ist(&jf);
+    quint32 magic = 0, version = 0;
+    quint64 baseSize = 0;
+    qint64 baseTime = 0;
+    ist >> magic >> version >> baseSize >> baseTime;
+    if (ist.status() != QDataStream::Ok || magic != journalMagic)
+    {
+        throwCorrupt();
+    }
+    if (version != journalVersion)
+    {
+        throw std::runtime_error(tr("Unsupported journal version %1").arg(version).toStdString());
+    }
+    QFileInfo base(baseFileName);
+    if (baseSize != static_cast<quint64>(base.size())
+            || baseTime != base.lastModified().toMSecsSinceEpoch())
+    {
+        // Журнал относится к другой версии базы: все его изменения уже
+        // включены в базу или потеряли смысл
+        jf.remove();
+        return 0;
+    }
+
+    int applied = 0;
+    qint64 valid = jf.pos();
+    Record r;
+    // Вставки в соседние строки подряд (например, добавление нескольких
+    // заметок одной командой) применяются одной вставкой диапазона
+    std::vector<Note> inserted;
+    quint64 insertRow = 0;
+    auto flush = [&]() {
+        if (!inserted.empty())
+        {
+            notebook.insertMany(static_cast<Notebook::SizeType>(insertRow), std::move(inserted));
+            inserted.clear();
+        }
+    };
+    while (!ist.atEnd() && readRecord(ist, r))
+    {
+        if (r.op == Insert && !inserted.empty() && r.row == insertRow + inserted.size())
+        {
+            inserted.push_back(std::move(r.note));
+        }
+        else
+        {
+            flush();
+            if (r.op == Insert)
+            {
+                if (r.row > static_cast<quint64>(notebook.size()))
+                {
+                    throwCorrupt();
+                }
+                insertRow = r.row;
+                inserted.push_back(std::move(r.note));
+            }
+            else
+            {
+                apply(r, notebook);
+            }
+        }
+        valid = jf.pos();
+        ++applied;
+    }
+    flush();
+    // Отбрасываем неполную запись в конце, чтобы следующие записи
+    // дописывались после последней целой
+    if (valid < jf.size())
+    {
+        jf.resize(valid);
+    }
+    return applied;
+}
+
+void NotebookJournal::discard(const QString &baseFileName)
+{
+    QFile::remove(journalFileName(baseFileName));
+}
+
+QString NotebookJournal::baseFileName() const
+{
+    return mBaseFileName;
+}
+
+bool NotebookJournal::canAppend() const
+{
+    // Пока записывается база, журнал не дописываем: после записи базы он
+    // будет заменён, и дописанные изменения потерялись бы
+    return !mBaseFileName.isEmpty() && !mNeedsFullSave && !mSaver->isBusy();
+}
+
+bool NotebookJournal::hasPendingChanges() const
+{
+    return !mPending.empty();
+}
+
+void NotebookJournal::append()
+{
+    if (!canAppend())
+    {
+        throw std::runtime_error(tr("The notebook has to be saved in full").toStdString());
+    }
+    if (mPending.empty())
+    {
+        return;
+    }
+    QFile jf(journalFileName(mBaseFileName));
+    if (!jf.open(QIODevice::ReadWrite))
+    {
+        throw std::runtime_error((tr("open(): ") + jf.errorString()).toStdString());
+    }
+    qint64 oldSize = jf.size();
+    jf.seek(oldSize);
+    QDataStream ost(&jf);
+    if (oldSize == 0)
+    {
+        writeHeader(ost, mBaseFileName);
+    }
+    for (const Record &r : mPending)
+    {
+        writeRecord(ost, r);
+    }
+    if (ost.status() != QDataStream::Ok || !jf.flush())
+    {
+        // Убираем частично записанные данные, чтобы журнал заканчивался
+        // целой записью
+        jf.resize(oldSize);
+        throw std::runtime_error(tr("Write to the stream failed").toStdString());
+    }
+    mPendingFirst += mPending.size();
+    mPending.clear();
+}
+
+quint64 NotebookJournal::mark() const
+{
+    return mSequence;
+}
+
+void NotebookJournal::rebase(const QString &baseFileName, quint64 mark)
+{
+    mBaseFileName = baseFileName;
+    discard(mBaseFileName);
+    // Изменения с номерами меньше mark вошли в новую базу
+    if (mark > mPendingFirst)
+    {
+        quint64 n = std::min<quint64>(mark - mPendingFirst, mPending.size());
+        mPending.erase(mPending.begin(), mPending.begin() + static_cast<std::ptrdiff_t>(n));
+        mPendingFirst += n;
+    }
+    // Полное сохранение по-прежнему нужно, только если оно потребовалось
+    // уже после снимка
+    if (mNeedsFullSave && mFullSaveMark <= mark)
+    {
+        mNeedsFullSave = false;
+    }
+}
+
+qint64 NotebookJournal::size() const
+{
+    return QFileInfo(journalFileName(mBaseFileName)).size();
+}
+
+qint64 NotebookJournal::compactionThreshold() const
+{
+    return mCompactionThreshold;
+}
+
+void NotebookJournal::setCompactionThreshold(qint64 threshold)
+{
+    mCompactionThreshold = threshold;
+}
+
+bool NotebookJournal::isCompacting() const
+{
+    return mCompactionJob != 0;
+}
+
+/*!
+ * Новая база записывается из снимка записной книжки, который соответствует
+ * базе вместе со всем журналом. После записи журнал удаляется методом rebase().
+ */
+void NotebookJournal::compactIfNeeded()
+{
+    // Снимок должен соответствовать журналу, поэтому при наличии
+    // незаписанных изменений уплотнение откладываем
+    if (isCompacting() || !canAppend() || hasPendingChanges() || size() < mCompactionThreshold)
+    {
+        return;
+    }
+    mCompactionMark = mark();
+    mCompactionJob = mSaver->save(mBaseFileName, mNotebook->snapshot(), mNotebook->textCompression());
+}
+
+void NotebookJournal::writeRecord(QDataStream &ost, const Record &r)
+{
+    ost << static_cast<quint8>(r.op) << r.row;
+    if (r.op == Erase)
+    {
+        ost << r.count;
+    }
+    else
+    {
+        ost << r.note.title() << r.note.text();
+    }
+}
+
+bool NotebookJournal::readRecord(QDataStream &ist, Record &r)
+{
+    quint8 op = 0;
+    ist >> op >> r.row;
+    switch (op)
+    {
+    case Insert:
+    case Update:
+    {
+        QString title, text;
+        ist >> title >> text;
+        r.note = Note(std::move(title), std::move(text));
+        break;
+    }
+    case Erase:
+        ist >> r.count;
+        break;
+    default:
+        // Данные прочитаны не до конца — это оборванная запись
+        if (ist.status() == QDataStream::ReadPastEnd)
+        {
+            return false;
+        }
+        throwCorrupt();
+    }
+    r.op = static_cast<Operation>(op);
+    // ReadPastEnd означает, что запись была записана не полностью
+    if (ist.status() == QDataStream::ReadPastEnd)
+    {
+        return false;
+    }
+    if (ist.status() != QDataStream::Ok)
+    {
+        throwCorrupt();
+    }
+    return true;
+}
+
+void NotebookJournal::apply(const Record &r, Notebook &notebook)
+{
+    quint64 size = static_cast<quint64>(notebook.size());
+    switch (r.op)
+    {
+    case Insert:
+        // Новые заметки вставляются в конец записной книжки, а заметки,
+        // возвращённые отменой удаления, — на прежнее место
+        if (r.row > size)
+        {
+            throwCorrupt();
+        }
+        notebook.insertAt(static_cast<Notebook::SizeType>(r.row), r.note);
+        break;
+    case Update:
+        if (r.row >= size)
+        {
+            throwCorrupt();
+        }
+        notebook.updateNoteAt(r.note, r.row);
+        break;
+    case Erase:
+        if (r.count == 0 || static_cast<quint64>(r.row) + r.count > size)
+        {
+            throwCorrupt();
+        }
+        // Диапазон удаляется за один проход по хранилищу, с одной парой
+        // сигналов для видов
+        notebook.eraseRanges(QItemSelection(notebook.index(static_cast<int>(r.row), 0),
+                                            notebook.index(static_cast<int>(r.row + r.count - 1), 0)));
+        break;
+    }
+}
+
+void NotebookJournal::writeHeader(QDataStream &ost, const QString &baseFileName)
+{
+    QFileInfo base(baseFileName);
+    ost << journalMagic << journalVersion
+        << static_cast<quint64>(base.size())
+        << static_cast<qint64>(base.lastModified().toMSecsSinceEpoch());
+}
+
+void NotebookJournal::record(const Record &r)
+{
+    mPending.push_back(r);
+    ++mSequence;
+}
+
+void NotebookJournal::requireFullSave()
+{
+    // Накопленные изменения больше не нужны: сохранить можно только всю
+    // записную книжку
+    mPending.clear();
+    mPendingFirst = ++mSequence;
+    mNeedsFullSave = true;
+    mFullSaveMark = mSequence;
+}
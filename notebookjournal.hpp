@@ -0,0 +1,175 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookJournal.
+ */
+#ifndef NOTEBOOKJOURNAL_HPP
+#define NOTEBOOKJOURNAL_HPP
+
+#include <deque>
+
+#include <QObject>
+#include <QString>
+
+#include "note.hpp"
+
+class QDataStream;
+class Notebook;
+class NotebookSaver;
+
+/*!
+ * \brief Класс журнала изменений записной книжки.
+ *
+ * Журнал позволяет сохранять записную книжку, не переписывая её файл
+ * целиком. Рядом с основным файлом (\e базой) создаётся файл журнала
+ * с суффиксом \c .journal, в конец которого дописываются записи о вставке,
+ * изменении и удалении заметок. Стоимость сохранения при этом зависит от
+ * объёма изменений, а не от размера записной книжки.
+ *
+ * Объект журнала следит за сигналами модели Notebook и накапливает
+ * изменения в памяти до вызова append(). При открытии базы журнал
+ * применяется к ней методом replay(). Когда размер журнала превышает порог,
+ * compactIfNeeded() через NotebookSaver записывает новую базу, включающую
+ * все изменения, и очищает журнал.
+ *
+ * Все изменения, отслеживаемые журналом, нумеруются по порядку. Номер,
+ * возвращаемый mark() в момент снимка записной книжки, позволяет после
+ * сохранения снимка в базу (см. rebase()) оставить в журнале только
+ * изменения, сделанные после снимка. Пока NotebookSaver записывает базу,
+ * журнал не дописывается.
+ *
+ * В заголовке журнала хранятся размер и время изменения базы, для которой
+ * он был создан. Журнал, не соответствующий базе (например, оставшийся
+ * после сохранения файла другим способом), не применяется.
+ */
+class NotebookJournal : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Конструктор.
+     * \param notebook Записная книжка, изменения которой записываются в журнал.
+     * \param baseFileName Имя файла базы, из которого загружена записная
+     * книжка, или пустая строка, если базы ещё нет.
+     * \param saver Объект, через который записываются базы.
+     * \param parent Родительский объект.
+     *
+     * Записная книжка и \a saver должны существовать, пока существует журнал.
+     */
+    NotebookJournal(Notebook *notebook, const QString &baseFileName, NotebookSaver *saver,
+                    QObject *parent = nullptr);
+
+    //! Возвращает имя файла журнала для базы \a baseFileName.
+    static QString journalFileName(const QString &baseFileName);
+    /*!
+     * \brief Применяет журнал базы \a baseFileName к записной книжке \a notebook.
+     * \return Количество применённых записей.
+     *
+     * Записная книжка должна быть только что загружена из базы. Неполная
+     * последняя запись (например, после аварийного завершения программы)
+     * отбрасывается. В случае ошибки запускает исключительную ситуацию.
+     */
+    static int replay(const QString &baseFileName, Notebook &notebook);
+    //! Удаляет журнал базы \a baseFileName.
+    static void discard(const QString &baseFileName);
+
+    //! Возвращает имя файла базы.
+    QString baseFileName() const;
+    /*!
+     * \brief Возвращает \c true, если накопленные изменения можно дописать в журнал.
+     *
+     * Это невозможно, если базы нет, если модель была сброшена и если
+     * в данный момент записывается база.
+     */
+    bool canAppend() const;
+    //! Возвращает \c true, если есть изменения, ещё не записанные в журнал.
+    bool hasPendingChanges() const;
+    //! Дописывает накопленные изменения в журнал. В случае ошибки запускает исключительную ситуацию.
+    void append();
+    //! Возвращает номер последнего отслеженного изменения.
+    quint64 mark() const;
+    /*!
+     * \brief Сообщает журналу, что записная книжка сохранена целиком.
+     * \param baseFileName Имя файла, который становится базой.
+     * \param mark Значение mark() на момент снимка, записанного в файл.
+     *
+     * Удаляет файл журнала новой базы и изменения, вошедшие в снимок.
+     * Изменения, сделанные после снимка, остаются в журнале.
+     */
+    void rebase(const QString &baseFileName, quint64 mark);
+    //! Возвращает размер файла журнала в байтах.
+    qint64 size() const;
+    //! Возвращает порог размера журнала, после которого выполняется уплотнение.
+    qint64 compactionThreshold() const;
+    //! Устанавливает порог размера журнала, после которого выполняется уплотнение.
+    void setCompactionThreshold(qint64 threshold);
+    //! Возвращает \c true, если выполняется уплотнение.
+    bool isCompacting() const;
+    //! Ставит в очередь NotebookSaver запись новой базы, если размер журнала превысил порог.
+    void compactIfNeeded();
+
+signals:
+    //! Сигнализирует, что уплотнение успешно завершено.
+    void compacted();
+    //! Сигнализирует, что уплотнение завершилось ошибкой \a message.
+    void compactionFailed(QString message);
+
+private:
+    //! Тип записи журнала.
+    enum Operation : quint8
+    {
+        Insert = 1, //!< Вставка заметки
+        Update = 2, //!< Изменение заметки
+        Erase = 3   //!< Удаление заметок
+    };
+
+    //! Запись журнала.
+    struct Record
+    {
+        //! Тип записи.
+        Operation op;
+        //! Номер строки.
+        quint32 row;
+        //! Количество удаляемых строк (для Erase).
+        quint32 count;
+        //! Заметка (для Insert и Update).
+        Note note;
+    };
+
+    //! Записывает запись \a r в поток \a ost.
+    static void writeRecord(QDataStream &ost, const Record &r);
+    //! Читает запись из потока \a ist в \a r. Возвращает \c false, если запись неполная.
+    static bool readRecord(QDataStream &ist, Record &r);
+    //! Применяет запись \a r к записной книжке \a notebook.
+    static void apply(const Record &r, Notebook &notebook);
+    //! Записывает в поток \a ost заголовок журнала для базы \a baseFileName.
+    static void writeHeader(QDataStream &ost, const QString &baseFileName);
+    //! Добавляет изменение \a r в список накопленных.
+    void record(const Record &r);
+    //! Отмечает, что записную книжку можно сохранить только целиком.
+    void requireFullSave();
+
+    //! Записная книжка.
+    Notebook *mNotebook;
+    //! Объект, через который записываются базы.
+    NotebookSaver *mSaver;
+    //! Имя файла базы.
+    QString mBaseFileName;
+    //! Изменения, ещё не записанные в журнал.
+    std::deque<Record> mPending;
+    //! Количество отслеженных изменений (номер следующего изменения).
+    quint64 mSequence;
+    //! Номер первого изменения в mPending.
+    quint64 mPendingFirst;
+    //! Признак того, что записную книжку можно сохранить только целиком.
+    bool mNeedsFullSave;
+    //! Номер изменения, после которого потребовалось полное сохранение.
+    quint64 mFullSaveMark;
+    //! Порог размера журнала для уплотнения.
+    qint64 mCompactionThreshold;
+    //! Задание NotebookSaver, записывающее новую базу при уплотнении (0, если уплотнения нет).
+    quint64 mCompactionJob;
+    //! Значение mark() на момент снимка для уплотнения.
+    quint64 mCompactionMark;
+};
+
+#endif // NOTEBOOKJOURNAL_HPP
@@ -0,0 +1,271 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookLoader.
+ */
+#include "notebookloader.hpp"
+
+#include <algorithm> // min()
+#include <exception>
+#include <iterator> // make_move_iterator()
+#include <memory> // shared_ptr, unique_ptr
+#include <stdexcept> // runtime_error
+#include <utility> // move()
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+
+#include "config.hpp"
+#include "notebook.hpp"
+#include "notebookfile.hpp"
+#include "notedecoder.hpp"
+#include "trace.hpp"
+#include "workerpool.hpp"
+
+NotebookLoader::NotebookLoader(QObject *parent)
+    : QObject(parent)
+    , mNotebook(nullptr)
+    , mCompressTexts(false)
+    , mSalvage(false)
+    , mSalvageReport{ -1, 0, {} }
+    , mRunning(false)
+    , mCancel(false)
+    , mOpened(false)
+    , mDone(false)
+    , mNext(0)
+    , mCount(0)
+    , mBytesRead(0)
+    , mBytesTotal(0)
+{
+    connect(&mWatcher, &QFutureWatcher<QString>::finished, this, &NotebookLoader::sliceFinished);
+}
+
+NotebookLoader::~NotebookLoader()
+{
+    // Рабочий поток обращается к объекту, поэтому дожидаемся его остановки
+    mCancel = true;
+    mWatcher.waitForFinished();
+}
+
+void NotebookLoader::load(const QString &fileName, Notebook *notebook, bool salvage)
+{
+    cancel();
+    mFileName = fileName;
+    mNotebook = notebook;
+    mCompressTexts = notebook->textCompression();
+    mSalvage = salvage;
+    mSalvageReport = NotebookFile::SalvageReport{ -1, 0, {} };
+    mRunning = true;
+    mCancel = false;
+    mOpened = false;
+    mDone = false;
+    mNext = 0;
+    mCount = 0;
+    mBytesRead = 0;
+    mBytesTotal = QFile(fileName).size();
+    mReady.clear();
+    startSlice();
+}
+
+bool NotebookLoader::isRunning() const
+{
+    return mRunning;
+}
+
+NotebookFile::SalvageReport NotebookLoader::salvageReport() const
+{
+    // Рабочий поток уже завершён, если загрузка не выполняется
+    return mRunning ? NotebookFile::SalvageReport{ -1, 0, {} } : mSalvageReport;
+}
+
+void NotebookLoader::cancel()
+{
+    if (!mRunning)
+    {
+        return;
+    }
+    mCancel = true;
+    // Часть загрузки, ещё не начатая пулом, завершается сразу после запуска,
+    // а выполняющаяся читает не больше одной порции
+    mWatcher.waitForFinished();
+    // Сигнал finished() наблюдателя придёт позже и будет проигнорирован
+    finish(QString());
+}
+
+void NotebookLoader::startSlice()
+{
+    // Части загрузки ставятся в очередь от имени записной книжки, поэтому
+    // её загрузка и индексирование делят между собой одну долю пула
+    mWatcher.setFuture(WorkerPool::instance().run<QString>(mNotebook, [this]() { return runSlice(); }));
+}
+
+QString NotebookLoader::runSlice()
+{
+    TRACE_SCOPE("NotebookLoader::runSlice");
+    try
+    {
+        if (mCancel)
+        {
+            return QString();
+        }
+        if (!mOpened)
+        {
+            open();
+            mOpened = true;
+        }
+        std::vector<Note> batch;
+        std::size_t last;
+        qint64 bytesRead;
+        if (mFile)
+        {
+            // Заметки файла версии 2 создаются ленивыми, поэтому ход загрузки
+            // оцениваем по количеству записей. Первую порцию отправляем как
+            // можно раньше, чтобы пользователь сразу увидел начало записной
+            // книжки
+            QElapsedTimer timer;
+            timer.start();
+            last = mNext;
+            while (last < mCount && batch.size() < static_cast<std::size_t>(Config::loaderBatchSize)
+                   && timer.elapsed() < Config::loaderBatchInterval)
+            {
+                // Контрольную сумму записи проверяем здесь, в рабочем потоке,
+                // а не при открытии: так открытие не читает весь файл.
+                // Записи, найденные salvage(), уже проверены
+                if (!mSalvage)
+                {
+                    mFile->verify(static_cast<NotebookFile::SizeType>(last), static_cast<NotebookFile::SizeType>(last + 1));
+                }
+                batch.push_back(mFile->note(static_cast<NotebookFile::SizeType>(last)));
+                ++last;
+            }
+            bytesRead = mCount > 0 ? static_cast<qint64>(mBytesTotal * static_cast<double>(last) / mCount) : 0;
+        }
+        else
+        {
+            // Каждая порция файла версии 1 декодируется параллельно. Тексты
+            // сжимаются здесь, в рабочих потоках, а не в потоке интерфейса
+            last = std::min(mNext + static_cast<std::size_t>(Config::loaderBatchSize), mCount);
+            batch = mDecoder->decode(mNext, last, mCompressTexts);
+            bytesRead = mDecoder->offset(last);
+        }
+        mNext = last;
+        mDone = mNext >= mCount;
+        if (mDone)
+        {
+            bytesRead = mBytesTotal;
+        }
+        post(batch, bytesRead);
+    }
+    catch (const std::exception &e)
+    {
+        return QString::fromUtf8(e.what());
+    }
+    return QString();
+}
+
+void NotebookLoader::open()
+{
+    std::unique_ptr<QFile> inf(new QFile(mFileName));
+    if (!inf->open(QIODevice::ReadOnly))
+    {
+        throw std::runtime_error((tr("open(): ") + inf->errorString()).toStdString());
+    }
+    if (NotebookFile::isVersion2(inf.get()))
+    {
+        // Файл версии 2 отображается в память
+        inf->close();
+        mFile = mSalvage ? NotebookFile::salvage(mFileName, mSalvageReport) : NotebookFile::open(mFileName);
+        mCount = static_cast<std::size_t>(mFile->size());
+    }
+    else
+    {
+        // Границы записей файла версии 1 находятся по размерам строк;
+        // декодер читает отображение файла, поэтому файл остаётся открытым
+        mDecoder.reset(new NoteDecoder(inf.get()));
+        mInput = std::move(inf);
+        mCount = mDecoder->size();
+    }
+}
+
+void NotebookLoader::post(std::vector<Note> &batch, qint64 bytesRead)
+{
+    QMutexLocker lock(&mMutex);
+    if (!batch.empty())
+    {
+        mReady.push_back(std::move(batch));
+    }
+    mBytesRead = bytesRead;
+}
+
+void NotebookLoader::deliver()
+{
+    TRACE_SCOPE("NotebookLoader::deliver");
+    std::vector<std::vector<Note>> ready;
+    qint64 bytesRead;
+    {
+        QMutexLocker lock(&mMutex);
+        ready.swap(mReady);
+        bytesRead = mBytesRead;
+    }
+    if (!mNotebook || ready.empty())
+    {
+        return;
+    }
+    // Объединяем накопившиеся порции, чтобы виды получили одно уведомление
+    std::vector<Note> &notes = ready.front();
+    for (std::size_t i = 1; i < ready.size(); ++i)
+    {
+        notes.insert(notes.end(), std::make_move_iterator(ready[i].begin()),
+                     std::make_move_iterator(ready[i].end()));
+    }
+    mNotebook->append(std::move(notes));
+    emit progress(bytesRead, mBytesTotal);
+}
+
+void NotebookLoader::sliceFinished()
+{
+    // Загрузка уже завершена методом cancel()
+    if (!mRunning)
+    {
+        return;
+    }
+    QString error = mWatcher.result();
+    if (mCancel || mDone || !error.isEmpty())
+    {
+        finish(error);
+        return;
+    }
+    // Следующая порция читается, пока поток интерфейса передаёт текущую
+    // записной книжке
+    startSlice();
+    deliver();
+}
+
+void NotebookLoader::finish(const QString &error)
+{
+    mRunning = false;
+    mFile.reset();
+    mDecoder.reset();
+    mInput.reset();
+    if (mCancel || !error.isEmpty())
+    {
+        {
+            QMutexLocker lock(&mMutex);
+            mReady.clear();
+        }
+        mNotebook = nullptr;
+        if (mCancel)
+        {
+            emit canceled(mFileName);
+        }
+        else
+        {
+            emit failed(mFileName, error);
+        }
+        return;
+    }
+    // Передаём записной книжке последние порции
+    deliver();
+    mNotebook = nullptr;
+    emit finished(mFileName);
+}
@@ -0,0 +1,152 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookLoader.
+ */
+#ifndef NOTEBOOKLOADER_HPP
+#define NOTEBOOKLOADER_HPP
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <memory> // shared_ptr, unique_ptr
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+#include "note.hpp"
+#include "notebookfile.hpp"
+
+class Notebook;
+class NoteDecoder;
+class QFile;
+
+/*!
+ * \brief Класс фоновой загрузки записной книжки.
+ *
+ * Загрузчик читает файл записной книжки в рабочем потоке и передаёт
+ * прочитанные заметки записной книжке порциями через Notebook::append().
+ * Благодаря этому таблица заметок заполняется по мере чтения файла, а окно
+ * не замирает. Ход загрузки сообщается сигналом progress() в байтах,
+ * прочитанных из файла. Загрузку можно прервать методом cancel().
+ *
+ * Рабочий поток не обращается к записной книжке: он только создаёт
+ * объекты Note и складывает их в очередь, которую разбирает поток объекта
+ * NotebookLoader.
+ *
+ * Загрузка делится на части: каждая часть читает одну порцию заметок и
+ * выполняется отдельной задачей общего пула WorkerPool от имени
+ * записной книжки, а следующая часть ставится в очередь, когда завершится
+ * предыдущая. Поэтому несколько записных книжек загружаются одновременно,
+ * и большая записная книжка не задерживает загрузку маленькой.
+ *
+ * Контрольные суммы записей файла версии 3 проверяются в той же части,
+ * что создаёт их заметки (см. NotebookFile::verify()), поэтому первые
+ * заметки появляются до того, как прочитан весь файл. Повреждённая запись
+ * прерывает загрузку сигналом failed().
+ */
+class NotebookLoader : public QObject
+{
+    Q_OBJECT
+public:
+    //! Конструктор с необязательным указанием родительского объекта \a parent.
+    explicit NotebookLoader(QObject *parent = nullptr);
+    //! Деструктор. Прерывает загрузку, если она выполняется.
+    ~NotebookLoader();
+
+    /*!
+     * \brief Начинает загрузку файла \a fileName в пустую записную книжку \a notebook.
+     *
+     * Записная книжка должна существовать до завершения загрузки или до
+     * вызова cancel(). Если \a salvage равен \c true, повреждённые записи
+     * файла версии 3 пропускаются (см. NotebookFile::salvage()), а отчёт
+     * о пропущенном после завершения загрузки возвращает salvageReport().
+     */
+    void load(const QString &fileName, Notebook *notebook, bool salvage = false);
+    //! Возвращает \c true, если выполняется загрузка.
+    bool isRunning() const;
+    //! Возвращает отчёт о восстановлении файла последней завершённой загрузкой с пропуском повреждённых записей.
+    NotebookFile::SalvageReport salvageReport() const;
+
+public slots:
+    /*!
+     * \brief Прерывает загрузку.
+     *
+     * Дожидается остановки рабочего потока и отправляет сигнал canceled().
+     * Заметки, ещё не переданные записной книжке, отбрасываются.
+     */
+    void cancel();
+
+signals:
+    //! Сигнализирует, что из файла прочитано \a bytesRead байт из \a bytesTotal.
+    void progress(qint64 bytesRead, qint64 bytesTotal);
+    //! Сигнализирует, что файл \a fileName полностью загружен.
+    void finished(QString fileName);
+    //! Сигнализирует, что загрузка файла \a fileName прервана ошибкой \a message.
+    void failed(QString fileName, QString message);
+    //! Сигнализирует, что загрузка файла \a fileName прервана методом cancel().
+    void canceled(QString fileName);
+
+private:
+    //! Ставит в очередь пула следующую часть загрузки.
+    void startSlice();
+    /*!
+     * \brief Читает следующую порцию заметок. Выполняется в рабочем потоке.
+     *
+     * Первая часть загрузки открывает файл. Возвращает сообщение об ошибке
+     * или пустую строку.
+     */
+    QString runSlice();
+    //! Открывает файл и находит его записи. Вызывается из рабочего потока.
+    void open();
+    //! Передаёт порцию \a batch в очередь готовых заметок. Вызывается из рабочего потока.
+    void post(std::vector<Note> &batch, qint64 bytesRead);
+    //! Передаёт готовые заметки записной книжке.
+    void deliver();
+    //! Обрабатывает завершение части загрузки.
+    void sliceFinished();
+    //! Завершает загрузку с сообщением об ошибке \a error или пустой строкой.
+    void finish(const QString &error);
+
+    //! Имя загружаемого файла.
+    QString mFileName;
+    //! Заполняемая записная книжка.
+    Notebook *mNotebook;
+    //! Признак сжатия текстов загружаемых заметок (см. Notebook::textCompression()).
+    bool mCompressTexts;
+    //! Признак загрузки с пропуском повреждённых записей.
+    bool mSalvage;
+    //! Отчёт о восстановлении файла. Заполняется рабочим потоком.
+    NotebookFile::SalvageReport mSalvageReport;
+    //! Признак того, что выполняется загрузка.
+    bool mRunning;
+    //! Признак запроса на прерывание загрузки.
+    std::atomic<bool> mCancel;
+    //! Открытый файл версии 2 или 3.
+    std::shared_ptr<NotebookFile> mFile;
+    //! Открытый файл версии 1.
+    std::unique_ptr<QFile> mInput;
+    //! Границы записей файла версии 1.
+    std::unique_ptr<NoteDecoder> mDecoder;
+    //! Признак того, что файл открыт.
+    bool mOpened;
+    //! Признак того, что прочитаны все записи.
+    bool mDone;
+    //! Номер следующей читаемой записи.
+    std::size_t mNext;
+    //! Количество записей в файле.
+    std::size_t mCount;
+    //! Мьютекс, защищающий mReady и mBytesRead.
+    QMutex mMutex;
+    //! Порции заметок, прочитанные, но ещё не переданные записной книжке.
+    std::vector<std::vector<Note>> mReady;
+    //! Количество прочитанных байт на момент последней порции.
+    qint64 mBytesRead;
+    //! Размер файла в байтах.
+    qint64 mBytesTotal;
+    //! Наблюдатель за текущей частью загрузки. Результат — сообщение об ошибке или пустая строка.
+    QFutureWatcher<QString> mWatcher;
+};
+
+#endif // NOTEBOOKLOADER_HPP
@@ -0,0 +1,127 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookSaver.
+ */
+#include "notebooksaver.hpp"
+
+#include <exception>
+#include <utility> // move()
+
+#include <QEventLoop>
+
+#include "notebookfile.hpp"
+#include "workerpool.hpp"
+
+NotebookSaver::NotebookSaver(QObject *parent)
+    : QObject(parent)
+    , mCurrent{ 0, QString(), nullptr, false }
+    , mRunning(false)
+    , mLastId(0)
+{
+    connect(&mWatcher, &QFutureWatcher<QString>::finished, this, &NotebookSaver::finishCurrent);
+}
+
+NotebookSaver::~NotebookSaver()
+{
+    // Рабочий поток обращается к объекту (отправляет сигнал progress()),
+    // поэтому объект нельзя уничтожать, пока задание выполняется
+    mWatcher.waitForFinished();
+}
+
+NotebookSaver::JobId NotebookSaver::save(const QString &fileName, std::vector<Note> notes, bool compress)
+{
+    Job job{ ++mLastId, fileName,
+             std::shared_ptr<const std::vector<Note>>(new std::vector<Note>(std::move(notes))), compress };
+    // Ожидающее задание для того же файла заменяем новым
+    for (Job &queued : mQueue)
+    {
+        if (queued.fileName == fileName)
+        {
+            JobId old = queued.id;
+            queued = job;
+            emit superseded(old);
+            return job.id;
+        }
+    }
+    mQueue.push_back(job);
+    startNext();
+    return job.id;
+}
+
+bool NotebookSaver::isBusy() const
+{
+    return mRunning || !mQueue.empty();
+}
+
+void NotebookSaver::waitForFinished()
+{
+    if (!isBusy())
+    {
+        return;
+    }
+    // Запускаем локальный цикл обработки событий, который завершится по
+    // сигналу finished(). Ввод пользователя в это время не обрабатывается
+    QEventLoop loop;
+    connect(this, &NotebookSaver::finished, &loop, &QEventLoop::quit);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+}
+
+void NotebookSaver::startNext()
+{
+    if (mRunning || mQueue.empty())
+    {
+        return;
+    }
+    mCurrent = mQueue.front();
+    mQueue.pop_front();
+    mRunning = true;
+    emit started(mCurrent.id, mCurrent.fileName);
+
+    Job job = mCurrent;
+    NotebookSaver *self = this;
+    mWatcher.setFuture(WorkerPool::instance().run<QString>(this, [job, self]() -> QString {
+        qint64 total = static_cast<qint64>(job.notes->size());
+        qint64 reported = 0;
+        try
+        {
+            NotebookFile::save(job.fileName, *job.notes, [&](std::size_t done) {
+                // Сообщаем о ходе сохранения не чаще, чем на каждый процент,
+                // чтобы не перегружать очередь событий
+                qint64 d = static_cast<qint64>(done);
+                if (d == total || (d - reported) * 100 >= total)
+                {
+                    reported = d;
+                    // Сигнал отправляется из рабочего потока, поэтому
+                    // получатели в потоке интерфейса получат его через очередь
+                    emit self->progress(job.id, d, total);
+                }
+            }, job.compress);
+        }
+        catch (const std::exception &e)
+        {
+            return QString::fromUtf8(e.what());
+        }
+        return QString();
+    }));
+}
+
+void NotebookSaver::finishCurrent()
+{
+    Job job = mCurrent;
+    QString error = mWatcher.result();
+    mCurrent = Job{ 0, QString(), nullptr, false };
+    mRunning = false;
+    if (error.isEmpty())
+    {
+        emit saved(job.id, job.fileName);
+    }
+    else
+    {
+        emit failed(job.id, job.fileName, error);
+    }
+    startNext();
+    if (!isBusy())
+    {
+        emit finished();
+    }
+}
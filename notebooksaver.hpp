@@ -0,0 +1,106 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookSaver.
+ */
+#ifndef NOTEBOOKSAVER_HPP
+#define NOTEBOOKSAVER_HPP
+
+#include <deque>
+#include <memory> // shared_ptr
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+
+#include "note.hpp"
+
+/*!
+ * \brief Класс фонового сохранения записных книжек.
+ *
+ * Сохранение записной книжки занимает время, пропорциональное её размеру,
+ * и, выполняясь в потоке графического интерфейса, замораживает окно.
+ * NotebookSaver принимает снимок заметок (см. Notebook::snapshot()) и
+ * записывает его в файл в рабочем потоке. Результат сообщается сигналами
+ * saved() и failed(), которые отправляются в потоке объекта NotebookSaver
+ * только после того, как QSaveFile::commit() завершился.
+ *
+ * Задания выполняются по одному в порядке поступления, поэтому записи
+ * в один и тот же файл не пересекаются. Если в очереди уже ждёт задание для
+ * того же файла, новое задание заменяет его: более позднее сохранение
+ * содержит все изменения более раннего.
+ */
+class NotebookSaver : public QObject
+{
+    Q_OBJECT
+public:
+    //! Тип идентификатора задания.
+    using JobId = quint64;
+
+    //! Конструктор с необязательным указанием родительского объекта \a parent.
+    explicit NotebookSaver(QObject *parent = nullptr);
+    //! Деструктор. Дожидается завершения выполняющегося задания.
+    ~NotebookSaver();
+
+    /*!
+     * \brief Ставит в очередь сохранение заметок \a notes в файл \a fileName.
+     * \param compress Сжимать ли тексты заметок (см. NotebookFile::write()).
+     * \return Идентификатор задания, который передаётся в сигналах.
+     */
+    JobId save(const QString &fileName, std::vector<Note> notes, bool compress = false);
+    //! Возвращает \c true, если выполняется или ожидает выполнения хотя бы одно задание.
+    bool isBusy() const;
+    /*!
+     * \brief Дожидается выполнения всех заданий.
+     *
+     * Во время ожидания обрабатываются события (кроме ввода пользователя),
+     * поэтому сигналы о завершении заданий доставляются и окно перерисовывается.
+     */
+    void waitForFinished();
+
+signals:
+    //! Сигнализирует, что началось выполнение задания \a job сохранения в файл \a fileName.
+    void started(quint64 job, QString fileName);
+    //! Сигнализирует, что в задании \a job записано \a done заметок из \a total.
+    void progress(quint64 job, qint64 done, qint64 total);
+    //! Сигнализирует, что задание \a job успешно сохранило файл \a fileName.
+    void saved(quint64 job, QString fileName);
+    //! Сигнализирует, что задание \a job не смогло сохранить файл \a fileName из-за ошибки \a message.
+    void failed(quint64 job, QString fileName, QString message);
+    //! Сигнализирует, что ожидавшее задание \a job заменено более поздним и выполнено не будет.
+    void superseded(quint64 job);
+    //! Сигнализирует, что все задания выполнены.
+    void finished();
+
+private:
+    //! Задание сохранения.
+    struct Job
+    {
+        //! Идентификатор задания.
+        JobId id;
+        //! Имя файла.
+        QString fileName;
+        //! Снимок заметок. Разделяется с рабочим потоком.
+        std::shared_ptr<const std::vector<Note>> notes;
+        //! Сжимать ли тексты заметок.
+        bool compress;
+    };
+
+    //! Запускает следующее задание из очереди, если ни одно не выполняется.
+    void startNext();
+    //! Обрабатывает завершение выполнявшегося задания.
+    void finishCurrent();
+
+    //! Очередь ожидающих заданий.
+    std::deque<Job> mQueue;
+    //! Выполняющееся задание.
+    Job mCurrent;
+    //! Признак того, что задание выполняется.
+    bool mRunning;
+    //! Идентификатор последнего созданного задания.
+    JobId mLastId;
+    //! Наблюдатель за выполнением задания. Результат — сообщение об ошибке или пустая строка.
+    QFutureWatcher<QString> mWatcher;
+};
+
+#endif // NOTEBOOKSAVER_HPP
@@ -0,0 +1,390 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotebookTool.
+ */
+#include "notebooktool.hpp"
+
+#include <algorithm> // min()
+#include <atomic>
+#include <limits> // numeric_limits
+#include <stdexcept> // runtime_error
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QList>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "notebookbench.hpp"
+#include "notedecoder.hpp"
+#include "noteexporter.hpp"
+#include "notegenerator.hpp"
+#include "noteimporter.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+//! Наибольшее количество заметок в одной части работы команд просмотра.
+const quint32 partSize = 16384;
+//! Количество заметок файла версии 1, декодируемых за раз.
+const std::size_t version1BatchSize = 65536;
+
+//! Результат обработки части работы.
+struct PartResult
+{
+    //! Вывод части.
+    QString output;
+    //! Сообщение об ошибке или пустая строка.
+    QString error;
+};
+
+//! Возвращает строку \a s, в которой переводы строк заменены пробелами.
+QString oneLine(QString s)
+{
+    s.replace(QLatin1Char('\n'), QLatin1Char(' '));
+    s.replace(QLatin1Char('\r'), QLatin1Char(' '));
+    return s;
+}
+
+//! Открывает файл \a file для чтения. В случае ошибки запускает исключительную ситуацию.
+void openForReading(QFile &file)
+{
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        throw std::runtime_error(NotebookTool::tr("Unable to open %1: %2")
+                                 .arg(file.fileName(), file.errorString()).toStdString());
+    }
+}
+
+}
+
+NotebookTool::NotebookTool(QTextStream &out)
+    : mOut(out)
+{
+}
+
+void NotebookTool::list(const QStringList &files)
+{
+    run(split(files, partSize), [](const Part &part) {
+        QString out;
+        forEachNote(part, [&out, &part](quint32 row, const Note &note) {
+            out += part.fileName + QLatin1Char(':') + QString::number(row) + QLatin1Char(':')
+                    + oneLine(note.title()) + QLatin1Char('\n');
+        });
+        return out;
+    });
+}
+
+void NotebookTool::grep(const QString &pattern, NoteScanner::Mode mode, const QStringList &files)
+{
+    QRegularExpression re;
+    if (mode == NoteScanner::RegExp)
+    {
+        re.setPattern(pattern);
+        if (!re.isValid())
+        {
+            throw std::runtime_error(tr("Invalid regular expression: %1").arg(re.errorString()).toStdString());
+        }
+        // Компилируем выражение сразу, а не в первом рабочем потоке
+        re.optimize();
+    }
+    Qt::CaseSensitivity cs = mode == NoteScanner::CaseInsensitive ? Qt::CaseInsensitive : Qt::CaseSensitive;
+    auto matches = [&](const QString &s) {
+        return mode == NoteScanner::RegExp ? re.match(s).hasMatch()
+                                           : NoteScanner::indexOf(s, pattern, 0, cs) >= 0;
+    };
+    run(split(files, partSize), [&matches](const Part &part) {
+        QString out;
+        forEachNote(part, [&](quint32 row, const Note &note) {
+            QString title = note.title();
+            if (matches(title) || matches(note.text()))
+            {
+                out += part.fileName + QLatin1Char(':') + QString::number(row) + QLatin1Char(':')
+                        + oneLine(title) + QLatin1Char('\n');
+            }
+        });
+        return out;
+    });
+}
+
+void NotebookTool::count(const QStringList &files)
+{
+    std::atomic<quint64> total(0);
+    // Каждый файл — одна часть: количество записей файла версии 2 известно
+    // из таблицы смещений, и читать заметки не нужно
+    run(split(files, std::numeric_limits<quint32>::max()), [&total](const Part &part) {
+        quint64 n = 0;
+        if (part.file)
+        {
+            n = part.file->size();
+        }
+        else
+        {
+            forEachNote(part, [&n](quint32, const Note &) { ++n; });
+        }
+        total += n;
+        return part.fileName + QLatin1Char(':') + QString::number(n) + QLatin1Char('\n');
+    });
+    if (files.size() > 1)
+    {
+        mOut << "total:" << total.load() << '\n';
+    }
+}
+
+void NotebookTool::exportText(const QString &fileName, const QString &textFileName)
+{
+    TRACE_SCOPE("NotebookTool::exportText");
+    NoteExporter::write(textFileName, readNotes(fileName), NoteExporter::formatForFileName(textFileName));
+}
+
+void NotebookTool::importText(const QString &textFileName, const QString &fileName, bool compress)
+{
+    TRACE_SCOPE("NotebookTool::importText");
+    NotebookFile::save(fileName, NoteImporter::read(textFileName), NotebookFile::ProgressFunction(), compress);
+}
+
+/*!
+ * Заметки файлов версии 2 ленивые, поэтому тексты читаются из исходных
+ * файлов только во время записи.
+ */
+void NotebookTool::merge(const QStringList &files, const QString &fileName, bool compress)
+{
+    std::vector<Note> notes;
+    for (const QString &input : files)
+    {
+        std::vector<Note> part = readNotes(input);
+        notes.insert(notes.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }
+    NotebookFile::save(fileName, notes, NotebookFile::ProgressFunction(), compress);
+}
+
+void NotebookTool::compact(const QStringList &files, bool compress)
+{
+    std::function<QString(const QString &)> job = [compress](const QString &fileName) {
+        try
+        {
+            // Файл сохраняется через QSaveFile, поэтому ленивые заметки
+            // читают прежнее содержимое до самой замены файла
+            NotebookFile::save(fileName, readNotes(fileName), NotebookFile::ProgressFunction(), compress);
+        }
+        catch (const std::exception &e)
+        {
+            return tr("%1: %2").arg(fileName, QString::fromUtf8(e.what()));
+        }
+        return QString();
+    };
+    QStringList errors = QtConcurrent::blockingMapped<QStringList>(files, job);
+    errors.removeAll(QString());
+    if (!errors.isEmpty())
+    {
+        throw std::runtime_error(errors.join(QLatin1Char('\n')).toStdString());
+    }
+}
+
+void NotebookTool::verify(const QStringList &files)
+{
+    TRACE_SCOPE("NotebookTool::verify");
+    int damaged = 0;
+    for (const QString &fileName : files)
+    {
+        try
+        {
+            std::size_t count = readNotes(fileName).size();
+            mOut << fileName << ": " << tr("OK, %n note(s)", nullptr, static_cast<int>(count)) << '\n';
+        }
+        catch (const std::exception &e)
+        {
+            mOut << fileName << ": " << QString::fromUtf8(e.what()) << '\n';
+            ++damaged;
+        }
+    }
+    if (damaged > 0)
+    {
+        throw std::runtime_error(tr("%n file(s) damaged", nullptr, damaged).toStdString());
+    }
+}
+
+void NotebookTool::salvage(const QString &fileName, const QString &outputFileName, bool compress)
+{
+    TRACE_SCOPE("NotebookTool::salvage");
+    NotebookFile::SalvageReport report;
+    std::shared_ptr<NotebookFile> file = NotebookFile::salvage(fileName, report);
+    std::vector<Note> notes;
+    notes.reserve(file->size());
+    for (NotebookFile::SizeType i = 0; i < file->size(); ++i)
+    {
+        notes.push_back(file->note(i));
+    }
+    NotebookFile::save(outputFileName, notes, NotebookFile::ProgressFunction(), compress);
+    mOut << NotebookFile::describe(report) << '\n';
+}
+
+void NotebookTool::generate(quint32 count, const QString &fileName, quint64 seed, bool compress)
+{
+    auto generator = std::make_shared<const NoteGenerator>(seed);
+    NotebookFile::save(fileName, NoteGenerator::lazyNotes(generator, 0, count),
+                       NotebookFile::ProgressFunction(), compress);
+}
+
+void NotebookTool::bench(quint32 notes, quint64 seed, const QString &storage, int repeat,
+                         const QString &jsonFileName, const QString &baselineFileName)
+{
+    std::map<QString, double> baseline;
+    if (!baselineFileName.isEmpty())
+    {
+        baseline = NotebookBench::readTimes(baselineFileName);
+    }
+    NotebookBench bench(notes, seed, storage, repeat);
+    std::vector<NotebookBench::Result> results = bench.run([this, &baseline](const NotebookBench::Result &r) {
+        mOut << QStringLiteral("%1 %2 notes %3 s %4 notes/s")
+                .arg(r.name, -14).arg(r.notes, 10).arg(r.seconds, 10, 'f', 4)
+                .arg(r.seconds > 0 ? r.notes / r.seconds : 0.0, 12, 'f', 0);
+        if (r.bytes > 0)
+        {
+            mOut << QStringLiteral(" %1 MB/s").arg(r.bytes / r.seconds / 1e6, 9, 'f', 1);
+        }
+        if (r.peakRss >= 0)
+        {
+            mOut << QStringLiteral(" peak %1 KiB, +%2 KiB").arg(r.peakRss).arg(std::max<qint64>(r.rssGrowth, 0));
+        }
+        auto base = baseline.find(r.name);
+        if (base != baseline.end() && base->second > 0)
+        {
+            mOut << QStringLiteral(" x%1").arg(r.seconds / base->second, 0, 'f', 2);
+        }
+        mOut << '\n';
+        mOut.flush();
+    });
+    if (jsonFileName.isEmpty())
+    {
+        return;
+    }
+    QSaveFile outf(jsonFileName);
+    if (!outf.open(QIODevice::WriteOnly))
+    {
+        throw std::runtime_error(tr("Unable to open %1: %2").arg(jsonFileName, outf.errorString()).toStdString());
+    }
+    outf.write(QJsonDocument(bench.toJson(results)).toJson());
+    if (!outf.commit())
+    {
+        throw std::runtime_error(tr("Unable to commit the save").toStdString());
+    }
+}
+
+std::vector<Note> NotebookTool::readNotes(const QString &fileName)
+{
+    TRACE_SCOPE("NotebookTool::readNotes");
+    QFile inf(fileName);
+    openForReading(inf);
+    std::vector<Note> notes;
+    if (NotebookFile::isVersion2(&inf))
+    {
+        inf.close();
+        std::shared_ptr<NotebookFile> file = NotebookFile::open(fileName);
+        file->verify();
+        notes.reserve(file->size());
+        for (NotebookFile::SizeType i = 0; i < file->size(); ++i)
+        {
+            notes.push_back(file->note(i));
+        }
+        return notes;
+    }
+    return NoteDecoder::readAll(&inf);
+}
+
+std::vector<NotebookTool::Part> NotebookTool::split(const QStringList &files, quint32 partSize)
+{
+    std::vector<Part> parts;
+    for (const QString &fileName : files)
+    {
+        QFile inf(fileName);
+        openForReading(inf);
+        if (!NotebookFile::isVersion2(&inf))
+        {
+            // Файл версии 1 можно читать только с начала, он обрабатывается целиком
+            parts.push_back(Part{ fileName, nullptr, 0, 0 });
+            continue;
+        }
+        inf.close();
+        std::shared_ptr<NotebookFile> file = NotebookFile::open(fileName);
+        file->verify();
+        // Пустой файл тоже даёт часть, чтобы команда count() вывела его
+        quint64 first = 0;
+        do
+        {
+            quint64 last = std::min<quint64>(first + partSize, file->size());
+            parts.push_back(Part{ fileName, file, static_cast<quint32>(first), static_cast<quint32>(last) });
+            first = last;
+        } while (first < file->size());
+    }
+    return parts;
+}
+
+void NotebookTool::forEachNote(const Part &part, const NoteFunction &f)
+{
+    if (part.file)
+    {
+        for (quint32 i = part.first; i < part.last; ++i)
+        {
+            f(i, part.file->note(i));
+        }
+        return;
+    }
+    QFile inf(part.fileName);
+    openForReading(inf);
+    // Файл версии 1 декодируется порциями, чтобы не держать в памяти все
+    // его заметки сразу
+    NoteDecoder decoder(&inf);
+    for (std::size_t first = 0; first < decoder.size(); first += version1BatchSize)
+    {
+        std::size_t last = std::min(first + version1BatchSize, decoder.size());
+        std::vector<Note> notes = decoder.decode(first, last);
+        for (std::size_t i = first; i < last; ++i)
+        {
+            f(static_cast<quint32>(i), notes[i - first]);
+        }
+    }
+}
+
+/*!
+ * Части обрабатываются окнами по несколько частей на поток. Внутри окна
+ * части выполняются параллельно, blockingMapped() возвращает их результаты
+ * в исходном порядке, и они выводятся, прежде чем начнётся следующее окно.
+ * Исключения рабочих потоков перехватываются и запускаются заново здесь,
+ * в вызывающем потоке.
+ */
+void NotebookTool::run(const std::vector<Part> &parts, const PartFunction &job)
+{
+    std::function<PartResult(const Part &)> guarded = [&job](const Part &part) {
+        TRACE_SCOPE("NotebookTool::run part");
+        PartResult result;
+        try
+        {
+            result.output = job(part);
+        }
+        catch (const std::exception &e)
+        {
+            result.error = tr("%1: %2").arg(part.fileName, QString::fromUtf8(e.what()));
+        }
+        return result;
+    };
+    std::size_t window = static_cast<std::size_t>(QThreadPool::globalInstance()->maxThreadCount()) * 4;
+    for (std::size_t first = 0; first < parts.size(); first += window)
+    {
+        std::vector<Part> slice(std::next(parts.begin(), first),
+                                std::next(parts.begin(), std::min(first + window, parts.size())));
+        QList<PartResult> results = QtConcurrent::blockingMapped<QList<PartResult>>(slice, guarded);
+        for (const PartResult &result : results)
+        {
+            if (!result.error.isEmpty())
+            {
+                throw std::runtime_error(result.error.toStdString());
+            }
+            mOut << result.output;
+        }
+        mOut.flush();
+    }
+}
@@ -0,0 +1,155 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotebookTool.
+ */
+#ifndef NOTEBOOKTOOL_HPP
+#define NOTEBOOKTOOL_HPP
+
+#include <functional> // function
+#include <memory> // shared_ptr
+#include <vector>
+
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+#include "note.hpp"
+#include "notebookfile.hpp"
+#include "notescanner.hpp"
+
+/*!
+ * \brief Класс команд консольной программы toynote-cli.
+ *
+ * Каждая команда обрабатывает файлы записных книжек без загрузки их
+ * в Notebook и без графического интерфейса. Файлы версии 2 отображаются
+ * в память, и заметки читаются из них по требованию (см. NotebookFile),
+ * файлы версии 1 читаются последовательно, заметка за заметкой.
+ *
+ * Команды просмотра (list(), grep(), count()) делят работу на \e части:
+ * файл версии 2 — на диапазоны записей, файл версии 1 — целиком. Части
+ * обрабатываются параллельно в пуле потоков QtConcurrent окнами
+ * ограниченного размера, а результаты выводятся в порядке частей, как
+ * только готово окно. Так вывод начинается сразу, память не растёт с
+ * размером файлов, а все ядра заняты и при одном большом файле, и при
+ * тысячах маленьких.
+ *
+ * В случае ошибки методы запускают исключительную ситуацию.
+ */
+class NotebookTool
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NotebookTool)
+public:
+    /*!
+     * \brief Конструктор.
+     * \param out Поток, в который команды выводят результаты.
+     */
+    explicit NotebookTool(QTextStream &out);
+
+    //! Выводит заголовки заметок файлов \a files строками вида "файл:строка:заголовок".
+    void list(const QStringList &files);
+    /*!
+     * \brief Выводит заметки файлов \a files, заголовок или текст которых содержит \a pattern.
+     *
+     * Строки вывода имеют вид "файл:строка:заголовок". Режим \a mode имеет
+     * тот же смысл, что и для NoteScanner::scan().
+     */
+    void grep(const QString &pattern, NoteScanner::Mode mode, const QStringList &files);
+    //! Выводит количество заметок в каждом из файлов \a files и, если файлов несколько, их сумму.
+    void count(const QStringList &files);
+    /*!
+     * \brief Записывает заметки файла \a fileName в текстовый файл \a textFileName.
+     *
+     * Формат определяется расширением \a textFileName: Markdown для .md,
+     * JSON Lines для .jsonl, иначе формат команды главного окна «Save As
+     * Text» (см. NoteExporter).
+     */
+    static void exportText(const QString &fileName, const QString &textFileName);
+    /*!
+     * \brief Читает заметки из текстового файла \a textFileName и сохраняет их в файл \a fileName.
+     *
+     * Формат определяется расширением \a textFileName так же, как в
+     * exportText() (см. NoteImporter).
+     */
+    void importText(const QString &textFileName, const QString &fileName, bool compress);
+    //! Сохраняет заметки файлов \a files по порядку в один файл \a fileName.
+    void merge(const QStringList &files, const QString &fileName, bool compress);
+    /*!
+     * \brief Перезаписывает каждый из файлов \a files в текущем формате (версии 3).
+     *
+     * Файлы обрабатываются параллельно. Если \a compress равен \c true,
+     * тексты заметок сжимаются (см. NoteCodec).
+     */
+    void compact(const QStringList &files, bool compress);
+    /*!
+     * \brief Проверяет каждый из файлов \a files и выводит результат.
+     *
+     * Проверяются структура файла и контрольные суммы записей файлов
+     * версии 3. Если хотя бы один файл повреждён, запускает
+     * исключительную ситуацию.
+     */
+    void verify(const QStringList &files);
+    /*!
+     * \brief Сохраняет неповреждённые заметки файла \a fileName в файл \a outputFileName.
+     *
+     * Выводит отчёт о пропущенных повреждённых областях (см.
+     * NotebookFile::salvage()).
+     */
+    void salvage(const QString &fileName, const QString &outputFileName, bool compress);
+    /*!
+     * \brief Сохраняет в файл \a fileName \a count синтетических заметок генератора с начальным значением \a seed.
+     *
+     * Одинаковые параметры всегда дают одинаковый файл (см. NoteGenerator).
+     * Заметки создаются по мере записи и не накапливаются в памяти.
+     */
+    void generate(quint32 count, const QString &fileName, quint64 seed, bool compress);
+    /*!
+     * \brief Измеряет производительность операций записной книжки (см. NotebookBench).
+     *
+     * Выводит результат каждой операции по мере готовности. Если задано имя
+     * \a baselineFileName, рядом выводится отношение времени к времени той же
+     * операции в сохранённых ранее результатах. Если задано имя
+     * \a jsonFileName, результаты сохраняются в этот файл в формате JSON.
+     */
+    void bench(quint32 notes, quint64 seed, const QString &storage, int repeat,
+               const QString &jsonFileName, const QString &baselineFileName);
+
+    /*!
+     * \brief Возвращает заметки файла \a fileName.
+     *
+     * Заметки файла версии 2 ленивые и не держат тексты в памяти.
+     */
+    static std::vector<Note> readNotes(const QString &fileName);
+
+private:
+    //! Часть работы: записи с first по last - 1 одного файла.
+    struct Part
+    {
+        //! Имя файла.
+        QString fileName;
+        //! Файл версии 2 или пустой указатель для файла версии 1.
+        std::shared_ptr<NotebookFile> file;
+        //! Первая запись части.
+        quint32 first;
+        //! Запись, следующая за последней записью части (для файла версии 1 не используется).
+        quint32 last;
+    };
+    //! Тип функции, обрабатывающей часть и возвращающей её вывод.
+    using PartFunction = std::function<QString(const Part &)>;
+    //! Тип функции, которой передаются номер строки и заметка.
+    using NoteFunction = std::function<void(quint32, const Note &)>;
+
+    //! Делит файлы \a files на части размером не больше \a partSize заметок.
+    static std::vector<Part> split(const QStringList &files, quint32 partSize);
+    //! Вызывает \a f для каждой заметки части \a part по порядку.
+    static void forEachNote(const Part &part, const NoteFunction &f);
+    //! Обрабатывает части \a parts функцией \a job параллельно и выводит результаты по порядку.
+    void run(const std::vector<Part> &parts, const PartFunction &job);
+
+    //! Поток вывода.
+    QTextStream &mOut;
+};
+
+#endif // NOTEBOOKTOOL_HPP
@@ -0,0 +1,122 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteCodec.
+ */
+#include "notecodec.hpp"
+
+#include <atomic>
+
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QtEndian>
+
+#include "config.hpp"
+
+namespace
+{
+
+//! Наименьшая длина текста (в символах), который имеет смысл сжимать.
+const int minCompressedLength = 64;
+
+//! Ключ текста в кэше: ключ владельца и номер записи.
+using CacheKey = QPair<quint64, quint32>;
+
+//! Кэш распакованных текстов. Стоимость элемента — длина текста в символах.
+QCache<CacheKey, QString> &cache()
+{
+    // Статическая локальная переменная создаётся при первом обращении
+    static QCache<CacheKey, QString> instance(Config::decodedTextCacheSize);
+    return instance;
+}
+
+//! Мьютекс, защищающий кэш: QCache изменяет порядок элементов даже при чтении.
+QMutex &cacheMutex()
+{
+    static QMutex instance;
+    return instance;
+}
+
+}
+
+QByteArray NoteCodec::compress(const QString &text)
+{
+    if (text.size() < minCompressedLength)
+    {
+        return QByteArray();
+    }
+    int rawSize = text.size() * 2;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // Внутреннее представление QString уже имеет вид UTF-16LE
+    QByteArray packed = qCompress(reinterpret_cast<const uchar *>(text.utf16()), rawSize);
+#else
+    QByteArray raw(rawSize, Qt::Uninitialized);
+    for (int i = 0; i < text.size(); ++i)
+    {
+        qToLittleEndian<quint16>(text.at(i).unicode(), raw.data() + 2 * i);
+    }
+    QByteArray packed = qCompress(raw);
+#endif
+    // Если текст почти не сжимается, распаковывать его при каждом обращении незачем
+    if (packed.size() > rawSize / 8 * 7)
+    {
+        return QByteArray();
+    }
+    return packed;
+}
+
+QString NoteCodec::decompress(const char *data, int size)
+{
+    QByteArray raw = qUncompress(reinterpret_cast<const uchar *>(data), size);
+    int length = raw.size() / 2;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return QString(reinterpret_cast<const QChar *>(raw.constData()), length);
+#else
+    QString s(length, Qt::Uninitialized);
+    ushort *d = reinterpret_cast<ushort *>(s.data());
+    for (int i = 0; i < length; ++i)
+    {
+        d[i] = qFromLittleEndian<quint16>(raw.constData() + 2 * i);
+    }
+    return s;
+#endif
+}
+
+QString NoteCodec::decompressCached(quint64 owner, quint32 record, const char *data, int size)
+{
+    CacheKey key(owner, record);
+    {
+        QMutexLocker lock(&cacheMutex());
+        if (const QString *text = cache().object(key))
+        {
+            // Копия разделяет данные со строкой в кэше
+            return *text;
+        }
+    }
+    // Распаковываем без блокировки, чтобы потоки не ждали друг друга
+    QString text = decompress(data, size);
+    {
+        QMutexLocker lock(&cacheMutex());
+        // Слишком длинный текст QCache не примет и удалит сам
+        cache().insert(key, new QString(text), qMax(text.size(), 1));
+    }
+    return text;
+}
+
+int NoteCodec::decompressedLength(const char *data, int size)
+{
+    // qCompress() записывает перед данными zlib размер исходных данных
+    // в байтах (4 байта, big-endian)
+    if (size < 4)
+    {
+        return 0;
+    }
+    return static_cast<int>(qFromBigEndian<quint32>(data) / 2);
+}
+
+quint64 NoteCodec::newCacheKey()
+{
+    static std::atomic<quint64> next(1);
+    return next++;
+}
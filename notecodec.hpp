@@ -0,0 +1,58 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteCodec.
+ */
+#ifndef NOTECODEC_HPP
+#define NOTECODEC_HPP
+
+#include <QByteArray>
+#include <QString>
+
+/*!
+ * \brief Класс сжатия текстов заметок.
+ *
+ * Тексты сжимаются функцией qCompress() (zlib) из представления UTF-16LE,
+ * то есть того же, в котором несжатые тексты хранятся в файле записной
+ * книжки (см. NotebookFile). Сжатый текст распаковывается при каждом
+ * обращении к нему, поэтому последние распакованные тексты хранятся в общем
+ * для всей программы кэше, из которого давно не использовавшиеся тексты
+ * вытесняются первыми (LRU). Размер кэша задаётся Config::decodedTextCacheSize.
+ *
+ * Тексты в кэше принадлежат \e владельцам — источникам сжатых текстов
+ * (файлу записной книжки, сжатой заметке). Каждый владелец получает
+ * уникальный ключ методом newCacheKey(), ключи не используются повторно,
+ * поэтому тексты удалённых владельцев не нужно удалять из кэша: они будут
+ * вытеснены. Все методы можно вызывать из разных потоков одновременно.
+ */
+class NoteCodec
+{
+public:
+    /*!
+     * \brief Сжимает текст \a text.
+     * \return Сжатые данные или пустой массив, если текст слишком короткий
+     * или сжатие не даёт заметного выигрыша.
+     */
+    static QByteArray compress(const QString &text);
+    /*!
+     * \brief Распаковывает текст из \a size байт сжатых данных \a data.
+     * \return Текст или пустая строка, если данные повреждены.
+     */
+    static QString decompress(const char *data, int size);
+    /*!
+     * \brief Распаковывает текст записи \a record владельца \a owner, используя кэш.
+     *
+     * Если текст записи есть в кэше, данные \a data размером \a size байт
+     * не распаковываются.
+     */
+    static QString decompressCached(quint64 owner, quint32 record, const char *data, int size);
+    /*!
+     * \brief Возвращает длину текста в символах, сжатого в \a size байт данных \a data.
+     *
+     * Длина читается из заголовка данных qCompress(), текст не распаковывается.
+     */
+    static int decompressedLength(const char *data, int size);
+    //! Возвращает новый уникальный ключ владельца текстов в кэше.
+    static quint64 newCacheKey();
+};
+
+#endif // NOTECODEC_HPP
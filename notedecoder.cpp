@@ -0,0 +1,193 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteDecoder.
+ */
+#include "notedecoder.hpp"
+
+#include <algorithm> // min()
+#include <cstring> // memcpy()
+#include <stdexcept> // runtime_error
+#include <utility> // move()
+
+#include <QFile>
+#include <QIODevice>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtEndian>
+#include <QtGlobal> // QT_VERSION
+
+#include "trace.hpp"
+
+namespace
+{
+
+//! Количество записей, декодируемых одной задачей пула потоков.
+const std::size_t chunkSize = 4096;
+//! Размер нулевой строки QString в QDataStream.
+const quint32 nullString = 0xFFFFFFFF;
+
+//! Копирует \a length символов UTF-16BE из \a source в \a dest, приводя их к порядку байтов машины.
+void fromBigEndian(const uchar *source, int length, ushort *dest)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    std::memcpy(dest, source, static_cast<std::size_t>(length) * 2);
+#elif QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    // Qt переставляет байты массива векторными инструкциями (SSSE3, AVX2),
+    // если процессор их поддерживает
+    qFromBigEndian<quint16>(source, length, dest);
+#else
+    // Простой цикл без ветвлений компилятор векторизует сам
+    for (int i = 0; i < length; ++i)
+    {
+        dest[i] = static_cast<ushort>(source[2 * i] << 8 | source[2 * i + 1]);
+    }
+#endif
+}
+
+}
+
+NoteDecoder::NoteDecoder(QIODevice *device)
+    : mBase(nullptr)
+    , mSize(0)
+{
+    // qobject_cast() возвращает нулевой указатель, если устройство не является файлом
+    QFile *f = qobject_cast<QFile *>(device);
+    if (f && !f->fileName().isEmpty() && !f->isSequential() && f->size() > f->pos())
+    {
+        mSize = static_cast<quint64>(f->size() - f->pos());
+        mBase = f->map(f->pos(), static_cast<qint64>(mSize));
+    }
+    if (!mBase)
+    {
+        mData = device->readAll();
+        mBase = reinterpret_cast<const uchar *>(mData.constData());
+        mSize = static_cast<quint64>(mData.size());
+    }
+    scan();
+}
+
+std::vector<Note> NoteDecoder::readAll(QIODevice *device)
+{
+    NoteDecoder decoder(device);
+    return decoder.decode(0, decoder.size());
+}
+
+std::size_t NoteDecoder::size() const
+{
+    return mRecords.size();
+}
+
+qint64 NoteDecoder::offset(std::size_t record) const
+{
+    return static_cast<qint64>(record < mRecords.size() ? mRecords[record] : mSize);
+}
+
+/*!
+ * Каждая задача декодирует подряд до chunkSize записей: задачи по одной
+ * записи тратили бы больше времени на пул потоков, чем на декодирование.
+ */
+std::vector<Note> NoteDecoder::decode(std::size_t first, std::size_t last, bool compress) const
+{
+    TRACE_SCOPE("NoteDecoder::decode");
+    last = std::min(last, mRecords.size());
+    if (first >= last)
+    {
+        return std::vector<Note>();
+    }
+    std::vector<Note> notes(last - first);
+    std::vector<std::size_t> chunks;
+    for (std::size_t c = first; c < last; c += chunkSize)
+    {
+        chunks.push_back(c);
+    }
+    QtConcurrent::blockingMap(chunks, [this, &notes, first, last, compress](std::size_t c) {
+        TRACE_SCOPE("NoteDecoder chunk");
+        for (std::size_t i = c; i < std::min(c + chunkSize, last); ++i)
+        {
+            quint64 pos = mRecords[i];
+            QString title = string(pos);
+            QString text = string(pos);
+            Note &n = notes[i - first];
+            n = Note(std::move(title), std::move(text));
+            if (compress)
+            {
+                n.compressText();
+            }
+        }
+    });
+    return notes;
+}
+
+/*!
+ * Повторяет проверки QDataStream: нечётный размер строки означает
+ * повреждённые данные, а нехватка данных — конец файла.
+ */
+void NoteDecoder::scan()
+{
+    TRACE_SCOPE("NoteDecoder::scan");
+    quint64 pos = 0;
+    // Пропускает строку; возвращает false, если данные закончились
+    auto skip = [this, &pos]() {
+        if (mSize - pos < 4)
+        {
+            pos = mSize;
+            return false;
+        }
+        quint32 bytes = qFromBigEndian<quint32>(mBase + pos);
+        pos += 4;
+        if (bytes == nullString)
+        {
+            return true;
+        }
+        if (bytes % 2 != 0)
+        {
+            throw std::runtime_error(tr("Corrupt data were read from the stream").toStdString());
+        }
+        if (mSize - pos < bytes)
+        {
+            pos = mSize;
+            return false;
+        }
+        pos += bytes;
+        return true;
+    };
+    while (pos < mSize)
+    {
+        mRecords.push_back(pos);
+        if (!skip() || !skip())
+        {
+            break;
+        }
+    }
+}
+
+QString NoteDecoder::string(quint64 &pos) const
+{
+    if (mSize - pos < 4)
+    {
+        pos = mSize;
+        return QString();
+    }
+    quint32 bytes = qFromBigEndian<quint32>(mBase + pos);
+    pos += 4;
+    if (bytes == nullString)
+    {
+        return QString();
+    }
+    if (mSize - pos < bytes)
+    {
+        // Обрезанная строка, как и в QDataStream, становится пустой
+        pos = mSize;
+        return QString();
+    }
+    const uchar *p = mBase + pos;
+    pos += bytes;
+    if (bytes == 0)
+    {
+        // QDataStream отличает пустую строку от нулевой
+        return QString(QLatin1String(""));
+    }
+    int length = static_cast<int>(bytes / 2);
+    QString s(length, Qt::Uninitialized);
+    fromBigEndian(p, length, reinterpret_cast<ushort *>(s.data()));
+    return s;
+}
@@ -0,0 +1,81 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteDecoder.
+ */
+#ifndef NOTEDECODER_HPP
+#define NOTEDECODER_HPP
+
+#include <cstddef> // size_t
+#include <vector>
+
+#include <QByteArray>
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QString>
+
+#include "note.hpp"
+
+class QIODevice;
+
+/*!
+ * \brief Класс параллельного чтения файлов записной книжки формата версии 1.
+ *
+ * Файл версии 1 — последовательность заметок, записанных через QDataStream:
+ * для каждой заметки заголовок и текст, каждая строка — размер в байтах
+ * (4 байта big-endian, 0xFFFFFFFF для нулевой строки) и символы в UTF-16BE.
+ * Таблицы смещений в файле нет, но по размерам строк границы записей
+ * находятся, не декодируя сами строки. Поэтому чтение делится на два шага:
+ * конструктор последовательно проходит по размерам строк и запоминает
+ * смещения записей, а decode() декодирует записи параллельно в пуле потоков
+ * QtConcurrent, каждую прямо в свою ячейку заранее выделенного вектора.
+ *
+ * Результат совпадает с последовательным чтением через QDataStream, в том
+ * числе для файла, обрезанного на середине записи: недочитанные строки
+ * последней записи становятся пустыми.
+ */
+class NoteDecoder
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NoteDecoder)
+public:
+    /*!
+     * \brief Находит записи в данных устройства \a device от текущей позиции до конца.
+     *
+     * Файл отображается в память, данные других устройств считываются
+     * целиком. Файл должен оставаться открытым, пока существует объект.
+     * В случае ошибки запускает исключительную ситуацию.
+     */
+    explicit NoteDecoder(QIODevice *device);
+
+    //! Читает все заметки с текущей позиции устройства \a device. В случае ошибки запускает исключительную ситуацию.
+    static std::vector<Note> readAll(QIODevice *device);
+
+    //! Возвращает количество записей.
+    std::size_t size() const;
+    //! Возвращает смещение записи \a record от начала данных; для \a record, равного size(), — размер данных.
+    qint64 offset(std::size_t record) const;
+    /*!
+     * \brief Декодирует записи с \a first по \a last - 1.
+     *
+     * Если \a compress равен \c true, тексты заметок сжимаются
+     * (см. Note::compressText()) там же, в рабочих потоках.
+     */
+    std::vector<Note> decode(std::size_t first, std::size_t last, bool compress = false) const;
+
+private:
+    //! Находит смещения записей.
+    void scan();
+    //! Декодирует строку со смещения \a pos и сдвигает \a pos за её конец.
+    QString string(quint64 &pos) const;
+
+    //! Данные устройства, если его не удалось отобразить в память.
+    QByteArray mData;
+    //! Указатель на начало данных.
+    const uchar *mBase;
+    //! Размер данных в байтах.
+    quint64 mSize;
+    //! Смещения записей.
+    std::vector<quint64> mRecords;
+};
+
+#endif // NOTEDECODER_HPP
@@ -0,0 +1,289 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteExporter.
+ */
+#include "noteexporter.hpp"
+
+#include <algorithm> // min()
+#include <stdexcept> // runtime_error
+#include <string>
+#include <utility> // pair
+
+#include <QList>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "trace.hpp"
+
+namespace
+{
+
+//! Количество заметок в одной части.
+const std::size_t chunkSize = 1024;
+
+//! Способ записи строки.
+enum Escape
+{
+    Plain,        //!< Без изменений
+    SingleLine,   //!< Переводы строк заменяются пробелами
+    MarkdownText, //!< Строки, начинающиеся с # или \, предваряются обратной косой чертой
+    JsonString    //!< Экранирование строки JSON
+};
+
+//! Наибольшее количество байтов, в которое записывается один элемент UTF-16 способом \a escape.
+std::size_t maxBytesPerUnit(Escape escape)
+{
+    // Символ вне ASCII занимает не больше 3 байтов, пара суррогатов — 4 байта
+    // на 2 элемента; \u00XX занимает 6 байтов
+    return escape == JsonString ? 6 : escape == MarkdownText ? 4 : 3;
+}
+
+//! Записывает в \a p строку ASCII \a s.
+void putAscii(char *&p, const char *s)
+{
+    while (*s)
+    {
+        *p++ = *s++;
+    }
+}
+
+//! Записывает в \a p десятичную запись числа \a n.
+void putNumber(char *&p, quint64 n)
+{
+    char digits[20];
+    int k = 0;
+    do
+    {
+        digits[k++] = static_cast<char>('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    while (k > 0)
+    {
+        *p++ = digits[--k];
+    }
+}
+
+/*!
+ * \brief Записывает в \a p строку \a s в UTF-8 способом \a escape.
+ *
+ * Непарные суррогаты заменяются символом U+FFFD.
+ */
+void putUtf8(char *&p, const QString &s, Escape escape)
+{
+    static const char hex[] = "0123456789abcdef";
+    const ushort *u = s.utf16();
+    const int n = s.size();
+    bool lineStart = true;
+    for (int i = 0; i < n; ++i)
+    {
+        uint c = u[i];
+        if (escape == MarkdownText)
+        {
+            if (lineStart && (c == '#' || c == '\\'))
+            {
+                *p++ = '\\';
+            }
+            lineStart = c == '\n';
+        }
+        if (c < 0x80)
+        {
+            if (escape == SingleLine && (c == '\n' || c == '\r'))
+            {
+                *p++ = ' ';
+            }
+            else if (escape == JsonString && (c < 0x20 || c == '"' || c == '\\'))
+            {
+                *p++ = '\\';
+                switch (c)
+                {
+                case '"': *p++ = '"'; break;
+                case '\\': *p++ = '\\'; break;
+                case '\n': *p++ = 'n'; break;
+                case '\r': *p++ = 'r'; break;
+                case '\t': *p++ = 't'; break;
+                default:
+                    putAscii(p, "u00");
+                    *p++ = hex[c >> 4];
+                    *p++ = hex[c & 0xF];
+                }
+            }
+            else
+            {
+                *p++ = static_cast<char>(c);
+            }
+            continue;
+        }
+        if (QChar::isHighSurrogate(c) && i + 1 < n && QChar::isLowSurrogate(u[i + 1]))
+        {
+            c = QChar::surrogateToUcs4(static_cast<ushort>(c), u[++i]);
+            *p++ = static_cast<char>(0xF0 | (c >> 18));
+            *p++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            *p++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *p++ = static_cast<char>(0x80 | (c & 0x3F));
+            continue;
+        }
+        if (QChar::isSurrogate(c))
+        {
+            c = 0xFFFD;
+        }
+        if (c < 0x800)
+        {
+            *p++ = static_cast<char>(0xC0 | (c >> 6));
+        }
+        else
+        {
+            *p++ = static_cast<char>(0xE0 | (c >> 12));
+            *p++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        }
+        *p++ = static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+/*!
+ * \brief Форматирует заметки \a notes с \a first по \a last - 1 в формате \a format.
+ *
+ * Заголовки и тексты читаются один раз (ленивые заметки декодируют их при
+ * каждом обращении), по их длинам вычисляется наибольший размер результата,
+ * и буфер выделяется один раз.
+ */
+std::string formatChunk(const std::vector<Note> &notes, std::size_t first, std::size_t last,
+                        NoteExporter::Format format)
+{
+    // Разметка одной заметки вместе с двумя номерами занимает меньше 100 байтов
+    const std::size_t markupSize = 100;
+    Escape titleEscape = format == NoteExporter::JsonLines ? JsonString
+                       : format == NoteExporter::Markdown ? SingleLine : Plain;
+    Escape textEscape = format == NoteExporter::JsonLines ? JsonString
+                      : format == NoteExporter::Markdown ? MarkdownText : Plain;
+    std::vector<std::pair<QString, QString>> fields;
+    fields.reserve(last - first);
+    std::size_t size = 0;
+    for (std::size_t i = first; i < last; ++i)
+    {
+        fields.emplace_back(notes[i].title(), notes[i].text());
+        size += static_cast<std::size_t>(fields.back().first.size()) * maxBytesPerUnit(titleEscape)
+                + static_cast<std::size_t>(fields.back().second.size()) * maxBytesPerUnit(textEscape)
+                + markupSize;
+    }
+    std::string out(size, '\0');
+    char *p = &out[0];
+    for (std::size_t i = first; i < last; ++i)
+    {
+        const QString &title = fields[i - first].first;
+        const QString &text = fields[i - first].second;
+        switch (format)
+        {
+        case NoteExporter::Text:
+            putAscii(p, "+++ ");
+            putNumber(p, i + 1);
+            *p++ = '/';
+            putNumber(p, notes.size());
+            putAscii(p, " +++\nTitle: ");
+            putUtf8(p, title, titleEscape);
+            putAscii(p, "\nContent: ");
+            putUtf8(p, text, textEscape);
+            putAscii(p, "\n--- ");
+            putNumber(p, i + 1);
+            *p++ = '/';
+            putNumber(p, notes.size());
+            putAscii(p, " ---\n");
+            break;
+        case NoteExporter::Markdown:
+            putAscii(p, "## ");
+            putUtf8(p, title, titleEscape);
+            putAscii(p, "\n\n");
+            if (!text.isEmpty())
+            {
+                putUtf8(p, text, textEscape);
+                putAscii(p, "\n\n");
+            }
+            break;
+        case NoteExporter::JsonLines:
+            putAscii(p, "{\"title\":\"");
+            putUtf8(p, title, titleEscape);
+            putAscii(p, "\",\"text\":\"");
+            putUtf8(p, text, textEscape);
+            putAscii(p, "\"}\n");
+            break;
+        }
+    }
+    out.resize(static_cast<std::size_t>(p - out.data()));
+    return out;
+}
+
+}
+
+NoteExporter::Format NoteExporter::formatForFileName(const QString &fileName)
+{
+    if (fileName.endsWith(QLatin1String(".md"), Qt::CaseInsensitive)
+            || fileName.endsWith(QLatin1String(".markdown"), Qt::CaseInsensitive))
+    {
+        return Markdown;
+    }
+    if (fileName.endsWith(QLatin1String(".jsonl"), Qt::CaseInsensitive))
+    {
+        return JsonLines;
+    }
+    return Text;
+}
+
+/*!
+ * Окно состоит из нескольких частей на поток, чтобы потоки не простаивали,
+ * пока форматируется самая длинная часть. Буферы окна записываются, когда
+ * отформатированы все его части.
+ */
+bool NoteExporter::write(const QString &fileName, const std::vector<Note> &notes, Format format,
+                         const ProgressFunction &progress, const CancelFunction &canceled)
+{
+    TRACE_SCOPE("NoteExporter::write");
+    auto isCanceled = [&canceled]() {
+        return canceled && canceled();
+    };
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly))
+    {
+        throw std::runtime_error(tr("Unable to open %1: %2").arg(fileName, f.errorString()).toStdString());
+    }
+    std::function<std::string(std::size_t)> formatter = [&](std::size_t first) {
+        // Прерванная выгрузка не дожидается форматирования оставшихся частей
+        if (isCanceled())
+        {
+            return std::string();
+        }
+        TRACE_SCOPE("NoteExporter chunk");
+        return formatChunk(notes, first, std::min(first + chunkSize, notes.size()), format);
+    };
+    const std::size_t window = chunkSize * static_cast<std::size_t>(QThreadPool::globalInstance()->maxThreadCount()) * 2;
+    for (std::size_t begin = 0; begin < notes.size(); begin += window)
+    {
+        std::size_t end = std::min(begin + window, notes.size());
+        std::vector<std::size_t> firsts;
+        for (std::size_t first = begin; first < end; first += chunkSize)
+        {
+            firsts.push_back(first);
+        }
+        QList<std::string> blocks = QtConcurrent::blockingMapped<QList<std::string>>(firsts, formatter);
+        if (isCanceled())
+        {
+            f.cancelWriting();
+            return false;
+        }
+        for (const std::string &block : blocks)
+        {
+            if (f.write(block.data(), static_cast<qint64>(block.size())) != static_cast<qint64>(block.size()))
+            {
+                throw std::runtime_error(tr("Unable to write to %1: %2").arg(fileName, f.errorString()).toStdString());
+            }
+        }
+        if (progress)
+        {
+            progress(end);
+        }
+    }
+    if (!f.commit())
+    {
+        throw std::runtime_error(tr("Unable to commit the save").toStdString());
+    }
+    return true;
+}
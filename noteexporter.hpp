@@ -0,0 +1,74 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteExporter.
+ */
+#ifndef NOTEEXPORTER_HPP
+#define NOTEEXPORTER_HPP
+
+#include <cstddef> // size_t
+#include <functional> // function
+#include <vector>
+
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QString>
+
+#include "note.hpp"
+
+/*!
+ * \brief Класс выгрузки заметок в текстовые форматы.
+ *
+ * Поддерживаются три формата (все в кодировке UTF-8):
+ *
+ * - Text — прежний формат команды «Save As Text»: для каждой заметки строки
+ *   "+++ i/N +++", "Title: заголовок", "Content: текст" и "--- i/N ---".
+ * - Markdown — заголовок второго уровня "## заголовок", пустая строка, текст
+ *   и ещё одна пустая строка. Строки текста, начинающиеся с \c # или \c \\,
+ *   предваряются обратной косой чертой, чтобы их нельзя было принять за
+ *   заголовок; переводы строк в заголовке заменяются пробелами.
+ * - JsonLines — по одному объекту JSON {"title": ..., "text": ...} в строке.
+ *
+ * Заметки делятся на части, которые форматируются параллельно в пуле
+ * потоков QtConcurrent, каждая — в собственный буфер UTF-8, размер которого
+ * вычисляется заранее. Готовые буферы записываются в файл по порядку
+ * большими блоками. Одновременно форматируется ограниченное окно частей,
+ * поэтому объём памяти не зависит от количества заметок.
+ *
+ * Методы не обращаются к объектам графического интерфейса и могут
+ * вызываться из рабочего потока.
+ */
+class NoteExporter
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NoteExporter)
+public:
+    //! Формат выгрузки.
+    enum Format
+    {
+        Text,     //!< Формат «Save As Text»
+        Markdown, //!< Markdown
+        JsonLines //!< JSON Lines
+    };
+    //! Тип функции, которой сообщается количество уже записанных заметок.
+    using ProgressFunction = std::function<void(std::size_t)>;
+    //! Тип функции, возвращающей \c true, если выгрузку нужно прервать.
+    using CancelFunction = std::function<bool()>;
+
+    //! Возвращает формат по расширению имени файла \a fileName (.md, .jsonl); по умолчанию Text.
+    static Format formatForFileName(const QString &fileName);
+    /*!
+     * \brief Записывает заметки \a notes в файл \a fileName в формате \a format.
+     *
+     * Запись выполняется через QSaveFile, то есть файл заменяется только в
+     * случае успешной записи. Функция \a progress вызывается после записи
+     * каждого окна частей. Функция \a canceled проверяется перед
+     * форматированием каждой части; если она вернула \c true, файл не
+     * изменяется и метод возвращает \c false. В случае ошибки запускает
+     * исключительную ситуацию.
+     */
+    static bool write(const QString &fileName, const std::vector<Note> &notes, Format format,
+                      const ProgressFunction &progress = ProgressFunction(),
+                      const CancelFunction &canceled = CancelFunction());
+};
+
+#endif // NOTEEXPORTER_HPP
@@ -0,0 +1,431 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteFilterModel.
+ */
+#include "notefiltermodel.hpp"
+
+#include <algorithm> // lower_bound(), min()
+#include <iterator> // next()
+#include <utility> // pair
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "notescanner.hpp"
+
+namespace
+{
+
+//! Количество строк, начиная с которого проверка выполняется параллельно.
+const std::size_t parallelThreshold = 4096;
+/*!
+ * \brief Наибольшее количество удаляемых и вставляемых диапазонов строк при смене фильтра.
+ *
+ * Каждый диапазон — это отдельные сигналы модели и сдвиг хвоста таблицы
+ * соответствия, поэтому при большем их количестве модель сбрасывается.
+ */
+const std::size_t maxRefilterRanges = 256;
+
+//! Часть списка строк, проверяемая одним заданием.
+struct Chunk
+{
+    //! Первая строка части.
+    std::vector<int>::const_iterator first;
+    //! Строка, следующая за последней строкой части.
+    std::vector<int>::const_iterator last;
+    //! Строки части, прошедшие фильтр.
+    std::vector<int> accepted;
+};
+
+}
+
+NoteFilterModel::NoteFilterModel(Notebook *notebook, QObject *parent)
+    : QAbstractProxyModel(parent)
+    , mNotebook(notebook)
+    , mRemoveFirst(0)
+    , mRemoveLast(-1)
+{
+    QAbstractProxyModel::setSourceModel(notebook);
+    // Пока фильтр пуст, в модель попадают все строки
+    mRows = rowRange(0, notebook->size() - 1);
+
+    connect(notebook, &Notebook::rowsInserted, this,
+            [this](const QModelIndex &, int first, int last) { sourceRowsInserted(first, last); });
+    connect(notebook, &Notebook::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &, int first, int last) { sourceRowsAboutToBeRemoved(first, last); });
+    connect(notebook, &Notebook::rowsRemoved, this,
+            [this](const QModelIndex &, int first, int last) { sourceRowsRemoved(first, last); });
+    connect(notebook, &Notebook::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        // Если модель не сообщила, какие строки изменились, проверяем все
+        if (!topLeft.isValid() || !bottomRight.isValid())
+        {
+            refilter(rowRange(0, mNotebook->size() - 1));
+            return;
+        }
+        sourceRowsChanged(topLeft.row(), bottomRight.row());
+    });
+    connect(notebook, &Notebook::modelAboutToBeReset, this, [this] { beginResetModel(); });
+    connect(notebook, &Notebook::modelReset, this, [this] {
+        mRows = filterRows(rowRange(0, mNotebook->size() - 1));
+        endResetModel();
+    });
+}
+
+QString NoteFilterModel::filterText() const
+{
+    return mFilterText;
+}
+
+void NoteFilterModel::setFilterText(const QString &text)
+{
+    if (text == mFilterText)
+    {
+        return;
+    }
+    // Если новая строка содержит прежнюю, её могут содержать только заметки,
+    // уже прошедшие фильтр. Так при наборе строки каждый следующий символ
+    // проверяется всё быстрее
+    bool narrowing = !mFilterText.isEmpty() && text.contains(mFilterText, Qt::CaseInsensitive);
+    mFilterText = text;
+    refilter(narrowing ? mRows : rowRange(0, mNotebook->size() - 1));
+}
+
+int NoteFilterModel::sourceRow(int row) const
+{
+    return mRows[row];
+}
+
+QModelIndex NoteFilterModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() || column < 0 || column >= columnCount())
+    {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex NoteFilterModel::parent(const QModelIndex &) const
+{
+    // Модель табличная, у элементов нет родителей
+    return QModelIndex();
+}
+
+int NoteFilterModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(mRows.size());
+}
+
+int NoteFilterModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : mNotebook->columnCount();
+}
+
+QModelIndex NoteFilterModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid())
+    {
+        return QModelIndex();
+    }
+    return mNotebook->index(mRows[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex NoteFilterModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid())
+    {
+        return QModelIndex();
+    }
+    int pos = proxyPosition(sourceIndex.row());
+    if (pos == rowCount() || mRows[pos] != sourceIndex.row())
+    {
+        // Строка не прошла фильтр
+        return QModelIndex();
+    }
+    return createIndex(pos, sourceIndex.column());
+}
+
+QItemSelection NoteFilterModel::mapSelectionToSource(const QItemSelection &proxySelection) const
+{
+    QItemSelection result;
+    for (const QItemSelectionRange &range : proxySelection)
+    {
+        if (!range.isValid())
+        {
+            continue;
+        }
+        // Соседние строки модели соответствуют соседним строкам записной
+        // книжки, пока между ними нет отфильтрованных строк
+        int first = -1, last = -1;
+        for (int row = range.top(); row <= range.bottom(); ++row)
+        {
+            int source = mRows[row];
+            if (first >= 0 && source == last + 1)
+            {
+                last = source;
+                continue;
+            }
+            if (first >= 0)
+            {
+                result.append(QItemSelectionRange(mNotebook->index(first, range.left()),
+                                                  mNotebook->index(last, range.right())));
+            }
+            first = last = source;
+        }
+        if (first >= 0)
+        {
+            result.append(QItemSelectionRange(mNotebook->index(first, range.left()),
+                                              mNotebook->index(last, range.right())));
+        }
+    }
+    return result;
+}
+
+QItemSelection NoteFilterModel::mapSelectionFromSource(const QItemSelection &sourceSelection) const
+{
+    QItemSelection result;
+    for (const QItemSelectionRange &range : sourceSelection)
+    {
+        if (!range.isValid())
+        {
+            continue;
+        }
+        // Строки записной книжки из диапазона, прошедшие фильтр, идут в
+        // модели подряд, поэтому диапазон отображается в один диапазон
+        int first = proxyPosition(range.top());
+        int last = proxyPosition(range.bottom() + 1) - 1;
+        if (first <= last)
+        {
+            result.append(QItemSelectionRange(index(first, range.left()), index(last, range.right())));
+        }
+    }
+    return result;
+}
+
+bool NoteFilterModel::accepts(int row) const
+{
+    const Note &note = (*mNotebook)[row];
+    return NoteScanner::indexOf(note.title(), mFilterText, 0, Qt::CaseInsensitive) >= 0
+            || NoteScanner::indexOf(note.text(), mFilterText, 0, Qt::CaseInsensitive) >= 0;
+}
+
+/*!
+ * Во время параллельной проверки поток интерфейса ждёт её окончания,
+ * поэтому записная книжка не изменяется и рабочие потоки могут читать
+ * заметки без блокировок. Записная книжка, хранилище которой привязано
+ * к потоку (см. Notebook::isConcurrentReadable()), проверяется в потоке
+ * интерфейса.
+ */
+std::vector<int> NoteFilterModel::filterRows(const std::vector<int> &candidates) const
+{
+    if (mFilterText.isEmpty())
+    {
+        return candidates;
+    }
+    std::vector<int> accepted;
+    if (candidates.size() < parallelThreshold || !mNotebook->isConcurrentReadable())
+    {
+        for (int row : candidates)
+        {
+            if (accepts(row))
+            {
+                accepted.push_back(row);
+            }
+        }
+        return accepted;
+    }
+    // Делим строки на части, по несколько на каждый поток, чтобы потоки,
+    // быстро обработавшие свои части, брали следующие
+    std::size_t parts = static_cast<std::size_t>(QThreadPool::globalInstance()->maxThreadCount()) * 8;
+    std::size_t size = candidates.size() / parts + 1;
+    std::vector<Chunk> chunks;
+    for (std::size_t first = 0; first < candidates.size(); first += size)
+    {
+        std::size_t last = std::min(first + size, candidates.size());
+        chunks.push_back(Chunk{ std::next(candidates.begin(), first),
+                                std::next(candidates.begin(), last), std::vector<int>() });
+    }
+    QtConcurrent::blockingMap(chunks, [this](Chunk &chunk) {
+        for (auto it = chunk.first; it != chunk.last; ++it)
+        {
+            if (accepts(*it))
+            {
+                chunk.accepted.push_back(*it);
+            }
+        }
+    });
+    // Части идут по порядку, поэтому результат остаётся упорядоченным
+    for (const Chunk &chunk : chunks)
+    {
+        accepted.insert(accepted.end(), chunk.accepted.begin(), chunk.accepted.end());
+    }
+    return accepted;
+}
+
+std::vector<int> NoteFilterModel::rowRange(int first, int last)
+{
+    std::vector<int> rows;
+    rows.reserve(last >= first ? last - first + 1 : 0);
+    for (int row = first; row <= last; ++row)
+    {
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+int NoteFilterModel::proxyPosition(int sourceRow) const
+{
+    return static_cast<int>(std::lower_bound(mRows.begin(), mRows.end(), sourceRow) - mRows.begin());
+}
+
+/*!
+ * Прежняя и новая таблицы соответствия упорядочены, поэтому их разница
+ * находится одним проходом: это диапазоны соседних позиций прежней
+ * таблицы, которых нет в новой, и диапазоны новой таблицы, которых не было
+ * в прежней. Сначала удаляются первые, с конца, чтобы позиции ещё не
+ * удалённых диапазонов не сдвигались. Затем по возрастанию вставляются
+ * вторые: к моменту вставки диапазона все предшествующие ему строки новой
+ * таблицы уже на месте, поэтому его позиция в новой таблице совпадает
+ * с позицией вставки.
+ */
+void NoteFilterModel::refilter(const std::vector<int> &candidates)
+{
+    std::vector<int> rows = filterRows(candidates);
+    // Диапазоны позиций [first, last]: удаляемые — в прежней таблице,
+    // вставляемые — в новой
+    std::vector<std::pair<int, int>> removed, inserted;
+    auto addPosition = [](std::vector<std::pair<int, int>> &ranges, int pos) {
+        if (!ranges.empty() && ranges.back().second + 1 == pos)
+        {
+            ranges.back().second = pos;
+        }
+        else
+        {
+            ranges.emplace_back(pos, pos);
+        }
+    };
+    std::size_t i = 0, j = 0;
+    while (i < mRows.size() || j < rows.size())
+    {
+        if (j == rows.size() || (i < mRows.size() && mRows[i] < rows[j]))
+        {
+            addPosition(removed, static_cast<int>(i++));
+        }
+        else if (i == mRows.size() || rows[j] < mRows[i])
+        {
+            addPosition(inserted, static_cast<int>(j++));
+        }
+        else
+        {
+            ++i;
+            ++j;
+        }
+    }
+    if (removed.size() + inserted.size() > maxRefilterRanges)
+    {
+        beginResetModel();
+        mRows.swap(rows);
+        endResetModel();
+        return;
+    }
+    for (auto it = removed.rbegin(); it != removed.rend(); ++it)
+    {
+        beginRemoveRows(QModelIndex(), it->first, it->second);
+        mRows.erase(std::next(mRows.begin(), it->first), std::next(mRows.begin(), it->second + 1));
+        endRemoveRows();
+    }
+    for (const std::pair<int, int> &range : inserted)
+    {
+        beginInsertRows(QModelIndex(), range.first, range.second);
+        mRows.insert(std::next(mRows.begin(), range.first),
+                     std::next(rows.begin(), range.first), std::next(rows.begin(), range.second + 1));
+        endInsertRows();
+    }
+}
+
+void NoteFilterModel::sourceRowsInserted(int first, int last)
+{
+    int count = last - first + 1;
+    int pos = proxyPosition(first);
+    // Строки записной книжки после вставленных сдвинулись. Обычно
+    // заметки добавляются в конец, и сдвигать ничего не нужно
+    for (auto it = std::next(mRows.begin(), pos); it != mRows.end(); ++it)
+    {
+        *it += count;
+    }
+    // Проверяем только вставленные строки
+    std::vector<int> accepted = filterRows(rowRange(first, last));
+    if (accepted.empty())
+    {
+        return;
+    }
+    beginInsertRows(QModelIndex(), pos, pos + static_cast<int>(accepted.size()) - 1);
+    mRows.insert(std::next(mRows.begin(), pos), accepted.begin(), accepted.end());
+    endInsertRows();
+}
+
+void NoteFilterModel::sourceRowsAboutToBeRemoved(int first, int last)
+{
+    // Строки модели, соответствующие удаляемым строкам, идут подряд
+    mRemoveFirst = proxyPosition(first);
+    mRemoveLast = proxyPosition(last + 1) - 1;
+    if (mRemoveFirst <= mRemoveLast)
+    {
+        beginRemoveRows(QModelIndex(), mRemoveFirst, mRemoveLast);
+    }
+}
+
+void NoteFilterModel::sourceRowsRemoved(int first, int last)
+{
+    int count = last - first + 1;
+    bool removing = mRemoveFirst <= mRemoveLast;
+    if (removing)
+    {
+        mRows.erase(std::next(mRows.begin(), mRemoveFirst), std::next(mRows.begin(), mRemoveLast + 1));
+    }
+    // Строки записной книжки после удалённых сдвинулись
+    for (auto it = std::next(mRows.begin(), mRemoveFirst); it != mRows.end(); ++it)
+    {
+        *it -= count;
+    }
+    mRemoveFirst = 0;
+    mRemoveLast = -1;
+    if (removing)
+    {
+        endRemoveRows();
+    }
+}
+
+void NoteFilterModel::sourceRowsChanged(int first, int last)
+{
+    // Проверяем изменённые строки заново. Строки, переставшие проходить
+    // фильтр, удаляются из модели, а начавшие — вставляются
+    std::vector<int> accepted = filterRows(rowRange(first, last));
+    auto next = accepted.begin();
+    for (int row = first; row <= last; ++row)
+    {
+        bool now = next != accepted.end() && *next == row;
+        if (now)
+        {
+            ++next;
+        }
+        int pos = proxyPosition(row);
+        bool was = pos < rowCount() && mRows[pos] == row;
+        if (was && now)
+        {
+            emit dataChanged(index(pos, 0), index(pos, columnCount() - 1));
+        }
+        else if (was)
+        {
+            beginRemoveRows(QModelIndex(), pos, pos);
+            mRows.erase(std::next(mRows.begin(), pos));
+            endRemoveRows();
+        }
+        else if (now)
+        {
+            beginInsertRows(QModelIndex(), pos, pos);
+            mRows.insert(std::next(mRows.begin(), pos), row);
+            endInsertRows();
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteFilterModel.
+ */
+#ifndef NOTEFILTERMODEL_HPP
+#define NOTEFILTERMODEL_HPP
+
+#include <vector>
+
+#include <QAbstractProxyModel>
+#include <QString>
+
+#include "notebook.hpp"
+
+/*!
+ * \brief Класс модели-посредника, отбирающей заметки по строке фильтра.
+ *
+ * Модель располагается между записной книжкой и видом и показывает только
+ * заметки, заголовок или текст которых содержит строку фильтра без учёта
+ * регистра (см. setFilterText()).
+ *
+ * В отличие от QSortFilterProxyModel, модель не проверяет все заметки
+ * заново при изменениях записной книжки: проверяются только вставленные
+ * и изменённые строки, а таблица соответствия строк обновляется на месте.
+ * Таблица — это упорядоченный по возрастанию вектор номеров строк записной
+ * книжки, поэтому строка записной книжки находится в нём двоичным поиском.
+ *
+ * Если проверить нужно много заметок (смена фильтра, вставка большой
+ * порции), они делятся на части, которые проверяются параллельно в пуле
+ * потоков QtConcurrent. Если новая строка фильтра содержит прежнюю,
+ * проверяются только заметки, уже прошедшие фильтр.
+ */
+class NoteFilterModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Конструктор.
+     * \param notebook Записная книжка. Должна существовать, пока существует модель.
+     * \param parent Родительский объект.
+     */
+    explicit NoteFilterModel(Notebook *notebook, QObject *parent = nullptr);
+
+    //! Возвращает строку фильтра.
+    QString filterText() const;
+    //! Устанавливает строку фильтра \a text. Пустая строка отключает фильтр.
+    void setFilterText(const QString &text);
+    /*!
+     * \brief Возвращает номер строки записной книжки, соответствующей строке \a row модели.
+     *
+     * В отличие от mapToSource(), не создаёт индексов.
+     */
+    int sourceRow(int row) const;
+
+    /*!
+     * \name Реализация интерфейса модели-посредника.
+     * @{
+     */
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QModelIndex parent(const QModelIndex &child) const Q_DECL_OVERRIDE;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const Q_DECL_OVERRIDE;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const Q_DECL_OVERRIDE;
+    /*!
+     * \brief Преобразует выделение \a proxySelection в выделение записной книжки.
+     *
+     * В отличие от реализации QAbstractProxyModel, преобразует диапазоны
+     * целиком, не перебирая каждый элемент: соседние строки записной книжки
+     * объединяются в один диапазон.
+     */
+    QItemSelection mapSelectionToSource(const QItemSelection &proxySelection) const Q_DECL_OVERRIDE;
+    //! Преобразует выделение записной книжки \a sourceSelection в выделение модели.
+    QItemSelection mapSelectionFromSource(const QItemSelection &sourceSelection) const Q_DECL_OVERRIDE;
+    //! @}
+
+private:
+    //! Возвращает \c true, если заметка с индексом \a row проходит фильтр.
+    bool accepts(int row) const;
+    /*!
+     * \brief Возвращает строки из \a candidates, проходящие фильтр.
+     *
+     * Номера строк в \a candidates должны идти по возрастанию. Большие
+     * списки проверяются параллельно, если записная книжка это допускает.
+     */
+    std::vector<int> filterRows(const std::vector<int> &candidates) const;
+    //! Возвращает номера строк с \a first по \a last.
+    static std::vector<int> rowRange(int first, int last);
+    //! Возвращает позицию строки записной книжки \a sourceRow в таблице соответствия (или позицию для её вставки).
+    int proxyPosition(int sourceRow) const;
+    /*!
+     * \brief Заново отбирает строки из \a candidates.
+     *
+     * Модель сообщает об удалении и вставке только изменившихся диапазонов
+     * строк, а сбрасывается, лишь если диапазонов слишком много.
+     */
+    void refilter(const std::vector<int> &candidates);
+
+    //! Обрабатывает вставку строк записной книжки с \a first по \a last.
+    void sourceRowsInserted(int first, int last);
+    //! Обрабатывает начало удаления строк записной книжки с \a first по \a last.
+    void sourceRowsAboutToBeRemoved(int first, int last);
+    //! Обрабатывает удаление строк записной книжки с \a first по \a last.
+    void sourceRowsRemoved(int first, int last);
+    //! Обрабатывает изменение строк записной книжки с \a first по \a last.
+    void sourceRowsChanged(int first, int last);
+
+    //! Записная книжка.
+    Notebook *mNotebook;
+    //! Строка фильтра.
+    QString mFilterText;
+    //! Таблица соответствия: номера строк записной книжки, прошедших фильтр, по возрастанию.
+    std::vector<int> mRows;
+    //! Первая удаляемая строка модели между началом и концом удаления строк записной книжки.
+    int mRemoveFirst;
+    //! Последняя удаляемая строка модели (меньше mRemoveFirst, если удалять нечего).
+    int mRemoveLast;
+};
+
+#endif // NOTEFILTERMODEL_HPP
@@ -0,0 +1,212 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteGenerator.
+ */
+#include "notegenerator.hpp"
+
+#include <algorithm> // min(), max()
+#include <cmath> // exp()
+
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace
+{
+
+//! Потоки случайных чисел записи.
+enum Stream
+{
+    LanguageStream, //!< Выбор языка
+    TitleStream,    //!< Заголовок
+    TextStream,     //!< Текст
+    StreamCount     //!< Количество потоков
+};
+
+/*!
+ * \brief Генератор псевдослучайных чисел SplitMix64.
+ *
+ * В отличие от распределений стандартной библиотеки, результаты не зависят
+ * от её реализации, поэтому заметки одинаковы на всех платформах.
+ */
+class Random
+{
+public:
+    //! Конструктор. \a state — начальное состояние.
+    explicit Random(quint64 state)
+        : mState(state)
+    {
+    }
+    //! Возвращает следующее число.
+    quint64 next()
+    {
+        quint64 z = (mState += Q_UINT64_C(0x9E3779B97F4A7C15));
+        z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+        z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+        return z ^ (z >> 31);
+    }
+    //! Возвращает число, равномерно распределённое на [0, 1).
+    double uniform()
+    {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    //! Возвращает число, равномерно распределённое на [0, \a n).
+    int below(int n)
+    {
+        return static_cast<int>(next() % static_cast<quint64>(n));
+    }
+    /*!
+     * \brief Возвращает логнормально распределённое число от \a min до \a max.
+     *
+     * Нормальная величина приближается суммой двенадцати равномерных
+     * (распределение Ирвина — Холла), что не требует тригонометрии.
+     */
+    int logNormal(double mu, double sigma, int min, int max)
+    {
+        double z = -6;
+        for (int i = 0; i < 12; ++i)
+        {
+            z += uniform();
+        }
+        double x = std::exp(mu + sigma * z);
+        return x >= max ? max : std::max(min, static_cast<int>(x));
+    }
+
+private:
+    //! Состояние.
+    quint64 mState;
+};
+
+//! Возвращает генератор потока \a stream записи \a record для начального значения \a seed.
+Random random(quint64 seed, quint32 record, Stream stream)
+{
+    Random mixer(seed ^ ((static_cast<quint64>(record) * StreamCount + stream) * Q_UINT64_C(0xD1342543DE82EF95)));
+    return Random(mixer.next());
+}
+
+//! Возвращает \c true, если запись \a record генератора \a seed составлена из русских слогов.
+bool isRussian(quint64 seed, quint32 record)
+{
+    return random(seed, record, LanguageStream).below(10) < 7;
+}
+
+//! Дописывает в строку \a s псевдослово из слогов языка \a russian, с заглавной буквы, если \a capital.
+void appendWord(QString &s, Random &rng, bool russian, bool capital)
+{
+    static const QString ru[] = {
+        QStringLiteral("ка"), QStringLiteral("ло"), QStringLiteral("ми"), QStringLiteral("ре"),
+        QStringLiteral("то"), QStringLiteral("ны"), QStringLiteral("ст"), QStringLiteral("ва"),
+        QStringLiteral("де"), QStringLiteral("по"), QStringLiteral("ра"), QStringLiteral("ли"),
+        QStringLiteral("зна"), QStringLiteral("тель"), QStringLiteral("ще"), QStringLiteral("ов")
+    };
+    static const QString la[] = {
+        QStringLiteral("an"), QStringLiteral("er"), QStringLiteral("in"), QStringLiteral("on"),
+        QStringLiteral("ta"), QStringLiteral("re"), QStringLiteral("lo"), QStringLiteral("mi"),
+        QStringLiteral("su"), QStringLiteral("de"), QStringLiteral("ko"), QStringLiteral("ba"),
+        QStringLiteral("tion"), QStringLiteral("ex"), QStringLiteral("ul"), QStringLiteral("pra")
+    };
+    const QString *syllables = russian ? ru : la;
+    int first = s.size();
+    // От одного до четырёх слогов, чаще один-три
+    int count = 1 + rng.below(3) + (rng.below(4) == 0 ? 1 : 0);
+    for (int i = 0; i < count; ++i)
+    {
+        s += syllables[rng.below(16)];
+    }
+    if (capital)
+    {
+        s[first] = s[first].toUpper();
+    }
+}
+
+}
+
+NoteGenerator::NoteGenerator(quint64 seed)
+    : mSeed(seed)
+{
+}
+
+quint64 NoteGenerator::seed() const
+{
+    return mSeed;
+}
+
+QString NoteGenerator::title(quint32 record) const
+{
+    Random rng = random(mSeed, record, TitleStream);
+    bool russian = isRussian(mSeed, record);
+    // В среднем три-четыре слова
+    int words = rng.logNormal(1.2, 0.5, 1, 16);
+    QString s;
+    s.reserve(words * 8);
+    for (int i = 0; i < words; ++i)
+    {
+        if (i > 0)
+        {
+            s += QLatin1Char(' ');
+        }
+        appendWord(s, rng, russian, i == 0);
+    }
+    return s;
+}
+
+QString NoteGenerator::text(quint32 record) const
+{
+    Random rng = random(mSeed, record, TextStream);
+    bool russian = isRussian(mSeed, record);
+    // Медиана около 55 слов, среднее — около 110, длинный хвост
+    int words = rng.logNormal(4.0, 1.2, 0, 20000);
+    QString s;
+    s.reserve(words * 8);
+    int sentenceLeft = 0, paragraphLeft = 1 + rng.below(6);
+    for (int i = 0; i < words; ++i)
+    {
+        bool capital = sentenceLeft == 0;
+        if (capital)
+        {
+            sentenceLeft = 4 + rng.below(17);
+        }
+        appendWord(s, rng, russian, capital);
+        if (--sentenceLeft == 0 || i + 1 == words)
+        {
+            sentenceLeft = 0;
+            s += QLatin1Char('.');
+            if (--paragraphLeft == 0)
+            {
+                paragraphLeft = 1 + rng.below(6);
+                if (i + 1 < words)
+                {
+                    s += QLatin1Char('\n');
+                }
+                continue;
+            }
+        }
+        if (i + 1 < words)
+        {
+            s += QLatin1Char(' ');
+        }
+    }
+    return s;
+}
+
+std::vector<Note> NoteGenerator::lazyNotes(const std::shared_ptr<const NoteGenerator> &generator,
+                                           quint32 first, quint32 count)
+{
+    std::vector<Note> notes;
+    notes.reserve(count);
+    for (quint32 i = 0; i < count; ++i)
+    {
+        notes.emplace_back(generator, first + i);
+    }
+    return notes;
+}
+
+std::vector<Note> NoteGenerator::notes(quint32 first, quint32 count) const
+{
+    std::vector<Note> notes(count);
+    const Note *base = notes.data();
+    // Записи независимы, поэтому порядок их создания не влияет на результат
+    QtConcurrent::blockingMap(notes, [this, first, base](Note &note) {
+        quint32 record = first + static_cast<quint32>(&note - base);
+        note = Note(title(record), text(record));
+    });
+    return notes;
+}
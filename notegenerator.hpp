@@ -0,0 +1,63 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteGenerator.
+ */
+#ifndef NOTEGENERATOR_HPP
+#define NOTEGENERATOR_HPP
+
+#include <memory> // shared_ptr
+#include <vector>
+
+#include <QString>
+
+#include "note.hpp"
+
+/*!
+ * \brief Класс генератора синтетических заметок.
+ *
+ * Генератор является источником данных (NoteSource): заголовок и текст
+ * записи с номером \e record вычисляются по начальному значению генератора
+ * и номеру записи. Поэтому одни и те же параметры всегда дают одни и те же
+ * заметки, записи можно получать в любом порядке и из разных потоков, а
+ * ленивые заметки генератора не занимают памяти под тексты, и записную
+ * книжку из миллионов заметок можно сохранить в файл потоком.
+ *
+ * Заметки состоят из псевдослов, собранных из русских или латинских
+ * слогов. Длины заголовков и текстов (в словах) распределены
+ * логнормально: большинство заметок короткие, но встречаются и тексты
+ * в десятки тысяч слов. Тексты разбиты на предложения и абзацы.
+ */
+class NoteGenerator : public NoteSource
+{
+public:
+    //! Конструктор. \a seed — начальное значение генератора.
+    explicit NoteGenerator(quint64 seed = 1);
+
+    //! Возвращает начальное значение генератора.
+    quint64 seed() const;
+
+    //! Создаёт заголовок записи \a record.
+    QString title(quint32 record) const Q_DECL_OVERRIDE;
+    //! Создаёт текст записи \a record.
+    QString text(quint32 record) const Q_DECL_OVERRIDE;
+
+    /*!
+     * \brief Возвращает ленивые заметки записей с \a first по \a first + \a count - 1 генератора \a generator.
+     *
+     * Заголовки и тексты создаются при каждом обращении к ним.
+     */
+    static std::vector<Note> lazyNotes(const std::shared_ptr<const NoteGenerator> &generator,
+                                       quint32 first, quint32 count);
+    /*!
+     * \brief Возвращает заметки записей с \a first по \a first + \a count - 1, хранящие заголовок и текст.
+     *
+     * Заметки создаются параллельно в пуле потоков QtConcurrent.
+     */
+    std::vector<Note> notes(quint32 first, quint32 count) const;
+
+private:
+    //! Начальное значение генератора.
+    quint64 mSeed;
+};
+
+#endif // NOTEGENERATOR_HPP
@@ -0,0 +1,654 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteImporter.
+ */
+#include "noteimporter.hpp"
+
+#include <algorithm> // max(), min()
+#include <cstring> // memchr(), memcmp()
+#include <iterator> // back_inserter()
+#include <stdexcept> // runtime_error
+#include <string>
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "trace.hpp"
+
+namespace
+{
+
+//! Наименьший размер части файла в байтах.
+const std::size_t minPartSize = 1024 * 1024;
+
+//! Часть файла и заметки, прочитанные из неё.
+struct Segment
+{
+    //! Смещение начала части.
+    std::size_t begin;
+    //! Смещение конца части.
+    std::size_t end;
+    //! Прочитанные заметки.
+    std::vector<Note> notes;
+    //! Сообщение об ошибке или пустая строка.
+    QString error;
+};
+
+//! Разбираемые данные.
+class Input
+{
+public:
+    //! Конструктор. \a name — имя данных для сообщений об ошибках.
+    Input(const char *data, std::size_t size, const QString &name)
+        : data(data)
+        , size(size)
+        , mName(name)
+    {
+    }
+    //! Возвращает смещение конца строки, начинающейся с \a pos (перевода строки или конца данных).
+    std::size_t lineEnd(std::size_t pos) const
+    {
+        const void *p = std::memchr(data + pos, '\n', size - pos);
+        return p ? static_cast<std::size_t>(static_cast<const char *>(p) - data) : size;
+    }
+    //! Возвращает смещение начала строки, следующей за строкой, содержащей \a pos.
+    std::size_t nextLine(std::size_t pos) const
+    {
+        std::size_t end = lineEnd(pos);
+        return end < size ? end + 1 : size;
+    }
+    //! Возвращает смещение конца строки с \a pos по \a end без завершающего возврата каретки.
+    std::size_t trimmed(std::size_t pos, std::size_t end) const
+    {
+        return end > pos && data[end - 1] == '\r' ? end - 1 : end;
+    }
+    //! Возвращает \c true, если с \a pos начинается строка ASCII \a prefix.
+    bool startsWith(std::size_t pos, const char *prefix) const
+    {
+        std::size_t n = std::strlen(prefix);
+        return size - pos >= n && std::memcmp(data + pos, prefix, n) == 0;
+    }
+    //! Декодирует \a length байтов UTF-8 начиная с \a pos.
+    QString decode(std::size_t pos, std::size_t length) const
+    {
+        return QString::fromUtf8(data + pos, static_cast<int>(length));
+    }
+    //! Возвращает исключение об ошибочной записи по смещению \a pos.
+    std::runtime_error error(std::size_t pos) const
+    {
+        return std::runtime_error(NoteImporter::tr("%1: invalid record at byte %2").arg(mName).arg(pos).toStdString());
+    }
+
+    //! Данные.
+    const char *data;
+    //! Размер данных.
+    std::size_t size;
+
+private:
+    //! Имя данных.
+    QString mName;
+};
+
+/*!
+ * \brief Разбирает строку \a s длиной \a length вида "M K/N M", где M — строка \a m из трёх символов.
+ *
+ * Если строка имеет такой вид, записывает числа в \a k и \a n и возвращает \c true.
+ */
+bool parseMarker(const char *s, std::size_t length, const char *m, quint64 &k, quint64 &n)
+{
+    // Самая короткая отметка — "+++ 1/1 +++"
+    if (length < 11 || std::memcmp(s, m, 3) != 0 || s[3] != ' '
+            || std::memcmp(s + length - 3, m, 3) != 0 || s[length - 4] != ' ')
+    {
+        return false;
+    }
+    const char *p = s + 4, *end = s + length - 4;
+    auto number = [&p, end](quint64 &v) {
+        if (p == end || *p < '0' || *p > '9')
+        {
+            return false;
+        }
+        for (v = 0; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            v = v * 10 + static_cast<quint64>(*p - '0');
+        }
+        return true;
+    };
+    if (!number(k) || p == end || *p++ != '/' || !number(n))
+    {
+        return false;
+    }
+    return p == end;
+}
+
+//! Возвращает отметку конца записи "\n--- K/N ---".
+QByteArray endMarker(quint64 k, quint64 n)
+{
+    return "\n--- " + QByteArray::number(k) + '/' + QByteArray::number(n) + " ---";
+}
+
+/*!
+ * \brief Ищет с \a pos до \a end отметку \a marker, занимающую конец строки.
+ *
+ * Возвращает смещение отметки (перевода строки в её начале) или \a end.
+ */
+std::size_t findMarker(const Input &in, std::size_t pos, std::size_t end, const QByteArray &marker)
+{
+    const std::size_t n = static_cast<std::size_t>(marker.size());
+    while (pos < end)
+    {
+        const void *p = std::memchr(in.data + pos, '\n', end - pos);
+        if (!p)
+        {
+            break;
+        }
+        pos = static_cast<std::size_t>(static_cast<const char *>(p) - in.data);
+        if (end - pos >= n && std::memcmp(in.data + pos, marker.constData(), n) == 0)
+        {
+            std::size_t after = pos + n;
+            if (after == end || in.data[after] == '\n'
+                    || (in.data[after] == '\r' && (after + 1 == end || in.data[after + 1] == '\n')))
+            {
+                return pos;
+            }
+        }
+        ++pos;
+    }
+    return end;
+}
+
+/*!
+ * \brief Возвращает начало первой записи текстового формата не раньше \a target.
+ *
+ * Строка "+++ K/N +++" считается началом записи, только если ей
+ * предшествует строка "--- K-1/N ---", поэтому такие же строки внутри
+ * текстов заметок не принимаются за границы.
+ */
+std::size_t textBoundary(const Input &in, std::size_t target)
+{
+    std::size_t pos = target == 0 ? 0 : in.nextLine(target - 1);
+    for (; pos < in.size; pos = in.nextLine(pos))
+    {
+        quint64 k, n;
+        std::size_t end = in.trimmed(pos, in.lineEnd(pos));
+        if (!parseMarker(in.data + pos, end - pos, "+++", k, n))
+        {
+            continue;
+        }
+        if (pos == 0)
+        {
+            return pos;
+        }
+        if (k < 2)
+        {
+            continue;
+        }
+        // Предыдущая строка должна быть отметкой конца предыдущей записи
+        QByteArray marker = endMarker(k - 1, n);
+        std::size_t prevEnd = in.trimmed(0, pos - 1);
+        std::size_t length = static_cast<std::size_t>(marker.size()) - 1;
+        if (prevEnd >= length && std::memcmp(in.data + prevEnd - length, marker.constData() + 1, length) == 0
+                && (prevEnd == length || in.data[prevEnd - length - 1] == '\n'))
+        {
+            return pos;
+        }
+    }
+    return in.size;
+}
+
+//! Возвращает начало первой строки, начинающейся с "## ", не раньше \a target.
+std::size_t markdownBoundary(const Input &in, std::size_t target)
+{
+    std::size_t pos = target == 0 ? 0 : in.nextLine(target - 1);
+    while (pos < in.size && !in.startsWith(pos, "## "))
+    {
+        pos = in.nextLine(pos);
+    }
+    return pos;
+}
+
+//! Возвращает начало первой записи формата \a format не раньше \a target.
+std::size_t boundary(const Input &in, NoteExporter::Format format, std::size_t target)
+{
+    switch (format)
+    {
+    case NoteExporter::Text:
+        return textBoundary(in, target);
+    case NoteExporter::Markdown:
+        return markdownBoundary(in, target);
+    case NoteExporter::JsonLines:
+        break;
+    }
+    return target == 0 ? 0 : in.nextLine(target - 1);
+}
+
+//! Разбирает записи текстового формата с \a begin по \a end.
+std::vector<Note> parseText(const Input &in, std::size_t begin, std::size_t end)
+{
+    std::vector<Note> notes;
+    std::size_t pos = begin;
+    while (pos < end)
+    {
+        std::size_t lineEnd = in.trimmed(pos, in.lineEnd(pos));
+        if (lineEnd == pos)
+        {
+            // Пустые строки между записями пропускаются
+            pos = in.nextLine(pos);
+            continue;
+        }
+        quint64 k, n;
+        if (!parseMarker(in.data + pos, lineEnd - pos, "+++", k, n))
+        {
+            throw in.error(pos);
+        }
+        std::size_t titlePos = in.nextLine(pos);
+        if (titlePos >= end || !in.startsWith(titlePos, "Title: "))
+        {
+            throw in.error(pos);
+        }
+        std::size_t contentPos = in.nextLine(titlePos);
+        if (contentPos >= end || !in.startsWith(contentPos, "Content: "))
+        {
+            throw in.error(pos);
+        }
+        titlePos += 7;
+        std::size_t textPos = contentPos + 9;
+        // Текст может занимать несколько строк и заканчивается отметкой с
+        // теми же номерами
+        std::size_t marker = findMarker(in, textPos, end, endMarker(k, n));
+        if (marker == end)
+        {
+            throw in.error(pos);
+        }
+        notes.emplace_back(in.decode(titlePos, in.trimmed(titlePos, in.lineEnd(titlePos)) - titlePos),
+                           in.decode(textPos, marker - textPos));
+        pos = in.nextLine(marker + 1);
+    }
+    return notes;
+}
+
+/*!
+ * \brief Возвращает текст раздела Markdown с \a begin по \a end.
+ *
+ * Выгрузка записывает после заголовка пустую строку, а после текста — две
+ * пустые строки; они отбрасываются. У строк, начинающихся с "\#" или
+ * "\\", убирается экранирующая обратная косая черта.
+ */
+QString markdownText(const Input &in, std::size_t begin, std::size_t end)
+{
+    const char *d = in.data;
+    if (begin < end && d[begin] == '\n')
+    {
+        ++begin;
+    }
+    else if (end - begin >= 2 && d[begin] == '\r' && d[begin + 1] == '\n')
+    {
+        begin += 2;
+    }
+    if (end - begin >= 2 && d[end - 1] == '\n' && d[end - 2] == '\n')
+    {
+        end -= 2;
+    }
+    else
+    {
+        while (end > begin && (d[end - 1] == '\n' || d[end - 1] == '\r'))
+        {
+            --end;
+        }
+    }
+    std::string bytes;
+    bytes.reserve(end - begin);
+    for (std::size_t pos = begin; pos < end;)
+    {
+        std::size_t lineEnd = std::min(in.lineEnd(pos), end);
+        if (lineEnd - pos >= 2 && d[pos] == '\\' && (d[pos + 1] == '#' || d[pos + 1] == '\\'))
+        {
+            ++pos;
+        }
+        bytes.append(d + pos, lineEnd - pos);
+        if (lineEnd < end)
+        {
+            bytes += '\n';
+        }
+        pos = lineEnd + 1;
+    }
+    return QString::fromUtf8(bytes.data(), static_cast<int>(bytes.size()));
+}
+
+//! Разбирает разделы Markdown с \a begin по \a end.
+std::vector<Note> parseMarkdown(const Input &in, std::size_t begin, std::size_t end)
+{
+    std::vector<Note> notes;
+    // Текст до первого заголовка второго уровня не относится к заметкам
+    std::size_t pos = begin;
+    while (pos < end && !in.startsWith(pos, "## "))
+    {
+        pos = in.nextLine(pos);
+    }
+    while (pos < end)
+    {
+        std::size_t titleEnd = in.lineEnd(pos);
+        std::size_t body = std::min(titleEnd + 1, end);
+        std::size_t next = body;
+        while (next < end && !in.startsWith(next, "## "))
+        {
+            next = in.nextLine(next);
+        }
+        notes.emplace_back(in.decode(pos + 3, in.trimmed(pos + 3, titleEnd) - pos - 3),
+                           markdownText(in, body, next));
+        pos = next;
+    }
+    return notes;
+}
+
+/*!
+ * \brief Разборщик объекта JSON из одной строки JSON Lines.
+ *
+ * Понимает только объекты со строковыми значениями, чего достаточно для
+ * файлов NoteExporter. Для остальных объектов parse() возвращает
+ * \c false, и строка разбирается QJsonDocument.
+ */
+class JsonLine
+{
+public:
+    //! Конструктор. Строка занимает байты с \a p по \a end.
+    JsonLine(const char *p, const char *end)
+        : mP(p)
+        , mEnd(end)
+    {
+    }
+    //! Разбирает объект, записывая значения полей title и text в \a title и \a text.
+    bool parse(QString &title, QString &text)
+    {
+        skip();
+        if (!eat('{'))
+        {
+            return false;
+        }
+        skip();
+        if (eat('}'))
+        {
+            return atEnd();
+        }
+        for (;;)
+        {
+            QString key, value;
+            skip();
+            if (!string(key))
+            {
+                return false;
+            }
+            skip();
+            if (!eat(':'))
+            {
+                return false;
+            }
+            skip();
+            if (!string(value))
+            {
+                return false;
+            }
+            if (key == QLatin1String("title"))
+            {
+                title = value;
+            }
+            else if (key == QLatin1String("text"))
+            {
+                text = value;
+            }
+            skip();
+            if (eat(','))
+            {
+                continue;
+            }
+            return eat('}') && atEnd();
+        }
+    }
+
+private:
+    //! Пропускает пробельные символы и возвращает \c true, если строка закончилась.
+    bool atEnd()
+    {
+        skip();
+        return mP == mEnd;
+    }
+    //! Пропускает пробельные символы.
+    void skip()
+    {
+        while (mP < mEnd && (*mP == ' ' || *mP == '\t' || *mP == '\r' || *mP == '\n'))
+        {
+            ++mP;
+        }
+    }
+    //! Пропускает символ \a c, если строка продолжается им.
+    bool eat(char c)
+    {
+        if (mP < mEnd && *mP == c)
+        {
+            ++mP;
+            return true;
+        }
+        return false;
+    }
+    //! Разбирает строку JSON в \a out.
+    bool string(QString &out)
+    {
+        if (!eat('"'))
+        {
+            return false;
+        }
+        // Участки без экранирования декодируются целиком
+        const char *run = mP;
+        while (mP < mEnd)
+        {
+            char c = *mP;
+            if (c == '"')
+            {
+                out += QString::fromUtf8(run, static_cast<int>(mP - run));
+                ++mP;
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                return false;
+            }
+            if (c != '\\')
+            {
+                ++mP;
+                continue;
+            }
+            out += QString::fromUtf8(run, static_cast<int>(mP - run));
+            if (++mP == mEnd)
+            {
+                return false;
+            }
+            switch (*mP++)
+            {
+            case '"': out += QLatin1Char('"'); break;
+            case '\\': out += QLatin1Char('\\'); break;
+            case '/': out += QLatin1Char('/'); break;
+            case 'b': out += QLatin1Char('\b'); break;
+            case 'f': out += QLatin1Char('\f'); break;
+            case 'n': out += QLatin1Char('\n'); break;
+            case 'r': out += QLatin1Char('\r'); break;
+            case 't': out += QLatin1Char('\t'); break;
+            case 'u':
+            {
+                // Суррогатные пары записываются двумя escape-последовательностями
+                // и попадают в строку UTF-16 как есть
+                if (mEnd - mP < 4)
+                {
+                    return false;
+                }
+                ushort u = 0;
+                for (int i = 0; i < 4; ++i, ++mP)
+                {
+                    char h = *mP;
+                    int v = h >= '0' && h <= '9' ? h - '0'
+                          : h >= 'a' && h <= 'f' ? h - 'a' + 10
+                          : h >= 'A' && h <= 'F' ? h - 'A' + 10 : -1;
+                    if (v < 0)
+                    {
+                        return false;
+                    }
+                    u = static_cast<ushort>(u * 16 + v);
+                }
+                out += QChar(u);
+                break;
+            }
+            default:
+                return false;
+            }
+            run = mP;
+        }
+        return false;
+    }
+
+    //! Текущая позиция.
+    const char *mP;
+    //! Конец строки.
+    const char *mEnd;
+};
+
+//! Разбирает строки JSON Lines с \a begin по \a end.
+std::vector<Note> parseJsonLines(const Input &in, std::size_t begin, std::size_t end)
+{
+    std::vector<Note> notes;
+    for (std::size_t pos = begin; pos < end; pos = in.nextLine(pos))
+    {
+        std::size_t lineEnd = std::min(in.lineEnd(pos), end);
+        const char *p = in.data + pos, *e = in.data + lineEnd;
+        while (p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            ++p;
+        }
+        if (p == e)
+        {
+            continue;
+        }
+        QString title, text;
+        if (!JsonLine(p, e).parse(title, text))
+        {
+            QJsonParseError error;
+            QJsonDocument doc = QJsonDocument::fromJson(
+                        QByteArray::fromRawData(p, static_cast<int>(e - p)), &error);
+            if (error.error != QJsonParseError::NoError || !doc.isObject())
+            {
+                throw in.error(pos);
+            }
+            QJsonObject o = doc.object();
+            title = o.value(QStringLiteral("title")).toString();
+            text = o.value(QStringLiteral("text")).toString();
+        }
+        notes.emplace_back(title, text);
+    }
+    return notes;
+}
+
+//! Разбирает записи формата \a format с \a begin по \a end.
+std::vector<Note> parseSegment(const Input &in, NoteExporter::Format format, std::size_t begin, std::size_t end)
+{
+    switch (format)
+    {
+    case NoteExporter::Text:
+        return parseText(in, begin, end);
+    case NoteExporter::Markdown:
+        return parseMarkdown(in, begin, end);
+    case NoteExporter::JsonLines:
+        break;
+    }
+    return parseJsonLines(in, begin, end);
+}
+
+}
+
+std::vector<Note> NoteImporter::read(const QString &fileName)
+{
+    return read(fileName, NoteExporter::formatForFileName(fileName));
+}
+
+std::vector<Note> NoteImporter::read(const QString &fileName, NoteExporter::Format format)
+{
+    TRACE_SCOPE("NoteImporter::read");
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        throw std::runtime_error(tr("Unable to open %1: %2").arg(fileName, f.errorString()).toStdString());
+    }
+    qint64 size = f.size();
+    // Размер известен только у обычных файлов: у каналов и устройств он
+    // равен 0, хотя данные в них есть, поэтому их пустоту определяет чтение
+    if (size == 0 && QFileInfo(fileName).isFile())
+    {
+        return std::vector<Note>();
+    }
+    // Отображение остаётся действительным, пока открыт файл
+    if (const uchar *map = size > 0 ? f.map(0, size) : nullptr)
+    {
+        return parse(reinterpret_cast<const char *>(map), static_cast<std::size_t>(size), format, fileName);
+    }
+    // Файлы, которые нельзя отобразить в память (например, каналы), читаются целиком
+    QByteArray data = f.readAll();
+    if (data.isEmpty())
+    {
+        return std::vector<Note>();
+    }
+    return parse(data.constData(), static_cast<std::size_t>(data.size()), format, fileName);
+}
+
+/*!
+ * Данные делятся примерно на равные части, по несколько на поток, а
+ * границы частей сдвигаются вперёд до начала ближайшей записи.
+ */
+std::vector<Note> NoteImporter::parse(const char *data, std::size_t size, NoteExporter::Format format,
+                                      const QString &name)
+{
+    TRACE_SCOPE("NoteImporter::parse");
+    Input in(data, size, name);
+    std::size_t parts = std::min(static_cast<std::size_t>(QThreadPool::globalInstance()->maxThreadCount()) * 4,
+                                 size / minPartSize);
+    parts = std::max<std::size_t>(parts, 1);
+    std::vector<Segment> segments;
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i <= parts && begin < size; ++i)
+    {
+        std::size_t end = i == parts ? size : boundary(in, format, size / parts * i);
+        if (end > begin)
+        {
+            segments.push_back(Segment{ begin, end, std::vector<Note>(), QString() });
+            begin = end;
+        }
+    }
+    QtConcurrent::blockingMap(segments, [&in, format](Segment &s) {
+        TRACE_SCOPE("NoteImporter segment");
+        try
+        {
+            s.notes = parseSegment(in, format, s.begin, s.end);
+        }
+        catch (const std::exception &e)
+        {
+            s.error = QString::fromUtf8(e.what());
+        }
+    });
+    std::size_t total = 0;
+    for (const Segment &s : segments)
+    {
+        if (!s.error.isEmpty())
+        {
+            throw std::runtime_error(s.error.toStdString());
+        }
+        total += s.notes.size();
+    }
+    std::vector<Note> notes;
+    notes.reserve(total);
+    for (Segment &s : segments)
+    {
+        std::move(s.notes.begin(), s.notes.end(), std::back_inserter(notes));
+    }
+    return notes;
+}
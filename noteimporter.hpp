@@ -0,0 +1,62 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteImporter.
+ */
+#ifndef NOTEIMPORTER_HPP
+#define NOTEIMPORTER_HPP
+
+#include <cstddef> // size_t
+#include <vector>
+
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QString>
+
+#include "note.hpp"
+#include "noteexporter.hpp"
+
+/*!
+ * \brief Класс чтения заметок из текстовых форматов.
+ *
+ * Читает форматы, в которые выгружает заметки NoteExporter: текстовый
+ * формат «Save As Text», Markdown и JSON Lines. Из Markdown читаются
+ * разделы с заголовками второго уровня ("## "); текст до первого такого
+ * заголовка пропускается. Из JSON Lines читаются строковые поля \c title
+ * и \c text каждого объекта, остальные поля пропускаются.
+ *
+ * Файл отображается в память и делится на части по границам записей:
+ * в текстовом формате — по строкам "+++ k/N +++", которым предшествует
+ * строка "--- k-1/N ---", в Markdown — по заголовкам, в JSON Lines — по
+ * переводам строк. Части разбираются параллельно в пуле потоков
+ * QtConcurrent прямо из отображения, без промежуточных копий файла, а их
+ * заметки соединяются по порядку.
+ *
+ * Методы не обращаются к объектам графического интерфейса и могут
+ * вызываться из рабочего потока.
+ */
+class NoteImporter
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NoteImporter)
+public:
+    /*!
+     * \brief Читает заметки из файла \a fileName.
+     *
+     * Формат определяется по расширению имени файла (см.
+     * NoteExporter::formatForFileName()). В случае ошибки запускает
+     * исключительную ситуацию.
+     */
+    static std::vector<Note> read(const QString &fileName);
+    //! Читает заметки из файла \a fileName в формате \a format. В случае ошибки запускает исключительную ситуацию.
+    static std::vector<Note> read(const QString &fileName, NoteExporter::Format format);
+    /*!
+     * \brief Разбирает \a size байтов \a data в формате \a format.
+     *
+     * В случае ошибки запускает исключительную ситуацию, сообщение которой
+     * начинается с \a name и содержит смещение ошибочной записи.
+     */
+    static std::vector<Note> parse(const char *data, std::size_t size, NoteExporter::Format format,
+                                   const QString &name = QString());
+};
+
+#endif // NOTEIMPORTER_HPP
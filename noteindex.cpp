@@ -0,0 +1,435 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteIndex.
+ */
+#include "noteindex.hpp"
+
+#include <algorithm> // lower_bound(), remove_if(), set_difference(), set_intersection(), set_union(), sort(), unique()
+#include <initializer_list>
+#include <iterator> // back_inserter()
+
+#include "workerpool.hpp"
+
+namespace
+{
+
+//! Упорядоченный список идентификаторов заметок.
+using IdList = std::vector<Notebook::NoteId>;
+
+/*!
+ * \brief Возвращает пересечение упорядоченных списков \a small и \a large.
+ *
+ * Если один список намного длиннее другого, элементы короткого ищутся
+ * в длинном двоичным поиском, иначе списки сливаются за линейное время.
+ */
+IdList intersect(const IdList &small, const IdList &large)
+{
+    IdList result;
+    if (large.size() / 8 > small.size())
+    {
+        auto from = large.begin();
+        for (Notebook::NoteId id : small)
+        {
+            from = std::lower_bound(from, large.end(), id);
+            if (from == large.end())
+            {
+                break;
+            }
+            if (*from == id)
+            {
+                result.push_back(id);
+            }
+        }
+    }
+    else
+    {
+        std::set_intersection(small.begin(), small.end(), large.begin(), large.end(),
+                              std::back_inserter(result));
+    }
+    return result;
+}
+
+//! Возвращает объединение упорядоченных списков \a a и \a b.
+IdList unite(const IdList &a, const IdList &b)
+{
+    IdList result;
+    result.reserve(a.size() + b.size());
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+}
+
+NoteIndex::NoteIndex(Notebook *notebook, QObject *parent)
+    : QObject(parent)
+    , mNotebook(notebook)
+{
+    connect(notebook, &Notebook::rowsInserted, this,
+            [this](const QModelIndex &, int first, int last) { notesInserted(first, last); });
+    // Идентификаторы удаляемых заметок можно узнать только до удаления
+    connect(notebook, &Notebook::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &, int first, int last) { notesAboutToBeRemoved(first, last); });
+    connect(notebook, &Notebook::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        // Если модель не сообщила, какие строки изменились, строим индекс заново
+        if (!topLeft.isValid() || !bottomRight.isValid())
+        {
+            rebuild();
+            return;
+        }
+        notesChanged(topLeft.row(), bottomRight.row());
+    });
+    connect(notebook, &Notebook::modelReset, this, &NoteIndex::rebuild);
+    connect(&mWatcher, &QFutureWatcher<std::shared_ptr<Data>>::finished, this, &NoteIndex::buildFinished);
+    rebuild();
+}
+
+/*!
+ * Терм — это последовательность букв и цифр. Термы приводятся к единому
+ * регистру (см. QString::toCaseFolded()), поэтому поиск не зависит от регистра.
+ */
+QStringList NoteIndex::tokenize(const QString &text)
+{
+    QStringList tokens;
+    QString token;
+    for (QChar ch : text)
+    {
+        if (ch.isLetterOrNumber())
+        {
+            token += ch.toCaseFolded();
+        }
+        else if (!token.isEmpty())
+        {
+            tokens.append(token);
+            token.clear();
+        }
+    }
+    if (!token.isEmpty())
+    {
+        tokens.append(token);
+    }
+    return tokens;
+}
+
+bool NoteIndex::isReady() const
+{
+    return static_cast<bool>(mData);
+}
+
+/*!
+ * В потоке интерфейса делается только снимок записной книжки (см.
+ * Notebook::snapshot()), разбор заметок выполняется в рабочем потоке.
+ * Если индекс уже строился, результат прежнего построения будет проигнорирован.
+ */
+void NoteIndex::rebuild()
+{
+    mData.reset();
+    mDeferred.clear();
+    std::shared_ptr<const std::vector<NoteId>> ids(new std::vector<NoteId>(mNotebook->ids()));
+    std::shared_ptr<const std::vector<Note>> notes(new std::vector<Note>(mNotebook->snapshot()));
+    // Индекс строится от имени записной книжки, поэтому построение индекса
+    // большой записной книжки не задерживает работу с остальными
+    mWatcher.setFuture(WorkerPool::instance().run<std::shared_ptr<Data>>(mNotebook, [ids, notes]() {
+        std::shared_ptr<Data> data(new Data);
+        for (std::size_t i = 0; i < notes->size(); ++i)
+        {
+            data->add((*ids)[i], (*notes)[i]);
+        }
+        return data;
+    }));
+}
+
+std::vector<NoteIndex::NoteId> NoteIndex::search(const QString &query) const
+{
+    IdList result;
+    if (!mData)
+    {
+        return result;
+    }
+    // Разбиваем запрос на альтернативы, разделённые словом OR
+    std::vector<QStringList> clauses(1);
+    for (const QString &word : query.split(QLatin1Char(' '), QString::SkipEmptyParts))
+    {
+        if (word == QLatin1String("OR"))
+        {
+            clauses.emplace_back();
+        }
+        else
+        {
+            clauses.back().append(word);
+        }
+    }
+    for (const QStringList &clause : clauses)
+    {
+        // Объединённые списки для слов со звёздочкой
+        std::deque<Postings> storage;
+        // Списки заметок для всех термов альтернативы
+        std::vector<const Postings *> lists;
+        bool found = true;
+        for (const QString &word : clause)
+        {
+            bool prefix = word.endsWith(QLatin1Char('*'));
+            // Слово запроса может состоять из нескольких термов, например
+            // "qt-based"; звёздочка относится к последнему из них
+            QStringList terms = tokenize(prefix ? word.left(word.size() - 1) : word);
+            for (int i = 0; i < terms.size() && found; ++i)
+            {
+                const Postings *list = lookup(terms[i], prefix && i == terms.size() - 1, storage);
+                if (list)
+                {
+                    lists.push_back(list);
+                }
+                else
+                {
+                    found = false;
+                }
+            }
+        }
+        if (!found || lists.empty())
+        {
+            continue;
+        }
+        // Пересекаем списки, начиная с самых коротких: промежуточный
+        // результат при этом остаётся минимальным
+        std::sort(lists.begin(), lists.end(),
+                  [](const Postings *a, const Postings *b) { return a->size() < b->size(); });
+        IdList matches = *lists.front();
+        for (std::size_t i = 1; i < lists.size() && !matches.empty(); ++i)
+        {
+            matches = intersect(matches, *lists[i]);
+        }
+        result = result.empty() ? std::move(matches) : unite(result, matches);
+    }
+    // Удалённые заметки могут ещё оставаться в списках
+    if (!mData->removed.empty())
+    {
+        result.erase(std::remove_if(result.begin(), result.end(), [this](NoteId id) {
+            return mData->removed.count(id) != 0;
+        }), result.end());
+    }
+    return result;
+}
+
+void NoteIndex::notesInserted(int first, int last)
+{
+    for (int row = first; row <= last; ++row)
+    {
+        if (mData)
+        {
+            mData->add(mNotebook->idAt(row), (*mNotebook)[row]);
+        }
+        else
+        {
+            mDeferred.emplace_back(Add, mNotebook->idAt(row));
+        }
+    }
+}
+
+void NoteIndex::notesAboutToBeRemoved(int first, int last)
+{
+    for (int row = first; row <= last; ++row)
+    {
+        if (mData)
+        {
+            mData->remove(mNotebook->idAt(row));
+        }
+        else
+        {
+            mDeferred.emplace_back(Remove, mNotebook->idAt(row));
+        }
+    }
+}
+
+void NoteIndex::notesChanged(int first, int last)
+{
+    for (int row = first; row <= last; ++row)
+    {
+        if (mData)
+        {
+            mData->update(mNotebook->idAt(row), (*mNotebook)[row]);
+        }
+        else
+        {
+            mDeferred.emplace_back(Add, mNotebook->idAt(row));
+        }
+    }
+}
+
+void NoteIndex::buildFinished()
+{
+    mData = mWatcher.result();
+    // Применяем изменения, сделанные во время построения. Заметки берём
+    // в их текущем состоянии; если заметка уже удалена, её пропускаем
+    for (const auto &deferred : mDeferred)
+    {
+        if (deferred.first == Remove)
+        {
+            mData->remove(deferred.second);
+        }
+        else
+        {
+            Notebook::SizeType row = mNotebook->rowOf(deferred.second);
+            if (row >= 0)
+            {
+                mData->update(deferred.second, (*mNotebook)[row]);
+            }
+        }
+    }
+    mDeferred.clear();
+    emit ready();
+}
+
+const NoteIndex::Postings *NoteIndex::lookup(const QString &term, bool prefix,
+                                             std::deque<Postings> &storage) const
+{
+    if (!prefix)
+    {
+        auto it = mData->terms.find(term);
+        return it != mData->terms.end() ? &mData->postings[it->second] : nullptr;
+    }
+    // Термы, начинающиеся с term, идут в словаре подряд, начиная с term
+    std::vector<const Postings *> lists;
+    for (auto it = mData->terms.lower_bound(term);
+         it != mData->terms.end() && it->first.startsWith(term); ++it)
+    {
+        lists.push_back(&mData->postings[it->second]);
+    }
+    if (lists.empty())
+    {
+        return nullptr;
+    }
+    if (lists.size() == 1)
+    {
+        return lists.front();
+    }
+    storage.emplace_back();
+    Postings &merged = storage.back();
+    for (const Postings *list : lists)
+    {
+        merged.insert(merged.end(), list->begin(), list->end());
+    }
+    std::sort(merged.begin(), merged.end());
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+    return &merged;
+}
+
+std::vector<NoteIndex::TermId> NoteIndex::Data::termsOf(const Note &note)
+{
+    std::vector<TermId> ids;
+    for (const QString &text : { note.title(), note.text() })
+    {
+        for (const QString &term : tokenize(text))
+        {
+            auto it = terms.find(term);
+            if (it == terms.end())
+            {
+                // Новый терм получает следующий свободный номер
+                it = terms.emplace(term, static_cast<TermId>(postings.size())).first;
+                postings.emplace_back();
+            }
+            ids.push_back(it->second);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+void NoteIndex::Data::add(NoteId id, const Note &note)
+{
+    // Заметка могла быть удалена и добавлена снова (например, при отмене
+    // удаления) с тем же идентификатором. Тогда она ещё остаётся в списках
+    // своих прежних термов: вычёркиваем её оттуда, иначе поиск находил бы
+    // её по словам, которых в ней может уже не быть
+    auto stale = removed.find(id);
+    if (stale != removed.end())
+    {
+        for (TermId term : stale->second)
+        {
+            Postings &list = postings[term];
+            auto pos = std::lower_bound(list.begin(), list.end(), id);
+            if (pos != list.end() && *pos == id)
+            {
+                list.erase(pos);
+            }
+        }
+        removed.erase(stale);
+    }
+    std::vector<TermId> noteTerms = termsOf(note);
+    for (TermId term : noteTerms)
+    {
+        Postings &list = postings[term];
+        // Новые заметки получают наибольшие идентификаторы, поэтому обычно
+        // достаточно добавить идентификатор в конец списка
+        if (list.empty() || list.back() < id)
+        {
+            list.push_back(id);
+        }
+        else
+        {
+            list.insert(std::lower_bound(list.begin(), list.end(), id), id);
+        }
+    }
+    forward[id] = std::move(noteTerms);
+}
+
+void NoteIndex::Data::update(NoteId id, const Note &note)
+{
+    auto it = forward.find(id);
+    if (it == forward.end())
+    {
+        add(id, note);
+        return;
+    }
+    std::vector<TermId> newTerms = termsOf(note);
+    std::vector<TermId> &oldTerms = it->second;
+    // Меняем только списки термов, которые исчезли из заметки или появились в ней
+    std::vector<TermId> gone, appeared;
+    std::set_difference(oldTerms.begin(), oldTerms.end(), newTerms.begin(), newTerms.end(),
+                        std::back_inserter(gone));
+    std::set_difference(newTerms.begin(), newTerms.end(), oldTerms.begin(), oldTerms.end(),
+                        std::back_inserter(appeared));
+    for (TermId term : gone)
+    {
+        Postings &list = postings[term];
+        auto pos = std::lower_bound(list.begin(), list.end(), id);
+        if (pos != list.end() && *pos == id)
+        {
+            list.erase(pos);
+        }
+    }
+    for (TermId term : appeared)
+    {
+        Postings &list = postings[term];
+        list.insert(std::lower_bound(list.begin(), list.end(), id), id);
+    }
+    oldTerms = std::move(newTerms);
+}
+
+void NoteIndex::Data::remove(NoteId id)
+{
+    auto it = forward.find(id);
+    if (it == forward.end())
+    {
+        return;
+    }
+    // Вычёркивать заметку из каждого списка дорого, особенно при удалении
+    // многих заметок подряд, поэтому только отмечаем её
+    removed[id] = std::move(it->second);
+    forward.erase(it);
+    if (removed.size() > 1024 && removed.size() * 4 > forward.size())
+    {
+        purge();
+    }
+}
+
+void NoteIndex::Data::purge()
+{
+    for (Postings &list : postings)
+    {
+        list.erase(std::remove_if(list.begin(), list.end(), [this](NoteId id) {
+            return removed.count(id) != 0;
+        }), list.end());
+    }
+    removed.clear();
+}
@@ -0,0 +1,157 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteIndex.
+ */
+#ifndef NOTEINDEX_HPP
+#define NOTEINDEX_HPP
+
+#include <deque>
+#include <map>
+#include <memory> // shared_ptr
+#include <unordered_map>
+#include <utility> // pair
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "notebook.hpp"
+
+/*!
+ * \brief Класс полнотекстового индекса заметок.
+ *
+ * Индекс является \e инвертированным: для каждого слова (\e терма),
+ * встречающегося в заголовках и текстах заметок, хранится упорядоченный
+ * по возрастанию список идентификаторов заметок, в которых оно встречается
+ * (см. Notebook::NoteId). Поиск сводится к пересечению и объединению таких
+ * списков и не требует просмотра самих заметок.
+ *
+ * Термы получаются методом tokenize(): это последовательности букв и цифр,
+ * приведённые к единому регистру. Строки термов хранятся в словаре один раз,
+ * а списки и прямой индекс (термы каждой заметки) ссылаются на них по номеру.
+ *
+ * Индекс следит за сигналами модели Notebook и обновляется по мере вставки,
+ * изменения и удаления заметок. Удалённые заметки не вычёркиваются из
+ * списков сразу, а отмечаются и отфильтровываются при поиске; списки
+ * очищаются, когда таких заметок накапливается достаточно много.
+ *
+ * При создании индекса и после сброса модели (например, загрузки файла)
+ * индекс строится заново в рабочем потоке по снимку записной книжки. Пока
+ * он строится, isReady() возвращает \c false, а изменения записной книжки
+ * запоминаются и применяются к построенному индексу. Об окончании
+ * построения сообщает сигнал ready().
+ */
+class NoteIndex : public QObject
+{
+    Q_OBJECT
+public:
+    //! Тип идентификаторов заметок.
+    using NoteId = Notebook::NoteId;
+
+    /*!
+     * \brief Конструктор.
+     * \param notebook Индексируемая записная книжка. Должна существовать,
+     * пока существует индекс.
+     * \param parent Родительский объект.
+     *
+     * Запускает построение индекса в рабочем потоке.
+     */
+    explicit NoteIndex(Notebook *notebook, QObject *parent = nullptr);
+
+    //! Разбивает строку \a text на термы.
+    static QStringList tokenize(const QString &text);
+
+    //! Возвращает \c true, если индекс построен и может использоваться для поиска.
+    bool isReady() const;
+    //! Запускает построение индекса заново в рабочем потоке.
+    void rebuild();
+    /*!
+     * \brief Ищет заметки, соответствующие запросу \a query.
+     * \return Идентификаторы найденных заметок по возрастанию.
+     *
+     * Запрос состоит из слов, разделённых пробелами. Заметка должна содержать
+     * все слова запроса (И). Слово \c OR разделяет альтернативы (ИЛИ):
+     * запрос <tt>qt model OR view</tt> находит заметки, содержащие оба слова
+     * \c qt и \c model или слово \c view. Звёздочка в конце слова означает
+     * поиск по началу слова: \c mod* соответствует \c model, \c modern и т. д.
+     *
+     * Пока индекс не построен, возвращает пустой список.
+     */
+    std::vector<NoteId> search(const QString &query) const;
+
+signals:
+    //! Сигнализирует, что индекс построен.
+    void ready();
+
+private:
+    //! Тип номеров термов в словаре.
+    using TermId = quint32;
+    //! Список идентификаторов заметок, упорядоченный по возрастанию.
+    using Postings = std::vector<NoteId>;
+
+    //! Данные индекса. Строятся в рабочем потоке целиком, а затем передаются объекту.
+    struct Data
+    {
+        //! Словарь термов. Упорядочен, что позволяет искать термы по началу.
+        std::map<QString, TermId> terms;
+        //! Списки заметок для каждого терма.
+        std::vector<Postings> postings;
+        //! Прямой индекс: упорядоченные номера термов каждой заметки.
+        std::unordered_map<NoteId, std::vector<TermId>> forward;
+        /*!
+         * \brief Удалённые заметки, ещё не вычеркнутые из списков, и их термы.
+         *
+         * Термы нужны, чтобы вычеркнуть заметку из её списков, если она
+         * добавляется снова (например, при отмене удаления).
+         */
+        std::unordered_map<NoteId, std::vector<TermId>> removed;
+
+        //! Возвращает упорядоченные номера термов заметки \a note, добавляя новые термы в словарь.
+        std::vector<TermId> termsOf(const Note &note);
+        //! Добавляет в индекс заметку \a note с идентификатором \a id.
+        void add(NoteId id, const Note &note);
+        //! Заменяет в индексе заметку с идентификатором \a id на \a note.
+        void update(NoteId id, const Note &note);
+        //! Удаляет из индекса заметку с идентификатором \a id.
+        void remove(NoteId id);
+        //! Вычёркивает удалённые заметки из всех списков.
+        void purge();
+    };
+
+    //! Тип изменения записной книжки, отложенного до окончания построения индекса.
+    enum Operation
+    {
+        Add,   //!< Заметка добавлена или изменена
+        Remove //!< Заметка удалена
+    };
+
+    //! Обрабатывает вставку строк с \a first по \a last.
+    void notesInserted(int first, int last);
+    //! Обрабатывает удаление строк с \a first по \a last (до удаления).
+    void notesAboutToBeRemoved(int first, int last);
+    //! Обрабатывает изменение строк с \a first по \a last.
+    void notesChanged(int first, int last);
+    //! Принимает построенный индекс и применяет отложенные изменения.
+    void buildFinished();
+    /*!
+     * \brief Возвращает список заметок, содержащих терм \a term.
+     *
+     * Если \a prefix равен \c true, возвращает объединение списков всех
+     * термов, начинающихся с \a term; объединённый список размещается
+     * в \a storage. Если таких термов нет, возвращает нулевой указатель.
+     */
+    const Postings *lookup(const QString &term, bool prefix, std::deque<Postings> &storage) const;
+
+    //! Индексируемая записная книжка.
+    Notebook *mNotebook;
+    //! Данные построенного индекса (нулевой указатель, пока индекс строится).
+    std::shared_ptr<Data> mData;
+    //! Изменения, сделанные во время построения индекса.
+    std::vector<std::pair<Operation, NoteId>> mDeferred;
+    //! Наблюдатель за построением индекса в рабочем потоке.
+    QFutureWatcher<std::shared_ptr<Data>> mWatcher;
+};
+
+#endif // NOTEINDEX_HPP
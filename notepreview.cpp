@@ -0,0 +1,158 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NotePreview.
+ */
+#include "notepreview.hpp"
+
+#include <algorithm> // max(), min()
+
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include "trace.hpp"
+
+namespace
+{
+
+//! Отступ текста от края видимой области в пикселях.
+const int margin = 4;
+
+}
+
+NotePreview::NotePreview(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , mLines(1, 0)
+    , mMaxLineLength(0)
+{
+    // Столбцы одинаковой ширины позволяют прокручивать текст по столбцам,
+    // не измеряя строки
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setFocusPolicy(Qt::StrongFocus);
+    verticalScrollBar()->setSingleStep(1);
+    horizontalScrollBar()->setSingleStep(1);
+}
+
+QString NotePreview::text() const
+{
+    return mText;
+}
+
+void NotePreview::setText(const QString &text)
+{
+    TRACE_SCOPE("NotePreview::setText");
+    mText = text;
+    mLines.assign(1, 0);
+    mMaxLineLength = 0;
+    // Один проход по тексту: запоминаем начала строк и длину самой длинной
+    for (int pos = mText.indexOf(QLatin1Char('\n')); pos >= 0; pos = mText.indexOf(QLatin1Char('\n'), pos + 1))
+    {
+        mMaxLineLength = std::max(mMaxLineLength, pos - mLines.back());
+        mLines.push_back(pos + 1);
+    }
+    mMaxLineLength = std::max(mMaxLineLength, mText.size() - mLines.back());
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    updateScrollBars();
+    viewport()->update();
+}
+
+int NotePreview::lineCount() const
+{
+    return static_cast<int>(mLines.size());
+}
+
+void NotePreview::paintEvent(QPaintEvent *)
+{
+    QPainter painter(viewport());
+    painter.setPen(palette().color(QPalette::Text));
+    QFontMetrics metrics(font());
+    const int charWidth = std::max(metrics.averageCharWidth(), 1);
+    const int firstLine = verticalScrollBar()->value();
+    const int lastLine = std::min(firstLine + visibleLines() + 1, lineCount());
+    const int firstColumn = horizontalScrollBar()->value();
+    const int columns = visibleColumns() + 1;
+    int y = margin + metrics.ascent();
+    for (int line = firstLine; line < lastLine; ++line, y += metrics.lineSpacing())
+    {
+        int begin = mLines[line];
+        int end = line + 1 < lineCount() ? mLines[line + 1] - 1 : mText.size();
+        if (end > begin && mText.at(end - 1) == QLatin1Char('\r'))
+        {
+            --end;
+        }
+        // Копируем только видимые столбцы строки
+        begin += firstColumn;
+        if (begin >= end)
+        {
+            continue;
+        }
+        QString visible = mText.mid(begin, std::min(end - begin, columns));
+        visible.replace(QLatin1Char('\t'), QLatin1Char(' '));
+        painter.drawText(margin, y, visible);
+    }
+}
+
+void NotePreview::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void NotePreview::keyPressEvent(QKeyEvent *event)
+{
+    QScrollBar *bar = verticalScrollBar();
+    switch (event->key())
+    {
+    case Qt::Key_Up:
+        bar->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        break;
+    case Qt::Key_Down:
+        bar->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        break;
+    case Qt::Key_PageUp:
+        bar->triggerAction(QAbstractSlider::SliderPageStepSub);
+        break;
+    case Qt::Key_PageDown:
+        bar->triggerAction(QAbstractSlider::SliderPageStepAdd);
+        break;
+    case Qt::Key_Home:
+        bar->triggerAction(QAbstractSlider::SliderToMinimum);
+        break;
+    case Qt::Key_End:
+        bar->triggerAction(QAbstractSlider::SliderToMaximum);
+        break;
+    case Qt::Key_Left:
+        horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        break;
+    case Qt::Key_Right:
+        horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void NotePreview::updateScrollBars()
+{
+    int rows = visibleLines();
+    verticalScrollBar()->setPageStep(rows);
+    verticalScrollBar()->setRange(0, std::max(lineCount() - rows, 0));
+    int columns = visibleColumns();
+    horizontalScrollBar()->setPageStep(columns);
+    horizontalScrollBar()->setRange(0, std::max(mMaxLineLength - columns, 0));
+}
+
+int NotePreview::visibleLines() const
+{
+    QFontMetrics metrics(font());
+    return std::max((viewport()->height() - 2 * margin) / std::max(metrics.lineSpacing(), 1), 1);
+}
+
+int NotePreview::visibleColumns() const
+{
+    QFontMetrics metrics(font());
+    return std::max((viewport()->width() - 2 * margin) / std::max(metrics.averageCharWidth(), 1), 1);
+}
@@ -0,0 +1,63 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NotePreview.
+ */
+#ifndef NOTEPREVIEW_HPP
+#define NOTEPREVIEW_HPP
+
+#include <vector>
+
+#include <QAbstractScrollArea>
+#include <QString>
+
+/*!
+ * \brief Класс виджета быстрого просмотра большого текста.
+ *
+ * В отличие от QPlainTextEdit, виджет не строит документ и не размечает
+ * текст: он только запоминает начала строк и при отрисовке выводит строки,
+ * попадающие в видимую область. Поэтому текст в десятки мегабайт
+ * показывается сразу, а прокрутка не зависит от его размера.
+ *
+ * Текст выводится моноширинным шрифтом без переноса строк, полосы
+ * прокрутки измеряются в строках и столбцах. Табуляция показывается
+ * одним пробелом.
+ */
+class NotePreview : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    //! Конструктор с необязательным указанием родительского объекта \a parent.
+    explicit NotePreview(QWidget *parent = nullptr);
+
+    //! Возвращает показываемый текст.
+    QString text() const;
+    //! Показывает текст \a text.
+    void setText(const QString &text);
+    //! Возвращает количество строк текста.
+    int lineCount() const;
+
+protected:
+    //! Отрисовывает видимые строки.
+    void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
+    //! Пересчитывает полосы прокрутки при изменении размера.
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
+    //! Прокручивает текст клавишами перемещения.
+    void keyPressEvent(QKeyEvent *event) Q_DECL_OVERRIDE;
+
+private:
+    //! Настраивает диапазоны полос прокрутки.
+    void updateScrollBars();
+    //! Возвращает количество строк, помещающихся в видимой области.
+    int visibleLines() const;
+    //! Возвращает количество столбцов, помещающихся в видимой области.
+    int visibleColumns() const;
+
+    //! Показываемый текст.
+    QString mText;
+    //! Позиции начала строк в mText.
+    std::vector<int> mLines;
+    //! Длина самой длинной строки в символах.
+    int mMaxLineLength;
+};
+
+#endif // NOTEPREVIEW_HPP
@@ -0,0 +1,429 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteScanner.
+ */
+#include "notescanner.hpp"
+
+#include <algorithm> // equal(), max(), min(), sort()
+#include <initializer_list>
+#include <stdexcept> // runtime_error
+#include <tuple> // tie()
+#include <vector>
+
+#include <QChar>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+// Векторные версии поиска символа собираются только для x86-64 компиляторами
+// GCC и Clang: они позволяют собрать функцию для AVX2 с помощью атрибута
+// target, не требуя AVX2 от остального кода, и проверить возможности
+// процессора встроенной функцией __builtin_cpu_supports(). SSE2 входит
+// в базовый набор инструкций x86-64
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TOYNOTE_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+/*!
+ * \brief Тип функции поиска символа.
+ *
+ * Функция ищет в диапазоне [\a p, \a end) первый символ UTF-16, равный \a a
+ * или \a b, и возвращает указатель на него или \a end, если такого символа нет.
+ */
+using FindFunction = const ushort *(*)(const ushort *p, const ushort *end, ushort a, ushort b);
+
+//! Ищет символ, просматривая строку по одному символу.
+const ushort *findCharScalar(const ushort *p, const ushort *end, ushort a, ushort b)
+{
+    for (; p < end; ++p)
+    {
+        if (*p == a || *p == b)
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef TOYNOTE_SCANNER_X86
+//! Ищет символ, сравнивая по 8 символов за раз инструкциями SSE2.
+const ushort *findCharSse2(const ushort *p, const ushort *end, ushort a, ushort b)
+{
+    const __m128i va = _mm_set1_epi16(static_cast<short>(a));
+    const __m128i vb = _mm_set1_epi16(static_cast<short>(b));
+    for (; end - p >= 8; p += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // Каждому совпавшему символу соответствуют два бита маски
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi16(v, va), _mm_cmpeq_epi16(v, vb))));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask) / 2;
+        }
+    }
+    return findCharScalar(p, end, a, b);
+}
+
+//! Ищет символ, сравнивая по 16 символов за раз инструкциями AVX2.
+__attribute__((target("avx2")))
+const ushort *findCharAvx2(const ushort *p, const ushort *end, ushort a, ushort b)
+{
+    const __m256i va = _mm256_set1_epi16(static_cast<short>(a));
+    const __m256i vb = _mm256_set1_epi16(static_cast<short>(b));
+    for (; end - p >= 16; p += 16)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi16(v, va), _mm256_cmpeq_epi16(v, vb))));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask) / 2;
+        }
+    }
+    return findCharSse2(p, end, a, b);
+}
+#endif
+
+//! Функция поиска символа, выбранная для данного процессора.
+struct FindDispatch
+{
+    //! Функция поиска.
+    FindFunction find;
+    //! Название набора инструкций.
+    const char *name;
+};
+
+//! Выбирает функцию поиска символа по возможностям процессора.
+FindDispatch selectFind()
+{
+#ifdef TOYNOTE_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return FindDispatch{ findCharAvx2, "avx2" };
+    }
+    return FindDispatch{ findCharSse2, "sse2" };
+#else
+    return FindDispatch{ findCharScalar, "scalar" };
+#endif
+}
+
+//! Функция поиска символа. Выбирается один раз при запуске программы.
+const FindDispatch findDispatch = selectFind();
+
+//! Отметка символа, с которым без учёта регистра совпадают два и более других символа (см. casePartners()).
+const ushort manyPartners = 0xFFFF;
+
+/*!
+ * \brief Возвращает таблицу символов, совпадающих без учёта регистра.
+ *
+ * Сравнение без учёта регистра сравнивает символы, приведённые методом
+ * QChar::toCaseFolded(). Для каждого символа базовой плоскости таблица
+ * содержит второй символ, приводимый к тому же, что и он; сам символ, если
+ * такого нет; или manyPartners, если таких символов больше одного (σ, Σ
+ * и ς; k, K и знак кельвина; s, S и ſ и т. п.). Пары строчного и
+ * прописного вариантов не всегда получаются методами toLower() и toUpper()
+ * (например, ß и ẞ), поэтому таблица строится по самому приведению.
+ * Строится при первом обращении.
+ */
+const std::vector<ushort> &casePartners()
+{
+    static const std::vector<ushort> partners = []() {
+        const std::size_t size = 0x10000;
+        // Первые два символа каждого класса, приводимых к одному символу, и размер класса
+        std::vector<ushort> first(size), second(size);
+        std::vector<quint8> count(size, 0);
+        for (std::size_t c = 0; c < size; ++c)
+        {
+            ushort folded = QChar(static_cast<ushort>(c)).toCaseFolded().unicode();
+            if (count[folded] == 0)
+            {
+                first[folded] = static_cast<ushort>(c);
+            }
+            else if (count[folded] == 1)
+            {
+                second[folded] = static_cast<ushort>(c);
+            }
+            count[folded] = static_cast<quint8>(std::min(count[folded] + 1, 3));
+        }
+        std::vector<ushort> result(size);
+        for (std::size_t c = 0; c < size; ++c)
+        {
+            ushort folded = QChar(static_cast<ushort>(c)).toCaseFolded().unicode();
+            if (count[folded] == 1)
+            {
+                result[c] = static_cast<ushort>(c);
+            }
+            else if (count[folded] == 2)
+            {
+                result[c] = first[folded] == c ? second[folded] : first[folded];
+            }
+            else
+            {
+                result[c] = manyPartners;
+            }
+        }
+        return result;
+    }();
+    return partners;
+}
+
+//! Наименьшее количество заметок в одной части записной книжки.
+const std::size_t minChunkSize = 64;
+
+}
+
+NoteScanner::NoteScanner(QObject *parent)
+    : QObject(parent)
+    , mNotebook(nullptr)
+    , mMode(Substring)
+    , mRunning(false)
+    , mCount(0)
+    , mCancel(false)
+    , mChunksDone(0)
+    , mDeliveryScheduled(false)
+{
+    connect(&mWatcher, &QFutureWatcher<void>::finished, this, &NoteScanner::finish);
+}
+
+NoteScanner::~NoteScanner()
+{
+    // Рабочие потоки обращаются к объекту, поэтому дожидаемся их остановки
+    mCancel = true;
+    mWatcher.cancel();
+    mWatcher.waitForFinished();
+}
+
+const char *NoteScanner::simdLevel()
+{
+    return findDispatch.name;
+}
+
+/*!
+ * Кандидаты отбираются по первому символу \a needle. Без учёта регистра
+ * первый символ ищется сразу вместе с совпадающим с ним символом (см.
+ * casePartners()), а кандидат проверяется сравнением без учёта регистра.
+ * Если с первым символом совпадают несколько символов, отбор по двум
+ * символам неприменим, и поиск выполняет QString::indexOf(). Если \a needle
+ * пуста, возвращает -1.
+ */
+int NoteScanner::indexOf(const QString &haystack, const QString &needle, int from,
+                         Qt::CaseSensitivity cs)
+{
+    const int n = needle.size();
+    if (n == 0 || from < 0 || haystack.size() - from < n)
+    {
+        return -1;
+    }
+    ushort a = needle.at(0).unicode();
+    ushort b = a;
+    if (cs == Qt::CaseInsensitive)
+    {
+        // Регистр символов вне базовой плоскости определяется только по
+        // паре суррогатов, отбор по первому символу здесь неприменим
+        if (needle.at(0).isSurrogate())
+        {
+            return haystack.indexOf(needle, from, cs);
+        }
+        b = casePartners()[a];
+        if (b == manyPartners)
+        {
+            return haystack.indexOf(needle, from, cs);
+        }
+    }
+    const ushort *data = haystack.utf16();
+    const ushort *p = data + from;
+    // Подстрока не может начинаться ближе n - 1 символа к концу строки
+    const ushort *last = data + haystack.size() - n + 1;
+    const ushort *rest = needle.utf16() + 1;
+    while ((p = findDispatch.find(p, last, a, b)) != last)
+    {
+        int pos = static_cast<int>(p - data);
+        bool equal = cs == Qt::CaseSensitive
+                ? std::equal(rest, rest + n - 1, p + 1)
+                : QStringRef(&haystack, pos, n).compare(needle, Qt::CaseInsensitive) == 0;
+        if (equal)
+        {
+            return pos;
+        }
+        ++p;
+    }
+    return -1;
+}
+
+void NoteScanner::scan(const Notebook *notebook, const QString &pattern, Mode mode)
+{
+    cancel();
+    if (mode == RegExp)
+    {
+        QRegularExpression re(pattern);
+        if (!re.isValid())
+        {
+            throw std::runtime_error(tr("Invalid regular expression: %1").arg(re.errorString()).toStdString());
+        }
+        // Компилируем выражение сразу, а не в первом рабочем потоке
+        re.optimize();
+        mRegExp = re;
+    }
+    mNotebook = notebook;
+    mPattern = pattern;
+    mMode = mode;
+    mIds.reset(new std::vector<Notebook::NoteId>(notebook->ids()));
+    mNotes.reset(new std::vector<Note>(notebook->snapshot()));
+    // Делим записную книжку на части так, чтобы на каждый поток пришлось
+    // несколько частей: потоки, быстро обработавшие свои части, возьмут
+    // следующие, и работа распределится равномерно
+    mChunks.clear();
+    if (!pattern.isEmpty())
+    {
+        std::size_t count = mNotes->size();
+        std::size_t parts = static_cast<std::size_t>(QThreadPool::globalInstance()->maxThreadCount()) * 8;
+        std::size_t size = std::max(minChunkSize, count / parts + 1);
+        for (std::size_t first = 0; first < count; first += size)
+        {
+            mChunks.push_back(Chunk{ first, std::min(first + size, count) });
+        }
+    }
+    mRunning = true;
+    mCount = 0;
+    mCancel = false;
+    mChunksDone = 0;
+    mFound.clear();
+    // Если записная книжка будет уничтожена, продолжать поиск незачем
+    connect(notebook, &QObject::destroyed, this, &NoteScanner::cancel, Qt::UniqueConnection);
+    mWatcher.setFuture(QtConcurrent::map(mChunks, [this](const Chunk &chunk) { scanChunk(chunk); }));
+}
+
+bool NoteScanner::isRunning() const
+{
+    return mRunning;
+}
+
+void NoteScanner::cancel()
+{
+    if (!mRunning)
+    {
+        return;
+    }
+    mCancel = true;
+    // Новые части больше не обрабатываются, а обрабатываемые прерываются
+    // после текущей заметки
+    mWatcher.cancel();
+    mWatcher.waitForFinished();
+    mRunning = false;
+    mNotebook = nullptr;
+    {
+        QMutexLocker lock(&mMutex);
+        mFound.clear();
+    }
+    mIds.reset();
+    mNotes.reset();
+}
+
+void NoteScanner::scanChunk(const Chunk &chunk)
+{
+    std::vector<Match> found;
+    for (std::size_t i = chunk.first; i < chunk.last; ++i)
+    {
+        if (mCancel)
+        {
+            return;
+        }
+        const Note &note = (*mNotes)[i];
+        Notebook::NoteId id = (*mIds)[i];
+        const QString fields[] = { note.title(), note.text() };
+        for (Field field : { Title, Text })
+        {
+            const QString &s = fields[field];
+            if (mMode == RegExp)
+            {
+                QRegularExpressionMatchIterator it = mRegExp.globalMatch(s);
+                while (it.hasNext())
+                {
+                    QRegularExpressionMatch m = it.next();
+                    found.push_back(Match{ id, -1, field, m.capturedStart(), m.capturedLength() });
+                }
+            }
+            else
+            {
+                Qt::CaseSensitivity cs = mMode == CaseInsensitive ? Qt::CaseInsensitive : Qt::CaseSensitive;
+                for (int pos = indexOf(s, mPattern, 0, cs); pos >= 0;
+                     pos = indexOf(s, mPattern, pos + mPattern.size(), cs))
+                {
+                    found.push_back(Match{ id, -1, field, pos, mPattern.size() });
+                }
+            }
+        }
+    }
+    {
+        QMutexLocker lock(&mMutex);
+        mFound.insert(mFound.end(), found.begin(), found.end());
+    }
+    ++mChunksDone;
+    // Ставим в очередь событий не более одного вызова deliver()
+    if (!mDeliveryScheduled.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, [this]() { deliver(); }, Qt::QueuedConnection);
+    }
+}
+
+void NoteScanner::deliver()
+{
+    mDeliveryScheduled = false;
+    std::vector<Match> found;
+    {
+        QMutexLocker lock(&mMutex);
+        found.swap(mFound);
+    }
+    // Поиск мог быть прерван, пока вызов ждал в очереди
+    if (!mRunning)
+    {
+        return;
+    }
+    // Записная книжка могла измениться после снимка: находим текущие
+    // номера строк и отбрасываем удалённые заметки
+    auto out = found.begin();
+    for (Match &m : found)
+    {
+        m.row = mNotebook->rowOf(m.id);
+        if (m.row >= 0)
+        {
+            *out++ = m;
+        }
+    }
+    found.erase(out, found.end());
+    // Части обрабатываются в произвольном порядке, а идентификаторы могут
+    // идти не по порядку строк, поэтому упорядочиваем совпадения по строкам
+    // и позициям
+    std::sort(found.begin(), found.end(), [](const Match &x, const Match &y) {
+        return std::tie(x.row, x.field, x.offset) < std::tie(y.row, y.field, y.offset);
+    });
+    emit progress(mChunksDone, static_cast<int>(mChunks.size()));
+    if (!found.empty())
+    {
+        mCount += static_cast<int>(found.size());
+        emit matchesFound(found);
+    }
+}
+
+void NoteScanner::finish()
+{
+    // Поиск уже прерван методом cancel()
+    if (!mRunning)
+    {
+        return;
+    }
+    // Передаём последние совпадения
+    deliver();
+    mRunning = false;
+    mNotebook = nullptr;
+    mIds.reset();
+    mNotes.reset();
+    emit finished(mCount);
+}
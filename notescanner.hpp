@@ -0,0 +1,162 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteScanner.
+ */
+#ifndef NOTESCANNER_HPP
+#define NOTESCANNER_HPP
+
+#include <atomic>
+#include <memory> // shared_ptr
+#include <vector>
+
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QObject>
+#include <QRegularExpression>
+#include <QString>
+
+#include "notebook.hpp"
+
+/*!
+ * \brief Класс поиска подстрок и регулярных выражений полным просмотром заметок.
+ *
+ * Полнотекстовый индекс (NoteIndex) находит только целые слова и их начала.
+ * Для произвольных подстрок и регулярных выражений NoteScanner просматривает
+ * заголовки и тексты всех заметок. Записная книжка делится на части, которые
+ * обрабатываются параллельно в пуле потоков QtConcurrent.
+ *
+ * При поиске подстроки кандидаты сначала отбираются по первому символу
+ * образца, а затем проверяются целиком. Первый символ ищется по 8 (SSE2)
+ * или 16 (AVX2) символов UTF-16 за раз; подходящий набор инструкций
+ * выбирается при запуске программы по возможностям процессора (см. simdLevel()).
+ *
+ * Найденные совпадения передаются сигналом matchesFound() по мере их
+ * обнаружения, не дожидаясь окончания поиска.
+ */
+class NoteScanner : public QObject
+{
+    Q_OBJECT
+public:
+    //! Вид образца.
+    enum Mode
+    {
+        Substring,       //!< Подстрока с учётом регистра
+        CaseInsensitive, //!< Подстрока без учёта регистра
+        RegExp           //!< Регулярное выражение (см. QRegularExpression)
+    };
+
+    //! Поле заметки.
+    enum Field
+    {
+        Title, //!< Заголовок
+        Text   //!< Текст
+    };
+
+    //! Совпадение с образцом.
+    struct Match
+    {
+        //! Идентификатор заметки.
+        Notebook::NoteId id;
+        //! Номер строки заметки в записной книжке на момент передачи совпадения.
+        Notebook::SizeType row;
+        //! Поле, в котором найдено совпадение.
+        Field field;
+        //! Смещение совпадения в поле (в символах UTF-16).
+        int offset;
+        //! Длина совпадения (в символах UTF-16).
+        int length;
+    };
+
+    //! Конструктор с необязательным указанием родительского объекта \a parent.
+    explicit NoteScanner(QObject *parent = nullptr);
+    //! Деструктор. Прерывает поиск, если он выполняется.
+    ~NoteScanner();
+
+    //! Возвращает название набора инструкций, используемого для поиска ("avx2", "sse2" или "scalar").
+    static const char *simdLevel();
+    /*!
+     * \brief Ищет подстроку \a needle в строке \a haystack, начиная с позиции \a from.
+     * \return Позиция найденной подстроки или -1.
+     *
+     * Выполняется в вызывающем потоке теми же средствами, что и scan().
+     */
+    static int indexOf(const QString &haystack, const QString &needle, int from = 0,
+                       Qt::CaseSensitivity cs = Qt::CaseSensitive);
+
+    /*!
+     * \brief Начинает поиск образца \a pattern вида \a mode в записной книжке \a notebook.
+     *
+     * Поиск ведётся по снимку записной книжки, поэтому её можно изменять во
+     * время поиска. Если предыдущий поиск не завершён, он прерывается.
+     * Для некорректного регулярного выражения запускает исключительную ситуацию.
+     */
+    void scan(const Notebook *notebook, const QString &pattern, Mode mode);
+    //! Возвращает \c true, если выполняется поиск.
+    bool isRunning() const;
+
+public slots:
+    //! Прерывает поиск. Совпадения, ещё не переданные сигналом matchesFound(), отбрасываются.
+    void cancel();
+
+signals:
+    /*!
+     * \brief Передаёт очередные найденные совпадения \a matches.
+     *
+     * Совпадения в заметках, удалённых после начала поиска, не передаются.
+     */
+    void matchesFound(const std::vector<NoteScanner::Match> &matches);
+    //! Сигнализирует, что просмотрено \a done частей записной книжки из \a total.
+    void progress(int done, int total);
+    //! Сигнализирует, что поиск завершён и найдено \a count совпадений.
+    void finished(int count);
+
+private:
+    //! Часть записной книжки, обрабатываемая одним заданием.
+    struct Chunk
+    {
+        //! Номер первой заметки части в снимке.
+        std::size_t first;
+        //! Номер заметки, следующей за последней заметкой части.
+        std::size_t last;
+    };
+
+    //! Обрабатывает часть \a chunk. Выполняется в рабочем потоке.
+    void scanChunk(const Chunk &chunk);
+    //! Передаёт накопленные совпадения получателям.
+    void deliver();
+    //! Обрабатывает завершение поиска.
+    void finish();
+
+    //! Записная книжка, в которой ведётся поиск.
+    const Notebook *mNotebook;
+    //! Образец.
+    QString mPattern;
+    //! Вид образца.
+    Mode mMode;
+    //! Регулярное выражение (для вида RegExp).
+    QRegularExpression mRegExp;
+    //! Снимок идентификаторов заметок.
+    std::shared_ptr<const std::vector<Notebook::NoteId>> mIds;
+    //! Снимок заметок.
+    std::shared_ptr<const std::vector<Note>> mNotes;
+    //! Части записной книжки. QtConcurrent::map() обходит этот вектор.
+    std::vector<Chunk> mChunks;
+    //! Признак того, что выполняется поиск.
+    bool mRunning;
+    //! Количество переданных совпадений.
+    int mCount;
+    //! Признак запроса на прерывание поиска.
+    std::atomic<bool> mCancel;
+    //! Количество обработанных частей.
+    std::atomic<int> mChunksDone;
+    //! Признак того, что вызов deliver() уже поставлен в очередь событий.
+    std::atomic<bool> mDeliveryScheduled;
+    //! Мьютекс, защищающий mFound.
+    QMutex mMutex;
+    //! Найденные, но ещё не переданные совпадения.
+    std::vector<Match> mFound;
+    //! Наблюдатель за выполнением поиска.
+    QFutureWatcher<void> mWatcher;
+};
+
+#endif // NOTESCANNER_HPP
@@ -0,0 +1,512 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteSortModel.
+ */
+#include "notesortmodel.hpp"
+
+#include <algorithm> // inplace_merge(), merge(), min(), sort(), upper_bound()
+#include <iterator> // next()
+#include <utility> // move()
+
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "trace.hpp"
+
+namespace
+{
+
+//! Количество строк, начиная с которого сортировка выполняется параллельно.
+const std::size_t parallelThreshold = 16384;
+
+/*!
+ * \brief Наибольшее количество мест, в которых строки вставляются или удаляются по отдельности.
+ *
+ * Если изменение затрагивает больше мест, виды уведомляются одним
+ * изменением раскладки, а не отдельной парой сигналов на каждое место.
+ */
+const std::size_t maxSeparateRuns = 64;
+
+//! Часть вектора, сортируемая одним заданием, или две соседние части, сливаемые в одну.
+struct Part
+{
+    //! Начало части.
+    std::size_t first;
+    //! Граница сливаемых частей (для сливания).
+    std::size_t middle;
+    //! Конец части.
+    std::size_t last;
+};
+
+//! Возвращает номера строк с \a first по \a last.
+std::vector<int> rowRange(int first, int last)
+{
+    std::vector<int> rows;
+    rows.reserve(last >= first ? last - first + 1 : 0);
+    for (int row = first; row <= last; ++row)
+    {
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+//! Непрерывный диапазон позиций с \a first по \a last.
+struct Run
+{
+    int first;
+    int last;
+};
+
+//! Объединяет упорядоченные позиции \a positions в непрерывные диапазоны.
+std::vector<Run> runsOf(const std::vector<int> &positions)
+{
+    std::vector<Run> runs;
+    for (int pos : positions)
+    {
+        if (!runs.empty() && runs.back().last + 1 == pos)
+        {
+            runs.back().last = pos;
+        }
+        else
+        {
+            runs.push_back(Run{ pos, pos });
+        }
+    }
+    return runs;
+}
+
+}
+
+NoteSortModel::NoteSortModel(Notebook *notebook, NoteFilterModel *filter, QObject *parent)
+    : QAbstractProxyModel(parent)
+    , mNotebook(notebook)
+    , mFilter(filter)
+    , mColumn(-1)
+    , mOrder(Qt::AscendingOrder)
+    , mRows(rowRange(0, filter->rowCount() - 1))
+    , mPositionsValid(false)
+{
+    QAbstractProxyModel::setSourceModel(filter);
+    // Числа в заголовках сравниваются по значению: "Заметка 2" идёт
+    // раньше "Заметка 10"
+    QCollator collator = notebook->collator();
+    collator.setNumericMode(true);
+    notebook->setCollator(collator);
+
+    connect(filter, &NoteFilterModel::rowsInserted, this,
+            [this](const QModelIndex &, int first, int last) { sourceRowsInserted(first, last); });
+    connect(filter, &NoteFilterModel::rowsAboutToBeRemoved, this,
+            [this](const QModelIndex &, int first, int last) { sourceRowsAboutToBeRemoved(first, last); });
+    connect(filter, &NoteFilterModel::rowsRemoved, this,
+            [this](const QModelIndex &, int first, int last) { sourceRowsRemoved(first, last); });
+    connect(filter, &NoteFilterModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        sourceRowsChanged(topLeft.row(), bottomRight.row());
+    });
+    connect(filter, &NoteFilterModel::modelAboutToBeReset, this, [this] { beginResetModel(); });
+    connect(filter, &NoteFilterModel::modelReset, this, [this] {
+        rebuild();
+        endResetModel();
+    });
+}
+
+int NoteSortModel::sortColumn() const
+{
+    return mColumn;
+}
+
+Qt::SortOrder NoteSortModel::sortOrder() const
+{
+    return mOrder;
+}
+
+QModelIndex NoteSortModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() || column < 0 || column >= columnCount())
+    {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+QModelIndex NoteSortModel::parent(const QModelIndex &) const
+{
+    // Модель табличная, у элементов нет родителей
+    return QModelIndex();
+}
+
+int NoteSortModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(mRows.size());
+}
+
+int NoteSortModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : mFilter->columnCount();
+}
+
+QModelIndex NoteSortModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid())
+    {
+        return QModelIndex();
+    }
+    return mFilter->index(mRows[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex NoteSortModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid())
+    {
+        return QModelIndex();
+    }
+    return createIndex(position(sourceIndex.row()), sourceIndex.column());
+}
+
+QItemSelection NoteSortModel::mapSelectionToSource(const QItemSelection &proxySelection) const
+{
+    std::vector<int> rows;
+    for (const QItemSelectionRange &range : proxySelection)
+    {
+        if (range.isValid())
+        {
+            for (int row = range.top(); row <= range.bottom(); ++row)
+            {
+                rows.push_back(mRows[row]);
+            }
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    QItemSelection result;
+    for (const Run &run : runsOf(rows))
+    {
+        result.append(QItemSelectionRange(mFilter->index(run.first, 0),
+                                          mFilter->index(run.last, columnCount() - 1)));
+    }
+    return result;
+}
+
+QItemSelection NoteSortModel::mapSelectionFromSource(const QItemSelection &sourceSelection) const
+{
+    std::vector<int> positions;
+    for (const QItemSelectionRange &range : sourceSelection)
+    {
+        if (range.isValid())
+        {
+            for (int row = range.top(); row <= range.bottom(); ++row)
+            {
+                positions.push_back(position(row));
+            }
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+    QItemSelection result;
+    for (const Run &run : runsOf(positions))
+    {
+        result.append(QItemSelectionRange(index(run.first, 0), index(run.last, columnCount() - 1)));
+    }
+    return result;
+}
+
+void NoteSortModel::sort(int column, Qt::SortOrder order)
+{
+    mColumn = column >= 0 && column < columnCount() ? column : -1;
+    mOrder = order;
+    std::vector<int> rows = rowRange(0, mFilter->rowCount() - 1);
+    prepareKeys(0, mFilter->rowCount() - 1);
+    sortRows(rows);
+    relayout(std::move(rows));
+}
+
+bool NoteSortModel::lessThan(int x, int y) const
+{
+    if (mColumn >= 0)
+    {
+        int c = mNotebook->sortKey(mFilter->sourceRow(x)).compare(mNotebook->sortKey(mFilter->sourceRow(y)));
+        if (c != 0)
+        {
+            return mOrder == Qt::AscendingOrder ? c < 0 : c > 0;
+        }
+    }
+    // Строки фильтра идут в порядке записной книжки
+    return x < y;
+}
+
+/*!
+ * Строки фильтра идут по возрастанию строк записной книжки, поэтому
+ * вычисляются ключи всех заметок между первой и последней строками, в том
+ * числе не прошедших фильтр: они понадобятся, когда фильтр изменится.
+ */
+void NoteSortModel::prepareKeys(int first, int last)
+{
+    if (mColumn >= 0 && first <= last)
+    {
+        mNotebook->prepareSortKeys(mFilter->sourceRow(first), mFilter->sourceRow(last));
+    }
+}
+
+/*!
+ * Вектор делится на части, по одной на поток, части сортируются
+ * параллельно, а затем соседние части попарно сливаются, тоже параллельно,
+ * пока не останется одна. Во время сортировки поток интерфейса ждёт её
+ * окончания, поэтому записная книжка не изменяется и рабочие потоки могут
+ * читать ключи без блокировок.
+ */
+void NoteSortModel::sortRows(std::vector<int> &rows) const
+{
+    TRACE_SCOPE("NoteSortModel::sortRows");
+    auto less = [this](int x, int y) { return lessThan(x, y); };
+    if (rows.size() < parallelThreshold)
+    {
+        std::sort(rows.begin(), rows.end(), less);
+        return;
+    }
+    std::size_t parts = static_cast<std::size_t>(QThreadPool::globalInstance()->maxThreadCount());
+    std::size_t size = rows.size() / parts + 1;
+    std::vector<Part> sorted;
+    for (std::size_t first = 0; first < rows.size(); first += size)
+    {
+        sorted.push_back(Part{ first, first, std::min(first + size, rows.size()) });
+    }
+    QtConcurrent::blockingMap(sorted, [&rows, &less](const Part &part) {
+        std::sort(std::next(rows.begin(), part.first), std::next(rows.begin(), part.last), less);
+    });
+    while (sorted.size() > 1)
+    {
+        std::vector<Part> merged;
+        for (std::size_t i = 0; i < sorted.size(); i += 2)
+        {
+            if (i + 1 < sorted.size())
+            {
+                merged.push_back(Part{ sorted[i].first, sorted[i].last, sorted[i + 1].last });
+            }
+            else
+            {
+                // Последняя часть без пары переходит в следующий круг как есть
+                merged.push_back(Part{ sorted[i].first, sorted[i].last, sorted[i].last });
+            }
+        }
+        QtConcurrent::blockingMap(merged, [&rows, &less](const Part &part) {
+            std::inplace_merge(std::next(rows.begin(), part.first), std::next(rows.begin(), part.middle),
+                               std::next(rows.begin(), part.last), less);
+        });
+        sorted.swap(merged);
+    }
+}
+
+int NoteSortModel::position(int sourceRow) const
+{
+    if (!mPositionsValid)
+    {
+        mPositions.assign(mRows.size(), 0);
+        for (std::size_t pos = 0; pos < mRows.size(); ++pos)
+        {
+            mPositions[mRows[pos]] = static_cast<int>(pos);
+        }
+        mPositionsValid = true;
+    }
+    return mPositions[sourceRow];
+}
+
+int NoteSortModel::insertPosition(int sourceRow) const
+{
+    auto it = std::upper_bound(mRows.begin(), mRows.end(), sourceRow,
+                               [this](int x, int y) { return lessThan(x, y); });
+    return static_cast<int>(it - mRows.begin());
+}
+
+/*!
+ * Постоянные индексы (выделение, текущий элемент вида) переносятся
+ * вслед за своими строками фильтра.
+ */
+void NoteSortModel::relayout(std::vector<int> rows)
+{
+    emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+    QModelIndexList from = persistentIndexList();
+    std::vector<int> sourceRows;
+    sourceRows.reserve(from.size());
+    for (const QModelIndex &index : from)
+    {
+        sourceRows.push_back(mRows[index.row()]);
+    }
+    mRows.swap(rows);
+    mPositionsValid = false;
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (int i = 0; i < from.size(); ++i)
+    {
+        to.append(index(position(sourceRows[i]), from[i].column()));
+    }
+    changePersistentIndexList(from, to);
+    emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+void NoteSortModel::rebuild()
+{
+    mRows = rowRange(0, mFilter->rowCount() - 1);
+    mPositionsValid = false;
+    prepareKeys(0, mFilter->rowCount() - 1);
+    sortRows(mRows);
+}
+
+/*!
+ * Новые строки упорядочиваются между собой, и для каждой двоичным поиском
+ * находится место среди прежних строк. Строки, встающие на одно место,
+ * вставляются одним диапазоном; места обходятся с конца, чтобы позиции
+ * ещё не вставленных диапазонов не сдвигались. Без сортировки все новые
+ * строки встают на одно место.
+ */
+void NoteSortModel::sourceRowsInserted(int first, int last)
+{
+    int count = last - first + 1;
+    // Строки фильтра после вставленных сдвинулись
+    for (int &row : mRows)
+    {
+        if (row >= first)
+        {
+            row += count;
+        }
+    }
+    mPositionsValid = false;
+    prepareKeys(first, last);
+    std::vector<int> added = rowRange(first, last);
+    sortRows(added);
+    std::vector<int> at;
+    at.reserve(added.size());
+    for (int row : added)
+    {
+        at.push_back(insertPosition(row));
+    }
+    std::size_t places = 0;
+    for (std::size_t i = 0; i < at.size(); ++i)
+    {
+        if (i == 0 || at[i] != at[i - 1])
+        {
+            ++places;
+        }
+    }
+    if (places > maxSeparateRuns)
+    {
+        // Добавляем строки в конец, а затем переставляем их на свои места
+        beginInsertRows(QModelIndex(), rowCount(), rowCount() + count - 1);
+        std::vector<int> merged(mRows.size() + added.size());
+        std::merge(mRows.begin(), mRows.end(), added.begin(), added.end(), merged.begin(),
+                   [this](int x, int y) { return lessThan(x, y); });
+        mRows.insert(mRows.end(), added.begin(), added.end());
+        endInsertRows();
+        relayout(std::move(merged));
+        return;
+    }
+    for (std::size_t end = at.size(); end > 0;)
+    {
+        std::size_t begin = end - 1;
+        while (begin > 0 && at[begin - 1] == at[end - 1])
+        {
+            --begin;
+        }
+        int pos = at[begin];
+        beginInsertRows(QModelIndex(), pos, pos + static_cast<int>(end - begin) - 1);
+        mRows.insert(std::next(mRows.begin(), pos), std::next(added.begin(), begin), std::next(added.begin(), end));
+        mPositionsValid = false;
+        endInsertRows();
+        end = begin;
+    }
+}
+
+/*!
+ * Удаляемые строки фильтра могут быть разбросаны по модели. Если они
+ * образуют немного непрерывных диапазонов, каждый удаляется отдельно,
+ * с конца; иначе удаляемые строки сначала переставляются в конец модели.
+ * Номера оставшихся строк фильтра уменьшаются в sourceRowsRemoved(),
+ * когда фильтр уже удалил строки.
+ */
+void NoteSortModel::sourceRowsAboutToBeRemoved(int first, int last)
+{
+    std::vector<int> positions;
+    positions.reserve(last - first + 1);
+    for (int row = first; row <= last; ++row)
+    {
+        positions.push_back(position(row));
+    }
+    std::sort(positions.begin(), positions.end());
+    std::vector<Run> runs = runsOf(positions);
+    if (runs.size() > maxSeparateRuns)
+    {
+        std::vector<int> rows;
+        rows.reserve(mRows.size());
+        for (int row : mRows)
+        {
+            if (row < first || row > last)
+            {
+                rows.push_back(row);
+            }
+        }
+        int kept = static_cast<int>(rows.size());
+        for (int row = first; row <= last; ++row)
+        {
+            rows.push_back(row);
+        }
+        relayout(std::move(rows));
+        runs.assign(1, Run{ kept, rowCount() - 1 });
+    }
+    for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+    {
+        beginRemoveRows(QModelIndex(), run->first, run->last);
+        mRows.erase(std::next(mRows.begin(), run->first), std::next(mRows.begin(), run->last + 1));
+        mPositionsValid = false;
+        endRemoveRows();
+    }
+}
+
+void NoteSortModel::sourceRowsRemoved(int first, int last)
+{
+    int count = last - first + 1;
+    // Строки фильтра после удалённых сдвинулись
+    for (int &row : mRows)
+    {
+        if (row > last)
+        {
+            row -= count;
+        }
+    }
+    mPositionsValid = false;
+}
+
+/*!
+ * Изменённая строка могла сменить заголовок, а значит, и место. Строка
+ * временно исключается из перестановки, и для неё заново находится место.
+ * Если изменилось много строк, перестановка строится заново.
+ */
+void NoteSortModel::sourceRowsChanged(int first, int last)
+{
+    prepareKeys(first, last);
+    if (mColumn >= 0 && static_cast<std::size_t>(last - first + 1) > maxSeparateRuns)
+    {
+        std::vector<int> rows = rowRange(0, mFilter->rowCount() - 1);
+        sortRows(rows);
+        relayout(std::move(rows));
+        emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+        return;
+    }
+    for (int row = first; row <= last; ++row)
+    {
+        int from = position(row);
+        int to = from;
+        if (mColumn >= 0)
+        {
+            mRows.erase(std::next(mRows.begin(), from));
+            to = insertPosition(row);
+            mRows.insert(std::next(mRows.begin(), from), row);
+        }
+        if (to != from)
+        {
+            // Место назначения указывается в позициях до переноса
+            beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+            mRows.erase(std::next(mRows.begin(), from));
+            mRows.insert(std::next(mRows.begin(), to), row);
+            mPositionsValid = false;
+            endMoveRows();
+        }
+        emit dataChanged(index(to, 0), index(to, columnCount() - 1));
+    }
+}
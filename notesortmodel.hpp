@@ -0,0 +1,125 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteSortModel.
+ */
+#ifndef NOTESORTMODEL_HPP
+#define NOTESORTMODEL_HPP
+
+#include <vector>
+
+#include <QAbstractProxyModel>
+
+#include "notebook.hpp"
+#include "notefiltermodel.hpp"
+
+/*!
+ * \brief Класс модели-посредника, упорядочивающей заметки по заголовкам.
+ *
+ * Модель располагается между фильтром (NoteFilterModel) и видом и
+ * показывает строки фильтра в порядке, заданном методом sort(). Порядок
+ * хранится перестановкой — вектором номеров строк фильтра — и обратной
+ * к ней таблицей, которая восстанавливается по требованию.
+ *
+ * Заголовки сравниваются с учётом языка по ключам QCollatorSortKey,
+ * которые записная книжка вычисляет один раз и хранит (см.
+ * Notebook::sortKey()). Перестановка строится параллельной сортировкой:
+ * части сортируются в пуле потоков QtConcurrent, а затем попарно
+ * сливаются. Равные заголовки остаются в порядке записной книжки.
+ *
+ * Вставленные, удалённые и изменённые строки фильтра не приводят к
+ * повторной сортировке: новые строки встают на свои места двоичным
+ * поиском, удалённые вырезаются, а изменённые переносятся
+ * (beginMoveRows()). Если изменения разбросаны по многим местам, модель
+ * сообщает о них одним изменением раскладки (layoutChanged()), сохраняя
+ * выделение.
+ *
+ * Пока модель не упорядочена (столбец сортировки -1), строки идут в порядке
+ * записной книжки, и ключи сортировки не вычисляются.
+ */
+class NoteSortModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Конструктор.
+     * \param notebook Записная книжка, заметки которой показывает фильтр.
+     * \param filter Фильтр — исходная модель. Оба объекта должны существовать, пока существует модель.
+     * \param parent Родительский объект.
+     */
+    NoteSortModel(Notebook *notebook, NoteFilterModel *filter, QObject *parent = nullptr);
+
+    //! Возвращает столбец, по которому упорядочены строки, или -1, если модель не упорядочена.
+    int sortColumn() const;
+    //! Возвращает направление сортировки.
+    Qt::SortOrder sortOrder() const;
+
+    /*!
+     * \name Реализация интерфейса модели-посредника.
+     * @{
+     */
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QModelIndex parent(const QModelIndex &child) const Q_DECL_OVERRIDE;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const Q_DECL_OVERRIDE;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const Q_DECL_OVERRIDE;
+    /*!
+     * \brief Преобразует выделение \a proxySelection в выделение фильтра.
+     *
+     * Строки выделения собираются, упорядочиваются и объединяются в
+     * непрерывные диапазоны строк фильтра, не создавая индексов для каждой
+     * строки.
+     */
+    QItemSelection mapSelectionToSource(const QItemSelection &proxySelection) const Q_DECL_OVERRIDE;
+    //! Преобразует выделение фильтра \a sourceSelection в выделение модели.
+    QItemSelection mapSelectionFromSource(const QItemSelection &sourceSelection) const Q_DECL_OVERRIDE;
+    /*!
+     * \brief Упорядочивает строки по столбцу \a column в направлении \a order.
+     *
+     * Столбец -1 возвращает строки в порядок записной книжки.
+     */
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) Q_DECL_OVERRIDE;
+    //! @}
+
+private:
+    //! Возвращает \c true, если строка фильтра \a x должна идти раньше строки \a y.
+    bool lessThan(int x, int y) const;
+    //! Вычисляет недостающие ключи сортировки строк фильтра с \a first по \a last.
+    void prepareKeys(int first, int last);
+    //! Упорядочивает строки фильтра \a rows параллельной сортировкой.
+    void sortRows(std::vector<int> &rows) const;
+    //! Возвращает позицию строки фильтра \a sourceRow в модели.
+    int position(int sourceRow) const;
+    //! Возвращает позицию, на которую встанет строка фильтра \a sourceRow, отсутствующая в модели.
+    int insertPosition(int sourceRow) const;
+    //! Заменяет перестановку на \a rows с тем же набором строк, уведомляя виды об изменении раскладки.
+    void relayout(std::vector<int> rows);
+    //! Заново строит перестановку для всех строк фильтра.
+    void rebuild();
+
+    //! Обрабатывает вставку строк фильтра с \a first по \a last.
+    void sourceRowsInserted(int first, int last);
+    //! Обрабатывает начало удаления строк фильтра с \a first по \a last.
+    void sourceRowsAboutToBeRemoved(int first, int last);
+    //! Обрабатывает удаление строк фильтра с \a first по \a last.
+    void sourceRowsRemoved(int first, int last);
+    //! Обрабатывает изменение строк фильтра с \a first по \a last.
+    void sourceRowsChanged(int first, int last);
+
+    //! Записная книжка.
+    Notebook *mNotebook;
+    //! Фильтр.
+    NoteFilterModel *mFilter;
+    //! Столбец сортировки или -1.
+    int mColumn;
+    //! Направление сортировки.
+    Qt::SortOrder mOrder;
+    //! Перестановка: номера строк фильтра в порядке строк модели.
+    std::vector<int> mRows;
+    //! Обратная перестановка: позиции строк фильтра в модели. Верна, только если mPositionsValid.
+    mutable std::vector<int> mPositions;
+    //! Признак того, что mPositions соответствует mRows.
+    mutable bool mPositionsValid;
+};
+
+#endif // NOTESORTMODEL_HPP
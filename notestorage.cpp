@@ -0,0 +1,123 @@
+/*!
+ * \file
+ * \brief Файл реализации класса NoteStorage.
+ */
+#include "notestorage.hpp"
+
+#include <stdexcept> // runtime_error
+#include <utility> // move()
+
+#include "arenanotestorage.hpp"
+#include "config.hpp"
+#ifdef TOYNOTE_SQLITE
+#include "sqlitenotestorage.hpp"
+#endif
+#include "vectornotestorage.hpp"
+
+namespace
+{
+
+//! Возвращает ссылку на вид хранилища новых записных книжек (см. NoteStorage::defaultKind()).
+QString &defaultStorageKind()
+{
+    static QString kind = QString::fromLatin1(Config::noteStorage);
+    return kind;
+}
+
+}
+
+std::unique_ptr<NoteStorage> NoteStorage::create(const QString &kind)
+{
+    if (kind == QLatin1String("vector"))
+    {
+        return std::unique_ptr<NoteStorage>(new VectorNoteStorage);
+    }
+    if (kind == QLatin1String("arena"))
+    {
+        return std::unique_ptr<NoteStorage>(new ArenaNoteStorage);
+    }
+#ifdef TOYNOTE_SQLITE
+    if (kind == QLatin1String("sqlite"))
+    {
+        return std::unique_ptr<NoteStorage>(new SqliteNoteStorage);
+    }
+#endif
+    throw std::runtime_error(tr("Unknown note storage: %1").arg(kind).toStdString());
+}
+
+std::unique_ptr<NoteStorage> NoteStorage::create()
+{
+    return create(defaultKind());
+}
+
+QStringList NoteStorage::kinds()
+{
+    QStringList result{ QStringLiteral("vector"), QStringLiteral("arena") };
+#ifdef TOYNOTE_SQLITE
+    result.append(QStringLiteral("sqlite"));
+#endif
+    return result;
+}
+
+QString NoteStorage::defaultKind()
+{
+    return defaultStorageKind();
+}
+
+void NoteStorage::setDefaultKind(const QString &kind)
+{
+    if (!kinds().contains(kind))
+    {
+        throw std::runtime_error(tr("Unknown note storage: %1").arg(kind).toStdString());
+    }
+    defaultStorageKind() = kind;
+}
+
+NoteStorage::~NoteStorage()
+{
+}
+
+void NoteStorage::insertMany(SizeType idx, std::vector<Note> notes)
+{
+    SizeType count = static_cast<SizeType>(notes.size());
+    SizeType end = size();
+    resize(end + count);
+    moveRange(idx, end, idx + count);
+    for (SizeType k = 0; k < count; ++k)
+    {
+        set(idx + k, std::move(notes[k]));
+    }
+}
+
+void NoteStorage::reserve(SizeType)
+{
+}
+
+void NoteStorage::moveRange(SizeType first, SizeType last, SizeType to)
+{
+    if (to < first)
+    {
+        // Сдвиг к началу: переносим ячейки с начала диапазона
+        for (SizeType i = first; i < last; ++i)
+        {
+            move(i, to + (i - first));
+        }
+    }
+    else if (to > first)
+    {
+        // Сдвиг к концу: переносим ячейки с конца диапазона
+        for (SizeType i = last; i > first; --i)
+        {
+            move(i - 1, to + (i - 1 - first));
+        }
+    }
+}
+
+void NoteStorage::setTextCompression(bool)
+{
+}
+
+bool NoteStorage::isConcurrentReadable() const
+{
+    return true;
+}
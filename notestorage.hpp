@@ -0,0 +1,157 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса NoteStorage.
+ */
+#ifndef NOTESTORAGE_HPP
+#define NOTESTORAGE_HPP
+
+#include <cstddef> // size_t
+#include <memory> // unique_ptr
+#include <vector>
+
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QString>
+#include <QStringList>
+
+#include "note.hpp"
+
+/*!
+ * \brief Интерфейс хранилища заметок записной книжки.
+ *
+ * Хранилище — это последовательность \e ячеек, в каждой из которых лежит
+ * одна заметка. Записная книжка (Notebook) сама решает, какие ячейки
+ * принадлежат ей (см. промежуток в Notebook::eraseRanges()), и обращается
+ * к ним по номерам; идентификаторы, набор изменений и уведомления видов
+ * остаются в Notebook. Поэтому способ хранения заметок можно менять,
+ * не затрагивая остальную программу (см. create()).
+ *
+ * Методы чтения (note(), title(), text(), snapshot()) могут вызываться из
+ * разных потоков одновременно, пока хранилище не изменяется, если
+ * isConcurrentReadable() возвращает true.
+ */
+class NoteStorage
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(NoteStorage)
+public:
+    //! Тип номеров ячеек.
+    using SizeType = std::size_t;
+
+    /*!
+     * \brief Создаёт хранилище вида \a kind.
+     *
+     * Виды хранилищ:
+     * - \c "vector" — вектор объектов Note (VectorNoteStorage);
+     * - \c "arena" — заголовки и тексты в общих непрерывных буферах (ArenaNoteStorage);
+     * - \c "sqlite" — база данных SQLite во временном файле (SqliteNoteStorage),
+     *   если программа собрана с модулем QtSql.
+     *
+     * Для неизвестного вида запускает исключительную ситуацию.
+     */
+    static std::unique_ptr<NoteStorage> create(const QString &kind);
+    //! Создаёт хранилище вида defaultKind().
+    static std::unique_ptr<NoteStorage> create();
+    //! Возвращает виды хранилищ, с которыми собрана программа (см. create()).
+    static QStringList kinds();
+    /*!
+     * \brief Возвращает вид хранилища новых записных книжек.
+     *
+     * По умолчанию это Config::noteStorage; программа может выбрать другой
+     * вид при запуске методом setDefaultKind() (например, по параметру
+     * командной строки \c --storage).
+     */
+    static QString defaultKind();
+    /*!
+     * \brief Устанавливает вид хранилища новых записных книжек \a kind.
+     *
+     * Для неизвестного вида запускает исключительную ситуацию. Вызывается
+     * при запуске программы, до создания записных книжек.
+     */
+    static void setDefaultKind(const QString &kind);
+
+    //! Виртуальный деструктор, чтобы хранилища можно было удалять через указатель на базовый класс.
+    virtual ~NoteStorage();
+    //! Возвращает количество ячеек.
+    virtual SizeType size() const = 0;
+    //! Возвращает заметку из ячейки \a idx.
+    virtual Note note(SizeType idx) const = 0;
+    /*!
+     * \brief Возвращает заголовок заметки из ячейки \a idx.
+     *
+     * В отличие от note().title(), не требует создавать объект Note.
+     */
+    virtual QString title(SizeType idx) const = 0;
+    //! Возвращает текст заметки из ячейки \a idx.
+    virtual QString text(SizeType idx) const = 0;
+    /*!
+     * \brief Возвращает заметки всех ячеек.
+     *
+     * Результат не зависит от дальнейших изменений хранилища, поэтому его
+     * можно передать в рабочий поток (см. Notebook::snapshot()).
+     */
+    virtual std::vector<Note> snapshot() const = 0;
+    //! Помещает заметку \a note в ячейку \a idx.
+    virtual void set(SizeType idx, Note note) = 0;
+    //! Вставляет ячейку с заметкой \a note перед ячейкой \a idx (в конец, если \a idx равен size()).
+    virtual void insert(SizeType idx, Note note) = 0;
+    //! Добавляет заметки \a notes в новые ячейки в конце хранилища.
+    virtual void append(std::vector<Note> notes) = 0;
+    /*!
+     * \brief Вставляет ячейки с заметками \a notes перед ячейкой \a idx.
+     *
+     * Реализация по умолчанию увеличивает хранилище один раз, сдвигает
+     * следующие ячейки методом moveRange() и перемещает заметки на
+     * освободившиеся места.
+     */
+    virtual void insertMany(SizeType idx, std::vector<Note> notes);
+    /*!
+     * \brief Резервирует место для \a size ячеек.
+     *
+     * Реализация по умолчанию ничего не делает.
+     */
+    virtual void reserve(SizeType size);
+    /*!
+     * \brief Переносит заметку из ячейки \a from в ячейку \a to.
+     *
+     * Прежняя заметка ячейки \a to теряется, а ячейка \a from остаётся
+     * допустимой, но её содержимое не определено.
+     */
+    virtual void move(SizeType from, SizeType to) = 0;
+    /*!
+     * \brief Переносит заметки из ячеек с \a first по \a last - 1 в ячейки начиная с \a to.
+     *
+     * Диапазоны могут перекрываться. Прежние заметки ячеек назначения
+     * теряются, а ячейки исходного диапазона, не попавшие в диапазон
+     * назначения, остаются допустимыми, но их содержимое не определено,
+     * как после move(). Используется записной книжкой для сдвига заметок
+     * при удалении диапазонов и возврате заметок (см. Notebook::eraseRanges()).
+     *
+     * Реализация по умолчанию переносит ячейки по одной методом move()
+     * в таком порядке, чтобы не затереть ещё не перенесённые.
+     */
+    virtual void moveRange(SizeType first, SizeType last, SizeType to);
+    //! Изменяет количество ячеек на \a size. Новые ячейки содержат пустые заметки.
+    virtual void resize(SizeType size) = 0;
+    //! Удаляет ячейки с \a first по \a last - 1, сдвигая следующие.
+    virtual void erase(SizeType first, SizeType last) = 0;
+    //! Удаляет все ячейки.
+    virtual void clear() = 0;
+    /*!
+     * \brief Включает или выключает сжатие текстов в памяти (см. Notebook::setTextCompression()).
+     *
+     * Реализация по умолчанию ничего не делает: не всякое хранилище
+     * держит тексты в виде, который стоит сжимать.
+     */
+    virtual void setTextCompression(bool on);
+    /*!
+     * \brief Возвращает true, если методы чтения можно вызывать из разных потоков одновременно.
+     *
+     * Реализация по умолчанию возвращает true. Хранилище, привязанное к
+     * потоку (например, к соединению с базой данных), возвращает false,
+     * и тогда записная книжка читает его только из своего потока.
+     */
+    virtual bool isConcurrentReadable() const;
+};
+
+#endif // NOTESTORAGE_HPP
@@ -0,0 +1,652 @@
+/*!
+ * \file
+ * \brief Файл реализации класса SqliteNoteStorage.
+ */
+#include "sqlitenotestorage.hpp"
+
+#include <algorithm> // max(), min(), min_element(), remove_if()
+#include <memory> // make_shared()
+#include <stdexcept> // runtime_error
+#include <utility> // move()
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QVariant>
+
+#include "config.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+//! Имя файла базы данных во временном каталоге хранилища.
+const char databaseFile[] = "notes.sqlite";
+
+//! Возвращает номер ячейки \a idx в виде значения параметра запроса.
+QVariant position(std::size_t idx)
+{
+    return QVariant(static_cast<qlonglong>(idx));
+}
+
+/*!
+ * \brief Источник ленивых заметок снимка хранилища SqliteNoteStorage.
+ *
+ * Снимок — это таблица базы данных хранилища, которая после создания
+ * не меняется, а номер записи — номер ячейки. Соединение QtSql можно
+ * использовать только в создавшем его потоке, поэтому каждый читающий
+ * поток получает своё соединение с базой. Соединения закрываются вместе
+ * с источником, а временный каталог с базой удаляется, когда его больше
+ * не используют ни хранилище, ни снимки.
+ */
+class SnapshotSource : public NoteSource
+{
+public:
+    //! Конструктор. \a dir — каталог базы данных, \a table — таблица снимка.
+    SnapshotSource(std::shared_ptr<QTemporaryDir> dir, QString table)
+        : mDir(std::move(dir))
+        , mTable(std::move(table))
+    {
+    }
+
+    //! Деструктор. Закрывает соединения читающих потоков.
+    ~SnapshotSource()
+    {
+        for (auto &reader : mReaders)
+        {
+            // Запросы должны быть удалены до удаления соединения
+            QString connection = reader.second->connection;
+            reader.second.reset();
+            QSqlDatabase::removeDatabase(connection);
+        }
+    }
+
+    QString title(quint32 record) const Q_DECL_OVERRIDE
+    {
+        return select(reader().selectTitle, record);
+    }
+
+    QString text(quint32 record) const Q_DECL_OVERRIDE
+    {
+        return select(reader().selectText, record);
+    }
+
+private:
+    //! Соединение одного потока с подготовленными запросами.
+    struct Reader
+    {
+        //! Имя соединения.
+        QString connection;
+        //! Заголовок записи.
+        QSqlQuery selectTitle;
+        //! Текст записи.
+        QSqlQuery selectText;
+    };
+
+    //! Возвращает соединение вызывающего потока, при необходимости открывая его.
+    Reader &reader() const
+    {
+        QMutexLocker locker(&mMutex);
+        std::unique_ptr<Reader> &slot = mReaders[QThread::currentThread()];
+        if (!slot)
+        {
+            QString connection = QStringLiteral("toynote-snapshot-%1-%2")
+                    .arg(reinterpret_cast<quintptr>(this))
+                    .arg(reinterpret_cast<quintptr>(QThread::currentThread()));
+            std::unique_ptr<Reader> opened;
+            {
+                QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), connection);
+                db.setDatabaseName(mDir->filePath(QLatin1String(databaseFile)));
+                if (db.open())
+                {
+                    opened.reset(new Reader{ connection, QSqlQuery(db), QSqlQuery(db) });
+                    if (!opened->selectTitle.prepare(QStringLiteral("SELECT title FROM %1 WHERE pos = ?").arg(mTable))
+                            || !opened->selectText.prepare(QStringLiteral("SELECT text FROM %1 WHERE pos = ?").arg(mTable)))
+                    {
+                        opened.reset();
+                    }
+                }
+                if (!opened)
+                {
+                    QString error = db.lastError().text();
+                    db = QSqlDatabase();
+                    QSqlDatabase::removeDatabase(connection);
+                    mReaders.erase(QThread::currentThread());
+                    throw std::runtime_error(SqliteNoteStorage::tr("SQLite error: %1").arg(error).toStdString());
+                }
+            }
+            slot = std::move(opened);
+        }
+        return *slot;
+    }
+
+    //! Выполняет запрос \a query для записи \a record и возвращает первое поле результата.
+    static QString select(QSqlQuery &query, quint32 record)
+    {
+        query.bindValue(0, position(record));
+        if (!query.exec())
+        {
+            throw std::runtime_error(SqliteNoteStorage::tr("SQLite error: %1")
+                                     .arg(query.lastError().text()).toStdString());
+        }
+        // Ячейка без строки содержит пустую заметку
+        QString value = query.next() ? query.value(0).toString() : QString();
+        query.finish();
+        return value;
+    }
+
+    //! Временный каталог с файлом базы данных.
+    std::shared_ptr<QTemporaryDir> mDir;
+    //! Таблица снимка.
+    QString mTable;
+    //! Защищает mReaders.
+    mutable QMutex mMutex;
+    //! Соединения читающих потоков.
+    mutable std::map<QThread *, std::unique_ptr<Reader>> mReaders;
+};
+
+}
+
+/*!
+ * \brief Подготовленные запросы хранилища SqliteNoteStorage.
+ *
+ * Запросы разбираются один раз при создании хранилища, а затем
+ * выполняются с новыми значениями параметров.
+ */
+struct SqliteNoteStorage::Statements
+{
+    //! Подготавливает запросы для соединения \a db.
+    explicit Statements(const QSqlDatabase &db)
+        : selectTitles(db)
+        , selectNote(db)
+        , selectText(db)
+        , insert(db)
+        , update(db)
+        , remove(db)
+        , renumber(db)
+        , shiftOut(db)
+        , shiftIn(db)
+        , clear(db)
+    {
+        prepare(selectTitles, "SELECT pos, title FROM notes WHERE pos >= ? AND pos < ? ORDER BY pos");
+        prepare(selectNote, "SELECT title, text FROM notes WHERE pos = ?");
+        prepare(selectText, "SELECT text FROM notes WHERE pos = ?");
+        prepare(insert, "INSERT INTO notes (pos, title, text) VALUES (?, ?, ?)");
+        // У ячейки может не быть строки, поэтому заметка не изменяется, а заменяется
+        prepare(update, "REPLACE INTO notes (pos, title, text) VALUES (?, ?, ?)");
+        prepare(remove, "DELETE FROM notes WHERE pos >= ? AND pos < ?");
+        prepare(renumber, "UPDATE notes SET pos = ? WHERE pos = ?");
+        // Сдвиг выполняется в два шага через отрицательные номера, чтобы
+        // новые номера строк не совпадали со старыми номерами других строк
+        prepare(shiftOut, "UPDATE notes SET pos = -(pos + ?) - 1 WHERE pos >= ? AND pos < ?");
+        prepare(shiftIn, "UPDATE notes SET pos = -pos - 1 WHERE pos < 0");
+        prepare(clear, "DELETE FROM notes");
+    }
+
+    //! Подготавливает запрос \a query с текстом \a sql.
+    static void prepare(QSqlQuery &query, const char *sql)
+    {
+        if (!query.prepare(QLatin1String(sql)))
+        {
+            throw std::runtime_error(SqliteNoteStorage::tr("SQLite error: %1")
+                                     .arg(query.lastError().text()).toStdString());
+        }
+    }
+
+    //! Заголовки ячеек из диапазона.
+    QSqlQuery selectTitles;
+    //! Заголовок и текст ячейки.
+    QSqlQuery selectNote;
+    //! Текст ячейки.
+    QSqlQuery selectText;
+    //! Вставка строки.
+    QSqlQuery insert;
+    //! Запись заметки ячейки.
+    QSqlQuery update;
+    //! Удаление диапазона строк.
+    QSqlQuery remove;
+    //! Изменение номера строки.
+    QSqlQuery renumber;
+    //! Первый шаг сдвига номеров строк.
+    QSqlQuery shiftOut;
+    //! Второй шаг сдвига номеров строк.
+    QSqlQuery shiftIn;
+    //! Удаление всех строк.
+    QSqlQuery clear;
+};
+
+SqliteNoteStorage::SqliteNoteStorage()
+    // Каждому хранилищу нужно своё соединение, поэтому имя соединения
+    // составляется из адреса объекта
+    : mDir(std::make_shared<QTemporaryDir>())
+    , mConnection(QStringLiteral("toynote-storage-%1").arg(reinterpret_cast<quintptr>(this)))
+    , mSize(0)
+    , mPending(0)
+    , mInTransaction(false)
+    , mClock(0)
+    , mSnapshotCount(0)
+{
+    if (!QSqlDatabase::isDriverAvailable(QStringLiteral("QSQLITE")))
+    {
+        throw std::runtime_error(tr("The SQLite database driver is not available").toStdString());
+    }
+    if (!mDir->isValid())
+    {
+        throw std::runtime_error(tr("Unable to create a temporary directory: %1")
+                                 .arg(mDir->errorString()).toStdString());
+    }
+    try
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), mConnection);
+        db.setDatabaseName(mDir->filePath(QLatin1String(databaseFile)));
+        if (!db.open())
+        {
+            throw std::runtime_error(tr("Unable to open the SQLite database: %1")
+                                     .arg(db.lastError().text()).toStdString());
+        }
+        QSqlQuery query(db);
+        // База временная и после сбоя не нужна, поэтому не ждём записи на
+        // диск, а размер кэша страниц SQLite ограничиваем
+        const QString setup[] = {
+            QStringLiteral("PRAGMA journal_mode = WAL"),
+            QStringLiteral("PRAGMA synchronous = OFF"),
+            QStringLiteral("PRAGMA cache_size = -%1").arg(Config::sqliteCacheSize),
+            QStringLiteral("CREATE TABLE notes (pos INTEGER PRIMARY KEY, title TEXT, text TEXT)")
+        };
+        for (const QString &sql : setup)
+        {
+            if (!query.exec(sql))
+            {
+                throw std::runtime_error(tr("SQLite error: %1").arg(query.lastError().text()).toStdString());
+            }
+        }
+        mStatements.reset(new Statements(db));
+    }
+    catch (...)
+    {
+        mStatements.reset();
+        QSqlDatabase::removeDatabase(mConnection);
+        throw;
+    }
+}
+
+SqliteNoteStorage::~SqliteNoteStorage()
+{
+    // Запросы и все копии QSqlDatabase должны быть удалены до удаления
+    // соединения. Незафиксированные изменения не нужны: база удаляется
+    // вместе с временным каталогом, когда его не используют и снимки
+    mStatements.reset();
+    QSqlDatabase::database(mConnection, false).close();
+    QSqlDatabase::removeDatabase(mConnection);
+}
+
+SqliteNoteStorage::SizeType SqliteNoteStorage::size() const
+{
+    return mSize;
+}
+
+Note SqliteNoteStorage::note(SizeType idx) const
+{
+    QSqlQuery &query = mStatements->selectNote;
+    query.bindValue(0, position(idx));
+    exec(query);
+    Note note;
+    if (query.next())
+    {
+        note = Note(query.value(0).toString(), query.value(1).toString());
+    }
+    query.finish();
+    return note;
+}
+
+QString SqliteNoteStorage::title(SizeType idx) const
+{
+    const Page &p = page(idx / Config::sqlitePageRows);
+    SizeType offset = idx % Config::sqlitePageRows;
+    return offset < p.titles.size() ? p.titles[offset] : QString();
+}
+
+QString SqliteNoteStorage::text(SizeType idx) const
+{
+    QSqlQuery &query = mStatements->selectText;
+    query.bindValue(0, position(idx));
+    exec(query);
+    QString text;
+    if (query.next())
+    {
+        text = query.value(0).toString();
+    }
+    query.finish();
+    return text;
+}
+
+/*!
+ * Заметки копируются из таблицы в таблицу внутри базы, не проходя через
+ * память программы. Копия создаётся после фиксации открытой транзакции,
+ * чтобы соединения читающих потоков её увидели.
+ */
+std::vector<Note> SqliteNoteStorage::snapshot() const
+{
+    TRACE_SCOPE("SqliteNoteStorage::snapshot");
+    if (mInTransaction)
+    {
+        commit();
+    }
+    dropSnapshots();
+    if (!mSnapshot)
+    {
+        QString table = QStringLiteral("snapshot%1").arg(++mSnapshotCount);
+        QSqlQuery query(QSqlDatabase::database(mConnection, false));
+        const QString copy[] = {
+            QStringLiteral("CREATE TABLE %1 (pos INTEGER PRIMARY KEY, title TEXT, text TEXT)").arg(table),
+            QStringLiteral("INSERT INTO %1 SELECT pos, title, text FROM notes").arg(table)
+        };
+        for (const QString &sql : copy)
+        {
+            if (!query.exec(sql))
+            {
+                throw std::runtime_error(tr("SQLite error: %1").arg(query.lastError().text()).toStdString());
+            }
+        }
+        mSnapshot = std::make_shared<SnapshotSource>(mDir, table);
+        mSnapshots.emplace_back(table, mSnapshot);
+    }
+    std::vector<Note> notes;
+    notes.reserve(mSize);
+    for (SizeType idx = 0; idx < mSize; ++idx)
+    {
+        notes.emplace_back(mSnapshot, static_cast<quint32>(idx));
+    }
+    return notes;
+}
+
+void SqliteNoteStorage::set(SizeType idx, Note note)
+{
+    beginWrite();
+    QSqlQuery &query = mStatements->update;
+    query.bindValue(0, position(idx));
+    query.bindValue(1, note.title());
+    query.bindValue(2, note.text());
+    exec(query);
+    // Страницу в кэше исправляем на месте, чтобы не читать её заново
+    auto it = mPages.find(idx / Config::sqlitePageRows);
+    if (it != mPages.end() && idx % Config::sqlitePageRows < it->second.titles.size())
+    {
+        it->second.titles[idx % Config::sqlitePageRows] = note.title();
+    }
+    endWrite(1);
+}
+
+void SqliteNoteStorage::insert(SizeType idx, Note note)
+{
+    beginWrite();
+    shift(idx, mSize, 1);
+    insertRow(idx, note);
+    ++mSize;
+    invalidateFrom(idx);
+    endWrite(1);
+}
+
+void SqliteNoteStorage::append(std::vector<Note> notes)
+{
+    TRACE_SCOPE("SqliteNoteStorage::append");
+    beginWrite();
+    for (SizeType k = 0; k < notes.size(); ++k)
+    {
+        insertRow(mSize + k, notes[k]);
+    }
+    // Последняя страница могла быть неполной
+    invalidateFrom(mSize);
+    mSize += notes.size();
+    endWrite(notes.size());
+}
+
+void SqliteNoteStorage::insertMany(SizeType idx, std::vector<Note> notes)
+{
+    TRACE_SCOPE("SqliteNoteStorage::insertMany");
+    if (notes.empty())
+    {
+        return;
+    }
+    beginWrite();
+    // Следующие строки перенумеровываются одним запросом, а не по одной
+    // методом move(), как в реализации по умолчанию
+    shift(idx, mSize, static_cast<qint64>(notes.size()));
+    for (SizeType k = 0; k < notes.size(); ++k)
+    {
+        insertRow(idx + k, notes[k]);
+    }
+    mSize += notes.size();
+    invalidateFrom(idx);
+    endWrite(notes.size());
+}
+
+void SqliteNoteStorage::move(SizeType from, SizeType to)
+{
+    if (from == to)
+    {
+        return;
+    }
+    beginWrite();
+    removeRows(to, to + 1);
+    // Ячейка from остаётся без строки, то есть с пустой заметкой
+    QSqlQuery &renumber = mStatements->renumber;
+    renumber.bindValue(0, position(to));
+    renumber.bindValue(1, position(from));
+    exec(renumber);
+    invalidate(from);
+    invalidate(to);
+    endWrite(1);
+}
+
+/*!
+ * Выполняется тремя запросами независимо от длины диапазона: удалением
+ * прежних строк ячеек назначения и двухшаговым сдвигом номеров строк
+ * диапазона (см. shift()). Освободившиеся ячейки остаются без строк.
+ */
+void SqliteNoteStorage::moveRange(SizeType first, SizeType last, SizeType to)
+{
+    if (first >= last || first == to)
+    {
+        return;
+    }
+    TRACE_SCOPE("SqliteNoteStorage::moveRange");
+    beginWrite();
+    SizeType count = last - first;
+    // Строки ячеек назначения, кроме тех, что сами входят в переносимый диапазон
+    if (to < first)
+    {
+        removeRows(to, std::min(to + count, first));
+    }
+    else
+    {
+        removeRows(std::max(to, last), to + count);
+    }
+    shift(first, last, static_cast<qint64>(to) - static_cast<qint64>(first));
+    invalidateFrom(std::min(first, to));
+    endWrite(count);
+}
+
+void SqliteNoteStorage::resize(SizeType size)
+{
+    beginWrite();
+    SizeType changes = 0;
+    if (size < mSize)
+    {
+        removeRows(size, mSize);
+        invalidateFrom(size);
+        changes = mSize - size;
+    }
+    else
+    {
+        // Новые ячейки остаются без строк, то есть с пустыми заметками
+        invalidateFrom(mSize);
+    }
+    mSize = size;
+    endWrite(changes);
+}
+
+void SqliteNoteStorage::erase(SizeType first, SizeType last)
+{
+    if (first >= last)
+    {
+        return;
+    }
+    beginWrite();
+    removeRows(first, last);
+    shift(last, mSize, -static_cast<qint64>(last - first));
+    mSize -= last - first;
+    invalidateFrom(first);
+    endWrite(last - first);
+}
+
+void SqliteNoteStorage::clear()
+{
+    beginWrite();
+    exec(mStatements->clear);
+    mPages.clear();
+    endWrite(mSize);
+    mSize = 0;
+}
+
+bool SqliteNoteStorage::isConcurrentReadable() const
+{
+    return false;
+}
+
+const SqliteNoteStorage::Page &SqliteNoteStorage::page(SizeType number) const
+{
+    auto it = mPages.find(number);
+    if (it == mPages.end())
+    {
+        // Вытесняем страницу, к которой дольше всего не обращались
+        if (mPages.size() >= static_cast<SizeType>(Config::sqliteCachePages))
+        {
+            mPages.erase(std::min_element(mPages.begin(), mPages.end(),
+                                          [](const std::pair<const SizeType, Page> &a,
+                                             const std::pair<const SizeType, Page> &b) {
+                return a.second.used < b.second.used;
+            }));
+        }
+        SizeType first = number * Config::sqlitePageRows;
+        SizeType last = std::min(first + Config::sqlitePageRows, mSize);
+        Page loaded;
+        // Ячейки без строк остаются с пустыми заголовками
+        loaded.titles.resize(last > first ? last - first : 0);
+        QSqlQuery &query = mStatements->selectTitles;
+        query.bindValue(0, position(first));
+        query.bindValue(1, position(last));
+        exec(query);
+        while (query.next())
+        {
+            loaded.titles[static_cast<SizeType>(query.value(0).toLongLong()) - first] = query.value(1).toString();
+        }
+        query.finish();
+        it = mPages.emplace(number, std::move(loaded)).first;
+    }
+    it->second.used = ++mClock;
+    return it->second;
+}
+
+void SqliteNoteStorage::invalidateFrom(SizeType idx)
+{
+    mPages.erase(mPages.lower_bound(idx / Config::sqlitePageRows), mPages.end());
+}
+
+void SqliteNoteStorage::invalidate(SizeType idx)
+{
+    mPages.erase(idx / Config::sqlitePageRows);
+}
+
+void SqliteNoteStorage::removeRows(SizeType first, SizeType last)
+{
+    if (first >= last)
+    {
+        return;
+    }
+    QSqlQuery &remove = mStatements->remove;
+    remove.bindValue(0, position(first));
+    remove.bindValue(1, position(last));
+    exec(remove);
+}
+
+void SqliteNoteStorage::shift(SizeType first, SizeType last, qint64 delta)
+{
+    if (first >= last)
+    {
+        return;
+    }
+    QSqlQuery &out = mStatements->shiftOut;
+    out.bindValue(0, static_cast<qlonglong>(delta));
+    out.bindValue(1, position(first));
+    out.bindValue(2, position(last));
+    exec(out);
+    exec(mStatements->shiftIn);
+}
+
+void SqliteNoteStorage::insertRow(SizeType idx, const Note &note)
+{
+    QSqlQuery &query = mStatements->insert;
+    query.bindValue(0, position(idx));
+    query.bindValue(1, note.title());
+    query.bindValue(2, note.text());
+    exec(query);
+}
+
+void SqliteNoteStorage::beginWrite()
+{
+    // Следующий снимок должен увидеть изменение
+    mSnapshot.reset();
+    if (mInTransaction)
+    {
+        return;
+    }
+    QSqlDatabase db = QSqlDatabase::database(mConnection, false);
+    if (!db.transaction())
+    {
+        throw std::runtime_error(tr("SQLite error: %1").arg(db.lastError().text()).toStdString());
+    }
+    mInTransaction = true;
+}
+
+void SqliteNoteStorage::endWrite(SizeType changes)
+{
+    mPending += changes;
+    if (mPending >= static_cast<SizeType>(Config::sqliteCommitBatch))
+    {
+        commit();
+    }
+}
+
+void SqliteNoteStorage::commit() const
+{
+    TRACE_SCOPE("SqliteNoteStorage::commit");
+    QSqlDatabase db = QSqlDatabase::database(mConnection, false);
+    if (!db.commit())
+    {
+        throw std::runtime_error(tr("SQLite error: %1").arg(db.lastError().text()).toStdString());
+    }
+    mPending = 0;
+    mInTransaction = false;
+}
+
+void SqliteNoteStorage::dropSnapshots() const
+{
+    QSqlQuery query(QSqlDatabase::database(mConnection, false));
+    mSnapshots.erase(std::remove_if(mSnapshots.begin(), mSnapshots.end(),
+                                    [&query](const std::pair<QString, std::weak_ptr<const NoteSource>> &snapshot) {
+        // Если таблицу удалить не удалось, попробуем при следующем снимке
+        return snapshot.second.expired() && query.exec(QStringLiteral("DROP TABLE %1").arg(snapshot.first));
+    }), mSnapshots.end());
+}
+
+void SqliteNoteStorage::exec(QSqlQuery &query)
+{
+    if (!query.exec())
+    {
+        throw std::runtime_error(tr("SQLite error: %1").arg(query.lastError().text()).toStdString());
+    }
+}
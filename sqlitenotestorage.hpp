@@ -0,0 +1,150 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса SqliteNoteStorage.
+ */
+#ifndef SQLITENOTESTORAGE_HPP
+#define SQLITENOTESTORAGE_HPP
+
+#include <map>
+#include <memory> // shared_ptr, unique_ptr, weak_ptr
+#include <utility> // pair
+#include <vector>
+
+#include <QString>
+#include <QTemporaryDir>
+
+#include "notestorage.hpp"
+
+class QSqlQuery;
+
+/*!
+ * \brief Хранилище заметок в базе данных SQLite.
+ *
+ * Заметки лежат в таблице временной базы данных (драйвер QSQLITE модуля
+ * QtSql), строка таблицы — это ячейка, а её ключ — номер ячейки. В памяти
+ * остаются только количество ячеек и кэш \e страниц заголовков
+ * (Config::sqlitePageRows заголовков подряд, не больше
+ * Config::sqliteCachePages страниц): вид запрашивает заголовки видимых
+ * строк (title()), и они читаются из базы одним запросом на страницу.
+ * Давно не использованные страницы вытесняются, поэтому расход памяти
+ * не зависит от размера записной книжки. Тексты заметок читаются из
+ * базы по требованию (note(), text()).
+ *
+ * Изменения выполняются в открытой транзакции, которая фиксируется
+ * после Config::sqliteCommitBatch изменений (групповая фиксация).
+ * Запросы в том же соединении видят ещё не зафиксированные изменения,
+ * а база временная, поэтому фиксация нужна лишь для того, чтобы журнал
+ * транзакции не рос без ограничений.
+ *
+ * Вставка и удаление ячеек в середине перенумеровывают следующие строки
+ * таблицы, то есть стоят столько же, сколько сдвиг элементов вектора.
+ * Перенумерация выполняется несколькими запросами на весь диапазон, а не
+ * запросом на строку (см. moveRange()). Ячейке без строки в таблице
+ * соответствует пустая заметка, поэтому освободившиеся и добавленные
+ * методом resize() ячейки не требуют записи в базу.
+ *
+ * Соединение с базой данных привязано к создавшему его потоку, поэтому
+ * хранилище нельзя читать из рабочих потоков (isConcurrentReadable()).
+ * Снимок (snapshot()) создаётся в потоке хранилища копированием таблицы
+ * заметок в отдельную таблицу той же базы. Заметки снимка ленивые: каждый
+ * читающий их поток получает своё соединение с базой, поэтому снимок
+ * можно передать в рабочий поток (например, для сохранения или экспорта),
+ * а в памяти он занимает лишь объекты Note. Пока хранилище не изменяется,
+ * следующие снимки используют ту же таблицу. Таблица удаляется, когда
+ * заметки снимка больше никем не используются.
+ */
+class SqliteNoteStorage : public NoteStorage
+{
+public:
+    /*!
+     * \brief Конструктор по умолчанию.
+     *
+     * Создаёт временную базу данных. Если драйвер SQLite недоступен или
+     * базу создать не удалось, запускает исключительную ситуацию.
+     */
+    SqliteNoteStorage();
+    //! Деструктор. Закрывает соединение и удаляет временную базу данных.
+    ~SqliteNoteStorage();
+
+    SizeType size() const Q_DECL_OVERRIDE;
+    Note note(SizeType idx) const Q_DECL_OVERRIDE;
+    QString title(SizeType idx) const Q_DECL_OVERRIDE;
+    QString text(SizeType idx) const Q_DECL_OVERRIDE;
+    std::vector<Note> snapshot() const Q_DECL_OVERRIDE;
+    void set(SizeType idx, Note note) Q_DECL_OVERRIDE;
+    void insert(SizeType idx, Note note) Q_DECL_OVERRIDE;
+    void append(std::vector<Note> notes) Q_DECL_OVERRIDE;
+    void insertMany(SizeType idx, std::vector<Note> notes) Q_DECL_OVERRIDE;
+    void move(SizeType from, SizeType to) Q_DECL_OVERRIDE;
+    void moveRange(SizeType first, SizeType last, SizeType to) Q_DECL_OVERRIDE;
+    void resize(SizeType size) Q_DECL_OVERRIDE;
+    void erase(SizeType first, SizeType last) Q_DECL_OVERRIDE;
+    void clear() Q_DECL_OVERRIDE;
+    bool isConcurrentReadable() const Q_DECL_OVERRIDE;
+
+private:
+    // Подготовленные запросы; определены в файле реализации
+    struct Statements;
+
+    //! Страница кэша заголовков.
+    struct Page
+    {
+        //! Заголовки ячеек страницы.
+        std::vector<QString> titles;
+        //! Момент последнего обращения к странице (см. mClock).
+        quint64 used;
+    };
+
+    //! Возвращает страницу заголовков номер \a number, при необходимости читая её из базы.
+    const Page &page(SizeType number) const;
+    //! Удаляет из кэша страницы, содержащие ячейки начиная с \a idx.
+    void invalidateFrom(SizeType idx);
+    //! Удаляет из кэша страницу, содержащую ячейку \a idx.
+    void invalidate(SizeType idx);
+    //! Удаляет строки ячеек с \a first по \a last - 1, не сдвигая следующие.
+    void removeRows(SizeType first, SizeType last);
+    //! Добавляет к номерам строк ячеек с \a first по \a last - 1 величину \a delta.
+    void shift(SizeType first, SizeType last, qint64 delta);
+    //! Записывает в таблицу строку номер \a idx с заметкой \a note.
+    void insertRow(SizeType idx, const Note &note);
+    //! Открывает транзакцию, если она ещё не открыта.
+    void beginWrite();
+    //! Учитывает \a changes изменений и фиксирует транзакцию, если их накопилось достаточно.
+    void endWrite(SizeType changes);
+    /*!
+     * \brief Фиксирует открытую транзакцию.
+     *
+     * Фиксация не меняет содержимое хранилища, поэтому метод константный:
+     * его вызывает snapshot(), чтобы другие соединения увидели изменения.
+     */
+    void commit() const;
+    //! Удаляет таблицы снимков, заметки которых больше никем не используются.
+    void dropSnapshots() const;
+    //! Выполняет запрос \a query; при ошибке запускает исключительную ситуацию.
+    static void exec(QSqlQuery &query);
+
+    //! Временный каталог с файлом базы данных; разделяется с источниками снимков.
+    std::shared_ptr<QTemporaryDir> mDir;
+    //! Имя соединения с базой данных (см. QSqlDatabase::database()).
+    QString mConnection;
+    //! Подготовленные запросы.
+    std::unique_ptr<Statements> mStatements;
+    //! Количество ячеек.
+    SizeType mSize;
+    //! Количество изменений в открытой транзакции.
+    mutable SizeType mPending;
+    //! Открыта ли транзакция.
+    mutable bool mInTransaction;
+    //! Кэш страниц заголовков по номерам страниц.
+    mutable std::map<SizeType, Page> mPages;
+    //! Счётчик обращений к страницам для вытеснения давно не использованных.
+    mutable quint64 mClock;
+    //! Источник снимка, созданного после последнего изменения; пуст, если хранилище с тех пор изменялось.
+    mutable std::shared_ptr<const NoteSource> mSnapshot;
+    //! Таблицы созданных снимков и их источники.
+    mutable std::vector<std::pair<QString, std::weak_ptr<const NoteSource>>> mSnapshots;
+    //! Количество созданных снимков; из него составляются имена таблиц.
+    mutable quint64 mSnapshotCount;
+};
+
+#endif // SQLITENOTESTORAGE_HPP
@@ -0,0 +1,12 @@
+#-------------------------------------------------
+#
+# Модульные тесты (QtTest). Запускаются командой
+# make check
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    tst_notebookbench \
+    tst_noteindex
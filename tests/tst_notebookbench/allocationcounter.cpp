@@ -0,0 +1,126 @@
+/*!
+ * \file
+ * \brief Файл реализации класса AllocationCounter.
+ */
+#include "allocationcounter.hpp"
+
+#include <atomic>
+#include <cstddef> // size_t
+#include <cstdlib> // malloc(), free()
+#include <new> // bad_alloc, nothrow_t, get_new_handler()
+
+namespace
+{
+
+//! Количество выделений памяти. Статическая инициализация нулём не
+//! требует вызова конструктора, поэтому счётчик готов до запуска main().
+std::atomic<quint64> allocations(0);
+
+/*!
+ * \brief Выделяет \a size байт, как это делает стандартный оператор new.
+ *
+ * Пока памяти нет, вызывает обработчик std::get_new_handler(); если его нет,
+ * возвращает нулевой указатель.
+ */
+void *allocate(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    // malloc(0) может вернуть нулевой указатель, а new должен вернуть
+    // уникальный ненулевой
+    if (size == 0)
+    {
+        size = 1;
+    }
+    for (;;)
+    {
+        if (void *p = std::malloc(size))
+        {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            return nullptr;
+        }
+        handler();
+    }
+}
+
+//! Выделяет \a size байт; при нехватке памяти запускает исключительную ситуацию std::bad_alloc.
+void *allocateOrThrow(std::size_t size)
+{
+    if (void *p = allocate(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+}
+
+void *operator new(std::size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    // Обработчик нехватки памяти может запустить std::bad_alloc
+    try
+    {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+// Освобождение с размером (C++14); без замены компилятор вызвал бы
+// стандартную реализацию, которая тоже передаёт память free()
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+#endif
+
+quint64 AllocationCounter::count()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,33 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса AllocationCounter.
+ */
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+
+#include <QtGlobal>
+
+/*!
+ * \brief Счётчик выделений динамической памяти оператором new.
+ *
+ * Тест производительности замещает глобальные операторы new и delete
+ * (обычные, для массивов и с std::nothrow; варианты с выравниванием из
+ * C++17 программа не использует): операторы new увеличивают счётчик
+ * и выделяют память функцией malloc(),
+ * операторы delete освобождают её функцией free(). Замещение допускается
+ * стандартом и совместимо с любой библиотекой C и с санитайзерами, которые
+ * перехватывают malloc() и free().
+ *
+ * Считаются только выделения оператором new: контейнеры стандартной
+ * библиотеки, объекты в куче, std::shared_ptr и т. п. Строки и контейнеры
+ * Qt выделяют память функцией malloc(), и эти выделения не учитываются.
+ * Подсчёт стоит одного атомарного сложения на выделение.
+ */
+class AllocationCounter
+{
+public:
+    //! Возвращает количество выделений памяти оператором new с начала работы процесса.
+    static quint64 count();
+};
+
+#endif // ALLOCATIONCOUNTER_HPP
@@ -0,0 +1,170 @@
+/*!
+ * \file
+ * \brief Тест производительности записной книжки.
+ *
+ * Функции с QBENCHMARK измеряют отдельные операции Notebook средствами
+ * QtTest (результаты в машиночитаемом виде: <tt>-o results.xml,xml</tt>).
+ * Функция operations() выполняет полный набор замеров NotebookBench
+ * с подсчётом выделений памяти (см. AllocationCounter). Размер записной
+ * книжки по умолчанию небольшой, чтобы тест можно было запускать командой
+ * make check; переменная окружения \c TOYNOTE_BENCH_NOTES добавляет замер
+ * записной книжки заданного размера (до 10 миллионов заметок и больше),
+ * а \c TOYNOTE_BENCH_JSON задаёт каталог, куда записываются результаты
+ * NotebookBench в формате JSON для сравнения с другой версией программы.
+ */
+#include <memory> // unique_ptr
+#include <vector>
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QtTest>
+
+#include "allocationcounter.hpp"
+#include "notebook.hpp"
+#include "notebookbench.hpp"
+#include "notegenerator.hpp"
+#include "notestorage.hpp"
+
+namespace
+{
+
+//! Начальное значение генератора заметок.
+const quint64 seed = 1;
+//! Количество заметок записной книжки для замеров QBENCHMARK.
+const quint32 benchNotes = 10000;
+
+}
+
+//! Тест производительности записной книжки.
+class TestNotebookBench : public QObject
+{
+    Q_OBJECT
+private slots:
+    //! Создаёт записную книжку для замеров QBENCHMARK.
+    void initTestCase();
+
+    //! Вставка и удаление заметки в середине записной книжки.
+    void insertErase();
+    //! Изменение заметки в середине записной книжки.
+    void updateNoteAt();
+    //! Сохранение записной книжки в память.
+    void save();
+    //! Загрузка записной книжки из памяти.
+    void load();
+
+    //! Записные книжки для замеров NotebookBench.
+    void operations_data();
+    //! Замеры NotebookBench с подсчётом выделений памяти.
+    void operations();
+
+private:
+    //! Записная книжка для замеров QBENCHMARK.
+    std::unique_ptr<Notebook> mNotebook;
+    //! Заметки для вставки и изменения.
+    std::vector<Note> mExtra;
+};
+
+void TestNotebookBench::initTestCase()
+{
+    NoteGenerator generator(seed);
+    mNotebook.reset(new Notebook(NoteStorage::create()));
+    mNotebook->append(generator.notes(0, benchNotes));
+    mExtra = generator.notes(benchNotes, 1);
+}
+
+void TestNotebookBench::insertErase()
+{
+    const Notebook::SizeType middle = mNotebook->size() / 2;
+    QBENCHMARK
+    {
+        mNotebook->insertAt(middle, mExtra.front());
+        mNotebook->erase(middle);
+    }
+    QCOMPARE(mNotebook->size(), Notebook::SizeType(benchNotes));
+}
+
+void TestNotebookBench::updateNoteAt()
+{
+    const Notebook::SizeType middle = mNotebook->size() / 2;
+    const Note original = (*mNotebook)[middle];
+    QBENCHMARK
+    {
+        mNotebook->updateNoteAt(mExtra.front(), middle);
+        mNotebook->updateNoteAt(original, middle);
+    }
+}
+
+void TestNotebookBench::save()
+{
+    QByteArray data;
+    QBENCHMARK
+    {
+        data.clear();
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QDataStream ost(&buffer);
+        mNotebook->save(ost);
+    }
+    QVERIFY(!data.isEmpty());
+}
+
+void TestNotebookBench::load()
+{
+    QByteArray data;
+    {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        QDataStream ost(&buffer);
+        mNotebook->save(ost);
+    }
+    Notebook notebook(NoteStorage::create());
+    QBENCHMARK
+    {
+        QDataStream ist(data);
+        notebook.load(ist);
+    }
+    QCOMPARE(notebook.size(), mNotebook->size());
+}
+
+void TestNotebookBench::operations_data()
+{
+    QTest::addColumn<quint32>("notes");
+    QTest::newRow("1000") << quint32(1000);
+    const quint32 notes = qgetenv("TOYNOTE_BENCH_NOTES").toUInt();
+    if (notes > 0)
+    {
+        QTest::newRow(QByteArray::number(notes).constData()) << notes;
+    }
+}
+
+void TestNotebookBench::operations()
+{
+    QFETCH(quint32, notes);
+    NotebookBench bench(notes, seed, NoteStorage::defaultKind(), 1);
+    bench.setAllocationCounter(&AllocationCounter::count);
+    std::vector<NotebookBench::Result> results = bench.run([](const NotebookBench::Result &r) {
+        qInfo("%s: %.4f s, %.0f notes/s, peak %lld KiB, %lld allocations (%.1f/note)",
+              qPrintable(r.name), r.seconds, r.seconds > 0 ? r.notes / r.seconds : 0.0,
+              r.peakRss, r.allocations, r.notes > 0 ? static_cast<double>(r.allocations) / r.notes : 0.0);
+    });
+    QVERIFY(!results.empty());
+    for (const NotebookBench::Result &r : results)
+    {
+        QVERIFY(r.allocations >= 0);
+    }
+
+    const QString jsonDir = QString::fromLocal8Bit(qgetenv("TOYNOTE_BENCH_JSON"));
+    if (!jsonDir.isEmpty())
+    {
+        QFile outf(QDir(jsonDir).filePath(QStringLiteral("bench-%1.json").arg(notes)));
+        QVERIFY2(outf.open(QIODevice::WriteOnly), qPrintable(outf.errorString()));
+        outf.write(QJsonDocument(bench.toJson(results)).toJson());
+    }
+}
+
+QTEST_GUILESS_MAIN(TestNotebookBench)
+
+#include "tst_notebookbench.moc"
@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Тест производительности записной книжки
+# (QBENCHMARK и замеры NotebookBench с подсчётом
+# выделений памяти)
+#
+#-------------------------------------------------
+
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_notebookbench
+TEMPLATE = app
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+include(../../toynote.pri)
+
+SOURCES += \
+    allocationcounter.cpp \
+    tst_notebookbench.cpp \
+    $$PWD/../../notebookbench.cpp \
+    $$PWD/../../notebooktool.cpp \
+    $$PWD/../../notegenerator.cpp
+
+HEADERS += \
+    allocationcounter.hpp \
+    $$PWD/../../notebookbench.hpp \
+    $$PWD/../../notebooktool.hpp \
+    $$PWD/../../notegenerator.hpp
@@ -0,0 +1,73 @@
+/*!
+ * \file
+ * \brief Тесты класса NoteIndex.
+ */
+#include <vector>
+
+#include <QItemSelection>
+#include <QtTest>
+
+#include "notebook.hpp"
+#include "notebookhistory.hpp"
+#include "noteindex.hpp"
+
+//! Тесты полнотекстового индекса.
+class TestNoteIndex : public QObject
+{
+    Q_OBJECT
+private slots:
+    //! Заметка, удалённая и возвращённая отменой удаления, снова находится поиском.
+    void searchAfterUndoErase();
+    //! Возвращённая заметка не находится по словам, которые из неё удалены.
+    void searchAfterUndoEraseAndUpdate();
+};
+
+void TestNoteIndex::searchAfterUndoErase()
+{
+    Notebook notebook;
+    NotebookHistory history(&notebook);
+    NoteIndex index(&notebook);
+    QTRY_VERIFY(index.isReady());
+
+    history.insert(Note(QStringLiteral("Покупки"), QStringLiteral("молоко и хлеб")));
+    history.insert(Note(QStringLiteral("Работа"), QStringLiteral("отчёт")));
+    const NoteIndex::NoteId id = notebook.idAt(0);
+    const std::vector<NoteIndex::NoteId> expected{ id };
+    QVERIFY(index.search(QStringLiteral("молоко")) == expected);
+
+    history.erase(QItemSelection(notebook.index(0, 0), notebook.index(0, 0)));
+    QVERIFY(index.search(QStringLiteral("молоко")).empty());
+
+    history.undo();
+    QCOMPARE(notebook.rowOf(id), Notebook::SizeType(0));
+    QVERIFY(index.search(QStringLiteral("молоко")) == expected);
+    QVERIFY(index.search(QStringLiteral("хлеб")) == expected);
+
+    // Повтор и повторная отмена не дублируют заметку в списках
+    history.redo();
+    QVERIFY(index.search(QStringLiteral("хлеб")).empty());
+    history.undo();
+    QVERIFY(index.search(QStringLiteral("хлеб")) == expected);
+}
+
+void TestNoteIndex::searchAfterUndoEraseAndUpdate()
+{
+    Notebook notebook;
+    NotebookHistory history(&notebook);
+    NoteIndex index(&notebook);
+    QTRY_VERIFY(index.isReady());
+
+    history.insert(Note(QStringLiteral("Покупки"), QStringLiteral("молоко и хлеб")));
+    const NoteIndex::NoteId id = notebook.idAt(0);
+    history.erase(QItemSelection(notebook.index(0, 0), notebook.index(0, 0)));
+    history.undo();
+    history.update(0, Note(QStringLiteral("Покупки"), QStringLiteral("хлеб")));
+
+    const std::vector<NoteIndex::NoteId> expected{ id };
+    QVERIFY(index.search(QStringLiteral("молоко")).empty());
+    QVERIFY(index.search(QStringLiteral("хлеб")) == expected);
+}
+
+QTEST_GUILESS_MAIN(TestNoteIndex)
+
+#include "tst_noteindex.moc"
@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Тесты полнотекстового индекса NoteIndex
+#
+#-------------------------------------------------
+
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_noteindex
+TEMPLATE = app
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+include(../../toynote.pri)
+
+SOURCES += \
+    tst_noteindex.cpp \
+    $$PWD/../../notebookhistory.cpp \
+    $$PWD/../../noteindex.cpp
+
+HEADERS += \
+    $$PWD/../../notebookhistory.hpp \
+    $$PWD/../../noteindex.hpp
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Сборка всех программ: графической программы
+# toynote и консольной программы toynote-cli,
+# а также тестов из каталога tests.
+#
+# Проекты лежат в одном каталоге, поэтому qmake
+# создаёт для них отдельные файлы Makefile.toynote
+# и Makefile.toynote-cli, а объектные файлы каждой
+# программы попадают в свой подкаталог (см. toynote.pri)
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS = app cli tests
+
+app.file = toynote.pro
+cli.file = toynote-cli.pro
@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Консольная программа для пакетной обработки
+# записных книжек без графического интерфейса
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = toynote-cli
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+include(toynote.pri)
+
+SOURCES += \
+    climain.cpp \
+    notebookbench.cpp \
+    notebooktool.cpp \
+    notegenerator.cpp
+
+HEADERS += \
+    notebookbench.hpp \
+    notebooktool.hpp \
+    notegenerator.hpp
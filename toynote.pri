@@ -0,0 +1,63 @@
+#-------------------------------------------------
+#
+# Общая часть проектов toynote и toynote-cli: классы
+# заметок и записных книжек, которым нужны только
+# модули QtCore и QtConcurrent
+#
+#-------------------------------------------------
+
+QT       += core concurrent
+
+CONFIG += c++11
+
+# Пути указаны от каталога этого файла, чтобы его могли подключать
+# проекты из других каталогов (например, тесты в tests)
+INCLUDEPATH += $$PWD
+
+# Программы собираются в одном каталоге (см. toynote-all.pro) из общих
+# исходных файлов, но с разными модулями Qt, поэтому объектные файлы
+# и файлы moc каждой программы лежат в своём подкаталоге
+OBJECTS_DIR = .obj/$$TARGET
+MOC_DIR = .moc/$$TARGET
+
+SOURCES += \
+    $$PWD/arenanotestorage.cpp \
+    $$PWD/crc32c.cpp \
+    $$PWD/note.cpp \
+    $$PWD/notebook.cpp \
+    $$PWD/notebookfile.cpp \
+    $$PWD/notecodec.cpp \
+    $$PWD/notedecoder.cpp \
+    $$PWD/noteexporter.cpp \
+    $$PWD/noteimporter.cpp \
+    $$PWD/notescanner.cpp \
+    $$PWD/notestorage.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/vectornotestorage.cpp \
+    $$PWD/workerpool.cpp
+
+HEADERS += \
+    $$PWD/arenanotestorage.hpp \
+    $$PWD/config.hpp \
+    $$PWD/crc32c.hpp \
+    $$PWD/note.hpp \
+    $$PWD/notebook.hpp \
+    $$PWD/notebookfile.hpp \
+    $$PWD/notecodec.hpp \
+    $$PWD/notedecoder.hpp \
+    $$PWD/noteexporter.hpp \
+    $$PWD/noteimporter.hpp \
+    $$PWD/notescanner.hpp \
+    $$PWD/notestorage.hpp \
+    $$PWD/trace.hpp \
+    $$PWD/vectornotestorage.hpp \
+    $$PWD/workerpool.hpp
+
+# Хранилище заметок SQLite (см. NoteStorage::create()) собирается,
+# только если доступен модуль QtSql
+qtHaveModule(sql) {
+    QT += sql
+    DEFINES += TOYNOTE_SQLITE
+    SOURCES += $$PWD/sqlitenotestorage.cpp
+    HEADERS += $$PWD/sqlitenotestorage.hpp
+}
@@ -4,26 +4,43 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = toynote
 TEMPLATE = app
 
+include(toynote.pri)
+
 SOURCES += main.cpp\
     loteryprocessor.cpp \
         mainwindow.cpp \
-    notebook.cpp \
-    note.cpp \
+    notebookexporter.cpp \
+    notebookhistory.cpp \
+    notebookjournal.cpp \
+    notebookloader.cpp \
+    notebooksaver.cpp \
+    notefiltermodel.cpp \
+    noteindex.cpp \
+    notepreview.cpp \
+    notesortmodel.cpp \
+    workspacewindow.cpp \
     editnotedialog.cpp
 
 HEADERS  += \
     loteryprocessor.h \
     mainwindow.hpp \
-    notebook.hpp \
-    note.hpp \
-    config.hpp \
+    notebookexporter.hpp \
+    notebookhistory.hpp \
+    notebookjournal.hpp \
+    notebookloader.hpp \
+    notebooksaver.hpp \
+    notefiltermodel.hpp \
+    noteindex.hpp \
+    notepreview.hpp \
+    notesortmodel.hpp \
+    workspacewindow.hpp \
     editnotedialog.hpp
 
 FORMS    += mainwindow.ui \
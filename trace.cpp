@@ -0,0 +1,282 @@
+/*!
+ * \file
+ * \brief Файл реализации трассировки.
+ */
+#include "trace.hpp"
+
+#include <chrono>
+#include <memory> // unique_ptr
+#include <stdexcept> // runtime_error
+#include <vector>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+
+#include "config.hpp"
+
+std::atomic<bool> Trace::sEnabled(false);
+
+namespace
+{
+
+//! Интервал трассировки.
+struct Event
+{
+    //! Имя.
+    const char *name;
+    //! Уточнение или нулевой указатель.
+    const char *detail;
+    //! Время начала в наносекундах.
+    qint64 start;
+    //! Время окончания в наносекундах.
+    qint64 end;
+};
+
+//! Количество интервалов в блоке буфера.
+const std::size_t blockSize = 4096;
+
+//! Блок буфера интервалов.
+struct Block
+{
+    //! Интервалы.
+    Event events[blockSize];
+    //! Следующий блок или нулевой указатель.
+    Block *next = nullptr;
+};
+
+/*!
+ * \brief Буфер интервалов одного потока.
+ *
+ * Пишет в буфер только его поток, а читает stop() из другого потока.
+ * Интервал публикуется увеличением счётчика после записи, поэтому читатель
+ * видит только полностью записанные интервалы, а блоки никогда не
+ * перемещаются.
+ */
+class ThreadBuffer
+{
+public:
+    //! Конструктор. \a tid — номер потока в файле трассировки, \a name — имя потока.
+    ThreadBuffer(int tid, const QString &name)
+        : mTid(tid)
+        , mName(name)
+        , mHead(new Block)
+        , mTail(mHead)
+        , mCount(0)
+    {
+    }
+    ~ThreadBuffer()
+    {
+        while (mHead)
+        {
+            Block *next = mHead->next;
+            delete mHead;
+            mHead = next;
+        }
+    }
+    ThreadBuffer(const ThreadBuffer &) = delete;
+    ThreadBuffer &operator=(const ThreadBuffer &) = delete;
+
+    //! Возвращает номер потока.
+    int tid() const
+    {
+        return mTid;
+    }
+    //! Возвращает имя потока.
+    const QString &name() const
+    {
+        return mName;
+    }
+    //! Добавляет интервал \a event. Вызывается только потоком буфера.
+    void append(const Event &event)
+    {
+        std::size_t n = mCount.load(std::memory_order_relaxed);
+        std::size_t i = n % blockSize;
+        if (n > 0 && i == 0)
+        {
+            mTail->next = new Block;
+            mTail = mTail->next;
+        }
+        mTail->events[i] = event;
+        mCount.store(n + 1, std::memory_order_release);
+    }
+    //! Вызывает \a f для каждого опубликованного интервала.
+    template <typename Function>
+    void forEach(Function f) const
+    {
+        std::size_t n = mCount.load(std::memory_order_acquire);
+        const Block *block = mHead;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (i > 0 && i % blockSize == 0)
+            {
+                block = block->next;
+            }
+            f(block->events[i % blockSize]);
+        }
+    }
+
+private:
+    //! Номер потока.
+    int mTid;
+    //! Имя потока.
+    QString mName;
+    //! Первый блок.
+    Block *mHead;
+    //! Последний блок (используется только потоком буфера).
+    Block *mTail;
+    //! Количество опубликованных интервалов.
+    std::atomic<std::size_t> mCount;
+};
+
+//! Общее состояние трассировки.
+struct Registry
+{
+    //! Мьютекс, защищающий остальные поля.
+    QMutex mutex;
+    //! Буферы всех потоков, когда-либо записывавших интервалы. Удаляются только при завершении программы.
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    //! Имя файла трассировки.
+    QString fileName;
+    //! Время включения трассировки.
+    qint64 origin = 0;
+    //! Признак того, что трассировка уже включалась.
+    bool started = false;
+};
+
+//! Возвращает общее состояние трассировки.
+Registry &registry()
+{
+    static Registry r;
+    return r;
+}
+
+//! Буфер текущего потока или нулевой указатель, если поток ещё не записывал интервалы.
+thread_local ThreadBuffer *threadBuffer = nullptr;
+
+//! Регистрирует буфер текущего потока.
+ThreadBuffer *registerThread()
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    int tid = static_cast<int>(r.buffers.size());
+    QThread *thread = QThread::currentThread();
+    QString name = thread->objectName();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+    {
+        name = QStringLiteral("main");
+    }
+    else if (name.isEmpty())
+    {
+        name = QStringLiteral("thread %1").arg(tid);
+    }
+    r.buffers.emplace_back(new ThreadBuffer(tid, name));
+    return r.buffers.back().get();
+}
+
+//! Возвращает строку \a s в кавычках JSON.
+QString quoted(QString s)
+{
+    s.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    s.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    return QLatin1Char('"') + s + QLatin1Char('"');
+}
+
+//! Возвращает время \a ns в наносекундах как число микросекунд.
+QString microseconds(qint64 ns)
+{
+    return QString::number(ns / 1000.0, 'f', 3);
+}
+
+}
+
+void Trace::start(const QString &fileName)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    if (r.started)
+    {
+        return;
+    }
+    r.started = true;
+    r.fileName = fileName;
+    r.origin = now();
+    sEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool Trace::startFromEnvironment()
+{
+    QByteArray fileName = qgetenv(Config::traceVariable);
+    if (fileName.isEmpty())
+    {
+        return false;
+    }
+    start(QString::fromLocal8Bit(fileName));
+    return true;
+}
+
+/*!
+ * Интервалы записываются событиями вида \c "X" (complete event), имена
+ * потоков — событиями метаданных \c "thread_name". Время отсчитывается
+ * от включения трассировки.
+ */
+void Trace::stop()
+{
+    if (!sEnabled.exchange(false))
+    {
+        return;
+    }
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    QSaveFile f(r.fileName);
+    if (!f.open(QIODevice::WriteOnly))
+    {
+        throw std::runtime_error(tr("Unable to open %1: %2").arg(r.fileName, f.errorString()).toStdString());
+    }
+    QTextStream ost(&f);
+    ost.setCodec("UTF-8");
+    const QString pid = QString::number(QCoreApplication::applicationPid());
+    ost << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::unique_ptr<ThreadBuffer> &buffer : r.buffers)
+    {
+        const QString tid = QString::number(buffer->tid());
+        ost << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+            << ",\"tid\":" << tid << ",\"args\":{\"name\":" << quoted(buffer->name()) << "}}";
+        first = false;
+        buffer->forEach([&](const Event &e) {
+            ost << ",\n{\"name\":" << quoted(QString::fromUtf8(e.name)) << ",\"ph\":\"X\",\"ts\":"
+                << microseconds(e.start - r.origin) << ",\"dur\":" << microseconds(e.end - e.start)
+                << ",\"pid\":" << pid << ",\"tid\":" << tid;
+            if (e.detail)
+            {
+                ost << ",\"args\":{\"detail\":" << quoted(QString::fromUtf8(e.detail)) << '}';
+            }
+            ost << '}';
+        });
+    }
+    ost << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    ost.flush();
+    if (!f.commit())
+    {
+        throw std::runtime_error(tr("Unable to commit the save").toStdString());
+    }
+}
+
+qint64 Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char *name, const char *detail, qint64 start, qint64 end)
+{
+    if (!threadBuffer)
+    {
+        threadBuffer = registerThread();
+    }
+    threadBuffer->append(Event{ name, detail, start, end });
+}
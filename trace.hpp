@@ -0,0 +1,126 @@
+/*!
+ * \file
+ * \brief Заголовочный файл трассировки: классы Trace и TraceScope, макрос TRACE_SCOPE.
+ */
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+
+#include <QCoreApplication> // Q_DECLARE_TR_FUNCTIONS
+#include <QString>
+
+/*!
+ * \brief Класс трассировки.
+ *
+ * Трассировка записывает \e интервалы — время начала и продолжительность
+ * именованных участков программы (см. TRACE_SCOPE) вместе с номером
+ * потока. Каждый поток пишет в собственный буфер без блокировок; буфер
+ * растёт блоками, которые не перемещаются, поэтому запись интервала — это
+ * копирование нескольких полей. По окончании (stop()) интервалы всех
+ * потоков записываются в файл в формате JSON Chrome \c trace_event,
+ * который открывается в Perfetto или chrome://tracing.
+ *
+ * Пока трассировка не включена, интервал стоит одного чтения атомарного
+ * флага. Трассировку можно включить один раз за время работы программы.
+ */
+class Trace
+{
+    // Объявляет метод tr() для перевода строк, так как класс не является
+    // потомком QObject
+    Q_DECLARE_TR_FUNCTIONS(Trace)
+public:
+    //! Возвращает \c true, если трассировка включена.
+    static bool isEnabled()
+    {
+        return sEnabled.load(std::memory_order_relaxed);
+    }
+    /*!
+     * \brief Включает трассировку. По окончании интервалы будут записаны в файл \a fileName.
+     *
+     * Повторные вызовы игнорируются.
+     */
+    static void start(const QString &fileName);
+    /*!
+     * \brief Включает трассировку, если задана переменная окружения Config::traceVariable.
+     *
+     * Возвращает \c true, если трассировка включена.
+     */
+    static bool startFromEnvironment();
+    /*!
+     * \brief Выключает трассировку и записывает интервалы в файл.
+     *
+     * Интервалы, не закончившиеся к этому моменту, не записываются. Если
+     * трассировка не включена, ничего не делает. В случае ошибки запускает
+     * исключительную ситуацию.
+     */
+    static void stop();
+    //! Возвращает время монотонных часов в наносекундах.
+    static qint64 now();
+    /*!
+     * \brief Записывает интервал \a name с \a start по \a end (см. now()) в буфер текущего потока.
+     *
+     * Строки \a name и \a detail должны существовать до окончания
+     * трассировки, обычно это строковые литералы. \a detail может быть
+     * нулевым указателем.
+     */
+    static void record(const char *name, const char *detail, qint64 start, qint64 end);
+
+private:
+    //! Признак включённой трассировки.
+    static std::atomic<bool> sEnabled;
+};
+
+/*!
+ * \brief Класс интервала трассировки, охватывающего область видимости.
+ *
+ * Запоминает время в конструкторе и записывает интервал в деструкторе,
+ * если трассировка была включена при создании объекта. Обычно создаётся
+ * макросом TRACE_SCOPE.
+ */
+class TraceScope
+{
+public:
+    /*!
+     * \brief Конструктор.
+     * \param name Имя интервала.
+     * \param detail Уточнение (например, имя класса) или нулевой указатель.
+     */
+    explicit TraceScope(const char *name, const char *detail = nullptr)
+        : mName(Trace::isEnabled() ? name : nullptr)
+        , mDetail(detail)
+        , mStart(mName ? Trace::now() : 0)
+    {
+    }
+    //! Деструктор. Записывает интервал.
+    ~TraceScope()
+    {
+        if (mName)
+        {
+            Trace::record(mName, mDetail, mStart, Trace::now());
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    //! Имя интервала или нулевой указатель, если трассировка выключена.
+    const char *mName;
+    //! Уточнение.
+    const char *mDetail;
+    //! Время начала.
+    qint64 mStart;
+};
+
+//! Вспомогательные макросы для составления имени переменной TRACE_SCOPE.
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/*!
+ * \brief Записывает интервал трассировки от этого места до конца области видимости.
+ *
+ * Аргументы передаются конструктору TraceScope: имя и, возможно, уточнение.
+ */
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+#endif // TRACE_HPP
@@ -0,0 +1,118 @@
+/*!
+ * \file
+ * \brief Файл реализации класса VectorNoteStorage.
+ */
+#include "vectornotestorage.hpp"
+
+#include <iterator> // next(), make_move_iterator()
+#include <utility> // move()
+
+#include <QtConcurrent/QtConcurrentMap>
+
+VectorNoteStorage::VectorNoteStorage()
+    : mTextCompression(false)
+{
+}
+
+VectorNoteStorage::SizeType VectorNoteStorage::size() const
+{
+    return mNotes.size();
+}
+
+Note VectorNoteStorage::note(SizeType idx) const
+{
+    return mNotes[idx];
+}
+
+QString VectorNoteStorage::title(SizeType idx) const
+{
+    return mNotes[idx].title();
+}
+
+QString VectorNoteStorage::text(SizeType idx) const
+{
+    return mNotes[idx].text();
+}
+
+std::vector<Note> VectorNoteStorage::snapshot() const
+{
+    return mNotes;
+}
+
+void VectorNoteStorage::set(SizeType idx, Note note)
+{
+    prepare(note);
+    mNotes[idx] = std::move(note);
+}
+
+void VectorNoteStorage::insert(SizeType idx, Note note)
+{
+    prepare(note);
+    mNotes.insert(std::next(mNotes.begin(), idx), std::move(note));
+}
+
+void VectorNoteStorage::append(std::vector<Note> notes)
+{
+    SizeType first = mNotes.size();
+    // Перемещаем заметки в конец вектора, не копируя их
+    mNotes.insert(mNotes.end(), std::make_move_iterator(notes.begin()),
+                  std::make_move_iterator(notes.end()));
+    // Загрузчик сжимает тексты в рабочем потоке, здесь они обычно уже сжаты
+    for (auto it = std::next(mNotes.begin(), first); it != mNotes.end(); ++it)
+    {
+        prepare(*it);
+    }
+}
+
+void VectorNoteStorage::insertMany(SizeType idx, std::vector<Note> notes)
+{
+    for (Note &note : notes)
+    {
+        prepare(note);
+    }
+    // Вектор сдвигает хвост один раз для всех заметок
+    mNotes.insert(std::next(mNotes.begin(), idx), std::make_move_iterator(notes.begin()),
+                  std::make_move_iterator(notes.end()));
+}
+
+void VectorNoteStorage::reserve(SizeType size)
+{
+    mNotes.reserve(size);
+}
+
+void VectorNoteStorage::move(SizeType from, SizeType to)
+{
+    mNotes[to] = std::move(mNotes[from]);
+}
+
+void VectorNoteStorage::resize(SizeType size)
+{
+    mNotes.resize(size);
+}
+
+void VectorNoteStorage::erase(SizeType first, SizeType last)
+{
+    mNotes.erase(std::next(mNotes.begin(), first), std::next(mNotes.begin(), last));
+}
+
+void VectorNoteStorage::clear()
+{
+    mNotes.clear();
+}
+
+void VectorNoteStorage::setTextCompression(bool on)
+{
+    if (on && !mTextCompression)
+    {
+        QtConcurrent::blockingMap(mNotes, [](Note &note) { note.compressText(); });
+    }
+    mTextCompression = on;
+}
+
+void VectorNoteStorage::prepare(Note &note) const
+{
+    if (mTextCompression)
+    {
+        note.compressText();
+    }
+}
@@ -0,0 +1,59 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса VectorNoteStorage.
+ */
+#ifndef VECTORNOTESTORAGE_HPP
+#define VECTORNOTESTORAGE_HPP
+
+#include <vector>
+
+#include "notestorage.hpp"
+
+/*!
+ * \brief Хранилище заметок в векторе объектов Note.
+ *
+ * Каждая заметка хранит свои заголовок и текст в отдельных строках
+ * QString или читает их из источника (ленивые заметки файла версии 2,
+ * сжатые тексты). Перенос и копирование заметок дёшевы благодаря неявному
+ * разделению данных QString, а снимок — просто копия вектора.
+ */
+class VectorNoteStorage : public NoteStorage
+{
+public:
+    //! Конструктор по умолчанию.
+    VectorNoteStorage();
+
+    SizeType size() const Q_DECL_OVERRIDE;
+    Note note(SizeType idx) const Q_DECL_OVERRIDE;
+    QString title(SizeType idx) const Q_DECL_OVERRIDE;
+    QString text(SizeType idx) const Q_DECL_OVERRIDE;
+    std::vector<Note> snapshot() const Q_DECL_OVERRIDE;
+    void set(SizeType idx, Note note) Q_DECL_OVERRIDE;
+    void insert(SizeType idx, Note note) Q_DECL_OVERRIDE;
+    void append(std::vector<Note> notes) Q_DECL_OVERRIDE;
+    void insertMany(SizeType idx, std::vector<Note> notes) Q_DECL_OVERRIDE;
+    void reserve(SizeType size) Q_DECL_OVERRIDE;
+    void move(SizeType from, SizeType to) Q_DECL_OVERRIDE;
+    void resize(SizeType size) Q_DECL_OVERRIDE;
+    void erase(SizeType first, SizeType last) Q_DECL_OVERRIDE;
+    void clear() Q_DECL_OVERRIDE;
+    /*!
+     * \brief Включает или выключает сжатие текстов заметок (см. Note::compressText()).
+     *
+     * При включении тексты всех заметок сжимаются параллельно, в пуле потоков
+     * QtConcurrent, а затем сжимаются тексты помещаемых в хранилище заметок.
+     * При выключении уже сжатые тексты остаются сжатыми.
+     */
+    void setTextCompression(bool on) Q_DECL_OVERRIDE;
+
+private:
+    //! Сжимает текст заметки \a note, если сжатие включено.
+    void prepare(Note &note) const;
+
+    //! Заметки.
+    std::vector<Note> mNotes;
+    //! Признак сжатия текстов заметок.
+    bool mTextCompression;
+};
+
+#endif // VECTORNOTESTORAGE_HPP
@@ -0,0 +1,144 @@
+/*!
+ * \file
+ * \brief Файл реализации класса WorkerPool.
+ */
+#include "workerpool.hpp"
+
+#include <algorithm> // max()
+#include <utility> // move()
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+#include "config.hpp"
+
+//! Задача, переданная пулу потоков Qt. Сообщает пулу WorkerPool о своём завершении.
+class WorkerPool::Runnable : public QRunnable
+{
+public:
+    //! Конструктор задачи \a task владельца \a owner пула \a pool.
+    Runnable(WorkerPool *pool, const void *owner, Task task)
+        : mPool(pool)
+        , mOwner(owner)
+        , mTask(std::move(task))
+    {
+    }
+    //! Выполняет задачу.
+    void run() Q_DECL_OVERRIDE
+    {
+        mTask();
+        // Задача может держать ресурсы владельца, освобождаем их до того,
+        // как владелец узнает о завершении
+        mTask = Task();
+        mPool->finished(mOwner);
+    }
+
+private:
+    //! Пул, которому принадлежит задача.
+    WorkerPool *mPool;
+    //! Владелец задачи.
+    const void *mOwner;
+    //! Задача.
+    Task mTask;
+};
+
+WorkerPool &WorkerPool::instance()
+{
+    static WorkerPool pool(Config::workerThreads);
+    return pool;
+}
+
+WorkerPool::WorkerPool(int maxThreads)
+    : mRunning(0)
+    , mMaxThreads(maxThreads > 0 ? maxThreads : std::max(QThread::idealThreadCount(), 1))
+    , mMaxPerOwner(std::max((mMaxThreads + 1) / 2, 1))
+{
+    mPool.setMaxThreadCount(mMaxThreads);
+}
+
+WorkerPool::~WorkerPool()
+{
+    waitForDone();
+}
+
+int WorkerPool::maxThreadCount() const
+{
+    return mMaxThreads;
+}
+
+int WorkerPool::maxThreadsPerOwner() const
+{
+    return mMaxPerOwner;
+}
+
+void WorkerPool::start(const void *owner, Task task)
+{
+    QMutexLocker lock(&mMutex);
+    // Новая очередь начинает с нулём выполняющихся задач
+    Queue &queue = mQueues.emplace(owner, Queue{ std::deque<Task>(), 0 }).first->second;
+    if (queue.tasks.empty())
+    {
+        mOrder.push_back(owner);
+    }
+    queue.tasks.push_back(std::move(task));
+    dispatch();
+}
+
+void WorkerPool::waitForDone()
+{
+    QMutexLocker lock(&mMutex);
+    while (!mQueues.empty())
+    {
+        mIdle.wait(&mMutex);
+    }
+}
+
+/*!
+ * Владельцы обходятся по кругу, по одной задаче за раз. Владелец, уже
+ * занявший свою долю потоков, пропускается; обход заканчивается, когда
+ * потоки заняты или все ожидающие владельцы пропущены подряд.
+ */
+void WorkerPool::dispatch()
+{
+    std::size_t skipped = 0;
+    while (mRunning < mMaxThreads && skipped < mOrder.size())
+    {
+        const void *owner = mOrder.front();
+        mOrder.pop_front();
+        Queue &queue = mQueues[owner];
+        if (queue.running >= mMaxPerOwner)
+        {
+            mOrder.push_back(owner);
+            ++skipped;
+            continue;
+        }
+        skipped = 0;
+        Task task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        if (!queue.tasks.empty())
+        {
+            mOrder.push_back(owner);
+        }
+        ++queue.running;
+        ++mRunning;
+        mPool.start(new Runnable(this, owner, std::move(task)));
+    }
+}
+
+void WorkerPool::finished(const void *owner)
+{
+    QMutexLocker lock(&mMutex);
+    auto it = mQueues.find(owner);
+    --it->second.running;
+    --mRunning;
+    if (it->second.running == 0 && it->second.tasks.empty())
+    {
+        mQueues.erase(it);
+    }
+    dispatch();
+    if (mQueues.empty())
+    {
+        mIdle.wakeAll();
+    }
+}
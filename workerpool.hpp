@@ -0,0 +1,123 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса WorkerPool.
+ */
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <deque>
+#include <functional> // function
+#include <unordered_map>
+
+#include <QFuture>
+#include <QFutureInterface>
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/*!
+ * \brief Класс общего пула рабочих потоков для фоновой работы записных книжек.
+ *
+ * Загрузка, сохранение и индексирование записных книжек всех вкладок
+ * рабочей области выполняются в одном пуле с ограниченным количеством
+ * потоков (Config::workerThreads). Задачи ставятся в очередь от имени
+ * \e владельца — объекта, для которого выполняется работа (записной книжки,
+ * объекта сохранения). У каждого владельца своя очередь, а свободный поток
+ * получает задачу следующего по кругу владельца, поэтому владелец с
+ * длинной очередью не задерживает задачи остальных. Кроме того, задачи
+ * одного владельца занимают не больше половины потоков пула: пока большая
+ * записная книжка загружается, для маленькой всегда остаётся свободный
+ * поток.
+ *
+ * Длинную работу следует делить на задачи (см. NotebookLoader): тогда
+ * потоки переходят к задачам других владельцев между частями работы.
+ *
+ * Параллельные циклы внутри задач (QtConcurrent::blockingMap() и т. п.)
+ * по-прежнему выполняются в глобальном пуле QtConcurrent.
+ */
+class WorkerPool
+{
+public:
+    //! Тип задачи.
+    using Task = std::function<void()>;
+
+    //! Возвращает общий пул программы.
+    static WorkerPool &instance();
+
+    /*!
+     * \brief Конструктор.
+     *
+     * Пул использует не больше \a maxThreads потоков; если \a maxThreads
+     * не больше 0, количество потоков равно количеству ядер процессора.
+     */
+    explicit WorkerPool(int maxThreads = 0);
+    //! Деструктор. Дожидается выполнения всех задач.
+    ~WorkerPool();
+
+    //! Возвращает наибольшее количество потоков пула.
+    int maxThreadCount() const;
+    //! Возвращает наибольшее количество потоков, одновременно занятых задачами одного владельца.
+    int maxThreadsPerOwner() const;
+    //! Ставит задачу \a task владельца \a owner в очередь.
+    void start(const void *owner, Task task);
+    /*!
+     * \brief Ставит функцию \a f владельца \a owner в очередь и возвращает её будущий результат.
+     *
+     * Результат можно отслеживать через QFutureWatcher так же, как результат
+     * QtConcurrent::run(). Функция не должна запускать исключительных
+     * ситуаций.
+     */
+    template <typename T>
+    QFuture<T> run(const void *owner, std::function<T()> f);
+    //! Дожидается выполнения всех задач.
+    void waitForDone();
+
+private:
+    //! Задача, переданная пулу потоков Qt.
+    class Runnable;
+    //! Очередь задач владельца.
+    struct Queue
+    {
+        //! Задачи, ожидающие выполнения.
+        std::deque<Task> tasks;
+        //! Количество выполняющихся задач.
+        int running;
+    };
+
+    //! Запускает ожидающие задачи, пока есть свободные потоки. Вызывается под mMutex.
+    void dispatch();
+    //! Обрабатывает завершение задачи владельца \a owner.
+    void finished(const void *owner);
+
+    //! Мьютекс, защищающий очереди и счётчики.
+    QMutex mMutex;
+    //! Условие завершения всех задач.
+    QWaitCondition mIdle;
+    //! Очереди владельцев, у которых есть ожидающие или выполняющиеся задачи.
+    std::unordered_map<const void *, Queue> mQueues;
+    //! Владельцы с ожидающими задачами в порядке обхода по кругу.
+    std::deque<const void *> mOrder;
+    //! Количество выполняющихся задач.
+    int mRunning;
+    //! Наибольшее количество потоков.
+    int mMaxThreads;
+    //! Наибольшее количество потоков одного владельца.
+    int mMaxPerOwner;
+    //! Пул потоков Qt, в котором выполняются задачи.
+    QThreadPool mPool;
+};
+
+template <typename T>
+QFuture<T> WorkerPool::run(const void *owner, std::function<T()> f)
+{
+    QFutureInterface<T> promise;
+    promise.reportStarted();
+    QFuture<T> future = promise.future();
+    start(owner, [promise, f]() mutable {
+        promise.reportResult(f());
+        promise.reportFinished();
+    });
+    return future;
+}
+
+#endif // WORKERPOOL_HPP
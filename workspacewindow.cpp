@@ -0,0 +1,209 @@
+/*!
+ * \file
+ * \brief Файл реализации класса WorkspaceWindow.
+ */
+#include "workspacewindow.hpp"
+
+#include <utility> // move()
+#include <vector>
+
+#include <QAction>
+#include <QCloseEvent>
+#include <QFileDialog>
+#include <QKeySequence>
+#include <QMenu>
+#include <QMenuBar>
+#include <QMessageBox>
+#include <QPointer>
+#include <QTabWidget>
+
+#include "config.hpp"
+#include "mainwindow.hpp"
+
+WorkspaceWindow::WorkspaceWindow(QWidget *parent)
+    : QMainWindow(parent)
+{
+    mTabs = new QTabWidget(this);
+    mTabs->setDocumentMode(true);
+    mTabs->setTabsClosable(true);
+    mTabs->setMovable(true);
+    setCentralWidget(mTabs);
+    connect(mTabs, &QTabWidget::tabCloseRequested, this, &WorkspaceWindow::closeTab);
+    connect(mTabs, &QTabWidget::currentChanged, this, &WorkspaceWindow::currentTabChanged);
+
+    mWorkspaceMenu = new QMenu(tr("&Workspace"), this);
+    mWorkspaceMenu->addAction(tr("New &Tab"), this, &WorkspaceWindow::newTab, QKeySequence(tr("Ctrl+T")));
+    mWorkspaceMenu->addAction(tr("&Open in New Tabs..."), this, &WorkspaceWindow::openInTabs, QKeySequence(tr("Ctrl+Shift+O")));
+    mWorkspaceMenu->addAction(tr("&Close Tab"), this, [this]() {
+        closeTab(mTabs->currentIndex());
+    }, QKeySequence(tr("Ctrl+W")));
+    mWorkspaceMenu->addSeparator();
+    mCopyMenu = mWorkspaceMenu->addMenu(tr("Co&py Selected Notes To"));
+    connect(mCopyMenu, &QMenu::aboutToShow, this, &WorkspaceWindow::fillCopyMenu);
+
+    resize(800, 600);
+    newTab();
+}
+
+void WorkspaceWindow::openFiles(const QStringList &fileNames)
+{
+    for (const QString &fileName : fileNames)
+    {
+        // Каждый файл загружается в своей вкладке, загрузки идут одновременно
+        MainWindow *target = tab(mTabs->currentIndex());
+        if (!target || !target->isNotebookEmpty())
+        {
+            target = newTab();
+        }
+        target->openNotebookFile(fileName);
+    }
+}
+
+void WorkspaceWindow::closeEvent(QCloseEvent *event)
+{
+    for (int i = 0; i < mTabs->count(); ++i)
+    {
+        // Показываем вкладку, о записной книжке которой спрашиваем
+        mTabs->setCurrentIndex(i);
+        if (!tab(i)->prepareToClose())
+        {
+            event->ignore();
+            return;
+        }
+    }
+    event->accept();
+}
+
+bool WorkspaceWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::WindowTitleChange || event->type() == QEvent::ModifiedChange)
+    {
+        if (MainWindow *w = qobject_cast<MainWindow *>(watched))
+        {
+            updateTabTitle(w);
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+MainWindow *WorkspaceWindow::newTab()
+{
+    MainWindow *w = new MainWindow;
+    // Окно записной книжки становится обычным виджетом внутри вкладки, а его
+    // меню показывается в строке меню рабочей области
+    w->setWindowFlags(Qt::Widget);
+    w->menuBar()->hide();
+    w->installEventFilter(this);
+    int index = mTabs->addTab(w, QString());
+    updateTabTitle(w);
+    mTabs->setCurrentIndex(index);
+    return w;
+}
+
+void WorkspaceWindow::openInTabs()
+{
+    openFiles(QFileDialog::getOpenFileNames(this, tr("Open Notebooks"), QString(), Config::notebookFileNameFilter));
+}
+
+bool WorkspaceWindow::closeTab(int index)
+{
+    MainWindow *w = tab(index);
+    if (!w || !w->prepareToClose())
+    {
+        return false;
+    }
+    mTabs->removeTab(index);
+    w->deleteLater();
+    // В рабочей области всегда есть хотя бы одна вкладка
+    if (mTabs->count() == 0)
+    {
+        newTab();
+    }
+    return true;
+}
+
+void WorkspaceWindow::currentTabChanged(int index)
+{
+    // Меню вкладки принадлежат её окну, поэтому clear() их не удаляет
+    menuBar()->clear();
+    if (MainWindow *w = tab(index))
+    {
+        for (QAction *action : w->menuBar()->actions())
+        {
+            menuBar()->addAction(action);
+        }
+    }
+    menuBar()->addMenu(mWorkspaceMenu);
+    updateWindowTitle();
+}
+
+void WorkspaceWindow::fillCopyMenu()
+{
+    mCopyMenu->clear();
+    for (int i = 0; i < mTabs->count(); ++i)
+    {
+        if (i == mTabs->currentIndex())
+        {
+            continue;
+        }
+        // Вкладка может закрыться раньше, чем пользователь выберет пункт
+        QPointer<MainWindow> target = tab(i);
+        mCopyMenu->addAction(mTabs->tabText(i), this, [this, target]() {
+            if (target)
+            {
+                copySelectedNotes(target);
+            }
+        });
+    }
+    if (mCopyMenu->isEmpty())
+    {
+        mCopyMenu->addAction(tr("No Other Tabs"))->setEnabled(false);
+    }
+}
+
+MainWindow *WorkspaceWindow::tab(int index) const
+{
+    return qobject_cast<MainWindow *>(mTabs->widget(index));
+}
+
+void WorkspaceWindow::updateTabTitle(MainWindow *tab)
+{
+    int index = mTabs->indexOf(tab);
+    if (index < 0)
+    {
+        return;
+    }
+    QString name = tab->isNotebookOpen() ? tab->notebookName() : tr("No Notebook");
+    mTabs->setTabText(index, tab->isWindowModified() ? name + QLatin1Char('*') : name);
+    if (index == mTabs->currentIndex())
+    {
+        updateWindowTitle();
+    }
+}
+
+void WorkspaceWindow::updateWindowTitle()
+{
+    MainWindow *w = tab(mTabs->currentIndex());
+    // Заголовок окна вкладки содержит метку "[*]" для признака изменения
+    setWindowTitle(w ? w->windowTitle() : QString(Config::applicationName));
+    setWindowModified(w && w->isWindowModified());
+}
+
+void WorkspaceWindow::copySelectedNotes(MainWindow *target)
+{
+    MainWindow *source = tab(mTabs->currentIndex());
+    if (!source)
+    {
+        return;
+    }
+    std::vector<Note> notes = source->selectedNotes();
+    if (notes.empty())
+    {
+        return;
+    }
+    if (!target->appendNotes(std::move(notes)))
+    {
+        QMessageBox::warning(this, Config::applicationName,
+                             tr("The notebook %1 is not ready for new notes").arg(target->notebookName()));
+    }
+}
@@ -0,0 +1,80 @@
+/*!
+ * \file
+ * \brief Заголовочный файл класса WorkspaceWindow.
+ */
+#ifndef WORKSPACEWINDOW_HPP
+#define WORKSPACEWINDOW_HPP
+
+#include <QMainWindow>
+#include <QStringList>
+
+class MainWindow;
+class QMenu;
+class QTabWidget;
+
+/*!
+ * \brief Класс окна рабочей области с несколькими записными книжками.
+ *
+ * Каждая вкладка окна — отдельное окно записной книжки MainWindow со своей
+ * таблицей заметок, панелью инструментов и строкой состояния. Строка меню
+ * рабочей области показывает меню текущей вкладки и меню \e Workspace,
+ * через которое открываются и закрываются вкладки и копируются заметки
+ * между записными книжками.
+ *
+ * Записные книжки всех вкладок загружаются, сохраняются и индексируются
+ * в общем пуле потоков (см. WorkerPool), поэтому несколько файлов,
+ * открытых одновременно, загружаются параллельно.
+ */
+class WorkspaceWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    //! Конструктор с необязательным указанием родительского объекта \a parent.
+    explicit WorkspaceWindow(QWidget *parent = nullptr);
+
+    /*!
+     * \brief Открывает файлы \a fileNames, каждый в своей вкладке.
+     *
+     * Первый файл открывается в текущей вкладке, если её записная книжка
+     * новая и пустая. Файлы загружаются одновременно.
+     */
+    void openFiles(const QStringList &fileNames);
+
+protected:
+    //! Предлагает сохранить записные книжки всех вкладок перед закрытием окна.
+    void closeEvent(QCloseEvent *event) Q_DECL_OVERRIDE;
+    //! Обновляет надпись вкладки при изменении заголовка или признака изменения её окна.
+    bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
+
+private slots:
+    //! Создаёт вкладку с новой записной книжкой и делает её текущей.
+    MainWindow *newTab();
+    //! Открывает выбранные пользователем файлы в новых вкладках.
+    void openInTabs();
+    //! Закрывает вкладку \a index. Возвращает \c false, если пользователь отменил закрытие.
+    bool closeTab(int index);
+    //! Показывает в строке меню меню вкладки \a index.
+    void currentTabChanged(int index);
+    //! Заполняет меню копирования заметок списком остальных вкладок.
+    void fillCopyMenu();
+
+private:
+    //! Возвращает окно вкладки \a index или \c nullptr.
+    MainWindow *tab(int index) const;
+    //! Обновляет надпись вкладки \a tab.
+    void updateTabTitle(MainWindow *tab);
+    //! Обновляет заголовок окна по текущей вкладке.
+    void updateWindowTitle();
+    //! Копирует выбранные заметки текущей вкладки в записную книжку вкладки \a target.
+    void copySelectedNotes(MainWindow *target);
+
+    //! Вкладки записных книжек.
+    QTabWidget *mTabs;
+    //! Меню рабочей области.
+    QMenu *mWorkspaceMenu;
+    //! Меню копирования выбранных заметок в другую вкладку.
+    QMenu *mCopyMenu;
+};
+
+#endif // WORKSPACEWINDOW_HPP